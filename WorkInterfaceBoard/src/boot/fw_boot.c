@@ -0,0 +1,230 @@
+/*
+ * fw_boot.c
+ *
+ * CAN bootloader, linked on its own with fw_boot.ld into the first 15 KB of
+ * flash (config/conf_fw_update.h). Not part of the application project:
+ * "make -f Makefile.simple boot" in Debug/ builds fw_boot.elf/.bin/.hex from
+ * this file, fw_image.c, fw_update.c, fw_flash_efc.c, can_isotp_link.c,
+ * can_bittiming.c and the ASF startup, system, CAN, PMC and PIO sources. It is
+ * programmed once over SWD, before the application, which links at 0x404000.
+ *
+ * On every reset it installs a pending image from the staging slot
+ * (fw_image_boot()) and starts the application. Without a runnable
+ * application it stays on the bus and serves the same update protocol as the
+ * application's updater (fw_update.h) on the fwu channel, polled, until a
+ * RESET request.
+ */
+#include "fw_image.h"
+#include "fw_update.h"
+#include "can_isotp_link.h"
+#include "can_bittiming.h"
+#include "can_app.h"
+#include "asf.h"
+#include "can.h"
+#include <string.h>
+
+#define FW_BOOT_RX_MB          0u
+#define FW_BOOT_TX_MB          1u
+#define FW_BOOT_TX_RING        4u // Flow control and replies only, the tester sends the bulk
+
+typedef struct {
+	uint32_t datal;
+	uint32_t datah;
+	uint8_t len;
+} fw_boot_frame_t;
+
+static fw_boot_frame_t g_tx_ring[FW_BOOT_TX_RING];
+static uint32_t g_tx_head = 0;
+static uint32_t g_tx_tail = 0;
+static bool g_tx_loaded = false; // TX mailbox holds the frame at g_tx_tail
+
+static uint8_t g_isotp_tx[FW_UPDATE_REPLY_MAX];
+static uint8_t g_isotp_rx[FW_UPDATE_MSG_MAX];
+static uint8_t g_request[FW_UPDATE_MSG_MAX];
+static can_isotp_link_t g_link;
+static fw_update_t g_update;
+
+static uint32_t g_cyc_last = 0;
+static uint64_t g_cyc = 0; // DWT cycle counter extended to 64 bits
+
+static bool fw_boot_app_present(void)
+{
+	const uint32_t *vectors = (const uint32_t *)FW_APP_ADDR;
+	uint32_t sp = vectors[0];
+	uint32_t pc = vectors[1];
+	return sp > IRAM_ADDR && sp <= IRAM_ADDR + IRAM_SIZE &&
+	       pc > FW_APP_ADDR && pc < FW_APP_ADDR + FW_SLOT_SIZE;
+}
+
+// As if the application had come out of reset itself; its startup sets VTOR again
+static void fw_boot_jump(void)
+{
+	const uint32_t *vectors = (const uint32_t *)FW_APP_ADDR;
+	uint32_t sp = vectors[0];
+	void (*entry)(void) = (void (*)(void))vectors[1];
+
+	__disable_irq();
+	SCB->VTOR = FW_APP_ADDR & SCB_VTOR_TBLOFF_Msk;
+	__set_MSP(sp);
+	__DSB();
+	__ISB();
+	__enable_irq();
+	entry();
+}
+
+static uint64_t fw_boot_now_us(void)
+{
+	uint32_t c = DWT->CYCCNT;
+	g_cyc += (uint32_t)(c - g_cyc_last); // Called far more often than the 44 s wrap
+	g_cyc_last = c;
+	return g_cyc / (SystemCoreClock / 1000000u);
+}
+
+static bool fw_boot_emit(void *ctx, const uint8_t *data, uint8_t len)
+{
+	(void)ctx;
+	uint32_t next = (g_tx_head + 1u) % FW_BOOT_TX_RING;
+	if (next == g_tx_tail) return false;
+	fw_boot_frame_t *f = &g_tx_ring[g_tx_head];
+	f->datal = 0;
+	f->datah = 0;
+	for (uint8_t i = 0; i < 4 && i < len; i++) f->datal |= ((uint32_t)data[i]) << (i * 8);
+	for (uint8_t i = 4; i < 8 && i < len; i++) f->datah |= ((uint32_t)data[i]) << ((i - 4) * 8);
+	f->len = len;
+	g_tx_head = next;
+	return true;
+}
+
+// One frame in flight at a time keeps them in order
+static void fw_boot_tx_poll(uint64_t now)
+{
+	CanMb *p_mb = &CAN0->CAN_MB[FW_BOOT_TX_MB];
+	if (g_tx_loaded) {
+		if (!(p_mb->CAN_MSR & CAN_MSR_MRDY)) return;
+		g_tx_loaded = false;
+		g_tx_tail = (g_tx_tail + 1u) % FW_BOOT_TX_RING;
+		can_isotp_link_on_tx_done(&g_link, now);
+	}
+	if (g_tx_tail == g_tx_head) return;
+
+	const fw_boot_frame_t *f = &g_tx_ring[g_tx_tail];
+	p_mb->CAN_MID = CAN_MID_MIDvA(CAN_ID_FWU_TX);
+	p_mb->CAN_MDL = f->datal;
+	p_mb->CAN_MDH = f->datah;
+	p_mb->CAN_MCR = CAN_MCR_MDLC(f->len) | CAN_MCR_MTCR;
+	g_tx_loaded = true;
+}
+
+static void fw_boot_rx_poll(uint64_t now)
+{
+	CanMb *p_mb = &CAN0->CAN_MB[FW_BOOT_RX_MB];
+	uint32_t msr = p_mb->CAN_MSR;
+	if (!(msr & CAN_MSR_MRDY)) return;
+
+	uint8_t data[8];
+	uint32_t dl = p_mb->CAN_MDL;
+	uint32_t dh = p_mb->CAN_MDH;
+	uint8_t len = (uint8_t)((msr & CAN_MSR_MDLC_Msk) >> CAN_MSR_MDLC_Pos);
+	p_mb->CAN_MCR = CAN_MCR_MTCR; // Re-arm before handling
+	if (len > 8u) len = 8u;
+	for (uint8_t b = 0; b < 4; b++) data[b] = (uint8_t)(dl >> (b * 8));
+	for (uint8_t b = 0; b < 4; b++) data[b + 4] = (uint8_t)(dh >> (b * 8));
+	can_isotp_link_on_frame(&g_link, data, len, now);
+}
+
+static bool fw_boot_can_init(void)
+{
+	uint32_t mck = sysclk_get_peripheral_hz();
+	can_bittiming_t bt;
+	if (!can_bittiming_solve(mck, CAN_BAUD_KBPS * 1000u, CAN_SAMPLE_POINT_PERMILLE, &bt)) return false;
+
+	pmc_enable_periph_clk(ID_PIOB);
+	pio_configure(PIOB, PIO_PERIPH_A, PIO_PB2A_CANTX0, 0);
+	pio_configure(PIOB, PIO_PERIPH_A, PIO_PB3A_CANRX0, 0);
+	pmc_enable_periph_clk(ID_CAN0);
+
+	can_disable(CAN0);
+	CAN0->CAN_BR = can_bittiming_to_br(&bt);
+	can_reset_all_mailbox(CAN0);
+
+	can_mb_conf_t mb;
+	mb.ul_mb_idx = FW_BOOT_RX_MB;
+	mb.uc_obj_type = CAN_MB_RX_OVER_WR_MODE;
+	mb.uc_tx_prio = 0;
+	mb.uc_id_ver = 0;
+	mb.ul_id_msk = CAN_MAM_MIDvA(0x7FFu);
+	mb.ul_id = CAN_MID_MIDvA(CAN_ID_FWU_RX);
+	can_mailbox_init(CAN0, &mb);
+	can_mailbox_send_transfer_cmd(CAN0, &mb);
+
+	mb.ul_mb_idx = FW_BOOT_TX_MB;
+	mb.uc_obj_type = CAN_MB_TX_MODE;
+	mb.ul_id_msk = 0;
+	mb.ul_id = CAN_MID_MIDvA(CAN_ID_FWU_TX);
+	can_mailbox_init(CAN0, &mb);
+
+	can_enable(CAN0);
+	return true;
+}
+
+// Polled update service; only returns by resetting the chip
+static void fw_boot_recovery(void)
+{
+	WDT->WDT_MR = WDT_MR_WDDIS; // Waits for a tester indefinitely
+	if (!fw_boot_can_init()) {
+		for (;;) {}
+	}
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	g_link.emit = fw_boot_emit;
+	g_link.ctx = NULL;
+	g_link.tx_buf = g_isotp_tx;
+	g_link.tx_size = sizeof(g_isotp_tx);
+	g_link.rx_buf = g_isotp_rx;
+	g_link.rx_size = sizeof(g_isotp_rx);
+	g_link.block_size = 0;
+	g_link.st_min = 0;
+	can_isotp_link_init(&g_link);
+	fw_update_init(&g_update, fw_flash_efc());
+
+	for (;;) {
+		uint64_t now = fw_boot_now_us();
+		fw_boot_rx_poll(now);
+		fw_boot_tx_poll(now);
+		can_isotp_link_poll(&g_link, now);
+
+		int32_t len = can_isotp_link_read(&g_link, g_request, sizeof(g_request));
+		if (len < 0) continue;
+		if ((uint32_t)len > sizeof(g_request)) continue; // Cannot happen, rx_size is the same
+
+		uint8_t reply[FW_UPDATE_REPLY_MAX];
+		uint32_t n = fw_update_handle(&g_update, g_request, (uint32_t)len, reply, sizeof(reply));
+		if (n != 0) can_isotp_link_send(&g_link, reply, n, fw_boot_now_us());
+
+		if (fw_update_reset_requested(&g_update)) {
+			while (can_isotp_link_tx_busy(&g_link)) {
+				now = fw_boot_now_us();
+				fw_boot_tx_poll(now);
+				can_isotp_link_poll(&g_link, now);
+			}
+			NVIC_SystemReset(); // Installs the image on the way up
+		}
+	}
+}
+
+int main(void)
+{
+	SystemInit();
+
+	fw_boot_result_t result = fw_image_boot(fw_flash_efc());
+	volatile fw_boot_result_t debug_boot_result = result;
+
+	if (result != FW_BOOT_FAILED && fw_boot_app_present()) {
+		fw_boot_jump();
+	}
+	fw_boot_recovery();
+	return 0;
+}
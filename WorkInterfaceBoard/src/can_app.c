@@ -1,7 +1,25 @@
 #include "can_app.h"
+#include "can_tx.h"
+#include "can_rx.h"
+#include "can_dispatch.h"
+#include "can_signals.h"
+#include "can_stats.h"
+#include "can_rate.h"
+#include "can_sched.h"
+#include "can_producer.h"
+#include "can_urgent.h"
+#include "can_node.h"
+#include "can_time.h"
+#include "can_err.h"
+#include "can_bittiming.h"
+#include "can_autobaud.h"
+#include "can_isotp.h"
+#include "fw_update.h"
 #include "asf.h"
 #include "can.h"
 
+#include <string.h>
+
 #include "FreeRTOS.h"
 #include "task.h"
 
@@ -24,29 +42,70 @@ static void can0_configure_pins_local(void)
 	pio_configure(PIOB, PIO_PERIPH_A, PIO_PB3A_CANRX0, 0); // PB3 as CANRX0
 }
 
-/* Force robust 500 kbps timing for PCLK = 96 MHz using 16 TQ and ~81.25% sample point.
- * Segments: Prop=5, Phase1=7, Phase2=3, SJW=2, BRP = 12 (encoded as N-1 in CAN_BR fields).
- * This yields bitrate = 96e6 / (12 * 16) = 500000 bps, SP = (1+5+7)/16 = 81.25%.
- */
-static void can_force_500k_16tq_timing(Can *p_can, uint32_t mck)
+static uint32_t g_can_bitrate_bps = CAN_BAUD_KBPS * 1000u; // Bitrate in use, for the time base after a reset
+
+/* Load CAN_BR with the controller off, then wait (bounded) for it to
+ * synchronise to the bus, as can_init() does for its own table. */
+static bool can_app_apply_timing(Can *p_can, uint32_t can_br)
 {
-(void)mck; // mck expected 96 MHz per board clocking
-/* Disable before modifying CAN_BR (per driver convention). */
-can_disable(p_can);
-const uint32_t brp_enc= 12 - 1; // prescaler 12
-const uint32_t sjw_enc= 2  - 1; // SJW = 2 tq
-const uint32_t propag_enc= 5  - 1; // PropSeg = 5 tq
-const uint32_t phase1_enc= 7  - 1; // PhaseSeg1 = 7 tq
-const uint32_t phase2_enc= 3  - 1; // PhaseSeg2 = 3 tq
-p_can->CAN_BR =
-CAN_BR_PHASE2(phase2_enc) |
-CAN_BR_PHASE1(phase1_enc) |
-CAN_BR_PROPAG(propag_enc) |
-CAN_BR_SJW(sjw_enc)       |
-CAN_BR_BRP(brp_enc)       |
-CAN_BR_SMP_ONCE; // single sampling
-can_enable(p_can);
+	can_disable(p_can);
+	p_can->CAN_BR = can_br;
+	can_reset_all_mailbox(p_can);
+	can_enable(p_can);
+	
+	for (uint32_t tries = 0; tries < 100000u; tries++) {
+		if (can_get_status(p_can) & CAN_SR_WAKEUP) {
+			return true; // Synchronised with bus activity (11 recessive bits)
+		}
+	}
+	return false;
+}
+
+#if CONF_CAN_AUTOBAUD
+#define CAN_APP_SR_ERRORS      (CAN_SR_CERR | CAN_SR_SERR | CAN_SR_AERR | CAN_SR_FERR | CAN_SR_BERR)
+
+/* can_autobaud probe: listen-only with MB0 accepting every standard ID and
+ * MB1 every extended one, so a bus of 29-bit frames counts too. The error
+ * flags are cleared on read, so each poll sees only new errors. */
+static void can_app_listen(void *ctx, const can_bittiming_t *bt, uint32_t can_br, can_autobaud_obs_t *obs)
+{
+	Can *p_can = (Can *)ctx;
+	(void)bt;
+	
+	can_disable(p_can);
+	p_can->CAN_BR = can_br;
+	can_reset_all_mailbox(p_can);
+	can_enable_autobaud_listen_mode(p_can);
+	
+	can_mb_conf_t rx;
+	for (uint32_t mb = 0; mb < 2u; mb++) {
+		rx.ul_mb_idx = mb;
+		rx.uc_obj_type = CAN_MB_RX_MODE;
+		rx.uc_id_ver = (uint8_t)mb; // MB0 standard IDs, MB1 extended (MIDE)
+		rx.ul_id_msk = 0; // Accept everything
+		rx.ul_id = 0;
+		can_mailbox_init(p_can, &rx);
+	}
+	
+	can_enable(p_can);
+	(void)p_can->CAN_SR; // Drop flags from the previous candidate
+	
+	for (uint32_t us = 0; us < CAN_AUTOBAUD_WINDOW_MS * 1000u; us += 10u) {
+		uint32_t sr = p_can->CAN_SR;
+		if (sr & CAN_APP_SR_ERRORS) obs->errors++;
+		for (uint32_t mb = 0; mb < 2u; mb++) {
+			if (sr & (CAN_SR_MB0 << mb)) {
+				obs->frames++;
+				p_can->CAN_MB[mb].CAN_MCR = CAN_MCR_MTCR; // Release the mailbox for the next frame
+			}
+		}
+		delay_us(10);
+	}
+	
+	can_disable(p_can);
+	can_disable_autobaud_listen_mode(p_can);
 }
+#endif
 
 bool can_app_init(void)
 {
@@ -56,8 +115,6 @@ bool can_app_init(void)
 	// DIAGNOSTIC: Store actual clock frequencies for debugging
 	volatile uint32_t debug_peripheral_hz = mck;
 	volatile uint32_t debug_system_core_hz = SystemCoreClock;
-	// Expected: mck = 96,000,000 Hz for proper 500kbps CAN timing
-	// If these values are different, CAN bit rate will be incorrect
 	
 	pmc_enable_periph_clk(ID_CAN0); // Enable CAN0 peripheral clock
 	can0_configure_pins_local(); // Route pins to CAN peripheral
@@ -65,89 +122,109 @@ bool can_app_init(void)
 	// Add delay after pin configuration to ensure stability
 	delay_ms(10);
 	
-	// Initialize CAN controller with proper baudrate constant
-	// Try 500kbps first (desired rate), then fall back to lower rates if needed
-	volatile uint32_t debug_bitrate_used = 0;
-	if (can_init(CAN0, mck, CAN_BPS_500K)) {
-		debug_bitrate_used = 500; // 500k worked - preferred rate
-		/* Override ASF default timing (8..14 TQ) with 16 TQ @ ~81% SP for better margin. */
-		can_force_500k_16tq_timing(CAN0, mck);
-	} else if (can_init(CAN0, mck, CAN_BPS_250K)) {
-		debug_bitrate_used = 250; // 250k worked - fallback
-	} else if (can_init(CAN0, mck, CAN_BPS_125K)) {
-		debug_bitrate_used = 125; // 125k worked - last resort
-	} else {
-		// CAN initialization failed - likely due to clock/baudrate mismatch
-		volatile uint32_t debug_can_init_fail = 1;
+	can_bittiming_t bt;
+	uint32_t can_br = 0;
+	
+#if CONF_CAN_AUTOBAUD
+	// Listen for the bus bitrate before sending anything: a wrong guess would
+	// put error frames on a running bus (config/conf_can_bittiming.h)
+	can_bittiming_t candidates[CAN_AUTOBAUD_MAX_CANDIDATES];
+	uint32_t n_candidates = can_autobaud_candidates(mck, CAN_BAUD_KBPS * 1000u, candidates, CAN_AUTOBAUD_MAX_CANDIDATES);
+	if (can_autobaud_detect(candidates, n_candidates, can_app_listen, CAN0, &bt)) {
+		can_br = can_bittiming_to_br(&bt);
+	}
+	volatile uint32_t debug_autobaud_bitrate = (can_br != 0) ? bt.bitrate : 0; // 0 = silent bus, configured rate used
+#endif
+	
+	// Configured bit timing: compile-time value for known clocks
+	// (config/conf_can_bittiming.h), otherwise solved for whatever MCK the board runs at
+	if (can_br == 0) {
+		can_br = CAN_BITTIMING_CONST_BR(mck, CAN_BAUD_KBPS * 1000u);
+		if (can_br != 0) {
+			can_bittiming_from_br(can_br, mck, &bt);
+		} else if (can_bittiming_solve(mck, CAN_BAUD_KBPS * 1000u, CAN_SAMPLE_POINT_PERMILLE, &bt)) {
+			can_br = can_bittiming_to_br(&bt);
+		} else {
+			// No timing within CAN_BITTIMING_MAX_ERR_PPM for this clock
+			volatile uint32_t debug_can_init_fail = 1;
+			return false;
+		}
+	}
+	g_can_bitrate_bps = bt.bitrate;
+	
+	if (!can_app_apply_timing(CAN0, can_br)) {
+		// Controller never saw an idle bus
+		volatile uint32_t debug_can_init_fail = 2;
 		volatile uint32_t debug_can_sr_after_fail = CAN0->CAN_SR;
-		return false; // CAN baudrate configuration failed
+		return false;
 	}
 	
 	// DIAGNOSTIC: Check CAN status immediately after init
 	volatile uint32_t debug_can_sr_after_init = CAN0->CAN_SR;
 	volatile uint32_t debug_can_mr_after_init = CAN0->CAN_MR;
 	
-	// DIAGNOSTIC: Read back CAN baudrate register to verify configuration
+	// DIAGNOSTIC: Timing actually programmed
 	volatile uint32_t debug_can_br = CAN0->CAN_BR;
-	// Decode the CAN_BR register fields for analysis
-	volatile uint32_t debug_phase2 = (debug_can_br & CAN_BR_PHASE2_Msk) >> CAN_BR_PHASE2_Pos;
-	volatile uint32_t debug_phase1 = (debug_can_br & CAN_BR_PHASE1_Msk) >> CAN_BR_PHASE1_Pos;
-	volatile uint32_t debug_propag = (debug_can_br & CAN_BR_PROPAG_Msk) >> CAN_BR_PROPAG_Pos;
-	volatile uint32_t debug_sjw = (debug_can_br & CAN_BR_SJW_Msk) >> CAN_BR_SJW_Pos;
-	volatile uint32_t debug_brp = (debug_can_br & CAN_BR_BRP_Msk) >> CAN_BR_BRP_Pos;
-	// Calculate actual bit rate: mck / ((brp + 1) * (1 + (propag + 1) + (phase1 + 1) + (phase2 + 1)))
-	volatile uint32_t debug_total_tq = 1 + (debug_propag + 1) + (debug_phase1 + 1) + (debug_phase2 + 1);
-	volatile uint32_t debug_actual_bitrate = mck / ((debug_brp + 1) * debug_total_tq);
-	// Expected: debug_actual_bitrate should be 500000 for 500kbps
-	// Additional debugging: Store intermediate calculation values
-	volatile uint32_t debug_brp_plus_1 = debug_brp + 1;
-	volatile uint32_t debug_divisor = debug_brp_plus_1 * debug_total_tq;
-	volatile uint32_t debug_expected_bitrate = debug_bitrate_used * 1000; // Convert kbps to bps
-	
-	// DEBUG: Calculate what 500kbps should look like with current MCK
-	volatile uint32_t debug_target_500k = 500000; // 500kbps in bps
-	volatile uint32_t debug_optimal_divisor = mck / debug_target_500k;
-	volatile uint32_t debug_optimal_brp = debug_optimal_divisor / 16 - 1; // Assuming 16 TQ
-	volatile uint32_t debug_optimal_tq = debug_optimal_divisor / (debug_optimal_brp + 1);
+	volatile uint32_t debug_actual_bitrate = bt.bitrate;
+	volatile uint32_t debug_sample_point = bt.sample_point; // permille
+	volatile uint32_t debug_total_tq = 1u + bt.propag + bt.phase1 + bt.phase2;
 	
 	can_reset_all_mailbox(CAN0); // Reset all mailboxes to known state
 	
-	/* Configure a generic RX mailbox 0 - ACCEPT ALL MESSAGES for testing */
-	can_mb_conf_t mb;
-	mb.ul_mb_idx = 0; // Mailbox index 0 for RX
-	mb.uc_obj_type = CAN_MB_RX_MODE; // Receive mode
-	mb.uc_id_ver = 0; // Standard ID (11-bit)
-	mb.ul_id_msk = 0; // NO MASK - Accept all messages (for loopback test compatibility)
-	mb.ul_id = 0; // Don't filter on specific ID
-	mb.uc_length = 8; // Set MDLC before arming to avoid undefined length
-	
-	// DIAGNOSTIC: Store mailbox configuration for debugging
-	volatile uint32_t debug_mb_idx = mb.ul_mb_idx;
-	volatile uint32_t debug_mb_type = mb.uc_obj_type;
-	volatile uint32_t debug_mb_id_mask = mb.ul_id_msk;
-	volatile uint32_t debug_mb_id = mb.ul_id;
-	
-	can_mailbox_init(CAN0, &mb); // Apply configuration
-	// Arm RX mailbox 0 to start receiving
-	can_mailbox_send_transfer_cmd(CAN0, &mb);
+	// Bus load and latency figures are scaled by the bitrate actually in use
+	can_stats_init(g_can_bitrate_bps);
+	can_rate_init(g_can_bitrate_bps); // Telemetry periods follow the measured load (config/conf_can_rate.h)
+	
+	// Node ID from the chip unique ID (config/conf_can_node.h), before any mailbox holds an ID
+	volatile uint32_t debug_can_node = can_node_init();
+	
+	/* Configure the RX mailbox FIFO (MB0, MB6, MB7) with hardware acceptance filters */
+	if (!can_rx_init(CAN0)) {
+		return false; // No heap left for the RX semaphore
+	}
 	
 	// DIAGNOSTIC: Verify mailbox was configured
 	volatile uint32_t debug_mb_status_after_init = can_mailbox_get_status(CAN0, 0);
 	
-	// Initialize TX mailbox 1 for future use
-	can_mb_conf_t tx_init;
-	tx_init.ul_mb_idx = 1; // Use mailbox 1 for TX
-	tx_init.uc_obj_type = CAN_MB_TX_MODE; // Transmit mode
-	tx_init.uc_tx_prio = 15; // High priority
-	tx_init.uc_id_ver = 0; // Standard ID
-	tx_init.ul_id_msk = 0; // Not used for TX
-	can_mailbox_init(CAN0, &tx_init); // Configure TX mailbox
+	// Urgent command mailbox (MB1, config/conf_can_urgent.h), handlers run in CAN0_Handler
+	can_urgent_init(CAN0);
+	
+	// Interrupt-driven TX queue on MB2..MB3 (MB4..MB5 go to producers or, in TTM, the schedule)
+	can_tx_init(CAN0);
 	
 	// DIAGNOSTIC: Verify TX mailbox was configured
-	volatile uint32_t debug_tx_mb_status_after_init = can_mailbox_get_status(CAN0, 1);
+	volatile uint32_t debug_tx_mb_status_after_init = can_mailbox_get_status(CAN0, CAN_TX_MB_FIRST);
+	
+	// Time-triggered periodic frames (config/conf_can_sched.h); producers fall back to the queue if off
+	volatile bool debug_can_sched_active = can_sched_init(CAN0, g_can_bitrate_bps);
+	
+	// Remote-frame producers (config/conf_can_producer.h), after the RX filters they must avoid
+	volatile uint32_t debug_can_producers_bound = can_producer_init(CAN0);
+	
+	// 64-bit frame timestamps; anchored last because entering TTM restarts the controller
+	can_time_init(CAN0, g_can_bitrate_bps);
+	
+	// Error-state tracking and bus-off recovery, driven by the ERRA/WARN/ERRP/BOFF interrupts
+	if (!can_err_init(CAN0, g_can_bitrate_bps)) {
+		return false; // No heap left for the backoff timer
+	}
+	
+	// ISO-TP channels (config/conf_can_isotp.h), served from CAN0_Handler through the RX/TX hooks
+	if (!can_isotp_init()) {
+		return false; // No heap left for the channel timer/semaphores
+	}
+	
+	// CAN0_Handler calls FreeRTOS-safe code, so keep it at or below the syscall priority
+	NVIC_DisableIRQ(CAN0_IRQn);
+	NVIC_ClearPendingIRQ(CAN0_IRQn);
+	NVIC_SetPriority(CAN0_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(CAN0_IRQn);
+	
+	// Tell the other boards which node ID we took; one that wants it too answers
+	can_node_announce();
 	
 	// Verify the bit rate is correct
-	if (!can_verify_bitrate(debug_bitrate_used)) {
+	if (!can_verify_bitrate(g_can_bitrate_bps / 1000u)) {
 		volatile uint32_t debug_bitrate_verification_failed = 1;
 		// Continue anyway, but flag the issue
 	}
@@ -158,151 +235,211 @@ bool can_app_init(void)
 // Function to verify CAN bit rate configuration
 bool can_verify_bitrate(uint32_t expected_kbps)
 {
-	uint32_t mck = sysclk_get_peripheral_hz();
-	uint32_t can_br = CAN0->CAN_BR;
-	
-	// Decode CAN_BR register
-	uint32_t phase2 = (can_br & CAN_BR_PHASE2_Msk) >> CAN_BR_PHASE2_Pos;
-	uint32_t phase1 = (can_br & CAN_BR_PHASE1_Msk) >> CAN_BR_PHASE1_Pos;
-	uint32_t propag = (can_br & CAN_BR_PROPAG_Msk) >> CAN_BR_PROPAG_Pos;
-	uint32_t brp = (can_br & CAN_BR_BRP_Msk) >> CAN_BR_BRP_Pos;
-	
-	// Calculate actual bit rate
-	uint32_t total_tq = 1 + (propag + 1) + (phase1 + 1) + (phase2 + 1);
-	uint32_t actual_bitrate = mck / ((brp + 1) * total_tq);
+	can_bittiming_t bt;
+	can_bittiming_from_br(CAN0->CAN_BR, sysclk_get_peripheral_hz(), &bt);
 	uint32_t expected_bitrate = expected_kbps * 1000;
 	
-	// Allow 1% tolerance
-	uint32_t tolerance = expected_bitrate / 100;
-	return (actual_bitrate >= (expected_bitrate - tolerance)) && 
-	       (actual_bitrate <= (expected_bitrate + tolerance));
+	// Same tolerance the solver accepts
+	uint32_t tolerance = (uint32_t)(((uint64_t)expected_bitrate * CAN_BITTIMING_MAX_ERR_PPM) / 1000000u);
+	return (bt.bitrate >= (expected_bitrate - tolerance)) && 
+	       (bt.bitrate <= (expected_bitrate + tolerance));
 }
 
 bool can_app_tx(uint32_t id, const uint8_t *data, uint8_t len)
 {
-	// First, reset the TX mailbox to ensure it's in a clean state
-	can_mb_conf_t reset_mb;
-	reset_mb.ul_mb_idx = 1;
-	reset_mb.uc_obj_type = CAN_MB_DISABLE_MODE; // Disable first
-	can_mailbox_init(CAN0, &reset_mb);
-	
-	// Small delay to ensure reset takes effect
-	delay_ms(1);
-	
-	// Now configure the TX mailbox properly. IMPORTANT: set ul_id before mailbox init
-	can_mb_conf_t tx;
-	tx.ul_mb_idx = 1; // Use mailbox 1 for TX
-	tx.uc_obj_type = CAN_MB_TX_MODE; // Transmit mode
-	tx.uc_tx_prio = 15; // High priority
-	tx.uc_id_ver = 0; // Standard ID
-	tx.ul_id_msk = 0; // Not used for TX
-	tx.ul_id = CAN_MID_MIDvA(id); // Set CAN identifier BEFORE init (driver may snapshot)
-	can_mailbox_init(CAN0, &tx); // Configure mailbox
-	uint32_t dl = 0, dh = 0; // Data low/high 32-bit words
-	for (uint8_t i=0;i<4 && i<len;i++) dl |= ((uint32_t)data[i]) << (i*8); // Pack first 4 bytes
-	for (uint8_t i=4;i<8 && i<len;i++) dh |= ((uint32_t)data[i]) << ((i-4)*8); // Pack next 4 bytes
-	tx.ul_datal = dl;
-	tx.ul_datah = dh;
-	tx.uc_length = len; // DLC
-	
-	if (can_mailbox_write(CAN0, &tx) != CAN_MAILBOX_TRANSFER_OK) {
-		// DIAGNOSTIC: TX write failed
-		volatile uint32_t debug_tx_write_failed = 1;
-		volatile uint32_t debug_mb_status_after_write = can_mailbox_get_status(CAN0, 1);
-		return false; // Load MB failed
-	}
-	
-	can_global_send_transfer_cmd(CAN0, CAN_TCR_MB1); // Trigger transmission
-	
-	// Wait for transmission to complete
-	delay_ms(10);
-	
-	return true;
+	// Non-blocking: the frame is queued and sent from CAN0_Handler
+	return can_tx_enqueue(id, data, len);
 }
 
+bool can_app_tx_words(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len)
+{
+	return can_tx_enqueue_words(id, datal, datah, len);
+}
 
-bool can_app_reset(void)
+void CAN0_Handler(void)
 {
-	
-	can_disable(CAN0);
-	delay_ms(10);
-	can_enable(CAN0);
-	delay_ms(10);
-		can_reset_all_mailbox(CAN0);
-	can_mb_conf_t mb;
-	mb.ul_mb_idx = 0; // Mailbox index 0 for RX
-	mb.uc_obj_type = CAN_MB_RX_MODE; // Receive mode
-	mb.uc_id_ver = 0; // Standard ID (11-bit)
-	mb.ul_id_msk = CAN_MAM_MIDvA_Msk; // Mask for standard ID only
-	mb.ul_id = CAN_MID_MIDvA(CAN_ID_POT_COMMAND); // Filter on command base ID
-	can_mailbox_init(CAN0, &mb); // Apply configuration
-	// Arm RX mailbox 0 to start receiving after reset
-	can_mailbox_send_transfer_cmd(CAN0, &mb);
-	return true;	
+	uint32_t can_sr = CAN0->CAN_SR; // Single read: error flags are cleared on read
+	bool woken = can_urgent_isr(can_sr); // Urgent commands before anything else
+	woken |= can_rx_isr(can_sr); // Then RX, it has the tighter deadline
+	woken |= can_err_isr(can_sr); // Before TX, so a bus-off hold applies to this pass
+	can_tx_isr(can_sr);
+	can_sched_isr(can_sr);
+	can_producer_isr(can_sr);
+	portEND_SWITCHING_ISR(woken);
 }
+
+/* New node ID after a lost claim, without stopping the controller: with CAN0
+ * masked, frames already received are taken under the old ID, queued frames
+ * are pulled back from their mailboxes, and only the MAM/MID of the armed
+ * mailboxes change. Held frames reload with the new ID once CAN0_Handler has
+ * seen their aborts. ISO-TP transfers addressed to the old ID are dropped.
+ */
+static void can_app_move_node(void)
+{
+	taskENTER_CRITICAL();
+	uint32_t can_sr = CAN0->CAN_SR; // As CAN0_Handler would: disabling a mailbox loses its frame
+	(void)can_urgent_isr(can_sr);
+	(void)can_rx_isr(can_sr); // Wakes this task at most
+	bool held = can_tx_held(); // Bus-off or backoff keeps its own hold
+	can_tx_hold(true);
+	can_rx_set_node();
+	can_urgent_set_node();
+	can_sched_set_node();
+	can_producer_set_node();
+	can_isotp_reset();
+	if (!held) can_tx_hold(false);
+	taskEXIT_CRITICAL();
+}
+
 void can_rx_task(void *arg)
 {
 	(void)arg; // Unused
-	uint32_t error_count = 0;
 	
 	for (;;) {
-		// Check CAN controller status first
-		if (!can_app_get_status()) {
-			error_count++;
-			if (error_count > 100) { // After 100 consecutive errors, try to reinitialize
-				can_app_reset();// Note: In a real system, you might want to reset the CAN controller here
-				error_count = 0;
-			}
-			vTaskDelay(pdMS_TO_TICKS(100)); // Wait longer on errors
+		// Sleep until CAN0_Handler has moved at least one frame into the RX ring
+		const can_rx_frame_t *rx = can_rx_peek(CAN_RX_WAIT_FOREVER);
+		if (rx == NULL) {
 			continue;
 		}
 		
-		error_count = 0; // Reset error count on successful status check
+		// O(1) lookup in the compile-time command table (config/conf_can_commands.h);
+		// handlers read the frame in its ring slot, released once they return
+		if (!can_dispatch(rx)) {
+			volatile uint32_t debug_unhandled_can_id = rx->id; // Received but no command registered
+		}
+		can_rx_release();
 		
-		// Check if RX mailbox has data
-		uint32_t mb_status = can_mailbox_get_status(CAN0, 0);
-		if (mb_status & CAN_MSR_MRDY) { // If RX mailbox has data
-			can_mb_conf_t rx;
-			rx.ul_mb_idx = 0;
-			
-			// Read mailbox with error checking
-			if (can_mailbox_read(CAN0, &rx) == CAN_MAILBOX_TRANSFER_OK) {
-				uint8_t len = (uint8_t)(rx.ul_status >> CAN_MSR_MDLC_Pos) & 0xF; // Extract DLC
-				if (len > 8) len = 8; // Sanity check on length
-				
-				uint8_t data[8] = {0}; // Initialize to zero
-				// Unpack data words
-				for (uint8_t i = 0; i < 4 && i < len; i++) {
-					data[i] = (rx.ul_datal >> (i * 8)) & 0xFF;
-				}
-				for (uint8_t i = 0; i < 4 && (i + 4) < len; i++) {
-					data[4 + i] = (rx.ul_datah >> (i * 8)) & 0xFF;
-				}
-				
-				// Extract CAN ID and process based on message type
-				uint32_t can_id = rx.ul_fid;//(rx.ul_id >> CAN_MID_MIDvA_Pos) & 0x7FFu;
-// 				if (can_id == CAN_ID_POT_COMMAND) {
-// 					handle_pot_command(data, len); // Execute command
-// 				}
-				// Note: Other message IDs are received but not processed in this task
-				// This allows loopback test (ID 0x123) to be received successfully
-			}
+		// Lost a node ID claim: mailboxes holding the old IDs are set up again
+		if (can_node_moved()) {
+			can_app_move_node();
+			can_node_announce();
+		}
+	}
+}
+
+// Firmware update: one request at a time over the fwu ISO-TP channel. Flash is
+// programmed here, between messages, so the CAN path never waits on the EFC
+// mid-transfer; the tester sends the next block after the reply.
+void can_fwu_task(void *arg)
+{
+	(void)arg; // Unused
+	static uint8_t request[FW_UPDATE_MSG_MAX];
+	static fw_update_t update;
+	fw_update_init(&update, fw_flash_efc());
+	
+	for (;;) {
+		int32_t len = can_isotp_receive(CAN_ISOTP_CH(fwu), request, sizeof(request), CAN_ISOTP_WAIT_FOREVER);
+		if (len < 0 || (uint32_t)len > sizeof(request)) {
+			continue; // Oversized messages are refused by the channel already
 		}
 		
-		vTaskDelay(pdMS_TO_TICKS(5)); // Small delay to yield CPU time
+		uint8_t reply[FW_UPDATE_REPLY_MAX];
+		uint32_t n = fw_update_handle(&update, request, (uint32_t)len, reply, sizeof(reply));
+		while (can_isotp_tx_busy(CAN_ISOTP_CH(fwu))) {
+			vTaskDelay(1); // Previous reply still going out
+		}
+		if (n != 0 && !can_isotp_send(CAN_ISOTP_CH(fwu), reply, n)) {
+			volatile uint32_t debug_fwu_reply_dropped = reply[0];
+		}
+		
+		if (fw_update_reset_requested(&update)) {
+			while (can_isotp_tx_busy(CAN_ISOTP_CH(fwu))) {
+				vTaskDelay(1); // Idle once the reply has left its mailbox
+			}
+			NVIC_SystemReset(); // The bootloader installs the pending image
+		}
 	}
 }
-bool can_app_get_status(void){
-	// Check if CAN controller is properly initialized and running
-	if (CAN0->CAN_SR & CAN_SR_BOFF) {
-		return false; // CAN controller is in bus-off state (bad)
+
+static volatile bool g_can_stop = false; // Latched by can_cmd_stop()
+
+// Stop/release (urgent lane, runs in CAN0_Handler): byte 0 nonzero latches the
+// stop, zero releases it. Commands that move anything are refused while latched.
+void can_cmd_stop(const can_rx_frame_t *frame, bool *woken)
+{
+	(void)woken; // Nothing to wake, tasks poll can_app_stopped()
+	g_can_stop = (frame->len == 0) || (frame->data[0] != 0); // An empty frame also stops
+}
+
+bool can_app_stopped(void)
+{
+	return g_can_stop;
+}
+
+// Digipot (AD5252) command handler. The AD5252 driver is not part of this build,
+// so the last command is kept visible to the debugger.
+void can_cmd_pot(const can_rx_frame_t *frame)
+{
+	if (g_can_stop) {
+		return; // Stopped: hold the current setting
+	}
+	volatile uint32_t debug_pot_cmd_len = frame->len;
+	volatile uint32_t debug_pot_cmd_datal = frame->datal;
+	volatile uint32_t debug_pot_cmd_datah = frame->datah;
+	(void)debug_pot_cmd_len; (void)debug_pot_cmd_datal; (void)debug_pot_cmd_datah;
+}
+
+static void can_app_publish_diag(void)
+{
+	can_stats_t stats;
+	can_stats_get(&stats);
+	
+	can_diag_t diag;
+	diag.seen_load = stats.seen_load_permille; // 0.1 % units, a lower bound
+	diag.tec = stats.err_now.tec;
+	diag.rec = stats.err_now.rec;
+	diag.tec_max = stats.err_max.tec;
+	diag.rec_max = stats.err_max.rec;
+	diag.lat_max = (stats.lat_max_us > 0xFFFFu) ? 0xFFFFu : stats.lat_max_us; // Saturate to the signal width
+	
+	uint32_t datal, datah;
+	can_pack_diag(&diag, &datal, &datah);
+	can_app_tx_words(CAN_MSG_ID(diag), datal, datah, CAN_MSG_DLC(diag));
+}
+
+static void can_app_publish_diag_id(const can_stats_id_t *entry)
+{
+	can_diag_id_t msg;
+	msg.can_id = entry->id;
+	msg.tx = entry->tx;
+	msg.rx = entry->rx;
+	
+	uint32_t datal, datah;
+	can_pack_diag_id(&msg, &datal, &datah);
+	can_app_tx_words(CAN_MSG_ID(diag_id), datal, datah, CAN_MSG_DLC(diag_id));
+}
+
+// Diagnostic request: no payload -> summary frame now; bytes 0..1 = CAN ID ->
+// counters for that ID; 0xFFFF -> counters for every tracked ID.
+void can_cmd_diag_request(const can_rx_frame_t *frame)
+{
+	if (frame->len < 2) {
+		can_app_publish_diag();
+		return;
+	}
+	
+	uint32_t id = frame->datal & 0xFFFFu;
+	if (id == 0xFFFFu) {
+		can_stats_id_t ids[CAN_STATS_MAX_IDS];
+		uint32_t n = can_stats_get_ids(ids, CAN_STATS_MAX_IDS);
+		for (uint32_t i = 0; i < n; i++) {
+			can_app_publish_diag_id(&ids[i]); // Queue depth limits how many fit at once
+		}
+		return;
 	}
 	
-	// Check if there are any error conditions
-	uint32_t status = CAN0->CAN_SR;
-	if (status & (CAN_SR_ERRA | CAN_SR_WARN | CAN_SR_BOFF)) {
+	can_stats_id_t entry = { id, 0, 0 }; // Untracked IDs report zero counts
+	can_stats_get_id(id, &entry);
+	can_app_publish_diag_id(&entry);
+}
+
+bool can_app_get_status(void){
+	// Error active (with or without the warning) is the healthy state; passive,
+	// bus-off and the post-bus-off backoff are not
+	can_err_state_t state = can_err_state();
+	if (state != CAN_ERR_ACTIVE && state != CAN_ERR_WARNING) {
 		// DIAGNOSTIC: Store error status for debugging
-		volatile uint32_t debug_can_status = status;
+		volatile uint32_t debug_can_err_state = state;
 		volatile uint32_t debug_tx_errors = can_get_tx_error_cnt(CAN0);
 		volatile uint32_t debug_rx_errors = can_get_rx_error_cnt(CAN0);
 		// High error counts often indicate bit rate mismatch
@@ -323,143 +460,57 @@ bool can_app_test_loopback(void)
 	volatile uint32_t debug_initial_sr = CAN0->CAN_SR;
 	volatile uint32_t debug_initial_mr = CAN0->CAN_MR;
 	
-	// For SAM4E, implement loopback by configuring two mailboxes:
-	// - MB1 for TX
-	// - MB2 for RX (configured to receive the test message)
-	
-	// First, configure a dedicated RX mailbox for loopback test
-	can_mb_conf_t rx_mb;
-	rx_mb.ul_mb_idx = 2; // Use mailbox 2 for loopback RX
-	rx_mb.uc_obj_type = CAN_MB_RX_MODE; // Receive mode
-	rx_mb.uc_id_ver = 0; // Standard ID (11-bit)
-	rx_mb.ul_id_msk = CAN_MAM_MIDvA_Msk; // Match exact ID
-	rx_mb.ul_id = CAN_MID_MIDvA(0x100); // Accept only test ID 0x100
-	can_mailbox_init(CAN0, &rx_mb); // Configure mailbox
-	// Arm RX mailbox 2 to start receiving
-	can_mailbox_send_transfer_cmd(CAN0, &rx_mb);
-	
-	// Reset and configure TX mailbox
-	can_mb_conf_t reset_tx;
-	reset_tx.ul_mb_idx = 1;
-	reset_tx.uc_obj_type = CAN_MB_DISABLE_MODE; // Disable first
-	can_mailbox_init(CAN0, &reset_tx);
-	delay_ms(1);
-	
-	// Configure TX mailbox
-	can_mb_conf_t tx_mb;
-	tx_mb.ul_mb_idx = 1; // Use mailbox 1 for TX
-	tx_mb.uc_obj_type = CAN_MB_TX_MODE; // Transmit mode
-	tx_mb.uc_tx_prio = 15; // High priority
-	tx_mb.uc_id_ver = 0; // Standard ID
-	tx_mb.ul_id_msk = 0; // Not used for TX
-	// IMPORTANT: set ID before initializing mailbox so driver snapshots it correctly
-	tx_mb.ul_id = CAN_MID_MIDvA(0x100);
-	can_mailbox_init(CAN0, &tx_mb); // Configure mailbox
-	
-	// Wait for configuration to take effect
-	delay_ms(10);
-	
-	// Check if TX mailbox is ready
-	uint32_t tx_mb_status = can_mailbox_get_status(CAN0, 1);
-	volatile uint32_t debug_tx_mb_ready = (tx_mb_status & CAN_MSR_MRDY) != 0;
-	if (!(tx_mb_status & CAN_MSR_MRDY)) {
-		// DIAGNOSTIC: TX mailbox not ready
-		volatile uint32_t debug_tx_mb_not_ready = 1;
-		return false;
-	}
+	// For SAM4E, implement loopback through the normal queues:
+	// - TX via can_app_tx() (MB2..MB3)
+	// - RX via the RX FIFO; the test ID sits inside the default 0x2xx acceptance filter
 	
 	// Test transmission
 	uint8_t test_data[4] = {0xAA, 0x55, 0x12, 0x34};
-	uint32_t test_id = 0x100; // Test ID that matches RX filter
-	
-	// Send test message using the TX mailbox
-	// Ensure mailbox's ID is set (already set above) and data prepared
-	uint32_t dl = 0, dh = 0; // Data low/high 32-bit words
-	for (uint8_t i=0;i<4;i++) dl |= ((uint32_t)test_data[i]) << (i*8); // Pack data
-	tx_mb.ul_datal = dl;
-	tx_mb.ul_datah = dh;
-	tx_mb.uc_length = 4; // DLC
-	
-	if (can_mailbox_write(CAN0, &tx_mb) != CAN_MAILBOX_TRANSFER_OK) {
-		// DIAGNOSTIC: TX failed
+	uint32_t test_id = 0x2F0; // Unassigned node 0 ID inside the RX filter block, offset like the rest
+	
+	if (!can_app_tx(test_id, test_data, 4)) {
+		// DIAGNOSTIC: TX queue full
 		volatile uint32_t debug_tx_failed = 1;
 		volatile uint32_t debug_tx_sr = CAN0->CAN_SR;
 		return false; // Transmission failed
 	}
 	
-	// Trigger transmission
-	can_global_send_transfer_cmd(CAN0, CAN_TCR_MB1); // Send from MB1
-	
 	// DIAGNOSTIC: TX succeeded, check status
 	volatile uint32_t debug_after_tx_sr = CAN0->CAN_SR;
 	
 	// Wait for message to be transmitted and looped back
 	// In a real CAN network, the TX message should be seen by all nodes including self
-	delay_ms(50); // Increased delay for message propagation
-	
-	// Check if message was received in mailbox 2
-	uint32_t mb_status = can_mailbox_get_status(CAN0, 2); // Check MB2
-	volatile uint32_t debug_mb_status = mb_status;
-	volatile bool debug_msg_ready = (mb_status & CAN_MSR_MRDY) != 0;
-	
-	if (mb_status & CAN_MSR_MRDY) {
-		can_mb_conf_t rx;
-		rx.ul_mb_idx = 2; // Read from MB2
-		if (can_mailbox_read(CAN0, &rx) == CAN_MAILBOX_TRANSFER_OK) {
-			// Verify the received data matches what we sent
-			uint32_t received_id = (rx.ul_id >> CAN_MID_MIDvA_Pos) & 0x7FFu;
-			volatile uint32_t debug_received_id = received_id;
-			volatile uint32_t debug_expected_id = test_id;
-			
-			// DIAGNOSTIC: Check data integrity
-			volatile uint32_t debug_rx_datal = rx.ul_datal;
-			volatile uint32_t debug_rx_datah = rx.ul_datah;
-			
-			// Verify ID and data match
-			if (received_id == test_id && rx.ul_datal == dl) {
-				// Restore original mailbox configuration
-				// Reconfigure MB2 back to unused state
-				rx_mb.ul_mb_idx = 2;
-				rx_mb.uc_obj_type = CAN_MB_RX_MODE;
-				rx_mb.uc_id_ver = 0;
-				rx_mb.ul_id_msk = 0; // Accept all
-				rx_mb.ul_id = 0;
-				can_mailbox_init(CAN0, &rx_mb);
-				// Re-arm RX mailbox 2
-				can_mailbox_send_transfer_cmd(CAN0, &rx_mb);
-				
+	can_rx_frame_t rx;
+	while (can_rx_receive(&rx, 50)) { // Skip unrelated traffic until the test frame or timeout
+		// DIAGNOSTIC: Check data integrity
+		volatile uint32_t debug_received_id = rx.id;
+		volatile uint32_t debug_rx_datal = rx.datal;
+		volatile uint32_t debug_rx_datah = rx.datah;
+		
+		// Verify ID and data match
+		if (rx.id == test_id) {
+			if (rx.len == sizeof(test_data) && memcmp(rx.data, test_data, sizeof(test_data)) == 0) {
 				return true; // Test passed
-			} else {
-				// DIAGNOSTIC: ID or data mismatch
-				volatile uint32_t debug_mismatch = 1;
 			}
-		} else {
-			// DIAGNOSTIC: Mailbox read failed
-			volatile uint32_t debug_mb_read_failed = 1;
+			// DIAGNOSTIC: Data mismatch
+			volatile uint32_t debug_mismatch = 1;
+			return false;
 		}
-	} else {
-		// DIAGNOSTIC: No message received 
-		volatile uint32_t debug_no_loopback_rx = 1;
-		volatile uint32_t debug_final_sr = CAN0->CAN_SR;
-		
-		// Check if TX was successful
-		uint32_t tx_status = can_mailbox_get_status(CAN0, 1);
-		volatile uint32_t debug_tx_mb_status = tx_status;
-		
-		// Check error counters
-		volatile uint32_t debug_tx_errors = can_get_tx_error_cnt(CAN0);
-		volatile uint32_t debug_rx_errors = can_get_rx_error_cnt(CAN0);
 	}
 	
-	// Restore mailbox configuration
-	rx_mb.ul_mb_idx = 2;
-	rx_mb.uc_obj_type = CAN_MB_RX_MODE;
-	rx_mb.uc_id_ver = 0;
-	rx_mb.ul_id_msk = 0; // Accept all
-	rx_mb.ul_id = 0;
-	can_mailbox_init(CAN0, &rx_mb);
-	// Re-arm RX mailbox 2 after restore
-	can_mailbox_send_transfer_cmd(CAN0, &rx_mb);
+	// DIAGNOSTIC: No message received 
+	volatile uint32_t debug_no_loopback_rx = 1;
+	volatile uint32_t debug_final_sr = CAN0->CAN_SR;
+	
+	// Check if TX was successful
+	can_tx_stats_t tx_stats;
+	can_tx_get_stats(&tx_stats);
+	volatile uint32_t debug_tx_completed = tx_stats.completed;
+	volatile uint32_t debug_tx_in_flight = tx_stats.in_flight;
+	
+	// Check error counters
+	volatile uint32_t debug_tx_errors = can_get_tx_error_cnt(CAN0);
+	volatile uint32_t debug_rx_errors = can_get_rx_error_cnt(CAN0);
 	
 	return false; // Test failed
 }
@@ -503,9 +554,12 @@ void can_status_task(void *arg)
 {
 	(void)arg; // Unused
 	uint32_t status_report_interval = 0;
+	TickType_t last_tick = xTaskGetTickCount();
 	
 	for (;;) {
-		// Check CAN status periodically
+		// Bus-off recovery runs from CAN0_Handler (can_err.c); the poll only
+		// catches steps back towards error active, which raise no interrupt
+		can_err_poll();
 		bool can_ok = can_app_get_status();
 		
 		// Run diagnostics every 5 seconds
@@ -513,18 +567,44 @@ void can_status_task(void *arg)
 			can_diagnostic_info();
 		}
 		
+		// Close the bus-load window and publish the diagnostic summary (CAN_ID_DIAG)
+		TickType_t now = xTaskGetTickCount();
+		can_stats_tick((uint32_t)(now - last_tick) * portTICK_RATE_MS,
+		               (uint8_t)can_get_tx_error_cnt(CAN0), (uint8_t)can_get_rx_error_cnt(CAN0));
+		last_tick = now;
+		can_stats_t window;
+		can_stats_get(&window);
+		can_rate_update(&window); // Re-plan telemetry periods for the load just measured
+		can_app_publish_diag();
+		
+		can_status_t status;
+		status.can_ok = can_ok ? 0x01 : 0x00; // Status byte
+		status.err_state = can_err_state();
+		uint32_t datal, datah;
+		can_pack_status(&status, &datal, &datah);
+		can_producer_update(CAN_MSG_ID(status), datal, datah); // Answers remote frames if bound
+		
+		// Urgent lane reaction time, start of frame to handler call
+		can_urgent_stats_t urgent;
+		can_urgent_get_stats(&urgent);
+		volatile uint32_t debug_urgent_lat_last_us = urgent.lat_last_us;
+		volatile uint32_t debug_urgent_lat_max_us = urgent.lat_max_us;
+		volatile uint32_t debug_urgent_handled = urgent.handled;
+		
+		// Node ID claim: held once nobody challenged it for CAN_NODE_CLAIM_MS
+		can_node_tick((uint32_t)now * portTICK_RATE_MS);
+		can_node_status_t node;
+		can_node_get_status(&node);
+		volatile uint32_t debug_can_node_id = node.node;
+		volatile uint32_t debug_can_node_held = node.held;
+		
 		// Report status every 10 seconds (10000ms / 1000ms = 10 iterations)
 		status_report_interval++;
 		if (status_report_interval >= 10) {
 			status_report_interval = 0;
 			
-			// Send status message
-			uint8_t status_data[2] = {0};
-			status_data[0] = can_ok ? 0x01 : 0x00; // Status byte
-			status_data[1] = 0x00; // Reserved
-			
 			// Use the dedicated status ID
-			can_app_tx(CAN_ID_STATUS, status_data, 2);
+			can_app_tx_words(CAN_MSG_ID(status), datal, datah, CAN_MSG_DLC(status));
 		}
 		
 		vTaskDelay(pdMS_TO_TICKS(1000)); // Check every second
@@ -544,9 +624,9 @@ bool can_app_simple_test(void)
 		return false;
 	}
 	
-	// Check for error active state
-	if (can_sr & CAN_SR_ERRA) {
-		volatile uint32_t debug_error_active = 1;
+	// Check for error passive state (ERRA is the normal, healthy state)
+	if (can_sr & CAN_SR_ERRP) {
+		volatile uint32_t debug_error_passive = 1;
 		volatile uint32_t debug_tx_errors = can_get_tx_error_cnt(CAN0);
 		volatile uint32_t debug_rx_errors = can_get_rx_error_cnt(CAN0);
 		return false;
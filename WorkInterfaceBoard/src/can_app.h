@@ -1,4 +1,6 @@
 #pragma once
+#include "can_bittiming.h"
+#include "conf_can_node.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -6,26 +8,54 @@
 extern "C" {
 #endif
 
-#define CAN_BAUD_KBPS          500u // CAN bus bitrate in kbps
+#define CAN_BAUD_KBPS          500u // CAN bus bitrate in kbps (125, 250, 500 or 1000); tried first by autobaud, used on a silent bus
+#define CAN_SAMPLE_POINT_PERMILLE CAN_BITTIMING_SAMPLE_POINT(CAN_BAUD_KBPS * 1000u) // CiA 301 recommended sample point
 
-/* Default CAN IDs */
+/* Default CAN IDs. IDs in 0x100..0x2FF belong to one board and carry its node
+ * ID in the low four bits (can_node.h); the values below are node 0. The rest
+ * are shared by every board on the bus. CONF_CAN_LEGACY_IDS keeps the IDs of
+ * the single-board firmware (conf_can_node.h). */
+#define CAN_ID_STOP            0x010u // ID for the stop/release command (urgent lane, config/conf_can_urgent.h), all boards
 #define CAN_ID_LOADCELL        0x120u // ID for load cell measurements
-#define CAN_ID_ACCELEROMETER   0x121u // ID for accelerometer XYZ bytes
-#define CAN_ID_TEMPERATURE     0x122u // ID for temperature readings
-#define CAN_ID_TOOLTYPE        0x123u // ID for tool type status
 #define CAN_ID_ENCODER1        0x130u // ID for encoder1 position/velocity data
 #define CAN_ID_STATUS          0x200u // ID for system status messages
 #define CAN_ID_POT_COMMAND     0x220u // ID for potentiometer control/telemetry
+#define CAN_ID_ISOTP_TX        0x240u // ISO-TP bulk channel, this node to the tester
+#if CONF_CAN_LEGACY_IDS
+#define CAN_ID_ACCELEROMETER   0x121u
+#define CAN_ID_TEMPERATURE     0x122u
+#define CAN_ID_TOOLTYPE        0x123u
+#define CAN_ID_DIAG            0x201u
+#define CAN_ID_DIAG_ID         0x202u
+#define CAN_ID_DIAG_REQUEST    0x221u
+#define CAN_ID_ISOTP_RX        0x241u
+#define CAN_ID_FWU_TX          0x242u
+#define CAN_ID_FWU_RX          0x243u
+#else
+#define CAN_ID_ACCELEROMETER   0x140u // ID for accelerometer XYZ bytes
+#define CAN_ID_TEMPERATURE     0x150u // ID for temperature readings
+#define CAN_ID_TOOLTYPE        0x160u // ID for tool type status
+#define CAN_ID_DIAG            0x210u // ID for seen load / latency / error counter summary
+#define CAN_ID_DIAG_ID         0x280u // ID for per-ID frame counters (sent on request)
+#define CAN_ID_DIAG_REQUEST    0x230u // ID for on-demand diagnostic requests
+#define CAN_ID_ISOTP_RX        0x250u // ISO-TP bulk channel, tester to this node
+#define CAN_ID_FWU_TX          0x260u // ISO-TP firmware update channel, replies to the tester
+#define CAN_ID_FWU_RX          0x270u // ISO-TP firmware update channel, requests from the tester
+#endif
+#define CAN_ID_CLAIM           0x780u // Node ID claims, 0x780..0x7FF: low seven bits from the sender's name
 
 bool can_app_init(void); // Initialize CAN controller and RX mailbox
 bool can_app_tx(uint32_t id, const uint8_t *data, uint8_t len); // Transmit a CAN frame
+bool can_app_tx_words(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len); // Transmit pre-packed data words (see can_signals.h)
 void can_rx_task(void *arg); // FreeRTOS task for CAN RX and command handling
 bool can_app_get_status(void); // Get CAN controller status
 bool can_app_test_loopback(void); // Test CAN communication with loopback mode
 void can_status_task(void *arg); // FreeRTOS task for periodic CAN status monitoring
+void can_fwu_task(void *arg); // FreeRTOS task serving firmware update requests (fw_update.h)
 void can_diagnostic_info(void); // Comprehensive CAN diagnostic information
 bool can_app_simple_test(void); // Simple CAN controller state test for debugging
 bool can_verify_bitrate(uint32_t expected_kbps); // Verify CAN bit rate configuration
+bool can_app_stopped(void); // True while a stop command is latched (CAN_ID_STOP)
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,46 @@
+#include "can_autobaud.h"
+#include <stddef.h>
+
+static const uint32_t g_autobaud_bitrates[] = { CAN_AUTOBAUD_BITRATES };
+
+static bool can_autobaud_listed(const can_bittiming_t *out, uint32_t n, uint32_t bitrate)
+{
+	for (uint32_t i = 0; i < n; i++) {
+		if (out[i].bitrate == bitrate) return true;
+	}
+	return false;
+}
+
+uint32_t can_autobaud_candidates(uint32_t mck, uint32_t preferred_bps, can_bittiming_t *out, uint32_t max)
+{
+	uint32_t n = 0;
+	uint32_t total = sizeof(g_autobaud_bitrates) / sizeof(g_autobaud_bitrates[0]);
+	for (uint32_t i = 0; i <= total && n < max; i++) {
+		uint32_t bps = (i == 0) ? preferred_bps : g_autobaud_bitrates[i - 1u];
+		can_bittiming_t bt;
+		if (bps == 0 || !can_bittiming_solve(mck, bps, CAN_BITTIMING_SAMPLE_POINT(bps), &bt)) continue;
+		if (can_autobaud_listed(out, n, bt.bitrate)) continue;
+		out[n++] = bt;
+	}
+	return n;
+}
+
+bool can_autobaud_accept(const can_autobaud_obs_t *obs)
+{
+	return obs->errors == 0 && obs->frames >= CAN_AUTOBAUD_MIN_FRAMES;
+}
+
+bool can_autobaud_detect(const can_bittiming_t *cands, uint32_t count, can_autobaud_probe_t probe, void *ctx, can_bittiming_t *locked)
+{
+	for (uint32_t round = 0; round < CAN_AUTOBAUD_ROUNDS; round++) {
+		for (uint32_t i = 0; i < count; i++) {
+			can_autobaud_obs_t obs = { 0, 0 };
+			probe(ctx, &cands[i], can_bittiming_to_br(&cands[i]), &obs);
+			if (can_autobaud_accept(&obs)) {
+				if (locked != NULL) *locked = cands[i];
+				return true;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "can_bittiming.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Passive bitrate detection (see CONF_CAN_AUTOBAUD in conf_can_bittiming.h).
+ * The caller supplies the probe that programs a timing in listen mode and
+ * reports what the controller saw, so detection runs against the real CAN0
+ * (can_app.c) or a simulated controller on a host.
+ * Listen mode does not acknowledge, so a bitrate can only be recognised while
+ * at least one other node is active on the bus.
+ */
+
+#define CAN_AUTOBAUD_MAX_CANDIDATES 8u
+
+typedef struct {
+	uint32_t frames; // Frames received without error
+	uint32_t errors; // CRC, stuffing, ack, form or bit error flags seen
+} can_autobaud_obs_t;
+
+/* Listen with can_br for one window and fill obs (zeroed by the caller) */
+typedef void (*can_autobaud_probe_t)(void *ctx, const can_bittiming_t *bt, uint32_t can_br, can_autobaud_obs_t *obs);
+
+/* Solved timings for preferred_bps followed by the CAN_AUTOBAUD_BITRATES
+ * list, skipping repeats and rates with no timing for mck. Returns the count. */
+uint32_t can_autobaud_candidates(uint32_t mck, uint32_t preferred_bps, can_bittiming_t *out, uint32_t max);
+bool can_autobaud_accept(const can_autobaud_obs_t *obs); // Enough clean frames and no errors
+/* Probe each candidate in order for up to CAN_AUTOBAUD_ROUNDS passes and
+ * stop at the first one accepted. False if none was (silent bus). */
+bool can_autobaud_detect(const can_bittiming_t *cands, uint32_t count, can_autobaud_probe_t probe, void *ctx, can_bittiming_t *locked);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,76 @@
+#include "can_bench.h"
+#include "can_signals.h"
+#include "can_tx.h"
+#include "asf.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define CAN_BENCH_WAIT_MS      50u // Per frame, plenty at any bitrate
+
+// Encoder frame the way encoder1_task built it before can_signals.h
+static void can_bench_pack_bytes(int32_t position, int32_t velocity, uint8_t *data)
+{
+	for (uint8_t i = 0; i < 4; i++) data[i] = (uint8_t)((uint32_t)position >> (i * 8));
+	for (uint8_t i = 0; i < 4; i++) data[i + 4] = (uint8_t)((uint32_t)velocity >> (i * 8));
+}
+
+// Wait until the queue and the TX mailboxes are empty, so every frame starts alike
+static bool can_bench_idle(void)
+{
+	for (uint32_t ms = 0; ms < CAN_BENCH_WAIT_MS; ms++) {
+		can_tx_stats_t stats;
+		can_tx_get_stats(&stats);
+		if (stats.queued == 0 && stats.in_flight == 0) return true;
+		vTaskDelay(1);
+	}
+	return false;
+}
+
+// Cycles of one frame through the chosen path
+static uint32_t can_bench_frame(bool words, int32_t position, int32_t velocity, bool *ok)
+{
+	vTaskSuspendAll(); // No task switch inside the measurement; interrupts still count
+	uint32_t start = DWT->CYCCNT;
+	if (words) {
+		can_encoder1_t msg;
+		msg.position = position;
+		msg.velocity = velocity;
+		uint32_t datal, datah;
+		can_pack_encoder1(&msg, &datal, &datah);
+		*ok = can_tx_enqueue_words(CAN_BENCH_ID, datal, datah, CAN_MSG_DLC(encoder1));
+	} else {
+		uint8_t data[8];
+		can_bench_pack_bytes(position, velocity, data);
+		*ok = can_tx_enqueue(CAN_BENCH_ID, data, sizeof(data));
+	}
+	uint32_t cycles = DWT->CYCCNT - start;
+	xTaskResumeAll();
+	return cycles;
+}
+
+bool can_bench_tx(uint32_t frames, can_bench_result_t *result)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	uint32_t min[2] = { UINT32_MAX, UINT32_MAX };
+	uint64_t sum[2] = { 0, 0 };
+	for (uint32_t n = 0; n < frames; n++) {
+		for (uint32_t path = 0; path < 2; path++) {
+			bool ok = false;
+			if (!can_bench_idle()) return false; // Bus not taking frames
+			uint32_t cycles = can_bench_frame(path != 0, (int32_t)(n * 7919u), -(int32_t)n, &ok);
+			if (!ok) return false;
+			if (cycles < min[path]) min[path] = cycles;
+			sum[path] += cycles;
+		}
+	}
+
+	result->frames = frames;
+	result->bytes_min = min[0];
+	result->words_min = min[1];
+	result->bytes_avg = frames ? (uint32_t)(sum[0] / frames) : 0;
+	result->words_avg = frames ? (uint32_t)(sum[1] / frames) : 0;
+	return can_bench_idle();
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Cycle counts of the telemetry TX path, from an encoder sample to a loaded
+ * TX mailbox, measured with the DWT cycle counter. A debugging aid like
+ * can_app_test_loopback(): call it from a task with the bus up; it sends
+ * 2 * frames frames on CAN_BENCH_ID and waits for each one to leave.
+ */
+
+#define CAN_BENCH_ID           0x6FFu // Unassigned, below every application ID in priority
+
+typedef struct {
+	uint32_t frames;    // Frames measured per path
+	uint32_t bytes_min; // Fields packed into uint8_t[8] byte by byte, can_tx_enqueue()
+	uint32_t bytes_avg;
+	uint32_t words_min; // can_pack_encoder1() into the mailbox words, can_tx_enqueue_words()
+	uint32_t words_avg;
+} can_bench_result_t;
+
+bool can_bench_tx(uint32_t frames, can_bench_result_t *result); // Measure both paths, false if a frame did not get through
@@ -0,0 +1,97 @@
+#include "can_bittiming.h"
+#include <stddef.h>
+
+#define CAN_BT_BRP_MIN         2u
+#define CAN_BT_BRP_MAX         128u
+#define CAN_BT_TQ_MIN          8u
+#define CAN_BT_TQ_MAX          25u
+#define CAN_BT_SEG_MAX         8u  // PROPAG, PHASE1, PHASE2 upper limit
+#define CAN_BT_PHASE2_MIN      2u  // Information processing time
+#define CAN_BT_SJW_MAX         4u
+
+static uint32_t can_bt_min(uint32_t a, uint32_t b)
+{
+	return (a < b) ? a : b;
+}
+
+static uint32_t can_bt_absdiff(uint32_t a, uint32_t b)
+{
+	return (a > b) ? a - b : b - a;
+}
+
+/* Lexicographic comparison of the selection criteria, true if a beats b */
+static bool can_bt_better(const can_bittiming_t *a, const can_bittiming_t *b, uint16_t sp)
+{
+	if (a->err_ppm != b->err_ppm) return a->err_ppm < b->err_ppm;
+	uint32_t a_sp = can_bt_absdiff(a->sample_point, sp);
+	uint32_t b_sp = can_bt_absdiff(b->sample_point, sp);
+	if (a_sp != b_sp) return a_sp < b_sp;
+	if (a->sjw != b->sjw) return a->sjw > b->sjw;
+	uint32_t a_tq = 1u + a->propag + a->phase1 + a->phase2;
+	uint32_t b_tq = 1u + b->propag + b->phase1 + b->phase2;
+	if (a_tq != b_tq) return a_tq > b_tq;
+	return a->propag > b->propag;
+}
+
+bool can_bittiming_solve(uint32_t mck, uint32_t bitrate, uint16_t sample_point_permille, can_bittiming_t *out)
+{
+	if (mck == 0 || bitrate == 0) return false;
+
+	bool found = false;
+	can_bittiming_t best = {0};
+
+	for (uint32_t brp = CAN_BT_BRP_MIN; brp <= CAN_BT_BRP_MAX; brp++) {
+		for (uint32_t tq = CAN_BT_TQ_MIN; tq <= CAN_BT_TQ_MAX; tq++) {
+			uint64_t div = (uint64_t)brp * tq;
+			uint32_t rate = (uint32_t)(((uint64_t)mck + div / 2u) / div); // Rounded achieved bitrate
+			uint32_t err = (uint32_t)(((uint64_t)can_bt_absdiff(rate, bitrate) * 1000000u) / bitrate);
+			if (err > CAN_BITTIMING_MAX_ERR_PPM) continue;
+			if (found && err > best.err_ppm) continue; // Cannot win on the first criterion
+
+			// Split tq - 1 into PROPAG + PHASE1 + PHASE2
+			for (uint32_t ph2 = CAN_BT_PHASE2_MIN; ph2 <= CAN_BT_SEG_MAX; ph2++) {
+				if (ph2 + 2u > tq - 1u) break; // PROPAG and PHASE1 need one TQ each
+				uint32_t tseg1 = tq - 1u - ph2;
+				for (uint32_t ph1 = 1; ph1 <= CAN_BT_SEG_MAX && ph1 < tseg1; ph1++) {
+					uint32_t prop = tseg1 - ph1;
+					if (prop > CAN_BT_SEG_MAX) continue;
+
+					can_bittiming_t cand;
+					cand.brp = (uint8_t)brp;
+					cand.propag = (uint8_t)prop;
+					cand.phase1 = (uint8_t)ph1;
+					cand.phase2 = (uint8_t)ph2;
+					cand.sjw = (uint8_t)can_bt_min(CAN_BT_SJW_MAX, can_bt_min(ph1, ph2));
+					cand.bitrate = rate;
+					cand.err_ppm = err;
+					cand.sample_point = (uint16_t)(((1u + tseg1) * 1000u + tq / 2u) / tq);
+					if (!found || can_bt_better(&cand, &best, sample_point_permille)) {
+						best = cand;
+						found = true;
+					}
+				}
+			}
+		}
+	}
+
+	if (found && out != NULL) *out = best;
+	return found;
+}
+
+uint32_t can_bittiming_to_br(const can_bittiming_t *bt)
+{
+	return CAN_BITTIMING_BR(bt->brp, bt->propag, bt->phase1, bt->phase2, bt->sjw);
+}
+
+void can_bittiming_from_br(uint32_t br, uint32_t mck, can_bittiming_t *out)
+{
+	out->phase2 = (uint8_t)(((br >> 0) & 0x7u) + 1u);
+	out->phase1 = (uint8_t)(((br >> 4) & 0x7u) + 1u);
+	out->propag = (uint8_t)(((br >> 8) & 0x7u) + 1u);
+	out->sjw = (uint8_t)(((br >> 12) & 0x3u) + 1u);
+	out->brp = (uint8_t)(((br >> 16) & 0x7Fu) + 1u);
+	uint32_t tq = 1u + out->propag + out->phase1 + out->phase2;
+	out->bitrate = mck / ((uint32_t)out->brp * tq);
+	out->err_ppm = 0;
+	out->sample_point = (uint16_t)(((1u + out->propag + out->phase1) * 1000u + tq / 2u) / tq);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "conf_can_bittiming.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CAN bit-timing solver for the SAM4E CAN_BR register.
+ * A bit is 1 (sync) + PROPAG + PHASE1 + PHASE2 time quanta of BRP MCK cycles,
+ * sampled after SYNC + PROPAG + PHASE1. Hardware limits: BRP 2..128,
+ * PROPAG/PHASE1 1..8, PHASE2 2..8 (information processing time), 8..25 TQ per
+ * bit, SJW 1..4 and no longer than either phase segment.
+ * No hardware access, so it builds on a host.
+ */
+
+#define CAN_BITTIMING_MAX_ERR_PPM 5000u // Largest accepted bitrate error (0.5 %)
+#define CAN_BITTIMING_SAMPLE_POINT(bps) (((bps) >= 800000u) ? 750u : 875u) // CiA 301 recommended sample point, permille
+
+typedef struct {
+	uint8_t brp;           // Prescaler, MCK cycles per time quantum
+	uint8_t propag;        // Propagation segment, TQ
+	uint8_t phase1;        // Phase segment 1, TQ
+	uint8_t phase2;        // Phase segment 2, TQ
+	uint8_t sjw;           // Resynchronisation jump width, TQ
+	uint32_t bitrate;      // Achieved bitrate, bit/s
+	uint32_t err_ppm;      // |achieved - requested| / requested, ppm
+	uint16_t sample_point; // Achieved sample point, permille of the bit
+} can_bittiming_t;
+
+/* CAN_BR value, register fields hold value - 1, single sampling */
+#define CAN_BITTIMING_BR(brp, propag, phase1, phase2, sjw) \
+	((((uint32_t)(phase2) - 1u) << 0) | (((uint32_t)(phase1) - 1u) << 4) | \
+	 (((uint32_t)(propag) - 1u) << 8) | (((uint32_t)(sjw) - 1u) << 12) | \
+	 (((uint32_t)(brp) - 1u) << 16))
+
+/* Compile-time CAN_BR for a clock/bitrate pair listed in conf_can_bittiming.h,
+ * 0 if the pair is not listed. A constant expression when both are. */
+#define CAN_BITTIMING_GEN_SELECT(mck, bps, k_mck, k_bps, brp, propag, phase1, phase2, sjw) \
+	((mck) == (k_mck) && (bps) == (k_bps)) ? CAN_BITTIMING_BR(brp, propag, phase1, phase2, sjw) :
+#define CAN_BITTIMING_CONST_BR(mck, bps) (CAN_BITTIMING_KNOWN(CAN_BITTIMING_GEN_SELECT, mck, bps) 0u)
+
+/* Best timing for mck and bitrate: smallest bitrate error, then closest
+ * sample point, then widest SJW, then most TQ per bit, then longest
+ * propagation segment. False if nothing is within CAN_BITTIMING_MAX_ERR_PPM. */
+bool can_bittiming_solve(uint32_t mck, uint32_t bitrate, uint16_t sample_point_permille, can_bittiming_t *out);
+uint32_t can_bittiming_to_br(const can_bittiming_t *bt); // CAN_BR register value
+void can_bittiming_from_br(uint32_t br, uint32_t mck, can_bittiming_t *out); // Decode CAN_BR (err_ppm left 0)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,41 @@
+#include "can_dispatch.h"
+#include "can_app.h"
+#include <stddef.h>
+
+/* Slot numbers: 0 means "no handler", entries start at 1 */
+#define CAN_CMD_SLOT(handler, first_id, last_id) CAN_CMD_SLOT_##handler,
+enum {
+	CAN_CMD_SLOT_NONE = 0,
+	CAN_COMMAND_TABLE(CAN_CMD_SLOT)
+	CAN_CMD_SLOT_COUNT
+};
+
+/* Slot -> handler */
+#define CAN_CMD_HANDLER(handler, first_id, last_id) handler,
+static const can_cmd_handler_t g_can_cmd_handlers[CAN_CMD_SLOT_COUNT] = {
+	NULL,
+	CAN_COMMAND_TABLE(CAN_CMD_HANDLER)
+};
+
+/* ID -> slot, one byte per 11-bit ID (2 KB of flash). GNU range designators
+ * let a single entry cover an ID block. */
+#define CAN_CMD_INDEX(handler, first_id, last_id) [(first_id) ... (last_id)] = CAN_CMD_SLOT_##handler,
+static const uint8_t g_can_cmd_index[0x800] = {
+	CAN_COMMAND_TABLE(CAN_CMD_INDEX)
+};
+
+typedef char can_cmd_slot_fits_in_index[(CAN_CMD_SLOT_COUNT <= 256) ? 1 : -1]; // Compile-time limit check
+
+can_cmd_handler_t can_dispatch_lookup(uint32_t id)
+{
+	if (id > 0x7FFu) return NULL; // Not an 11-bit identifier
+	return g_can_cmd_handlers[g_can_cmd_index[id]];
+}
+
+bool can_dispatch(const can_rx_frame_t *frame)
+{
+	can_cmd_handler_t handler = can_dispatch_lookup(frame->id);
+	if (handler == NULL) return false;
+	handler(frame);
+	return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "can_rx.h"
+#include "conf_can_commands.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Constant-time dispatch of received frames to command handlers.
+ * Commands are registered at compile time in config/conf_can_commands.h.
+ */
+
+typedef void (*can_cmd_handler_t)(const can_rx_frame_t *frame); // Command handler callback
+
+/* Handler prototypes, one per table entry */
+#define CAN_CMD_PROTOTYPE(handler, first_id, last_id) void handler(const can_rx_frame_t *frame);
+CAN_COMMAND_TABLE(CAN_CMD_PROTOTYPE)
+
+bool can_dispatch(const can_rx_frame_t *frame); // Run the handler for frame->id, false if none registered
+can_cmd_handler_t can_dispatch_lookup(uint32_t id); // Handler registered for an ID, or NULL
+
+#ifdef __cplusplus
+}
+#endif
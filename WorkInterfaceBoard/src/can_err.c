@@ -0,0 +1,225 @@
+#include "can_err.h"
+#include "can_tx.h"
+#include "can_time.h"
+#include "asf.h"
+#include "can.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#define CAN_ERR_IRQ_ALL        (CAN_SR_ERRA | CAN_SR_WARN | CAN_SR_ERRP | CAN_SR_BOFF)
+
+/* Everything below is written with CAN0 masked: from CAN0_Handler, or from a
+ * task or the timer task inside a critical section.
+ */
+static Can *g_err_can = NULL;
+static uint32_t g_bitrate_bps = 500000u;
+static xTimerHandle g_backoff_timer = NULL;
+
+static can_err_state_t g_state = CAN_ERR_ACTIVE;
+static can_err_state_t g_hw = CAN_ERR_ACTIVE; // What CAN_SR shows; differs from g_state only in backoff
+static uint64_t g_bus_off_at = 0;  // Entry into the last bus-off
+static uint64_t g_released_at = 0; // TX queue released after the last bus-off
+static can_err_stats_t g_err_stats;
+
+static can_err_event_t g_log[CAN_ERR_LOG_LEN];
+static uint32_t g_log_head = 0;
+static uint32_t g_log_count = 0;
+
+static uint8_t can_err_sat8(uint32_t v)
+{
+	return (v > 0xFFu) ? 0xFFu : (uint8_t)v;
+}
+
+static uint32_t can_err_sat32(uint64_t v)
+{
+	return (v > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)v;
+}
+
+can_err_state_t can_err_state_from_sr(uint32_t can_sr)
+{
+	if (can_sr & CAN_SR_BOFF) return CAN_ERR_BUS_OFF;
+	if (can_sr & CAN_SR_ERRP) return CAN_ERR_PASSIVE;
+	if (can_sr & CAN_SR_WARN) return CAN_ERR_WARNING;
+	return CAN_ERR_ACTIVE;
+}
+
+uint32_t can_err_irq_mask(can_err_state_t state)
+{
+	switch (state) {
+	case CAN_ERR_ACTIVE:  return CAN_SR_WARN | CAN_SR_ERRP | CAN_SR_BOFF;
+	case CAN_ERR_WARNING: return CAN_SR_ERRP | CAN_SR_BOFF; // ERRA and WARN are both still set
+	case CAN_ERR_PASSIVE: return CAN_SR_ERRA | CAN_SR_BOFF; // ERRA returns below 128
+	case CAN_ERR_BUS_OFF: return CAN_SR_ERRA;               // Set again once recovered
+	default:              return CAN_SR_BOFF;
+	}
+}
+
+uint32_t can_err_backoff_ms(uint32_t streak)
+{
+	if (streak < 2u) return 0; // A single bus-off only waits for the hardware recovery
+	uint32_t shift = streak - 2u;
+	if (shift >= 16u) return CAN_ERR_BACKOFF_MAX_MS;
+	uint32_t ms = CAN_ERR_BACKOFF_FIRST_MS << shift;
+	return (ms > CAN_ERR_BACKOFF_MAX_MS) ? CAN_ERR_BACKOFF_MAX_MS : ms;
+}
+
+// Only interrupts that lead out of the state, the flags are levels
+static void can_err_set_irqs(can_err_state_t hw)
+{
+	uint32_t mask = can_err_irq_mask(hw);
+	g_err_can->CAN_IDR = CAN_ERR_IRQ_ALL & ~mask;
+	g_err_can->CAN_IER = mask;
+}
+
+static void can_err_log(can_err_state_t to, uint64_t now)
+{
+	can_err_event_t *ev = &g_log[g_log_head];
+	ev->at = now;
+	ev->from = (uint8_t)g_state;
+	ev->to = (uint8_t)to;
+	ev->tec = can_err_sat8(can_get_tx_error_cnt(g_err_can));
+	ev->rec = can_err_sat8(can_get_rx_error_cnt(g_err_can));
+	g_log_head = (g_log_head + 1u) % CAN_ERR_LOG_LEN;
+	if (g_log_count < CAN_ERR_LOG_LEN) g_log_count++;
+
+	g_state = to;
+	g_err_stats.state = to;
+	g_err_stats.transitions++;
+}
+
+static void can_err_release(uint64_t now)
+{
+	uint32_t us = can_err_sat32(can_time_to_us(now - g_bus_off_at));
+	g_err_stats.last_recovery_us = us;
+	if (us > g_err_stats.max_recovery_us) g_err_stats.max_recovery_us = us;
+	g_released_at = now;
+	can_tx_hold(false); // Reloads the mailboxes from the intact queue
+}
+
+// Follow a new CAN_SR; returns true if the timer task was woken
+static bool can_err_update(uint32_t can_sr, uint64_t now)
+{
+	can_err_state_t hw = can_err_state_from_sr(can_sr);
+	if (hw != g_hw) {
+		g_hw = hw;
+		can_err_set_irqs(hw);
+	}
+	if (hw == g_state) return false;
+	if (g_state == CAN_ERR_BACKOFF && hw != CAN_ERR_BUS_OFF) return false; // The timer ends the backoff
+
+	if (hw == CAN_ERR_BUS_OFF) {
+		uint64_t window = ((uint64_t)g_bitrate_bps * CAN_ERR_STREAK_MS) / 1000u;
+		bool repeat = (g_state == CAN_ERR_BACKOFF) ||
+		              (g_err_stats.bus_off != 0 && now - g_released_at < window);
+		g_err_stats.streak = repeat ? g_err_stats.streak + 1u : 1u;
+		g_err_stats.bus_off++;
+		g_bus_off_at = now;
+		can_tx_hold(true); // Loaded mailboxes are aborted back into the queue
+		can_err_log(hw, now);
+		return false;
+	}
+
+	if (g_state != CAN_ERR_BUS_OFF) {
+		can_err_log(hw, now); // Between active, warning and passive
+		return false;
+	}
+
+	// Back from bus-off: release now, or after the backoff for a repeat
+	uint32_t ms = can_err_backoff_ms(g_err_stats.streak);
+	g_err_stats.backoff_ms = ms;
+	if (ms != 0) {
+		portTickType ticks = (portTickType)(ms / portTICK_RATE_MS);
+		portBASE_TYPE woken = pdFALSE;
+		if (xTimerChangePeriodFromISR(g_backoff_timer, (ticks != 0) ? ticks : 1, &woken) == pdPASS) {
+			can_err_log(CAN_ERR_BACKOFF, now);
+			return woken == pdTRUE;
+		}
+		g_err_stats.backoff_ms = 0; // Timer queue full, release without the backoff
+	}
+	can_err_log(hw, now);
+	can_err_release(now);
+	return false;
+}
+
+static void can_err_backoff_done(xTimerHandle timer)
+{
+	(void)timer;
+	uint64_t now = can_time_now(); // Before the critical section, it takes its own
+	taskENTER_CRITICAL();
+	if (g_state == CAN_ERR_BACKOFF) { // Not overtaken by another bus-off
+		can_err_log(g_hw, now);
+		can_err_release(now);
+	}
+	taskEXIT_CRITICAL();
+}
+
+bool can_err_init(Can *p_can, uint32_t bitrate_bps)
+{
+	if (g_backoff_timer == NULL) {
+		g_backoff_timer = xTimerCreate((const signed char *)"canboff", 1, pdFALSE, NULL, can_err_backoff_done);
+		if (g_backoff_timer == NULL) return false;
+	}
+
+	uint64_t now = can_time_now();
+	taskENTER_CRITICAL();
+	g_err_can = p_can;
+	if (bitrate_bps != 0) g_bitrate_bps = bitrate_bps;
+	g_err_stats = (can_err_stats_t){0};
+	g_log_head = 0;
+	g_log_count = 0;
+	g_hw = can_err_state_from_sr(p_can->CAN_SR);
+	g_state = g_hw;
+	g_err_stats.state = g_hw;
+	can_err_set_irqs(g_hw);
+	if (g_hw == CAN_ERR_BUS_OFF) {
+		g_err_stats.bus_off = 1;
+		g_err_stats.streak = 1;
+		g_bus_off_at = now;
+		can_tx_hold(true);
+	}
+	taskEXIT_CRITICAL();
+	return true;
+}
+
+bool can_err_isr(uint32_t can_sr)
+{
+	if (g_err_can == NULL) return false;
+	if (can_err_state_from_sr(can_sr) == g_hw) return false; // Nothing moved, the common case
+	return can_err_update(can_sr, can_time_now_from_isr());
+}
+
+void can_err_poll(void)
+{
+	if (g_err_can == NULL) return;
+	uint64_t now = can_time_now();
+	taskENTER_CRITICAL();
+	bool woken = can_err_update(g_err_can->CAN_SR, now); // Clears the error event flags, nobody uses them
+	taskEXIT_CRITICAL();
+	if (woken) taskYIELD(); // Let the timer task start the backoff
+}
+
+can_err_state_t can_err_state(void)
+{
+	return g_state;
+}
+
+void can_err_get_stats(can_err_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = g_err_stats;
+	taskEXIT_CRITICAL();
+}
+
+uint32_t can_err_get_log(can_err_event_t *events, uint32_t max)
+{
+	taskENTER_CRITICAL();
+	uint32_t n = (g_log_count < max) ? g_log_count : max;
+	uint32_t first = (g_log_head + CAN_ERR_LOG_LEN - g_log_count) % CAN_ERR_LOG_LEN;
+	for (uint32_t i = 0; i < n; i++) {
+		events[i] = g_log[(first + i) % CAN_ERR_LOG_LEN];
+	}
+	taskEXIT_CRITICAL();
+	return n;
+}
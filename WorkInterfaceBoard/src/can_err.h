@@ -0,0 +1,63 @@
+#pragma once
+#include "sam4e.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CAN fault confinement state machine.
+ * CAN0_Handler passes every CAN_SR snapshot in; the ERRA/WARN/ERRP/BOFF
+ * interrupts are enabled only for the states the controller can move to from
+ * the current one, since those flags are levels, not events. The controller
+ * leaves bus-off by itself after 128 x 11 recessive bits (2.8 ms at
+ * 500 kbit/s). While it is off the TX queue is held (can_tx_hold()) and keeps
+ * every frame; after repeated bus-offs the hold is stretched by a backoff so a
+ * faulty link does not keep disturbing the bus.
+ */
+
+#define CAN_ERR_LOG_LEN            16u   // State transitions kept
+#define CAN_ERR_BACKOFF_FIRST_MS   10u   // Hold after the second bus-off in a row
+#define CAN_ERR_BACKOFF_MAX_MS     1000u // Longest hold, doubles from the first up to this
+#define CAN_ERR_STREAK_MS          1000u // Bus-off within this long of the last recovery counts as a repeat
+
+typedef enum {
+	CAN_ERR_ACTIVE = 0,  // Error counters below 96
+	CAN_ERR_WARNING = 1, // A counter at or above 96, still error active
+	CAN_ERR_PASSIVE = 2, // A counter at or above 128
+	CAN_ERR_BUS_OFF = 3, // TEC above 255, controller off the bus
+	CAN_ERR_BACKOFF = 4, // Recovered, TX queue still held for the backoff
+} can_err_state_t;
+
+typedef struct {
+	uint64_t at;    // Time of the transition in bit times (can_time.h)
+	uint8_t from;   // can_err_state_t
+	uint8_t to;     // can_err_state_t
+	uint8_t tec;    // Transmit error counter when it happened
+	uint8_t rec;    // Receive error counter when it happened
+} can_err_event_t;
+
+typedef struct {
+	can_err_state_t state;
+	uint32_t transitions;      // State changes since can_err_init()
+	uint32_t bus_off;          // Bus-off entries
+	uint32_t streak;           // Bus-offs in the current run of repeats
+	uint32_t backoff_ms;       // Hold applied after the last recovery
+	uint32_t last_recovery_us; // Bus-off entry to TX released, last time
+	uint32_t max_recovery_us;  // Longest of the above
+} can_err_stats_t;
+
+bool can_err_init(Can *p_can, uint32_t bitrate_bps); // Read the current state and enable its interrupts, false if the backoff timer cannot be created
+bool can_err_isr(uint32_t can_sr); // Track the state from CAN0_Handler's CAN_SR snapshot, returns true if a task was woken
+void can_err_poll(void); // Re-read CAN_SR (task context): steps back towards active raise no interrupt
+can_err_state_t can_err_state(void); // Current state
+can_err_state_t can_err_state_from_sr(uint32_t can_sr); // State the CAN_SR flags describe (never CAN_ERR_BACKOFF)
+uint32_t can_err_irq_mask(can_err_state_t state); // Error interrupts that signal a way out of state
+uint32_t can_err_backoff_ms(uint32_t streak); // TX hold after recovery for the n-th bus-off in a row
+void can_err_get_stats(can_err_stats_t *stats); // Snapshot of the counters
+uint32_t can_err_get_log(can_err_event_t *events, uint32_t max); // Copy the transition log oldest first, returns entries copied
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,206 @@
+#include "can_isotp.h"
+#include "can_app.h"
+#include "can_rx.h"
+#include "can_tx.h"
+#include "can_time.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "timers.h"
+
+#ifndef TickType_t
+typedef portTickType TickType_t;
+#endif
+#ifndef pdMS_TO_TICKS
+#define pdMS_TO_TICKS(ms) ((TickType_t)((ms) / portTICK_RATE_MS)) // Convert ms to OS ticks
+#endif
+
+/* The engines are only touched with CAN0 masked: from CAN0_Handler (hooks),
+ * or from a task or the timer task inside a critical section.
+ */
+typedef struct {
+	can_isotp_link_t link;
+	uint32_t tx_id;
+	uint32_t rx_id;
+	xSemaphoreHandle rx_sem;
+} can_isotp_chan_t;
+
+#define CAN_ISOTP_GEN_BUF(name, tx_id, rx_id, tx_size, rx_size, block_size, st_min) \
+	static uint8_t g_isotp_tx_##name[tx_size]; \
+	static uint8_t g_isotp_rx_##name[rx_size];
+CAN_ISOTP_TABLE(CAN_ISOTP_GEN_BUF)
+
+static bool can_isotp_emit(void *ctx, const uint8_t *data, uint8_t len);
+
+#define CAN_ISOTP_GEN_CHAN(name, txid, rxid, txsize, rxsize, bs, stmin) \
+	{ .link = { .emit = can_isotp_emit, .ctx = &g_isotp[CAN_ISOTP_CH(name)], \
+	            .tx_buf = g_isotp_tx_##name, .tx_size = (txsize), \
+	            .rx_buf = g_isotp_rx_##name, .rx_size = (rxsize), \
+	            .block_size = (bs), .st_min = (stmin) }, \
+	  .tx_id = (txid), .rx_id = (rxid) },
+static can_isotp_chan_t g_isotp[CAN_ISOTP_COUNT] = {
+	CAN_ISOTP_TABLE(CAN_ISOTP_GEN_CHAN)
+};
+
+static xTimerHandle g_isotp_timer = NULL;
+static uint64_t g_timer_due = CAN_ISOTP_NO_EVENT; // Earliest event the armed timer covers
+
+static uint64_t can_isotp_now_from_isr(void)
+{
+	return can_time_to_us(can_time_now_from_isr());
+}
+
+static bool can_isotp_emit(void *ctx, const uint8_t *data, uint8_t len)
+{
+	const can_isotp_chan_t *ch = (const can_isotp_chan_t *)ctx;
+	can_tx_frame_t frame = {0};
+	if (len > 8) len = 8;
+	memcpy(frame.data, data, len); // data[] overlays the mailbox words
+	return can_tx_enqueue_from_isr(ch->tx_id, frame.datal, frame.datah, len);
+}
+
+// Make sure the timer fires by the earliest pending event; returns true if the timer task was woken
+static bool can_isotp_arm(uint64_t now)
+{
+	uint64_t next = CAN_ISOTP_NO_EVENT;
+	for (uint32_t i = 0; i < CAN_ISOTP_COUNT; i++) {
+		uint64_t t = can_isotp_link_next_event(&g_isotp[i].link);
+		if (t < next) next = t;
+	}
+	if (next == CAN_ISOTP_NO_EVENT || next >= g_timer_due) return false;
+
+	uint64_t wait_ms = (next > now) ? (next - now + 999u) / 1000u : 0;
+	TickType_t ticks = (TickType_t)(wait_ms / portTICK_RATE_MS);
+	portBASE_TYPE woken = pdFALSE;
+	if (xTimerChangePeriodFromISR(g_isotp_timer, (ticks != 0) ? ticks : 1, &woken) == pdPASS) {
+		g_timer_due = next;
+	}
+	return woken == pdTRUE;
+}
+
+static void can_isotp_timer_cb(xTimerHandle timer)
+{
+	(void)timer;
+	uint64_t now = can_time_to_us(can_time_now());
+	taskENTER_CRITICAL();
+	g_timer_due = CAN_ISOTP_NO_EVENT;
+	for (uint32_t i = 0; i < CAN_ISOTP_COUNT; i++) {
+		can_isotp_link_poll(&g_isotp[i].link, now);
+	}
+	can_isotp_arm(now); // Own queue, no task to wake
+	taskEXIT_CRITICAL();
+}
+
+static bool can_isotp_rx_hook(const can_rx_frame_t *frame, bool *woken)
+{
+	for (uint32_t i = 0; i < CAN_ISOTP_COUNT; i++) {
+		can_isotp_chan_t *ch = &g_isotp[i];
+		if (frame->id != ch->rx_id) continue;
+
+		uint64_t now = can_isotp_now_from_isr();
+		bool was_ready = can_isotp_link_rx_ready(&ch->link);
+		can_isotp_link_on_frame(&ch->link, frame->data, frame->len, now);
+		if (!was_ready && can_isotp_link_rx_ready(&ch->link)) {
+			signed portBASE_TYPE w = pdFALSE;
+			xSemaphoreGiveFromISR(ch->rx_sem, &w);
+			if (w != pdFALSE) *woken = true;
+		}
+		if (can_isotp_arm(now)) *woken = true;
+		return true; // Consumed, never reaches the RX ring
+	}
+	return false;
+}
+
+static void can_isotp_tx_hook(const can_tx_frame_t *frame, uint64_t sent_at)
+{
+	(void)sent_at;
+	for (uint32_t i = 0; i < CAN_ISOTP_COUNT; i++) {
+		if (frame->id == g_isotp[i].tx_id) {
+			uint64_t now = can_isotp_now_from_isr();
+			can_isotp_link_on_tx_done(&g_isotp[i].link, now);
+			can_isotp_arm(now); // Timer task runs at top priority, the next tick is soon enough
+			return;
+		}
+	}
+}
+
+bool can_isotp_init(void)
+{
+	if (g_isotp_timer == NULL) {
+		g_isotp_timer = xTimerCreate((const signed char *)"isotp", 1, pdFALSE, NULL, can_isotp_timer_cb);
+		if (g_isotp_timer == NULL) return false;
+	}
+	for (uint32_t i = 0; i < CAN_ISOTP_COUNT; i++) {
+		if (g_isotp[i].rx_sem == NULL) {
+			vSemaphoreCreateBinary(g_isotp[i].rx_sem);
+			if (g_isotp[i].rx_sem == NULL) return false;
+			xSemaphoreTake(g_isotp[i].rx_sem, 0); // Created given
+		}
+	}
+
+	can_isotp_reset();
+
+	can_rx_set_isr_hook(can_isotp_rx_hook);
+	can_tx_set_complete_hook(can_isotp_tx_hook);
+	return true;
+}
+
+void can_isotp_reset(void)
+{
+	taskENTER_CRITICAL();
+	for (uint32_t i = 0; i < CAN_ISOTP_COUNT; i++) {
+		can_isotp_link_init(&g_isotp[i].link);
+		xSemaphoreTake(g_isotp[i].rx_sem, 0); // A message not read yet is gone with its link
+	}
+	g_timer_due = CAN_ISOTP_NO_EVENT; // A timer still running finds idle links
+	taskEXIT_CRITICAL();
+}
+
+bool can_isotp_send(uint32_t ch, const uint8_t *data, uint32_t len)
+{
+	if (ch >= CAN_ISOTP_COUNT) return false;
+	uint64_t now = can_time_to_us(can_time_now()); // Before the critical section, it takes its own
+	taskENTER_CRITICAL();
+	bool started = can_isotp_link_send(&g_isotp[ch].link, data, len, now);
+	bool woken = started && can_isotp_arm(now); // N_Bs from here
+	taskEXIT_CRITICAL();
+	if (woken) taskYIELD();
+	return started;
+}
+
+bool can_isotp_tx_busy(uint32_t ch)
+{
+	if (ch >= CAN_ISOTP_COUNT) return false;
+	taskENTER_CRITICAL();
+	bool busy = can_isotp_link_tx_busy(&g_isotp[ch].link);
+	taskEXIT_CRITICAL();
+	return busy;
+}
+
+int32_t can_isotp_receive(uint32_t ch, uint8_t *buf, uint32_t max, uint32_t timeout_ms)
+{
+	if (ch >= CAN_ISOTP_COUNT) return -1;
+	for (;;) {
+		// The ISR leaves a ready buffer alone until it is read
+		taskENTER_CRITICAL();
+		int32_t len = can_isotp_link_read(&g_isotp[ch].link, buf, max);
+		taskEXIT_CRITICAL();
+		if (len >= 0 || timeout_ms == 0) return len;
+
+		TickType_t ticks = (timeout_ms == CAN_ISOTP_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+		if (xSemaphoreTake(g_isotp[ch].rx_sem, ticks) != pdTRUE) {
+			return -1; // Timed out
+		}
+	}
+}
+
+void can_isotp_get_stats(uint32_t ch, can_isotp_stats_t *stats)
+{
+	if (ch >= CAN_ISOTP_COUNT) return;
+	taskENTER_CRITICAL();
+	*stats = g_isotp[ch].link.stats;
+	taskEXIT_CRITICAL();
+}
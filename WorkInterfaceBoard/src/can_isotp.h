@@ -0,0 +1,37 @@
+#pragma once
+#include "can_isotp_link.h"
+#include "conf_can_isotp.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ISO-TP channels on CAN0 (see config/conf_can_isotp.h).
+ * Frames on a channel's rx_id are taken in CAN0_Handler before the RX ring and
+ * TX completions drive the consecutive frames, so a transfer runs without any
+ * task involvement once started. A FreeRTOS timer covers STmin pacing and the
+ * N_As / N_Bs / N_Cr timeouts. can_isotp owns the can_tx completion hook.
+ */
+
+#define CAN_ISOTP_CH(name)     can_isotp_ch_##name // Channel index
+
+#define CAN_ISOTP_GEN_CH(name, tx_id, rx_id, tx_size, rx_size, block_size, st_min) CAN_ISOTP_CH(name),
+enum {
+	CAN_ISOTP_TABLE(CAN_ISOTP_GEN_CH)
+	CAN_ISOTP_COUNT
+};
+
+#define CAN_ISOTP_WAIT_FOREVER 0xFFFFFFFFu // can_isotp_receive() timeout that never expires
+
+bool can_isotp_init(void); // Reset the channels and install the CAN hooks, false if out of FreeRTOS heap
+void can_isotp_reset(void); // Drop every transfer in either direction, links idle (after a node ID move)
+bool can_isotp_send(uint32_t ch, const uint8_t *data, uint32_t len); // Copy and start a transfer (non-blocking), false if busy or too long
+bool can_isotp_tx_busy(uint32_t ch); // The previous transfer is still going
+int32_t can_isotp_receive(uint32_t ch, uint8_t *buf, uint32_t max, uint32_t timeout_ms); // Take a complete message, waiting up to timeout_ms (0 = poll); its length or -1
+void can_isotp_get_stats(uint32_t ch, can_isotp_stats_t *stats); // Snapshot of a channel's counters
+
+#ifdef __cplusplus
+}
+#endif
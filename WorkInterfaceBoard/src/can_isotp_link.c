@@ -0,0 +1,279 @@
+#include "can_isotp_link.h"
+#include <string.h>
+
+#define ISOTP_PCI_SF           0x00u
+#define ISOTP_PCI_FF           0x10u
+#define ISOTP_PCI_CF           0x20u
+#define ISOTP_PCI_FC           0x30u
+
+#define ISOTP_FS_CTS           0u
+#define ISOTP_FS_WAIT          1u
+#define ISOTP_FS_OVFLW         2u
+
+enum { TX_IDLE, TX_WAIT_FC, TX_SENDING, TX_DRAIN };
+enum { RX_IDLE, RX_BUSY, RX_READY };
+
+uint32_t can_isotp_st_min_us(uint8_t raw)
+{
+	if (raw <= 0x7Fu) return (uint32_t)raw * 1000u;
+	if (raw >= 0xF1u && raw <= 0xF9u) return (uint32_t)(raw - 0xF0u) * 100u;
+	return 127000u; // Reserved values mean the longest STmin
+}
+
+static bool can_isotp_emit(can_isotp_link_t *link, const uint8_t *data, uint8_t len, uint64_t now)
+{
+	if (!link->emit(link->ctx, data, len)) return false;
+	if (link->tx_in_flight++ == 0) link->tx_as_deadline = now + CAN_ISOTP_N_AS_US;
+	return true;
+}
+
+static bool can_isotp_send_fc(can_isotp_link_t *link, uint8_t fs, uint64_t now)
+{
+	uint8_t fc[3] = { (uint8_t)(ISOTP_PCI_FC | fs), link->block_size, link->st_min };
+	return can_isotp_emit(link, fc, sizeof(fc), now);
+}
+
+/* Emit consecutive frames while the receiver's block, STmin and the queue
+ * window allow */
+static void can_isotp_pump(can_isotp_link_t *link, uint64_t now)
+{
+	uint8_t window = (link->tx_st_us == 0) ? CAN_ISOTP_TX_WINDOW : 1u;
+	while (link->tx_state == TX_SENDING && link->tx_in_flight < window && now >= link->tx_ready_at) {
+		uint8_t cf[8];
+		uint32_t n = link->tx_len - link->tx_pos;
+		if (n > 7u) n = 7u;
+		cf[0] = (uint8_t)(ISOTP_PCI_CF | (link->tx_sn & 0x0Fu));
+		memcpy(&cf[1], &link->tx_buf[link->tx_pos], n);
+		if (!can_isotp_emit(link, cf, (uint8_t)(n + 1u), now)) {
+			link->tx_ready_at = now + CAN_ISOTP_RETRY_US;
+			return;
+		}
+		link->tx_pos = (uint16_t)(link->tx_pos + n);
+		link->tx_sn++;
+
+		if (link->tx_pos >= link->tx_len) {
+			link->tx_state = TX_DRAIN; // Done once the queued frames have left
+		} else if (link->tx_bs != 0 && --link->tx_bs_left == 0) {
+			link->tx_state = TX_WAIT_FC;
+			link->tx_deadline = now + CAN_ISOTP_N_BS_US;
+			link->tx_wait_count = 0;
+		}
+	}
+}
+
+static void can_isotp_tx_finish(can_isotp_link_t *link)
+{
+	if (link->tx_state == TX_DRAIN && link->tx_in_flight == 0) {
+		link->tx_state = TX_IDLE;
+		link->stats.tx_done++;
+	}
+}
+
+void can_isotp_link_init(can_isotp_link_t *link)
+{
+	link->tx_state = TX_IDLE;
+	link->tx_in_flight = 0;
+	link->rx_state = RX_IDLE;
+	memset(&link->stats, 0, sizeof(link->stats));
+}
+
+bool can_isotp_link_send(can_isotp_link_t *link, const uint8_t *data, uint32_t len, uint64_t now_us)
+{
+	if (link->tx_state != TX_IDLE || len == 0 || len > CAN_ISOTP_MAX_LEN) return false;
+
+	uint8_t frame[8];
+	if (len <= 7u) {
+		frame[0] = (uint8_t)(ISOTP_PCI_SF | len);
+		memcpy(&frame[1], data, len);
+		if (!can_isotp_emit(link, frame, (uint8_t)(len + 1u), now_us)) return false;
+		link->tx_state = TX_DRAIN;
+		link->tx_len = (uint16_t)len;
+		link->tx_pos = (uint16_t)len;
+		return true;
+	}
+
+	if (len > link->tx_size) return false;
+	frame[0] = (uint8_t)(ISOTP_PCI_FF | (len >> 8));
+	frame[1] = (uint8_t)len;
+	memcpy(&frame[2], data, 6);
+	if (!can_isotp_emit(link, frame, 8, now_us)) return false;
+
+	memcpy(link->tx_buf, data, len);
+	link->tx_len = (uint16_t)len;
+	link->tx_pos = 6;
+	link->tx_sn = 1;
+	link->tx_wait_count = 0;
+	link->tx_state = TX_WAIT_FC;
+	link->tx_deadline = now_us + CAN_ISOTP_N_BS_US;
+	return true;
+}
+
+static void can_isotp_on_fc(can_isotp_link_t *link, const uint8_t *data, uint8_t len, uint64_t now)
+{
+	if (link->tx_state != TX_WAIT_FC || len < 3) return;
+
+	switch (data[0] & 0x0Fu) {
+	case ISOTP_FS_CTS:
+		link->tx_bs = data[1];
+		link->tx_bs_left = data[1];
+		link->tx_st_us = can_isotp_st_min_us(data[2]);
+		link->tx_ready_at = now;
+		link->tx_state = TX_SENDING;
+		can_isotp_pump(link, now);
+		break;
+	case ISOTP_FS_WAIT:
+		if (++link->tx_wait_count > CAN_ISOTP_WFT_MAX) {
+			link->tx_state = TX_IDLE;
+			link->stats.tx_timeout++;
+		} else {
+			link->tx_deadline = now + CAN_ISOTP_N_BS_US;
+		}
+		break;
+	default: // Overflow or reserved: the receiver cannot take the message
+		link->tx_state = TX_IDLE;
+		link->stats.tx_refused++;
+		break;
+	}
+}
+
+static void can_isotp_on_sf(can_isotp_link_t *link, const uint8_t *data, uint8_t len)
+{
+	uint8_t n = data[0] & 0x0Fu;
+	if (n == 0 || n > 7u || n >= len) return; // Malformed
+	if (link->rx_state == RX_READY || n > link->rx_size) {
+		link->stats.rx_overflow++;
+		return;
+	}
+	memcpy(link->rx_buf, &data[1], n);
+	link->rx_len = n;
+	link->rx_state = RX_READY; // Replaces any message in progress
+	link->stats.rx_done++;
+}
+
+static void can_isotp_on_ff(can_isotp_link_t *link, const uint8_t *data, uint8_t len, uint64_t now)
+{
+	if (len < 8) return;
+	uint32_t total = ((uint32_t)(data[0] & 0x0Fu) << 8) | data[1];
+	if (total < 8u) return; // Would have fitted a single frame
+
+	if (link->rx_state == RX_READY || total > link->rx_size) {
+		link->stats.rx_overflow++;
+		can_isotp_send_fc(link, ISOTP_FS_OVFLW, now);
+		return;
+	}
+	memcpy(link->rx_buf, &data[2], 6);
+	link->rx_len = (uint16_t)total;
+	link->rx_pos = 6;
+	link->rx_sn = 1;
+	link->rx_bs_left = link->block_size;
+	link->rx_deadline = now + CAN_ISOTP_N_CR_US;
+	link->rx_state = RX_BUSY; // Replaces any message in progress
+	if (!can_isotp_send_fc(link, ISOTP_FS_CTS, now)) {
+		link->rx_state = RX_IDLE; // The sender times out and may retry
+	}
+}
+
+static void can_isotp_on_cf(can_isotp_link_t *link, const uint8_t *data, uint8_t len, uint64_t now)
+{
+	if (link->rx_state != RX_BUSY) return;
+	if ((data[0] & 0x0Fu) != (link->rx_sn & 0x0Fu)) {
+		link->rx_state = RX_IDLE;
+		link->stats.rx_seq_error++;
+		return;
+	}
+	uint32_t n = link->rx_len - link->rx_pos;
+	if (n > 7u) n = 7u;
+	if (len < n + 1u) return; // Short frame, wait for N_Cr
+
+	memcpy(&link->rx_buf[link->rx_pos], &data[1], n);
+	link->rx_pos = (uint16_t)(link->rx_pos + n);
+	link->rx_sn++;
+	link->rx_deadline = now + CAN_ISOTP_N_CR_US;
+
+	if (link->rx_pos >= link->rx_len) {
+		link->rx_state = RX_READY;
+		link->stats.rx_done++;
+	} else if (link->block_size != 0 && --link->rx_bs_left == 0) {
+		link->rx_bs_left = link->block_size;
+		can_isotp_send_fc(link, ISOTP_FS_CTS, now);
+	}
+}
+
+void can_isotp_link_on_frame(can_isotp_link_t *link, const uint8_t *data, uint8_t len, uint64_t now_us)
+{
+	if (len == 0) return;
+	switch (data[0] & 0xF0u) {
+	case ISOTP_PCI_SF: can_isotp_on_sf(link, data, len); break;
+	case ISOTP_PCI_FF: can_isotp_on_ff(link, data, len, now_us); break;
+	case ISOTP_PCI_CF: can_isotp_on_cf(link, data, len, now_us); break;
+	case ISOTP_PCI_FC: can_isotp_on_fc(link, data, len, now_us); break;
+	default: break;
+	}
+}
+
+void can_isotp_link_on_tx_done(can_isotp_link_t *link, uint64_t now_us)
+{
+	if (link->tx_in_flight == 0) return;
+	if (--link->tx_in_flight != 0) link->tx_as_deadline = now_us + CAN_ISOTP_N_AS_US; // The next one is on the bus now
+	if (link->tx_state == TX_SENDING) {
+		if (link->tx_st_us != 0) link->tx_ready_at = now_us + link->tx_st_us;
+		can_isotp_pump(link, now_us);
+	}
+	can_isotp_tx_finish(link);
+}
+
+void can_isotp_link_poll(can_isotp_link_t *link, uint64_t now_us)
+{
+	/* N_As: a queued frame that never leaves (bus-off, TX held, dropped from
+	 * the queue) would keep the sender busy forever. Give the message up; a
+	 * late completion is ignored once tx_in_flight is back at 0. */
+	if (link->tx_in_flight != 0 && now_us >= link->tx_as_deadline) {
+		link->tx_in_flight = 0;
+		if (link->tx_state != TX_IDLE) {
+			link->tx_state = TX_IDLE;
+			link->stats.tx_stalled++;
+		}
+	}
+	if (link->tx_state == TX_WAIT_FC && now_us >= link->tx_deadline) {
+		link->tx_state = TX_IDLE;
+		link->stats.tx_timeout++;
+	} else if (link->tx_state == TX_SENDING) {
+		can_isotp_pump(link, now_us);
+	}
+	if (link->rx_state == RX_BUSY && now_us >= link->rx_deadline) {
+		link->rx_state = RX_IDLE;
+		link->stats.rx_timeout++;
+	}
+}
+
+uint64_t can_isotp_link_next_event(const can_isotp_link_t *link)
+{
+	uint64_t next = (link->tx_in_flight != 0) ? link->tx_as_deadline : CAN_ISOTP_NO_EVENT;
+	if (link->tx_state == TX_WAIT_FC) {
+		if (link->tx_deadline < next) next = link->tx_deadline;
+	} else if (link->tx_state == TX_SENDING) {
+		uint8_t window = (link->tx_st_us == 0) ? CAN_ISOTP_TX_WINDOW : 1u;
+		if (link->tx_in_flight < window && link->tx_ready_at < next) next = link->tx_ready_at; // Otherwise a completion moves it on
+	}
+	if (link->rx_state == RX_BUSY && link->rx_deadline < next) next = link->rx_deadline;
+	return next;
+}
+
+bool can_isotp_link_tx_busy(const can_isotp_link_t *link)
+{
+	return link->tx_state != TX_IDLE;
+}
+
+bool can_isotp_link_rx_ready(const can_isotp_link_t *link)
+{
+	return link->rx_state == RX_READY;
+}
+
+int32_t can_isotp_link_read(can_isotp_link_t *link, uint8_t *buf, uint32_t max)
+{
+	if (link->rx_state != RX_READY) return -1;
+	uint32_t n = (link->rx_len < max) ? link->rx_len : max;
+	memcpy(buf, link->rx_buf, n);
+	link->rx_state = RX_IDLE;
+	return (int32_t)link->rx_len;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ISO 15765-2 (ISO-TP) protocol engine for one pair of CAN IDs.
+ * Segmentation, reassembly and flow control only: the owner feeds it received
+ * frames, TX completions and the time, and it emits frames through a callback.
+ * No hardware or RTOS access, so two links can be wired back to back on a host.
+ * Classic CAN, normal addressing, unpadded frames, messages up to 4095 bytes.
+ */
+
+#define CAN_ISOTP_MAX_LEN      4095u    // 12-bit FF_DL
+#define CAN_ISOTP_N_BS_US      1000000u // Sender wait for flow control
+#define CAN_ISOTP_N_CR_US      1000000u // Receiver wait for the next consecutive frame
+#define CAN_ISOTP_N_AS_US      1000000u // Wait for a queued frame to leave its mailbox
+#define CAN_ISOTP_WFT_MAX      8u       // Flow control WAIT frames accepted in a row
+#define CAN_ISOTP_TX_WINDOW    3u       // Frames queued ahead with STmin 0 (one per TX queue mailbox)
+#define CAN_ISOTP_RETRY_US     1000u    // Retry delay when the TX queue refused a frame
+#define CAN_ISOTP_NO_EVENT     UINT64_MAX
+
+/* Queue one frame on the link's TX ID; false if it could not be queued */
+typedef bool (*can_isotp_emit_t)(void *ctx, const uint8_t *data, uint8_t len);
+
+typedef struct {
+	uint32_t tx_done;      // Messages sent completely
+	uint32_t tx_timeout;   // No flow control within N_Bs
+	uint32_t tx_refused;   // Receiver answered overflow
+	uint32_t tx_stalled;   // A queued frame not sent within N_As, message dropped
+	uint32_t rx_done;      // Messages received completely
+	uint32_t rx_timeout;   // No consecutive frame within N_Cr
+	uint32_t rx_seq_error; // Wrong sequence number, message dropped
+	uint32_t rx_overflow;  // Message refused: too long, or the last one not read yet
+} can_isotp_stats_t;
+
+typedef struct {
+	/* Configuration, filled in before can_isotp_link_init() */
+	can_isotp_emit_t emit;
+	void *ctx;
+	uint8_t *tx_buf;
+	uint16_t tx_size;
+	uint8_t *rx_buf;
+	uint16_t rx_size;
+	uint8_t block_size;    // BS granted as receiver, 0 = no further flow control
+	uint8_t st_min;        // STmin asked for as receiver (raw ISO value)
+
+	/* Sender */
+	uint8_t tx_state;
+	uint8_t tx_sn;
+	uint8_t tx_bs;         // Block size granted by the receiver
+	uint8_t tx_bs_left;
+	uint8_t tx_wait_count;
+	uint8_t tx_in_flight;  // Frames queued on the bus, not yet completed
+	uint16_t tx_len;
+	uint16_t tx_pos;
+	uint32_t tx_st_us;     // Receiver's STmin
+	uint64_t tx_ready_at;  // Next consecutive frame not before this
+	uint64_t tx_deadline;  // N_Bs expiry while waiting for flow control
+	uint64_t tx_as_deadline; // N_As expiry while frames are in flight
+
+	/* Receiver */
+	uint8_t rx_state;
+	uint8_t rx_sn;
+	uint8_t rx_bs_left;
+	uint16_t rx_len;
+	uint16_t rx_pos;
+	uint64_t rx_deadline;  // N_Cr expiry
+
+	can_isotp_stats_t stats;
+} can_isotp_link_t;
+
+void can_isotp_link_init(can_isotp_link_t *link); // Reset both directions, keeps the configuration
+bool can_isotp_link_send(can_isotp_link_t *link, const uint8_t *data, uint32_t len, uint64_t now_us); // Copy and start a message; false if busy, too long or not queued
+void can_isotp_link_on_frame(can_isotp_link_t *link, const uint8_t *data, uint8_t len, uint64_t now_us); // Frame received on the RX ID
+void can_isotp_link_on_tx_done(can_isotp_link_t *link, uint64_t now_us); // A frame emitted by this link has left its mailbox
+void can_isotp_link_poll(can_isotp_link_t *link, uint64_t now_us); // Timeouts (N_As, N_Bs, N_Cr) and STmin pacing
+uint64_t can_isotp_link_next_event(const can_isotp_link_t *link); // Time the link next needs a poll, CAN_ISOTP_NO_EVENT if none
+bool can_isotp_link_tx_busy(const can_isotp_link_t *link); // A message is still being sent
+bool can_isotp_link_rx_ready(const can_isotp_link_t *link); // A complete message waits to be read
+int32_t can_isotp_link_read(can_isotp_link_t *link, uint8_t *buf, uint32_t max); // Take the message (truncated to max), returns its length or -1
+uint32_t can_isotp_st_min_us(uint8_t raw); // Decode an STmin byte
+
+#ifdef __cplusplus
+}
+#endif
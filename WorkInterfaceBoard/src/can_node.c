@@ -0,0 +1,200 @@
+#include "can_node.h"
+#include "can_app.h"
+#include "can_dispatch.h"
+#include "can_signals.h"
+#include "can_tx.h"
+#include "asf.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define CAN_NODE_ID_CLAIM_SPREAD 0x7Fu // Claim ID bits taken from the name, so two boards rarely send the same ID
+
+// Every per-board ID must leave the node ID bits clear
+#define CAN_NODE_BLOCK_IDS     (CAN_ID_LOADCELL | CAN_ID_ACCELEROMETER | CAN_ID_TEMPERATURE | CAN_ID_TOOLTYPE | \
+                                CAN_ID_ENCODER1 | CAN_ID_STATUS | CAN_ID_DIAG | CAN_ID_DIAG_ID | \
+                                CAN_ID_POT_COMMAND | CAN_ID_DIAG_REQUEST | CAN_ID_ISOTP_TX | CAN_ID_ISOTP_RX | \
+                                CAN_ID_FWU_TX | CAN_ID_FWU_RX)
+typedef char can_node_ids_aligned[(CONF_CAN_EXTENDED_ID || (CAN_NODE_BLOCK_IDS & CAN_NODE_ID_MASK) == 0) ? 1 : -1]; // Compile-time layout check
+#if CONF_CAN_LEGACY_IDS && (CONF_CAN_NODE_CLAIM || CONF_CAN_EXTENDED_ID || CONF_CAN_NODE_ID != 0)
+#error "CONF_CAN_LEGACY_IDS is one board at node 0: clear CONF_CAN_NODE_CLAIM and CONF_CAN_EXTENDED_ID"
+#endif
+typedef char can_node_claims_outside[(CAN_ID_CLAIM > CAN_NODE_BLOCK_LAST) ? 1 : -1];
+
+static volatile uint32_t g_node = CONF_CAN_NODE_ID; // Read by CAN0_Handler
+static volatile bool g_node_moved = false;
+static can_node_claim_t g_claim;
+
+#if CONF_CAN_NODE_CLAIM
+static uint32_t g_uid[4];      // Chip unique ID, names come from it
+static uint32_t g_name_round;  // Name rounds taken after clashes
+static uint32_t g_claim_id = CAN_ID_CLAIM; // From the first name, kept across renames
+
+static uint32_t can_node_now_ms(void)
+{
+	return (uint32_t)xTaskGetTickCount() * portTICK_RATE_MS;
+}
+
+/* The unique ID is read through the flash array itself, so this runs from RAM
+ * with interrupts masked until the EFC maps the array back (see
+ * fw_flash_efc.c). */
+RAMFUNC static void can_node_read_uid(uint32_t uid[4])
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	EFC->EEFC_FCR = EEFC_FCR_FKEY_PASSWD | EEFC_FCR_FCMD_STUI;
+	while (EFC->EEFC_FSR & EEFC_FSR_FRDY) {
+		// FRDY falls once the unique ID replaces the array
+	}
+	const volatile uint32_t *p = (const volatile uint32_t *)IFLASH_ADDR;
+	for (uint32_t i = 0; i < 4u; i++) {
+		uid[i] = p[i];
+	}
+	EFC->EEFC_FCR = EEFC_FCR_FKEY_PASSWD | EEFC_FCR_FCMD_SPUI;
+	while (!(EFC->EEFC_FSR & EEFC_FSR_FRDY)) {
+	}
+	__set_PRIMASK(primask);
+}
+#endif
+
+uint32_t can_node_init(void)
+{
+#if CONF_CAN_NODE_CLAIM
+	can_node_read_uid(g_uid);
+	taskENTER_CRITICAL();
+	g_name_round = 0;
+	g_node = can_node_claim_start(&g_claim, can_node_claim_name(g_uid, 0), CAN_NODE_COUNT, CONF_CAN_NODE_ID,
+	                              can_node_now_ms());
+	g_claim_id = CAN_MSG_ID(claim) | (uint32_t)(g_claim.name & CAN_NODE_ID_CLAIM_SPREAD);
+	g_node_moved = false;
+	taskEXIT_CRITICAL();
+#endif
+	return g_node;
+}
+
+void can_node_announce(void)
+{
+#if CONF_CAN_NODE_CLAIM
+	can_node_claim_msg_t m;
+	taskENTER_CRITICAL();
+	can_node_claim_msg(&g_claim, &m);
+	taskEXIT_CRITICAL();
+
+	can_claim_t msg;
+	msg.node = m.node;
+	msg.held = m.held ? 1u : 0u;
+	msg.name_lo = (uint32_t)m.name;
+	msg.name_hi = (uint32_t)(m.name >> 32);
+	uint32_t datal, datah;
+	can_pack_claim(&msg, &datal, &datah);
+	// Latest value: a claim still waiting is replaced, so no stale name or node ID goes out
+	if (!can_tx_enqueue_latest(g_claim_id, datal, datah, CAN_MSG_DLC(claim))) {
+		volatile uint32_t debug_can_node_claim_dropped = m.node; // Queue full; the next challenge repeats it
+	}
+#endif
+}
+
+void can_node_tick(uint32_t now_ms)
+{
+#if CONF_CAN_NODE_CLAIM
+	taskENTER_CRITICAL();
+	(void)can_node_claim_tick(&g_claim, now_ms);
+	taskEXIT_CRITICAL();
+#else
+	(void)now_ms;
+#endif
+}
+
+bool can_node_moved(void)
+{
+	if (!g_node_moved) return false;
+	g_node_moved = false;
+	return true;
+}
+
+// Claim from another board (can_rx_task, config/conf_can_commands.h)
+void can_cmd_claim(const can_rx_frame_t *frame)
+{
+#if CONF_CAN_NODE_CLAIM
+	if (frame->len < CAN_MSG_DLC(claim)) return;
+	can_claim_t msg;
+	can_unpack_claim(frame->datal, frame->datah, &msg);
+	can_node_claim_msg_t m;
+	m.node = (uint8_t)msg.node;
+	m.held = (msg.held != 0);
+	m.name = ((uint64_t)msg.name_hi << 32) | msg.name_lo;
+
+	taskENTER_CRITICAL();
+	can_node_claim_action_t action = can_node_claim_on_msg(&g_claim, &m, can_node_now_ms());
+	if (action == CAN_NODE_CLAIM_MOVED) {
+		g_node = g_claim.node; // Queued frames go out under the new ID from here on
+		g_node_moved = true;   // can_rx_task re-arms the mailboxes that hold IDs
+	} else if (action == CAN_NODE_CLAIM_RENAME) {
+		can_node_claim_rename(&g_claim, can_node_claim_name(g_uid, ++g_name_round), can_node_now_ms());
+	}
+	taskEXIT_CRITICAL();
+
+	if (action == CAN_NODE_CLAIM_SEND || action == CAN_NODE_CLAIM_RENAME) can_node_announce();
+#else
+	(void)frame;
+#endif
+}
+
+static bool can_node_in_block(uint32_t id)
+{
+	return id >= CAN_NODE_BLOCK_FIRST && id <= CAN_NODE_BLOCK_LAST;
+}
+
+/* 29-bit: the can_app.h ID in MIDvA, then the extension and node address in
+ * MIDvB (bits 17..8 and 7..0, conf_can_node.h) */
+uint32_t can_node_mid(uint32_t id)
+{
+	uint32_t base = id & 0x7FFu;
+	uint32_t node = can_node_in_block(base) ? g_node : 0;
+#if CONF_CAN_EXTENDED_ID
+	uint32_t ext = (id & CAN_NODE_MSG_MASK) >> CAN_NODE_EXT_SHIFT;
+	return CAN_MID_MIDE | CAN_MID_MIDvA(base) | CAN_MID_MIDvB((ext << 8) | node);
+#else
+	return CAN_MID_MIDvA(base | node);
+#endif
+}
+
+uint32_t can_node_mam(uint32_t id, uint32_t mask)
+{
+#if CONF_CAN_EXTENDED_ID
+	(void)id;
+	// IDE compared too, so standard frames stay out; extension bits as the mask says, node address exact
+	uint32_t ext = (mask & CAN_NODE_MSG_MASK) >> CAN_NODE_EXT_SHIFT;
+	return CAN_MAM_MIDE | CAN_MAM_MIDvA(mask & 0x7FFu) | CAN_MAM_MIDvB((ext << 8) | 0xFFu);
+#else
+	mask &= 0x7FFu;
+	if (can_node_in_block(id)) mask |= CAN_NODE_ID_MASK; // Only this node's frames
+	return CAN_MAM_MIDvA(mask);
+#endif
+}
+
+uint32_t can_node_from_mid(uint32_t mid)
+{
+	uint32_t id = (mid & CAN_MID_MIDvA_Msk) >> CAN_MID_MIDvA_Pos;
+	if (mid & CAN_MID_MIDE) {
+		uint32_t low = (mid & CAN_MID_MIDvB_Msk) >> CAN_MID_MIDvB_Pos;
+		if ((low & 0xFFu) != (can_node_in_block(id) ? g_node : 0)) {
+			return mid & (CAN_MID_MIDvA_Msk | CAN_MID_MIDvB_Msk); // Another board's, full 29-bit ID
+		}
+		return CAN_NODE_EXT_ID(id, low >> 8);
+	}
+	if (!can_node_in_block(id)) return id;
+	if ((id & CAN_NODE_ID_MASK) != g_node) return id; // Another board's
+	return id & ~CAN_NODE_ID_MASK;
+}
+
+void can_node_get_status(can_node_status_t *status)
+{
+	taskENTER_CRITICAL();
+	status->name = g_claim.name;
+	status->node = g_node;
+	status->held = CONF_CAN_NODE_CLAIM ? g_claim.held : true;
+	status->defends = g_claim.defends;
+	status->moves = g_claim.moves;
+	taskEXIT_CRITICAL();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "can_node_claim.h"
+#include "conf_can_node.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Node ID of this board and the identifier format on the bus (see
+ * config/conf_can_node.h). Tables and handlers keep using the node 0 IDs of
+ * can_app.h; mailbox code turns them into CAN_MID/CAN_MAM values with the
+ * node ID and IDE bit in place, and received CAN_MID values back, so nothing
+ * else sees bus IDs. A frame for another node keeps its bus ID (11-bit), or
+ * its full 29-bit ID, which no table entry matches.
+ *
+ * With 29-bit IDs a message ID also carries a 10-bit extension above the
+ * can_app.h ID, CAN_NODE_EXT_ID(id, ext), sent in the bits 11-bit IDs lack.
+ * Extension 0 is the can_app.h ID itself, so tables stay 11-bit; the
+ * extended IDs go through can_tx, the RX filters and can_rx hooks.
+ */
+
+#define CAN_NODE_BLOCK_FIRST   0x100u // First ID that carries the node ID
+#define CAN_NODE_BLOCK_LAST    0x2FFu // Last ID that carries the node ID
+
+#if CONF_CAN_LEGACY_IDS
+#define CAN_NODE_ID_MASK       0x000u // Earlier single-board IDs: no node ID bits
+#else
+#define CAN_NODE_ID_MASK       0x00Fu // 11-bit IDs: bits that hold the node ID
+#endif
+
+#define CAN_NODE_EXT_SHIFT     11u
+#define CAN_NODE_EXT_ID(id, ext) ((uint32_t)(id) | ((uint32_t)(ext) << CAN_NODE_EXT_SHIFT)) // Extension 0..1023, 29-bit IDs only
+#define CAN_NODE_BUS_ORDER(id) ((((id) & 0x7FFu) << 10) | ((id) >> CAN_NODE_EXT_SHIFT)) // Arbitration order of message IDs
+
+#if CONF_CAN_EXTENDED_ID
+#define CAN_NODE_MSG_MASK      0x1FFFFFu // Message ID bits: extension and can_app.h ID
+#else
+#define CAN_NODE_MSG_MASK      0x7FFu
+#endif
+
+#if CONF_CAN_LEGACY_IDS
+#define CAN_NODE_COUNT         1u
+#elif CONF_CAN_EXTENDED_ID
+#define CAN_NODE_COUNT         256u // Node address byte
+#else
+#define CAN_NODE_COUNT         16u  // CAN_NODE_ID_MASK
+#endif
+
+typedef struct {
+	uint64_t name;    // 48-bit name from the chip unique ID
+	uint32_t node;    // Node ID in use
+	bool held;        // Claim unchallenged for CAN_NODE_CLAIM_MS
+	uint32_t defends; // Claims answered to keep the node ID
+	uint32_t moves;   // Node ID changes after a lost claim
+} can_node_status_t;
+
+uint32_t can_node_init(void); // Pick the node ID from the unique ID, before any mailbox is configured; returns it
+void can_node_announce(void); // Queue our claim frame (after can_tx_init())
+void can_node_tick(uint32_t now_ms); // Age the claim; call from a task at least once a second
+bool can_node_moved(void); // True once after a lost claim changed the node ID: reconfigure the mailboxes, then announce
+uint32_t can_node_mid(uint32_t id); // CAN_MID value (ID, extension, IDE bit) to send a node 0 message ID as this node
+uint32_t can_node_mam(uint32_t id, uint32_t mask); // CAN_MAM value for a filter on node 0 message IDs (mask up to CAN_NODE_MSG_MASK), matching this node only
+uint32_t can_node_from_mid(uint32_t mid); // Node 0 message ID of a received CAN_MID value, if it is this node's or shared
+void can_node_get_status(can_node_status_t *status); // Snapshot of the claim
+
+#ifdef __cplusplus
+}
+#endif
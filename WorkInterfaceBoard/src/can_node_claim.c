@@ -0,0 +1,102 @@
+#include "can_node_claim.h"
+
+#define CAN_NODE_FNV_OFFSET    0xCBF29CE484222325ull
+#define CAN_NODE_FNV_PRIME     0x00000100000001B3ull
+
+uint64_t can_node_claim_name(const uint32_t uid[4], uint32_t round)
+{
+	// FNV-1a over the round and the 16 bytes, folded to 48 bits so every byte reaches the name
+	uint64_t h = CAN_NODE_FNV_OFFSET;
+	for (uint32_t i = 0; i < 4u; i++) {
+		h ^= (round >> (i * 8u)) & 0xFFu;
+		h *= CAN_NODE_FNV_PRIME;
+	}
+	for (uint32_t i = 0; i < 16u; i++) {
+		h ^= (uid[i / 4u] >> ((i % 4u) * 8u)) & 0xFFu;
+		h *= CAN_NODE_FNV_PRIME;
+	}
+	return (h ^ (h >> 48)) & CAN_NODE_NAME_MASK;
+}
+
+static bool can_node_claim_used(const can_node_claim_t *c, uint32_t node)
+{
+	return (c->used[node / 32u] >> (node % 32u)) & 1u;
+}
+
+static void can_node_claim_mark(can_node_claim_t *c, uint32_t node)
+{
+	c->used[node / 32u] |= 1u << (node % 32u);
+}
+
+uint8_t can_node_claim_start(can_node_claim_t *c, uint64_t name, uint32_t count, uint32_t first, uint32_t now_ms)
+{
+	if (count == 0 || count > CAN_NODE_CLAIM_MAX) count = CAN_NODE_CLAIM_MAX;
+	c->name = name & CAN_NODE_NAME_MASK;
+	c->count = count;
+	c->node = (uint8_t)(first % count);
+	c->held = false;
+	c->since_ms = now_ms;
+	for (uint32_t i = 0; i < CAN_NODE_CLAIM_MAX / 32u; i++) {
+		c->used[i] = 0;
+	}
+	c->defends = 0;
+	c->moves = 0;
+	c->renames = 0;
+	return c->node;
+}
+
+can_node_claim_action_t can_node_claim_on_msg(can_node_claim_t *c, const can_node_claim_msg_t *m, uint32_t now_ms)
+{
+	if (m->node >= c->count) return CAN_NODE_CLAIM_NONE; // Not a valid claim
+	if (m->name == c->name) return CAN_NODE_CLAIM_RENAME; // Names must differ for the rule below to decide
+	if (m->node != c->node) {
+		can_node_claim_mark(c, m->node);
+		return CAN_NODE_CLAIM_NONE;
+	}
+
+	bool we_win = (c->held != m->held) ? c->held : (c->name < m->name);
+	if (we_win) {
+		c->defends++; // The other board moves when it sees this
+		return CAN_NODE_CLAIM_SEND;
+	}
+
+	// Lost: next node ID nobody was seen claiming, or just the next one when all were
+	can_node_claim_mark(c, m->node);
+	uint8_t next = (uint8_t)((c->node + 1u) % c->count);
+	for (uint32_t i = 1; i < c->count; i++) {
+		uint8_t n = (uint8_t)((c->node + i) % c->count);
+		if (!can_node_claim_used(c, n)) {
+			next = n;
+			break;
+		}
+	}
+	c->node = next;
+	c->held = false;
+	c->since_ms = now_ms;
+	c->moves++;
+	return CAN_NODE_CLAIM_MOVED;
+}
+
+// The other board renames too and both claim again; the node ID held so far
+// is given up, so between the two the new names decide
+void can_node_claim_rename(can_node_claim_t *c, uint64_t name, uint32_t now_ms)
+{
+	c->name = name & CAN_NODE_NAME_MASK;
+	c->held = false;
+	c->since_ms = now_ms;
+	c->renames++;
+}
+
+bool can_node_claim_tick(can_node_claim_t *c, uint32_t now_ms)
+{
+	if (c->held || (now_ms - c->since_ms) < CAN_NODE_CLAIM_MS) return false; // Differences survive the wrap
+	c->held = true;
+	return true;
+}
+
+void can_node_claim_msg(const can_node_claim_t *c, can_node_claim_msg_t *m)
+{
+	m->name = c->name;
+	m->node = c->node;
+	m->held = c->held;
+}
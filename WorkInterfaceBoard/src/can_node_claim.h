@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Node ID address claim. Every board announces the node ID it wants together
+ * with a name derived from its chip unique ID, starting from the same first
+ * node ID. When two boards want the same node ID, one that already holds it
+ * beats one still claiming, and between equals the lower name wins. The loser
+ * moves to the next node ID it has not seen claimed. Two different unique IDs
+ * can fold to the same name: a claim carrying our own name (the controller
+ * never receives its own frames) makes the board take the next name round of
+ * its unique ID and claim again, so the names differ and every contest has
+ * one winner. Pure
+ * state machine on a millisecond clock, no hardware or RTOS access, so it
+ * runs on a host.
+ */
+
+#define CAN_NODE_CLAIM_MAX     256u // Node IDs fit in a byte of the claim frame
+#define CAN_NODE_CLAIM_MS      250u // Unchallenged this long, a claim is held
+#define CAN_NODE_NAME_MASK     0xFFFFFFFFFFFFull // Names are 48 bits, sent in the claim frame
+
+typedef enum {
+	CAN_NODE_CLAIM_NONE = 0, // Nothing to do
+	CAN_NODE_CLAIM_SEND,     // Send our claim (defend, or announce after a move)
+	CAN_NODE_CLAIM_MOVED,    // Lost the node ID: reconfigure, then send our claim
+	CAN_NODE_CLAIM_RENAME,   // Another board has our name: can_node_claim_rename() with the next round, then send our claim
+} can_node_claim_action_t;
+
+typedef struct {
+	uint64_t name; // 48-bit name of the sender
+	uint8_t node;  // Node ID claimed
+	bool held;     // Sender already holds it (defending)
+} can_node_claim_msg_t;
+
+typedef struct {
+	uint64_t name;     // Our name, lower wins
+	uint8_t node;      // Node ID claimed or held
+	bool held;         // Unchallenged for CAN_NODE_CLAIM_MS
+	uint32_t count;    // Node IDs 0..count-1 are available
+	uint32_t since_ms; // When the current claim started
+	uint32_t used[CAN_NODE_CLAIM_MAX / 32u]; // Node IDs seen claimed by other boards (bit per node)
+	uint32_t defends;  // Claims we answered to keep our node ID
+	uint32_t moves;    // Node ID changes after losing a claim
+	uint32_t renames;  // Name rounds taken after a name clash
+} can_node_claim_t;
+
+uint64_t can_node_claim_name(const uint32_t uid[4], uint32_t round); // 48-bit name of a 128-bit unique ID, round 0 first
+uint8_t can_node_claim_start(can_node_claim_t *c, uint64_t name, uint32_t count, uint32_t first, uint32_t now_ms); // Start claiming node ID first out of count (up to CAN_NODE_CLAIM_MAX), returns it
+can_node_claim_action_t can_node_claim_on_msg(can_node_claim_t *c, const can_node_claim_msg_t *m, uint32_t now_ms); // Claim frame from another board
+void can_node_claim_rename(can_node_claim_t *c, uint64_t name, uint32_t now_ms); // Claim our node ID again under a new name
+bool can_node_claim_tick(can_node_claim_t *c, uint32_t now_ms); // True when the claim has just become held
+void can_node_claim_msg(const can_node_claim_t *c, can_node_claim_msg_t *m); // Our claim, to send
+
+#ifdef __cplusplus
+}
+#endif
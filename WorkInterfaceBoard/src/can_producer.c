@@ -0,0 +1,159 @@
+#include "can_producer.h"
+#include "can_signals.h"
+#include "can_rx.h"
+#include "can_node.h"
+#include "asf.h"
+#include "can.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct {
+	uint32_t id;
+	uint8_t dlc;
+	uint32_t datal;  // Latest value, kept across can_producer_init()
+	uint32_t datah;
+	uint32_t armed_datal; // Value in the mailbox
+	uint32_t armed_datah;
+	uint32_t armed_ms;    // When it was loaded
+	bool valid;      // A value has been supplied
+	bool bound;      // Owns a mailbox
+	bool aborting;   // MACR issued to swap in a new value
+} can_producer_entry_t;
+
+#define CAN_PRODUCER_GEN_ENTRY(msg) { .id = CAN_MSG_ID(msg), .dlc = CAN_MSG_DLC(msg) },
+static can_producer_entry_t g_prod[CAN_PRODUCER_COUNT] = {
+	CAN_PRODUCER_TABLE(CAN_PRODUCER_GEN_ENTRY)
+};
+
+static Can *g_prod_can = NULL;
+static uint32_t g_prod_armed = 0; // CAN_SR-style mask of mailboxes waiting for a remote frame
+static can_producer_stats_t g_prod_stats = {0};
+
+// Load the latest value and wait for a remote frame (CAN interrupt masked or in CAN0_Handler)
+static void can_producer_arm(uint32_t n, uint32_t now_ms)
+{
+	can_producer_entry_t *e = &g_prod[n];
+	uint32_t mb = CAN_PRODUCER_MB_FIRST + n;
+	CanMb *p_mb = &g_prod_can->CAN_MB[mb];
+	p_mb->CAN_MDL = e->datal;
+	p_mb->CAN_MDH = e->datah;
+	p_mb->CAN_MCR = CAN_MCR_MDLC(e->dlc) | CAN_MCR_MTCR;
+	if (e->datal != e->armed_datal || e->datah != e->armed_datah) g_prod_stats.updates++;
+	e->armed_datal = e->datal;
+	e->armed_datah = e->datah;
+	e->armed_ms = now_ms;
+	e->aborting = false;
+	g_prod_armed |= (1u << mb);
+	g_prod_can->CAN_IER = (1u << mb);
+}
+
+uint32_t can_producer_init(Can *p_can)
+{
+	uint32_t bound = 0;
+	uint32_t now_ms = (uint32_t)xTaskGetTickCount() * portTICK_RATE_MS;
+	taskENTER_CRITICAL();
+	g_prod_can = p_can;
+	g_prod_armed = 0;
+	g_prod_stats = (can_producer_stats_t){0};
+	p_can->CAN_IDR = CAN_PRODUCER_MB_MASK;
+
+#if !CONF_CAN_TIME_TRIGGERED
+	for (uint32_t n = 0; n < CAN_PRODUCER_COUNT; n++) {
+		can_producer_entry_t *e = &g_prod[n];
+		e->aborting = false;
+
+		can_mb_conf_t mbc;
+		mbc.ul_mb_idx = CAN_PRODUCER_MB_FIRST + n;
+		mbc.uc_obj_type = CAN_MB_DISABLE_MODE;
+		can_mailbox_init(p_can, &mbc);
+
+		// The RX FIFO sits in lower mailboxes and would take the remote frame
+		e->bound = !can_rx_accepts(e->id);
+		if (!e->bound) {
+			g_prod_stats.unbound++;
+			continue;
+		}
+
+		mbc.uc_obj_type = CAN_MB_PRODUCER_MODE;
+		mbc.uc_tx_prio = 0; // Replies go ahead of queued frames
+		mbc.uc_id_ver = 0; // IDE bit comes with the MAM/MID values (can_node.h)
+		mbc.ul_id_msk = can_node_mam(e->id, CAN_NODE_MSG_MASK); // Answer this ID only
+		mbc.ul_id = can_node_mid(e->id);
+		can_mailbox_init(p_can, &mbc);
+		if (e->valid) can_producer_arm(n, now_ms); // Value from before a controller reset
+		bound++;
+	}
+#endif
+	taskEXIT_CRITICAL();
+	return bound;
+}
+
+void can_producer_set_node(void)
+{
+	uint32_t now_ms = (uint32_t)xTaskGetTickCount() * portTICK_RATE_MS;
+	for (uint32_t n = 0; n < CAN_PRODUCER_COUNT; n++) {
+		can_producer_entry_t *e = &g_prod[n];
+		if (!e->bound) continue;
+
+		uint32_t mb = CAN_PRODUCER_MB_FIRST + n;
+		CanMb *p_mb = &g_prod_can->CAN_MB[mb];
+		uint32_t mmr = p_mb->CAN_MMR;
+		p_mb->CAN_MMR = mmr & ~CAN_MMR_MOT_Msk; // MAM/MID are written with the mailbox disabled
+		p_mb->CAN_MAM = can_node_mam(e->id, CAN_NODE_MSG_MASK);
+		p_mb->CAN_MID = can_node_mid(e->id);
+		p_mb->CAN_MMR = mmr;
+		g_prod_armed &= ~(1u << mb);
+		if (e->valid) can_producer_arm(n, now_ms); // Also ends a pending abort, the latest value goes in
+	}
+}
+
+bool can_producer_update(uint32_t id, uint32_t datal, uint32_t datah)
+{
+	for (uint32_t n = 0; n < CAN_PRODUCER_COUNT; n++) {
+		can_producer_entry_t *e = &g_prod[n];
+		if (e->id != id) continue;
+		if (!e->bound) return false;
+
+		uint32_t now_ms = (uint32_t)xTaskGetTickCount() * portTICK_RATE_MS;
+		taskENTER_CRITICAL();
+		e->datal = datal;
+		e->datah = datah;
+		e->valid = true;
+		uint32_t mb = CAN_PRODUCER_MB_FIRST + n;
+		if (!(g_prod_armed & (1u << mb))) {
+			can_producer_arm(n, now_ms); // Idle: nothing to abort
+		} else if (!e->aborting && (datal != e->armed_datal || datah != e->armed_datah) &&
+		           now_ms - e->armed_ms >= CONF_CAN_PRODUCER_REFRESH_MS) {
+			/* The armed data cannot be swapped safely; CAN0_Handler reloads the
+			 * latest on MRDY. Values until then only update e->datal/datah. */
+			g_prod_can->CAN_MB[mb].CAN_MCR = CAN_MCR_MACR;
+			e->aborting = true;
+			g_prod_stats.aborts++;
+		}
+		taskEXIT_CRITICAL();
+		return true;
+	}
+	return false;
+}
+
+void can_producer_isr(uint32_t can_sr)
+{
+	uint32_t done = can_sr & g_prod_armed;
+	if (done == 0) return;
+	uint32_t now_ms = (uint32_t)xTaskGetTickCountFromISR() * portTICK_RATE_MS;
+	for (uint32_t pending = done; pending != 0; pending &= pending - 1u) {
+		uint32_t mb = (uint32_t)__builtin_ctz(pending);
+		if (!(g_prod_can->CAN_MB[mb].CAN_MSR & CAN_MSR_MABT)) {
+			g_prod_stats.answered++; // Also when an abort came too late to stop the reply
+		}
+		can_producer_arm(mb - CAN_PRODUCER_MB_FIRST, now_ms); // Latest value, ready for the next poll
+	}
+}
+
+void can_producer_get_stats(can_producer_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = g_prod_stats;
+	taskEXIT_CRITICAL();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "sam4e.h"
+#include "conf_can_producer.h"
+#include "can_sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* On-demand values answered by the controller (see config/conf_can_producer.h).
+ * Producers keep a mailbox loaded with can_producer_update(); a master polls
+ * with a remote frame and the reply leaves without CPU involvement. A changed
+ * value goes into an idle mailbox at once; an armed one is aborted for it at
+ * most once per CONF_CAN_PRODUCER_REFRESH_MS and CAN0_Handler reloads it.
+ */
+
+#define CAN_PRODUCER_GEN_SLOT(msg) can_producer_slot_##msg,
+enum {
+	CAN_PRODUCER_TABLE(CAN_PRODUCER_GEN_SLOT)
+	CAN_PRODUCER_COUNT
+};
+
+#if CONF_CAN_TIME_TRIGGERED
+#define CAN_PRODUCER_MB_COUNT  0u // Replies would wait for the timemark
+#else
+#define CAN_PRODUCER_MB_COUNT  ((uint32_t)CAN_PRODUCER_COUNT) // One mailbox per producer
+#endif
+#define CAN_PRODUCER_MB_FIRST  (CAN_SCHED_MB_FIRST - CAN_PRODUCER_MB_COUNT) // Just below the schedule
+#define CAN_PRODUCER_MB_MASK   (((1u << CAN_PRODUCER_MB_COUNT) - 1u) << CAN_PRODUCER_MB_FIRST)
+
+typedef struct {
+	uint32_t updates;  // Value changes loaded into a mailbox
+	uint32_t aborts;   // Armed mailboxes aborted to load a newer value
+	uint32_t answered; // Remote frames answered
+	uint32_t unbound;  // Table entries left out because an RX filter accepts their ID
+} can_producer_stats_t;
+
+uint32_t can_producer_init(Can *p_can); // Configure the producer mailboxes (after can_rx_init), returns the number bound
+void can_producer_set_node(void); // Re-program the bound mailboxes for a new node ID and re-arm them (CAN interrupt masked)
+bool can_producer_update(uint32_t id, uint32_t datal, uint32_t datah); // Latest value for a bound message, false if it has no producer mailbox
+void can_producer_isr(uint32_t can_sr); // Reload and re-arm answered or aborted mailboxes, called from CAN0_Handler with a CAN_SR snapshot
+void can_producer_get_stats(can_producer_stats_t *stats); // Snapshot of the counters
+
+#ifdef __cplusplus
+}
+#endif
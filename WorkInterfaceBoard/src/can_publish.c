@@ -0,0 +1,88 @@
+#include "can_publish.h"
+#include "can_signals.h"
+#include "can_sched.h"
+#include "can_producer.h"
+#include "can_tx.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define CAN_PUBLISH_DLC_MASK(dlc) (((dlc) >= 8u) ? ~0ull : ((1ull << ((dlc) * 8u)) - 1u)) // Payload bits of a DLC
+
+/* Per-message deadband lists, and from them the bits compared exactly:
+ * the payload minus the deadbanded signals */
+#define CAN_PUBLISH_GEN_DB(msg, sig, db) \
+	{ .start = CAN_SIG_START(msg, sig), .length = CAN_SIG_LEN(msg, sig), \
+	  .is_signed = CAN_SIG_SIGNED(msg, sig), .deadband = (db) },
+#define CAN_PUBLISH_GEN_DB_COUNT(msg, sig, db) + 1u
+#define CAN_PUBLISH_GEN_DB_BITS(msg, sig, db) | (CAN_SIG_MASK(CAN_SIG_LEN(msg, sig)) << CAN_SIG_START(msg, sig))
+
+#define CAN_PUBLISH_GEN_DB_TABLE(msg, inhibit_ms, heartbeat_ms, mode, DEADBANDS) \
+	static const can_publish_deadband_t g_pub_db_##msg[] = { DEADBANDS(CAN_PUBLISH_GEN_DB, msg) { 0 } };
+CAN_PUBLISH_TABLE(CAN_PUBLISH_GEN_DB_TABLE)
+
+#define CAN_PUBLISH_MODE_FIFO   false
+#define CAN_PUBLISH_MODE_LATEST true
+
+typedef struct {
+	uint32_t id;
+	uint8_t dlc;
+	bool latest; // Unsent frames are overwritten by newer ones
+	can_publish_cfg_t cfg;
+} can_publish_entry_t;
+
+#define CAN_PUBLISH_GEN_ENTRY(msg, inhibit, heartbeat, mode, DEADBANDS) \
+	{ .id = CAN_MSG_ID(msg), .dlc = CAN_MSG_DLC(msg), .latest = CAN_PUBLISH_MODE_##mode, \
+	  .cfg = { .inhibit_ms = (inhibit), .heartbeat_ms = (heartbeat), \
+	           .exact_mask = CAN_PUBLISH_DLC_MASK(CAN_MSG_DLC(msg)) & ~(0ull DEADBANDS(CAN_PUBLISH_GEN_DB_BITS, msg)), \
+	           .deadbands = g_pub_db_##msg, \
+	           .deadband_count = (uint8_t)(0u DEADBANDS(CAN_PUBLISH_GEN_DB_COUNT, msg)) } },
+static can_publish_entry_t g_pub[CAN_PUBLISH_COUNT] = { // inhibit_ms is retuned by can_rate.c
+	CAN_PUBLISH_TABLE(CAN_PUBLISH_GEN_ENTRY)
+};
+
+static can_publish_state_t g_pub_state[CAN_PUBLISH_COUNT];
+
+bool can_publish(uint32_t slot, uint32_t datal, uint32_t datah)
+{
+	if (slot >= CAN_PUBLISH_COUNT) return false;
+	const can_publish_entry_t *e = &g_pub[slot];
+	uint32_t now_ms = (uint32_t)xTaskGetTickCount() * portTICK_RATE_MS;
+	uint64_t payload = ((uint64_t)datah << 32) | datal;
+	can_producer_update(e->id, datal, datah); // Remote frames get every sample, not just the published ones
+
+	taskENTER_CRITICAL(); // Stats are read from other tasks
+	can_publish_state_t before = g_pub_state[slot];
+	can_publish_reason_t reason = can_publish_decide(&e->cfg, &g_pub_state[slot], payload, now_ms);
+	taskEXIT_CRITICAL();
+	if (reason == CAN_PUBLISH_HOLD) return false;
+
+	// Scheduled messages go out at their next timemark, the rest as soon as the queue allows
+	if (can_sched_post(e->id, datal, datah)) return true;
+	bool queued = e->latest ? can_tx_enqueue_latest(e->id, datal, datah, e->dlc)
+	                        : can_tx_enqueue_words(e->id, datal, datah, e->dlc);
+	if (queued) return true;
+
+	// Queue full: forget the send so the next sample tries again
+	taskENTER_CRITICAL();
+	before.stats.offered = g_pub_state[slot].stats.offered;
+	g_pub_state[slot] = before;
+	taskEXIT_CRITICAL();
+	return false;
+}
+
+void can_publish_set_inhibit(uint32_t slot, uint32_t inhibit_ms)
+{
+	if (slot >= CAN_PUBLISH_COUNT) return;
+	taskENTER_CRITICAL();
+	g_pub[slot].cfg.inhibit_ms = inhibit_ms;
+	taskEXIT_CRITICAL();
+}
+
+void can_publish_get_stats(uint32_t slot, can_publish_stats_t *stats)
+{
+	if (slot >= CAN_PUBLISH_COUNT) return;
+	taskENTER_CRITICAL();
+	*stats = g_pub_state[slot].stats;
+	taskEXIT_CRITICAL();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "can_publish_policy.h"
+#include "conf_can_publish.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-message publishing policy (see config/conf_can_publish.h).
+ * Producers offer every sample; only changes beyond the deadband, spaced by
+ * the inhibit time, and heartbeats reach the bus. A stationary encoder costs
+ * one frame per heartbeat instead of one per period.
+ */
+
+#define CAN_PUBLISH_SLOT(msg)  can_publish_slot_##msg // Policy index of a message
+
+#define CAN_PUBLISH_GEN_SLOT(msg, inhibit_ms, heartbeat_ms, mode, DEADBANDS) CAN_PUBLISH_SLOT(msg),
+enum {
+	CAN_PUBLISH_TABLE(CAN_PUBLISH_GEN_SLOT)
+	CAN_PUBLISH_COUNT
+};
+
+bool can_publish(uint32_t slot, uint32_t datal, uint32_t datah); // Offer a packed sample, true if it was handed to the schedule or the TX queue
+void can_publish_set_inhibit(uint32_t slot, uint32_t inhibit_ms); // Change the minimum spacing of a message's frames
+void can_publish_get_stats(uint32_t slot, can_publish_stats_t *stats); // Snapshot of a message's counters
+
+#ifdef __cplusplus
+}
+#endif
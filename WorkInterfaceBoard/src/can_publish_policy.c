@@ -0,0 +1,51 @@
+#include "can_publish_policy.h"
+
+static int64_t can_publish_raw(const can_publish_deadband_t *db, uint64_t payload)
+{
+	uint64_t mask = (1ull << db->length) - 1u;
+	uint64_t raw = (payload >> db->start) & mask;
+	if (db->is_signed && ((raw >> (db->length - 1u)) & 1u)) raw |= ~mask;
+	return (int64_t)raw;
+}
+
+bool can_publish_changed(const can_publish_cfg_t *cfg, uint64_t from, uint64_t to)
+{
+	if ((from ^ to) & cfg->exact_mask) return true;
+	for (uint8_t i = 0; i < cfg->deadband_count; i++) {
+		const can_publish_deadband_t *db = &cfg->deadbands[i];
+		int64_t d = can_publish_raw(db, to) - can_publish_raw(db, from); // 32-bit fields, no overflow
+		if (d < 0) d = -d;
+		if ((uint64_t)d > db->deadband) return true;
+	}
+	return false;
+}
+
+can_publish_reason_t can_publish_decide(const can_publish_cfg_t *cfg, can_publish_state_t *state, uint64_t payload, uint32_t now_ms)
+{
+	state->stats.offered++;
+	can_publish_reason_t reason = CAN_PUBLISH_HOLD;
+	uint32_t elapsed = now_ms - state->last_ms; // Wraps after 49 days, differences stay right
+
+	if (!state->sent) {
+		reason = CAN_PUBLISH_CHANGE; // Nothing on the bus yet
+	} else if (can_publish_changed(cfg, state->last, payload)) {
+		if (elapsed < cfg->inhibit_ms) {
+			state->stats.inhibited++; // Compared again on the next sample, still against the last frame sent
+			return CAN_PUBLISH_HOLD;
+		}
+		reason = CAN_PUBLISH_CHANGE;
+	} else if (cfg->heartbeat_ms != 0 && elapsed >= cfg->heartbeat_ms) {
+		reason = CAN_PUBLISH_HEARTBEAT;
+	}
+	if (reason == CAN_PUBLISH_HOLD) return reason;
+
+	if (reason == CAN_PUBLISH_CHANGE) {
+		state->stats.changes++;
+	} else {
+		state->stats.heartbeats++;
+	}
+	state->last = payload;
+	state->last_ms = now_ms;
+	state->sent = true;
+	return reason;
+}
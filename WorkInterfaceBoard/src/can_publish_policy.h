@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Publish decision for one message: deadband, inhibit time and heartbeat.
+ * Works on the packed 64-bit payload (CAN_MDH:CAN_MDL) and a millisecond
+ * clock, no hardware or RTOS access, so it runs on a host.
+ */
+
+typedef struct {
+	uint8_t start;     // First bit, little-endian numbering as in conf_can_signals.h
+	uint8_t length;    // Width in bits, up to 32
+	bool is_signed;
+	uint32_t deadband; // Raw units; a change by more than this counts
+} can_publish_deadband_t;
+
+typedef struct {
+	uint32_t inhibit_ms;   // Minimum spacing of frames
+	uint32_t heartbeat_ms; // Maximum spacing of frames, 0 = no heartbeat
+	uint64_t exact_mask;   // Payload bits where any difference counts
+	const can_publish_deadband_t *deadbands;
+	uint8_t deadband_count;
+} can_publish_cfg_t;
+
+typedef struct {
+	uint32_t offered;    // Samples given to can_publish_decide()
+	uint32_t changes;    // Sent because the value moved
+	uint32_t heartbeats; // Sent because nothing was sent for heartbeat_ms
+	uint32_t inhibited;  // Changes held back by the inhibit time
+} can_publish_stats_t;
+
+typedef struct {
+	uint64_t last;    // Payload of the last frame sent
+	uint32_t last_ms; // When it was sent
+	bool sent;        // Anything sent yet
+	can_publish_stats_t stats;
+} can_publish_state_t;
+
+typedef enum {
+	CAN_PUBLISH_HOLD = 0,   // Nothing to send
+	CAN_PUBLISH_CHANGE,     // Value moved beyond its deadband (or first sample)
+	CAN_PUBLISH_HEARTBEAT,  // Unchanged, repeated for the heartbeat
+} can_publish_reason_t;
+
+bool can_publish_changed(const can_publish_cfg_t *cfg, uint64_t from, uint64_t to); // Any exact bit or deadband exceeded
+can_publish_reason_t can_publish_decide(const can_publish_cfg_t *cfg, can_publish_state_t *state, uint64_t payload, uint32_t now_ms); // Decide for a sample; a send is recorded in state
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,87 @@
+#include "can_rate.h"
+#include "can_publish.h"
+#include "can_signals.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define CAN_RATE_GEN_SIGNAL(msg, min, max, prio) { .min_ms = (min), .max_ms = (max), .priority = (prio) },
+static can_rate_signal_t g_rate_sig[CAN_RATE_COUNT] = { // frame_bits filled in by can_rate_init()
+	CAN_RATE_TABLE(CAN_RATE_GEN_SIGNAL)
+};
+
+#define CAN_RATE_GEN_PUB(msg, min_ms, max_ms, priority) CAN_PUBLISH_SLOT(msg),
+static const uint32_t g_rate_pub[CAN_RATE_COUNT] = {
+	CAN_RATE_TABLE(CAN_RATE_GEN_PUB)
+};
+
+#define CAN_RATE_GEN_DLC(msg, min_ms, max_ms, priority) CAN_MSG_DLC(msg),
+static const uint8_t g_rate_dlc[CAN_RATE_COUNT] = {
+	CAN_RATE_TABLE(CAN_RATE_GEN_DLC)
+};
+
+typedef char can_rate_table_fits[(CAN_RATE_COUNT <= CAN_RATE_PLAN_MAX) ? 1 : -1]; // Compile-time limit check
+
+static uint32_t g_rate_bitrate_bps = 500000u;
+static can_rate_state_t g_rate_state;
+static can_rate_status_t g_rate_status;
+
+void can_rate_init(uint32_t bitrate_bps)
+{
+	if (bitrate_bps != 0) g_rate_bitrate_bps = bitrate_bps;
+	taskENTER_CRITICAL();
+	g_rate_state = (can_rate_state_t){0};
+	g_rate_status = (can_rate_status_t){0};
+	for (uint32_t i = 0; i < CAN_RATE_COUNT; i++) {
+		g_rate_sig[i].frame_bits = can_stats_frame_bits(g_rate_dlc[i]);
+		g_rate_status.period_ms[i] = g_rate_sig[i].min_ms;
+	}
+	uint32_t period_ms[CAN_RATE_COUNT];
+	g_rate_status.plan_permille = can_rate_plan(g_rate_sig, CAN_RATE_COUNT, 1000u, g_rate_bitrate_bps, period_ms); // All at min_ms
+	taskEXIT_CRITICAL();
+#if CONF_CAN_RATE_ADAPTIVE
+	for (uint32_t i = 0; i < CAN_RATE_COUNT; i++) {
+		can_publish_set_inhibit(g_rate_pub[i], g_rate_sig[i].min_ms);
+	}
+#endif
+}
+
+void can_rate_update(const can_stats_t *stats)
+{
+#if CONF_CAN_RATE_ADAPTIVE
+	if (stats->window_ms == 0) return;
+
+	can_rate_window_t w;
+	w.seen_permille = stats->seen_load_permille;
+	w.own_permille = stats->tx_load_permille;
+	w.tx_frames = stats->window_tx_frames;
+	w.tx_waited = stats->window_tx_waited;
+
+	uint32_t other = can_rate_other_load(&g_rate_state, &w);
+	uint32_t budget = can_rate_budget(CONF_CAN_RATE_TARGET_PERMILLE, other, g_rate_status.plan_permille);
+	uint32_t period_ms[CAN_RATE_COUNT];
+	uint32_t plan = can_rate_plan(g_rate_sig, CAN_RATE_COUNT, budget, g_rate_bitrate_bps, period_ms);
+
+	for (uint32_t i = 0; i < CAN_RATE_COUNT; i++) {
+		can_publish_set_inhibit(g_rate_pub[i], period_ms[i]);
+	}
+
+	taskENTER_CRITICAL();
+	g_rate_status.other_permille = other;
+	g_rate_status.plan_permille = plan;
+	for (uint32_t i = 0; i < CAN_RATE_COUNT; i++) {
+		g_rate_status.period_ms[i] = period_ms[i];
+	}
+	g_rate_status.updates++;
+	taskEXIT_CRITICAL();
+#else
+	(void)stats;
+#endif
+}
+
+void can_rate_get_status(can_rate_status_t *status)
+{
+	taskENTER_CRITICAL();
+	*status = g_rate_status;
+	taskEXIT_CRITICAL();
+}
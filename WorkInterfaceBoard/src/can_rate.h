@@ -0,0 +1,35 @@
+#pragma once
+#include "can_rate_plan.h"
+#include "can_stats.h"
+#include "conf_can_rate.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Adaptive publishing periods (see config/conf_can_rate.h), driven by the
+ * per-window figures of can_stats.h and applied with can_publish_set_inhibit().
+ */
+
+#define CAN_RATE_GEN_SLOT(msg, min_ms, max_ms, priority) can_rate_slot_##msg,
+enum {
+	CAN_RATE_TABLE(CAN_RATE_GEN_SLOT)
+	CAN_RATE_COUNT
+};
+
+typedef struct {
+	uint32_t other_permille; // Filtered load of other nodes
+	uint32_t plan_permille;  // Worst-case load of the current plan
+	uint32_t period_ms[CAN_RATE_COUNT]; // Current inhibit time per table entry
+	uint32_t updates;        // Windows planned
+} can_rate_status_t;
+
+void can_rate_init(uint32_t bitrate_bps); // Start from the fastest periods (can_stats_init() time)
+void can_rate_update(const can_stats_t *stats); // Re-plan from a closed load window (task, after can_stats_tick())
+void can_rate_get_status(can_rate_status_t *status); // Snapshot of the estimate and the periods in use
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,84 @@
+#include "can_rate_plan.h"
+
+uint32_t can_rate_other_load(can_rate_state_t *state, const can_rate_window_t *w)
+{
+	uint32_t seen = (w->seen_permille > w->own_permille) ? w->seen_permille - w->own_permille : 0;
+
+	/* Own frames queued behind each other also count as waited, which only
+	 * errs on the slow side. */
+	if (w->tx_frames != 0) {
+		uint32_t busy = (uint32_t)(((uint64_t)w->tx_waited * 1000u) / w->tx_frames);
+		if (busy > 1000u) busy = 1000u;
+		if (!state->primed) {
+			state->busy_permille = busy;
+			state->primed = true;
+		} else {
+			uint32_t n = w->tx_frames;
+			if (busy > state->busy_permille) {
+				n *= 2u; // Back off faster than speeding up
+				state->busy_permille += (uint32_t)(((uint64_t)(busy - state->busy_permille) * n) / (n + CAN_RATE_WAIT_WEIGHT));
+			} else {
+				state->busy_permille -= (uint32_t)(((uint64_t)(state->busy_permille - busy) * n) / (n + CAN_RATE_WAIT_WEIGHT));
+			}
+		}
+	}
+	return (seen > state->busy_permille) ? seen : state->busy_permille;
+}
+
+uint32_t can_rate_budget(uint32_t target_permille, uint32_t other_permille, uint32_t own_permille)
+{
+	if (own_permille == 0) return (target_permille > other_permille) ? target_permille - other_permille : 0;
+	return (uint32_t)(((uint64_t)own_permille * target_permille) / ((uint64_t)other_permille + own_permille));
+}
+
+// Load of one frame every period_ms, in permille * 1000 to keep the rounding small
+static uint64_t can_rate_load(const can_rate_signal_t *s, uint32_t period_ms, uint32_t bitrate_bps)
+{
+	return ((uint64_t)s->frame_bits * 1000000000u) / ((uint64_t)period_ms * bitrate_bps);
+}
+
+uint32_t can_rate_plan(const can_rate_signal_t *signals, uint32_t count, uint32_t budget_permille, uint32_t bitrate_bps, uint32_t *period_ms)
+{
+	if (count > CAN_RATE_PLAN_MAX) count = CAN_RATE_PLAN_MAX;
+
+	// Floor: every signal at its slowest period, whatever the budget
+	uint64_t used = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		period_ms[i] = signals[i].max_ms;
+		used += can_rate_load(&signals[i], signals[i].max_ms, bitrate_bps);
+	}
+	uint64_t budget = (uint64_t)budget_permille * 1000u;
+	uint64_t left = (budget > used) ? budget - used : 0;
+	uint64_t load = used;
+
+	// Priority order, stable
+	uint8_t order[CAN_RATE_PLAN_MAX];
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t j = i;
+		while (j > 0 && signals[order[j - 1]].priority > signals[i].priority) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = (uint8_t)i;
+	}
+
+	for (uint32_t k = 0; k < count && left > 0; k++) {
+		const can_rate_signal_t *s = &signals[order[k]];
+		uint64_t floor = can_rate_load(s, s->max_ms, bitrate_bps);
+		uint64_t full = can_rate_load(s, s->min_ms, bitrate_bps);
+		if (full - floor <= left) {
+			period_ms[order[k]] = s->min_ms;
+			left -= full - floor;
+			load += full - floor;
+			continue;
+		}
+		// Partial: the shortest period whose extra load still fits
+		uint64_t p = ((uint64_t)s->frame_bits * 1000000000u + (floor + left) * bitrate_bps - 1u) / ((floor + left) * bitrate_bps);
+		if (p > s->max_ms) p = s->max_ms;
+		if (p < s->min_ms) p = s->min_ms;
+		period_ms[order[k]] = (uint32_t)p;
+		load += can_rate_load(s, (uint32_t)p, bitrate_bps) - floor;
+		break; // Lower priorities stay at max_ms
+	}
+	return (uint32_t)((load + 999u) / 1000u);
+}
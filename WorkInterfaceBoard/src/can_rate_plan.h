@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bus-load-adaptive telemetry periods. Loads are in permille of the bitrate,
+ * times in microseconds or milliseconds as named. Pure arithmetic, no hardware
+ * or RTOS access, so it runs on a host against a simulated bus.
+ */
+
+#define CAN_RATE_PLAN_MAX      8u // Largest signal table can_rate_plan() accepts
+#define CAN_RATE_WAIT_WEIGHT   16u // Own frames at which a window counts as much as the history
+
+typedef struct {
+	uint32_t min_ms;     // Fastest period allowed
+	uint32_t max_ms;     // Slowest period, kept even when the bus is over target
+	uint32_t frame_bits; // Bus time of one frame (can_stats_frame_bits())
+	uint8_t priority;    // 0 is served first; equal priorities in table order
+} can_rate_signal_t;
+
+/* One measurement window. Hardware filters hide most foreign frames, so the
+ * load this node sees is only a lower bound. The rest shows in how often its
+ * own frames find the bus busy: a frame queued at a random instant does so
+ * with a probability equal to the load. */
+typedef struct {
+	uint32_t seen_permille; // Frames sent or received, over the window
+	uint32_t own_permille;  // Frames sent by this node
+	uint32_t tx_frames;     // Own frames sent
+	uint32_t tx_waited;     // Of those, frames that had to wait for the bus
+} can_rate_window_t;
+
+typedef struct {
+	uint32_t busy_permille; // Filtered share of own frames that waited
+	bool primed;            // busy_permille holds a measurement
+} can_rate_state_t;
+
+/* Load of other nodes' traffic: the larger of what was seen and the filtered
+ * busy share. A window moves the filter by tx_frames / (tx_frames +
+ * CAN_RATE_WAIT_WEIGHT) of the way, twice that when the load rises, so a
+ * window with few frames cannot swing the plan. */
+uint32_t can_rate_other_load(can_rate_state_t *state, const can_rate_window_t *w);
+/* This node's share of target_permille, from its current plan and the load of
+ * the others. The plan is scaled by target / (other + own) rather than given
+ * all of target - other: every board on the bus sees the same slack, and if
+ * each took all of it they would overshoot together and then all back off,
+ * window after window. Scaled, N boards land on the target together. With no
+ * plan yet it is target - other. */
+uint32_t can_rate_budget(uint32_t target_permille, uint32_t other_permille, uint32_t own_permille);
+/* Periods that fit this node's frames into budget_permille.
+ * Every signal first gets its max_ms period; what remains is handed out in
+ * priority order, each signal going as fast as min_ms allows before the next
+ * one gets any. Returns the load the plan puts on the bus. */
+uint32_t can_rate_plan(const can_rate_signal_t *signals, uint32_t count, uint32_t budget_permille, uint32_t bitrate_bps, uint32_t *period_ms);
+
+#ifdef __cplusplus
+}
+#endif
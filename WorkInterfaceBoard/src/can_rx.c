@@ -0,0 +1,293 @@
+#include "can_rx.h"
+#include "can_app.h"
+#include "can_stats.h"
+#include "can_time.h"
+#include "can_node.h"
+#include "conf_can_rx.h"
+#include "asf.h"
+#include "can.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#ifndef TickType_t
+typedef portTickType TickType_t; // Backward-compatible alias if TickType_t isn't defined
+#endif
+#ifndef portTICK_PERIOD_MS
+#define portTICK_PERIOD_MS portTICK_RATE_MS // Legacy macro mapping
+#endif
+#ifndef pdMS_TO_TICKS
+#define pdMS_TO_TICKS(ms) ((TickType_t)((ms) / portTICK_PERIOD_MS)) // Convert milliseconds to OS ticks
+#endif
+
+/* Default filters: node ID claims in the first mailbox, then this node's
+ * 0x200..0x2FF command/status block (conf_can_rx.h). Boards that need finer
+ * per-ID filtering call can_rx_set_filters().
+ */
+static const can_rx_filter_t g_default_filters[] = {
+	{ CAN_ID_CLAIM, 0x780u, CONF_CAN_RX_CLAIM_DEPTH },
+	{ CAN_ID_STATUS & 0x700u, 0x700u, CONF_CAN_RX_BLOCK_DEPTH },
+};
+
+#if CONF_CAN_RX_CLAIM_DEPTH < 1 || CONF_CAN_RX_BLOCK_DEPTH < 1
+#error "Each default RX filter needs a mailbox"
+#elif CONF_CAN_RX_CLAIM_DEPTH + CONF_CAN_RX_BLOCK_DEPTH > CAN_RX_MB_COUNT
+#error "Default RX filters are deeper than the mailboxes of CAN_RX_MB_MASK"
+#endif
+typedef char can_rx_mb_count_check[(__builtin_popcount(CAN_RX_MB_MASK) == CAN_RX_MB_COUNT) ? 1 : -1];
+
+#define CAN_RX_MAX_FILTERS     3u // One mailbox per filter at minimum
+
+static can_rx_filter_t g_rx_filters[CAN_RX_MAX_FILTERS];
+static uint8_t g_rx_filter_count = 0;
+
+static Can *g_rx_can = NULL;
+static uint32_t g_rx_mb_armed = 0; // RX mailboxes currently in use
+static xSemaphoreHandle g_rx_sem = NULL;
+
+/* Single-producer (CAN0_Handler) / single-consumer (task) ring.
+ * Indices run freely and are masked on access; only the ISR writes head and
+ * only the consumer writes tail, so no lock is needed.
+ */
+static can_rx_frame_t g_rx_ring[CAN_RX_RING_LEN];
+static volatile uint32_t g_rx_head = 0;
+static volatile uint32_t g_rx_tail = 0;
+
+static can_rx_stats_t g_rx_stats = {0};
+static can_rx_hook_t g_rx_hook = NULL;
+
+void can_rx_set_filters(const can_rx_filter_t *filters, uint8_t count)
+{
+	if (count > CAN_RX_MAX_FILTERS) count = CAN_RX_MAX_FILTERS;
+	for (uint8_t i = 0; i < count; i++) {
+		g_rx_filters[i] = filters[i];
+	}
+	g_rx_filter_count = count;
+}
+
+bool can_rx_init(Can *p_can)
+{
+	if (g_rx_filter_count == 0) {
+		can_rx_set_filters(g_default_filters, sizeof(g_default_filters) / sizeof(g_default_filters[0]));
+	}
+	if (g_rx_sem == NULL) {
+		vSemaphoreCreateBinary(g_rx_sem);
+		if (g_rx_sem == NULL) return false; // Out of FreeRTOS heap
+	}
+
+	g_rx_can = p_can;
+	p_can->CAN_IDR = CAN_RX_MB_MASK;
+	g_rx_mb_armed = 0;
+	g_rx_head = 0;
+	g_rx_tail = 0;
+
+	uint32_t pool = CAN_RX_MB_MASK; // Mailboxes not yet assigned to a filter
+	for (uint8_t f = 0; f < g_rx_filter_count; f++) {
+		for (uint8_t n = 0; n < g_rx_filters[f].depth && pool != 0; n++) {
+			uint32_t mb = (uint32_t)__builtin_ctz(pool);
+			pool &= ~(1u << mb);
+			bool last = (n + 1 == g_rx_filters[f].depth) || (pool == 0);
+
+			can_mb_conf_t rx;
+			rx.ul_mb_idx = mb;
+			rx.uc_obj_type = last ? CAN_MB_RX_OVER_WR_MODE : CAN_MB_RX_MODE; // Tail of the chain overwrites
+			rx.uc_tx_prio = 0;
+			rx.uc_id_ver = 0; // IDE bit comes with the MAM/MID values (can_node.h)
+			rx.ul_id_msk = can_node_mam(g_rx_filters[f].id, g_rx_filters[f].mask);
+			rx.ul_id = can_node_mid(g_rx_filters[f].id);
+			can_mailbox_init(p_can, &rx);
+			can_mailbox_send_transfer_cmd(p_can, &rx); // Arm for reception
+			g_rx_mb_armed |= (1u << mb);
+		}
+	}
+
+	// Park any RX mailbox left without a filter
+	for (uint32_t mb = 0; mb < CANMB_NUMBER; mb++) {
+		if (pool & (1u << mb)) {
+			can_mb_conf_t off;
+			off.ul_mb_idx = mb;
+			off.uc_obj_type = CAN_MB_DISABLE_MODE;
+			can_mailbox_init(p_can, &off);
+		}
+	}
+
+	p_can->CAN_IER = g_rx_mb_armed;
+	return true;
+}
+
+void can_rx_set_node(void)
+{
+	// Same filter-to-mailbox walk as can_rx_init()
+	uint32_t pool = CAN_RX_MB_MASK;
+	for (uint8_t f = 0; f < g_rx_filter_count; f++) {
+		for (uint8_t n = 0; n < g_rx_filters[f].depth && pool != 0; n++) {
+			uint32_t mb = (uint32_t)__builtin_ctz(pool);
+			pool &= ~(1u << mb);
+
+			CanMb *p_mb = &g_rx_can->CAN_MB[mb];
+			uint32_t mmr = p_mb->CAN_MMR;
+			p_mb->CAN_MMR = mmr & ~CAN_MMR_MOT_Msk; // MAM/MID are written with the mailbox disabled
+			p_mb->CAN_MAM = can_node_mam(g_rx_filters[f].id, g_rx_filters[f].mask);
+			p_mb->CAN_MID = can_node_mid(g_rx_filters[f].id);
+			p_mb->CAN_MMR = mmr;
+			p_mb->CAN_MCR = CAN_MCR_MTCR; // Armed again
+		}
+	}
+}
+
+bool can_rx_isr(uint32_t can_sr)
+{
+	uint32_t ready = can_sr & g_rx_mb_armed;
+	if (ready == 0) return false;
+
+	/* Oldest capture first. The controller fills the lowest free mailbox of a
+	 * chain, so once a pass has re-armed a lower one it can take a newer frame
+	 * than the one still waiting above it: index order is not arrival order. */
+	uint32_t order[CAN_RX_MB_COUNT];
+	uint32_t msrs[CAN_RX_MB_COUNT];
+	uint16_t ages[CAN_RX_MB_COUNT];
+	uint32_t count = 0;
+	uint16_t now = (uint16_t)(g_rx_can->CAN_TIM & CAN_TIM_TIMER_Msk);
+	while (ready != 0) {
+		uint32_t mb = (uint32_t)__builtin_ctz(ready);
+		ready &= ~(1u << mb);
+		uint32_t msr = g_rx_can->CAN_MB[mb].CAN_MSR; // Reading MSR clears MMI, keep it
+		uint16_t age = (uint16_t)(now - can_time_mailbox_stamp(msr));
+		uint32_t i = count++;
+		for (; i > 0 && ages[i - 1] < age; i--) { // Equal ages keep index order
+			order[i] = order[i - 1];
+			msrs[i] = msrs[i - 1];
+			ages[i] = ages[i - 1];
+		}
+		order[i] = mb;
+		msrs[i] = msr;
+		ages[i] = age;
+	}
+
+	bool woken = false;
+	bool published = false;
+	for (uint32_t k = 0; k < count; k++) {
+		uint32_t mb = order[k];
+		CanMb *p_mb = &g_rx_can->CAN_MB[mb];
+		uint32_t msr = msrs[k];
+		uint32_t head = g_rx_head;
+		bool room = (head - g_rx_tail < CAN_RX_RING_LEN);
+
+		/* Copy, then read MSR again: the tail of a chain (RX_OVER_WR) can take a
+		 * newer frame while this pass is busy with older ones, and the copy
+		 * would mix the two. Then the newer frame is taken whole. */
+		uint32_t mid, datal, datah;
+		for (;;) {
+			if (msr & CAN_MSR_MMI) {
+				g_rx_stats.mb_overrun++; // Frame lost (RX) or overwritten (RX_OVER_WR) in hardware
+			}
+			mid = p_mb->CAN_MID;
+			datal = p_mb->CAN_MDL;
+			datah = p_mb->CAN_MDH;
+			uint32_t again = p_mb->CAN_MSR;
+			if (!(again & CAN_MSR_MMI) || again == msr) break;
+			msr = again;
+		}
+
+		uint32_t id = can_node_from_mid(mid);
+		uint8_t len = (uint8_t)((msr & CAN_MSR_MDLC_Msk) >> CAN_MSR_MDLC_Pos);
+		if (len > 8) len = 8;
+		can_stats_on_rx(id, len); // Counted even if the ring is full, it used the bus
+
+		// Built in the next ring slot, unpublished until head moves; the hook sees it there
+		can_rx_frame_t scratch;
+		can_rx_frame_t *frame = room ? &g_rx_ring[head & (CAN_RX_RING_LEN - 1u)] : &scratch;
+		frame->id = id;
+		frame->len = len;
+		frame->datal = datal;
+		frame->datah = datah;
+		frame->timestamp = can_time_extend_from_isr(can_time_mailbox_stamp(msr));
+
+		if (g_rx_hook != NULL && g_rx_hook(frame, &woken)) {
+			g_rx_stats.consumed++;
+		} else if (room) {
+			g_rx_head = head + 1; // Publish after the frame is complete
+			published = true;
+			g_rx_stats.received++;
+			if (head + 1 - g_rx_tail > g_rx_stats.high_water) g_rx_stats.high_water = head + 1 - g_rx_tail;
+		} else {
+			g_rx_stats.ring_overrun++;
+		}
+
+		p_mb->CAN_MCR = CAN_MCR_MTCR; // Re-arm the mailbox for the next frame
+	}
+
+	signed portBASE_TYPE sem_woken = pdFALSE;
+	if (published) {
+		xSemaphoreGiveFromISR(g_rx_sem, &sem_woken); // Frames the hook consumed leave can_rx_task asleep
+	}
+	return woken || sem_woken != pdFALSE;
+}
+
+void can_rx_set_isr_hook(can_rx_hook_t hook)
+{
+	taskENTER_CRITICAL();
+	g_rx_hook = hook;
+	taskEXIT_CRITICAL();
+}
+
+bool can_rx_accepts(uint32_t id)
+{
+	for (uint8_t f = 0; f < g_rx_filter_count; f++) {
+		if (((id ^ g_rx_filters[f].id) & g_rx_filters[f].mask) == 0) return true;
+	}
+	return false;
+}
+
+bool can_rx_available(void)
+{
+	return g_rx_head != g_rx_tail;
+}
+
+const can_rx_frame_t *can_rx_peek(uint32_t timeout_ms)
+{
+	for (;;) {
+		uint32_t tail = g_rx_tail;
+		if (g_rx_head != tail) {
+			return &g_rx_ring[tail & (CAN_RX_RING_LEN - 1u)]; // The ISR leaves it alone until released
+		}
+
+		TickType_t ticks = (timeout_ms == CAN_RX_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+		if (xSemaphoreTake(g_rx_sem, ticks) != pdTRUE) {
+			return NULL; // Timed out with nothing received
+		}
+	}
+}
+
+void can_rx_release(void)
+{
+	if (g_rx_head != g_rx_tail) g_rx_tail++; // Only the consumer writes tail
+}
+
+bool can_rx_receive(can_rx_frame_t *frame, uint32_t timeout_ms)
+{
+	const can_rx_frame_t *slot = can_rx_peek(timeout_ms);
+	if (slot == NULL) return false;
+	*frame = *slot;
+	can_rx_release(); // Release the slot after copying
+	return true;
+}
+
+void can_rx_get_stats(can_rx_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = g_rx_stats;
+	taskEXIT_CRITICAL();
+}
+
+void can_rx_reset_stats(void)
+{
+	taskENTER_CRITICAL();
+	g_rx_stats.received = 0;
+	g_rx_stats.consumed = 0;
+	g_rx_stats.ring_overrun = 0;
+	g_rx_stats.mb_overrun = 0;
+	g_rx_stats.high_water = g_rx_head - g_rx_tail;
+	taskEXIT_CRITICAL();
+}
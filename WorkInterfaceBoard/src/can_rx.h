@@ -0,0 +1,78 @@
+#pragma once
+#include "sam4e.h"
+#include "conf_can_sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Interrupt-driven CAN receive engine.
+ * RX mailboxes are grouped into hardware FIFOs, one per acceptance filter.
+ * CAN0_Handler copies frames into a lock-free ring and wakes the consumer.
+ */
+
+#if CONF_CAN_TIME_TRIGGERED
+/* A frame received in MB7 would reset the CAN timer in time-triggered mode */
+#define CAN_RX_MB_MASK         ((1u << 0) | (1u << 6)) // MB0, MB6 (MB1 urgent, MB2..MB5 TX and schedule, MB7 unused)
+#define CAN_RX_MB_COUNT        2 // Mailboxes in CAN_RX_MB_MASK
+#else
+#define CAN_RX_MB_MASK         ((1u << 0) | (1u << 6) | (1u << 7)) // MB0, MB6, MB7 (MB1 urgent, MB2..MB5 TX and producers)
+#define CAN_RX_MB_COUNT        3 // Mailboxes in CAN_RX_MB_MASK
+#endif
+#define CAN_RX_RING_LEN        64u // Software ring depth, must be a power of two
+#define CAN_RX_WAIT_FOREVER    0xFFFFFFFFu // Timeout value for can_rx_receive() that never expires
+
+typedef struct {
+	uint32_t id;    // 11-bit CAN identifier
+	union {
+		struct {
+			uint32_t datal; // Data bytes 0..3 (CAN_MDL layout, byte 0 in bits 7..0)
+			uint32_t datah; // Data bytes 4..7 (CAN_MDH layout)
+		};
+		uint8_t data[8]; // The same bytes in bus order (little-endian core)
+	};
+	uint64_t timestamp; // Capture time in bit times (can_time.h), start of frame by default
+	uint8_t len;    // DLC 0..8
+} can_rx_frame_t;
+
+/* Acceptance filter: a frame matches when (frame_id & mask) == (id & mask).
+ * depth mailboxes are chained into a FIFO for this filter; the last one runs in
+ * overwrite mode so the newest frame survives if the ISR ever falls behind.
+ */
+typedef struct {
+	uint32_t id;    // Identifier to match
+	uint32_t mask;  // 11-bit acceptance mask (0x7FF = exact match)
+	uint8_t depth;  // Number of mailboxes chained for this filter (cut short past CAN_RX_MB_COUNT in total)
+} can_rx_filter_t;
+
+/* Called from CAN0_Handler for every received frame before it is queued.
+ * Return true to consume the frame (it then skips the ring); set *woken if a
+ * task was woken. Keep it short. */
+typedef bool (*can_rx_hook_t)(const can_rx_frame_t *frame, bool *woken);
+
+typedef struct {
+	uint32_t received;     // Frames moved into the ring
+	uint32_t consumed;     // Frames taken by the ISR hook
+	uint32_t ring_overrun; // Frames dropped because the ring was full
+	uint32_t mb_overrun;   // Frames lost or overwritten inside a mailbox (MMI)
+	uint32_t high_water;   // Maximum ring depth seen since the last reset
+} can_rx_stats_t;
+
+bool can_rx_init(Can *p_can); // Apply filters to the RX mailboxes and empty the ring
+void can_rx_set_node(void); // Re-program the armed mailboxes for a new node ID (CAN interrupt masked, ready frames drained)
+void can_rx_set_filters(const can_rx_filter_t *filters, uint8_t count); // Replace the filter table (takes effect on can_rx_init)
+bool can_rx_accepts(uint32_t id); // True if a filter in the current table matches id
+void can_rx_set_isr_hook(can_rx_hook_t hook); // Install (or clear with NULL) the ISR receive hook
+bool can_rx_isr(uint32_t can_sr); // Drain RX mailboxes from CAN0_Handler, returns true if a task was woken
+bool can_rx_receive(can_rx_frame_t *frame, uint32_t timeout_ms); // Pop a frame, blocking up to timeout_ms
+const can_rx_frame_t *can_rx_peek(uint32_t timeout_ms); // Oldest frame in place in the ring, blocking up to timeout_ms (NULL on timeout); single consumer
+void can_rx_release(void); // Free the slot returned by can_rx_peek()
+bool can_rx_available(void); // True when the ring holds at least one frame
+void can_rx_get_stats(can_rx_stats_t *stats); // Snapshot receive/overrun counters
+void can_rx_reset_stats(void); // Clear receive/overrun counters
+
+#ifdef __cplusplus
+}
+#endif
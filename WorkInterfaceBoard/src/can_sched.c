@@ -0,0 +1,288 @@
+#include "can_sched.h"
+#include "can_app.h"
+#include "can_sched_plan.h"
+#include "can_signals.h"
+#include "can_stats.h"
+#include "can_time.h"
+#include "can_node.h"
+#include "asf.h"
+#include "can.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Table checks for the preprocessor: CAN_SCHED_COUNT is an enum, so count
+ * and test the rows with the table itself */
+#define CAN_SCHED_GEN_ONE(msg, period_ms, phase_ms) + 1
+#define CAN_SCHED_GEN_TOO_LONG(msg, period_ms, phase_ms) || ((period_ms) * CAN_BAUD_KBPS > 0x10000u - CAN_SCHED_MARGIN_BITS)
+#if CONF_CAN_TIME_TRIGGERED
+#if (0 CAN_SCHED_TABLE(CAN_SCHED_GEN_ONE)) > 4
+#error "conf_can_sched.h: at most 4 scheduled messages, one TX mailbox must stay with the event queue"
+#endif
+#if (0 CAN_SCHED_TABLE(CAN_SCHED_GEN_ONE)) > CAN_SCHED_PLAN_MAX
+#error "conf_can_sched.h: schedule larger than CAN_SCHED_PLAN_MAX"
+#endif
+#if 0 CAN_SCHED_TABLE(CAN_SCHED_GEN_TOO_LONG)
+#error "conf_can_sched.h: a period is longer than one CAN timer wrap (65536 bit times) at CAN_BAUD_KBPS"
+#endif
+#endif
+
+/* Time is kept as 64-bit bit times since g_epoch (the CAN_TIM value when the
+ * schedule started), so every frame stays on its exact phase + k * period grid
+ * no matter how often the 16-bit timer wraps. A timemark is the low 16 bits
+ * of that time offset by g_epoch.
+ */
+typedef struct {
+	uint32_t id;
+	uint8_t dlc;
+	uint32_t period; // Bit times
+	uint32_t phase;  // Bit times, from can_sched_plan()
+	uint32_t datal;  // Latest data from the producer
+	uint32_t datah;
+	uint64_t next;   // Time of the pending (armed) or next timemark
+	bool valid;      // Producer has supplied data
+	bool armed;      // Mailbox loaded and waiting for its timemark
+	bool once;       // Posted: sent at one timemark, then parked until the next post
+	bool fresh;      // Data not loaded into the mailbox yet
+} can_sched_entry_t;
+
+#define CAN_SCHED_GEN_ENTRY(msg, period_ms, phase_ms) { .id = CAN_MSG_ID(msg), .dlc = CAN_MSG_DLC(msg) },
+static can_sched_entry_t g_sched[CAN_SCHED_COUNT] = {
+	CAN_SCHED_TABLE(CAN_SCHED_GEN_ENTRY)
+};
+
+/* Table periods/phases in ms; g_sched holds them in bit times once planned */
+#define CAN_SCHED_GEN_MS(msg, period_ms, phase_ms) { (period_ms), (phase_ms) },
+static const uint32_t g_sched_ms[CAN_SCHED_COUNT][2] = {
+	CAN_SCHED_TABLE(CAN_SCHED_GEN_MS)
+};
+
+static Can *g_sched_can = NULL;
+static bool g_sched_active = false;
+static uint32_t g_sched_armed = 0; // CAN_SR-style mask of armed mailboxes
+static uint16_t g_epoch = 0;
+static uint64_t g_epoch_time = 0; // can_time.h value at g_epoch
+static can_sched_stats_t g_sched_stats = {0};
+
+static uint16_t can_sched_timemark(uint64_t t)
+{
+	return (uint16_t)(g_epoch + (uint16_t)t);
+}
+
+// First grid point of e at or after t
+static uint64_t can_sched_next_after(const can_sched_entry_t *e, uint64_t t)
+{
+	if (t <= e->phase) return e->phase;
+	uint64_t k = (t - e->phase + e->period - 1u) / e->period;
+	return e->phase + k * e->period;
+}
+
+static void can_sched_arm(uint32_t n)
+{
+	can_sched_entry_t *e = &g_sched[n];
+	uint32_t mb = CAN_SCHED_MB_FIRST + n;
+	CanMb *p_mb = &g_sched_can->CAN_MB[mb];
+
+	p_mb->CAN_MMR = (p_mb->CAN_MMR & ~(CAN_MMR_PRIOR_Msk | CAN_MMR_MTIMEMARK_Msk)) |
+	                CAN_MMR_PRIOR(e->id >> 7) | CAN_MMR_MTIMEMARK(can_sched_timemark(e->next));
+	p_mb->CAN_MID = can_node_mid(e->id);
+	p_mb->CAN_MDL = e->datal;
+	p_mb->CAN_MDH = e->datah;
+	p_mb->CAN_MCR = CAN_MCR_MDLC(e->dlc) | CAN_MCR_MTCR; // Held until the timemark
+
+	e->armed = true;
+	e->fresh = false;
+	g_sched_armed |= (1u << mb);
+	g_sched_can->CAN_IER = (1u << mb);
+}
+
+// Arm every entry that has data but no mailbox load yet, relative to time now
+static void can_sched_join(uint64_t now)
+{
+	for (uint32_t n = 0; n < CAN_SCHED_COUNT; n++) {
+		can_sched_entry_t *e = &g_sched[n];
+		if (e->valid && !e->armed) {
+			e->next = can_sched_next_after(e, now + CAN_SCHED_MARGIN_BITS);
+			can_sched_arm(n);
+		}
+	}
+}
+
+bool can_sched_init(Can *p_can, uint32_t bitrate_bps)
+{
+	g_sched_active = false;
+	g_sched_armed = 0;
+	g_sched_can = p_can;
+	p_can->CAN_IDR = CAN_SCHED_MB_MASK;
+
+#if CONF_CAN_TIME_TRIGGERED
+	can_sched_slot_t slots[CAN_SCHED_COUNT];
+	for (uint32_t n = 0; n < CAN_SCHED_COUNT; n++) {
+		slots[n].period = can_sched_ms_to_bits(g_sched_ms[n][0], bitrate_bps);
+		slots[n].phase = can_sched_ms_to_bits(g_sched_ms[n][1], bitrate_bps);
+		slots[n].length = can_stats_frame_bits(g_sched[n].dlc);
+	}
+	// A period must leave room to re-arm inside one timer wrap
+	if (can_sched_plan(slots, CAN_SCHED_COUNT, 0x10000u - CAN_SCHED_MARGIN_BITS, 16u) != CAN_SCHED_PLAN_OK) {
+		g_sched_stats.unplanned++; // Autobaud found a bus too fast for a period
+		can_disable_time_triggered_mode(p_can);
+		return false; // Producers fall back to the event queue
+	}
+
+	for (uint32_t n = 0; n < CAN_SCHED_COUNT; n++) {
+		can_sched_entry_t *e = &g_sched[n];
+		e->period = slots[n].period;
+		e->phase = slots[n].phase;
+		e->valid = false;
+		e->armed = false;
+		e->once = false;
+		e->fresh = false;
+
+		can_mb_conf_t tx;
+		tx.ul_mb_idx = CAN_SCHED_MB_FIRST + n;
+		tx.uc_obj_type = CAN_MB_DISABLE_MODE;
+		can_mailbox_init(p_can, &tx);
+		tx.uc_obj_type = CAN_MB_TX_MODE;
+		tx.uc_tx_prio = 15;
+		tx.uc_id_ver = 0;
+		tx.ul_id_msk = 0;
+		tx.ul_id = 0;
+		can_mailbox_init(p_can, &tx);
+	}
+
+	/* TTM is switched with the controller off. The timer free-runs (no
+	 * TIMFRZ) and wraps every 65536 bit times. */
+	can_disable(p_can);
+	can_disable_timer_freeze(p_can);
+	can_enable_time_triggered_mode(p_can);
+	can_enable(p_can);
+
+	taskENTER_CRITICAL();
+	g_sched_stats = (can_sched_stats_t){ .unplanned = g_sched_stats.unplanned };
+	g_sched_active = true;
+	taskEXIT_CRITICAL();
+	return true;
+#else
+	(void)bitrate_bps;
+	(void)g_sched_ms;
+	can_disable_time_triggered_mode(p_can);
+	return false;
+#endif
+}
+
+void can_sched_set_node(void)
+{
+	for (uint32_t n = 0; n < CAN_SCHED_COUNT; n++) {
+		if (!g_sched[n].armed) continue;
+		CanMb *p_mb = &g_sched_can->CAN_MB[CAN_SCHED_MB_FIRST + n];
+		uint32_t mmr = p_mb->CAN_MMR;
+		p_mb->CAN_MMR = mmr & ~CAN_MMR_MOT_Msk; // Drops the pending request so MID can change
+		p_mb->CAN_MMR = mmr;
+		can_sched_arm(n); // Same timemark, new MID
+	}
+}
+
+bool can_sched_active(void)
+{
+	return g_sched_active;
+}
+
+/* Hand data to an entry, inside a critical section. t is can_time_now() from
+ * just before it; CAN_TIM brings it up to date. An entry without a loaded
+ * mailbox joins the grid at once; the first one starts the grid. */
+static void can_sched_submit(can_sched_entry_t *e, uint32_t datal, uint32_t datah, bool once, uint64_t t)
+{
+	if (e->fresh) g_sched_stats.superseded++; // Previous sample never reached the mailbox
+	e->datal = datal;
+	e->datah = datah;
+	e->once = once;
+	e->fresh = true;
+	e->valid = true;
+	if (e->armed) return; // Loaded at the re-arm after the pending timemark
+
+	uint16_t tim = (uint16_t)(g_sched_can->CAN_TIM & CAN_TIM_TIMER_Msk);
+	t += (uint16_t)(tim - (uint16_t)t);
+	if (g_sched_armed == 0) {
+		g_epoch = tim;
+		g_epoch_time = t;
+		can_sched_join(0);
+	} else {
+		can_sched_join(t - g_epoch_time);
+	}
+}
+
+bool can_sched_update(uint32_t slot, uint32_t datal, uint32_t datah)
+{
+	if (!g_sched_active || slot >= CAN_SCHED_COUNT) return false;
+
+	uint64_t t = can_time_now(); // Before the critical section, it takes its own
+	taskENTER_CRITICAL();
+	can_sched_submit(&g_sched[slot], datal, datah, false, t);
+	taskEXIT_CRITICAL();
+	return true;
+}
+
+bool can_sched_post(uint32_t id, uint32_t datal, uint32_t datah)
+{
+	if (!g_sched_active) return false;
+	for (uint32_t n = 0; n < CAN_SCHED_COUNT; n++) {
+		if (g_sched[n].id != id) continue;
+		uint64_t t = can_time_now();
+		taskENTER_CRITICAL();
+		can_sched_submit(&g_sched[n], datal, datah, true, t);
+		taskEXIT_CRITICAL();
+		return true;
+	}
+	return false; // Not a scheduled message
+}
+
+void can_sched_isr(uint32_t can_sr)
+{
+	uint32_t done = can_sr & g_sched_armed;
+	if (done == 0) return;
+
+	uint16_t tim = (uint16_t)(g_sched_can->CAN_TIM & CAN_TIM_TIMER_Msk);
+	uint64_t now = 0;
+
+	for (uint32_t pending = done; pending != 0; pending &= pending - 1u) {
+		uint32_t mb = (uint32_t)__builtin_ctz(pending);
+		can_sched_entry_t *e = &g_sched[mb - CAN_SCHED_MB_FIRST];
+
+		bool aborted = (g_sched_can->CAN_MB[mb].CAN_MSR & CAN_MSR_MABT) != 0;
+		if (aborted) {
+			g_sched_stats.missed++;
+		} else {
+			g_sched_stats.sent++;
+		}
+
+		// The mark just passed, so the current time is less than one wrap after it
+		now = e->next + (uint16_t)(tim - can_sched_timemark(e->next));
+		if (e->once && !e->fresh && !aborted) {
+			e->armed = false; // Sent, park until the next can_sched_post()
+			e->valid = false;
+			g_sched_armed &= ~(1u << mb);
+			g_sched_can->CAN_IDR = (1u << mb);
+			continue;
+		}
+		e->next += e->period;
+		if (e->next < now + CAN_SCHED_MARGIN_BITS) {
+			e->next = can_sched_next_after(e, now + CAN_SCHED_MARGIN_BITS);
+			g_sched_stats.late++;
+		}
+		can_sched_arm(mb - CAN_SCHED_MB_FIRST);
+	}
+
+	can_sched_join(now); // Messages whose producer started since the last event
+}
+
+uint16_t can_sched_asap_timemark(void)
+{
+	return (uint16_t)((g_sched_can->CAN_TIM & CAN_TIM_TIMER_Msk) + CAN_SCHED_MARGIN_BITS);
+}
+
+void can_sched_get_stats(can_sched_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = g_sched_stats;
+	taskEXIT_CRITICAL();
+}
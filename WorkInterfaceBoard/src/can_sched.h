@@ -0,0 +1,55 @@
+#pragma once
+#include "sam4e.h"
+#include "conf_can_sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Time-triggered periodic CAN transmission (see config/conf_can_sched.h).
+ * Producers hand over their latest data with can_sched_update(); the frame is
+ * loaded into its mailbox with the next timemark and the controller sends it
+ * when the CAN timer gets there. Data is therefore at most one period old.
+ * can_sched_post() is the change-driven variant (can_publish.h): the frame
+ * goes out at the next timemark only, and the mailbox idles until the next post.
+ */
+
+#define CAN_SCHED_SLOT(msg)    can_sched_slot_##msg // Schedule index of a message
+
+#define CAN_SCHED_GEN_SLOT(msg, period_ms, phase_ms) CAN_SCHED_SLOT(msg),
+enum {
+	CAN_SCHED_TABLE(CAN_SCHED_GEN_SLOT)
+	CAN_SCHED_COUNT
+};
+
+#if CONF_CAN_TIME_TRIGGERED
+#define CAN_SCHED_MB_COUNT     ((uint32_t)CAN_SCHED_COUNT) // One mailbox per scheduled message
+#else
+#define CAN_SCHED_MB_COUNT     0u
+#endif
+#define CAN_SCHED_MB_FIRST     (6u - CAN_SCHED_MB_COUNT) // Top of MB2..MB5
+#define CAN_SCHED_MB_MASK      (((1u << CAN_SCHED_MB_COUNT) - 1u) << CAN_SCHED_MB_FIRST)
+#define CAN_SCHED_MARGIN_BITS  32u // Minimum lead of a timemark over CAN_TIM when it is written
+
+typedef struct {
+	uint32_t sent;   // Frames sent at their timemark
+	uint32_t missed; // Frames that completed with MABT set
+	uint32_t late;   // Timemarks skipped because the mailbox was re-armed too late
+	uint32_t superseded; // Samples replaced by a newer one before they were loaded
+	uint32_t unplanned;  // can_sched_init() calls that left the schedule off because it did not fit the bitrate
+} can_sched_stats_t;
+
+bool can_sched_init(Can *p_can, uint32_t bitrate_bps); // Plan the table and enter time-triggered mode, false if disabled or it does not fit
+void can_sched_set_node(void); // Re-arm loaded mailboxes with the new node ID, same timemarks (CAN interrupt masked)
+bool can_sched_active(void); // True when the schedule is running
+bool can_sched_update(uint32_t slot, uint32_t datal, uint32_t datah); // Latest data for a scheduled message, false if the schedule is not running
+bool can_sched_post(uint32_t id, uint32_t datal, uint32_t datah); // Send once at the message's next timemark, false if it is not scheduled or the schedule is not running
+void can_sched_isr(uint32_t can_sr); // Re-arm completed mailboxes, called from CAN0_Handler with a CAN_SR snapshot
+uint16_t can_sched_asap_timemark(void); // Timemark for an unscheduled frame to go out as soon as possible
+void can_sched_get_stats(can_sched_stats_t *stats); // Snapshot sent/missed counters
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,69 @@
+#include "can_sched_plan.h"
+
+static uint32_t can_sched_gcd(uint32_t a, uint32_t b)
+{
+	while (b != 0) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+uint32_t can_sched_ms_to_bits(uint32_t ms, uint32_t bitrate_bps)
+{
+	return (uint32_t)(((uint64_t)ms * bitrate_bps) / 1000u);
+}
+
+/* Start times of a and b differ by (b.phase - a.phase) + j*b.period - i*a.period,
+ * which takes exactly the values congruent to the phase difference modulo
+ * g = gcd(a.period, b.period). With d the smallest such value >= 0, b starts
+ * d bits after some start of a and g - d bits before the next one, so the
+ * frames are disjoint iff a.length <= d and d + b.length <= g. No hyperperiod
+ * walk is needed.
+ */
+bool can_sched_overlap(const can_sched_slot_t *a, const can_sched_slot_t *b)
+{
+	uint32_t g = can_sched_gcd(a->period, b->period);
+	uint32_t d = (b->phase % g + g - a->phase % g) % g;
+	return (d < a->length) || (d + b->length > g);
+}
+
+can_sched_plan_result_t can_sched_plan(can_sched_slot_t *slots, uint32_t count, uint32_t max_period, uint32_t step)
+{
+	if (count > CAN_SCHED_PLAN_MAX) return CAN_SCHED_PLAN_NO_ROOM;
+	if (step == 0) step = 1;
+
+	// Shortest period first (stable), the tightest constraints are placed first
+	uint8_t order[CAN_SCHED_PLAN_MAX];
+	for (uint32_t i = 0; i < count; i++) {
+		const can_sched_slot_t *s = &slots[i];
+		if (s->period == 0 || s->period >= max_period || s->length >= s->period) {
+			return CAN_SCHED_PLAN_BAD_PERIOD;
+		}
+		uint32_t j = i;
+		while (j > 0 && slots[order[j - 1]].period > s->period) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = (uint8_t)i;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		can_sched_slot_t *s = &slots[order[i]];
+		uint32_t wanted = s->phase % s->period;
+		bool placed = false;
+		for (uint32_t offset = 0; offset < s->period && !placed; offset += step) {
+			s->phase = (wanted + offset) % s->period;
+			placed = true;
+			for (uint32_t k = 0; k < i; k++) {
+				if (can_sched_overlap(&slots[order[k]], s)) {
+					placed = false;
+					break;
+				}
+			}
+		}
+		if (!placed) return CAN_SCHED_PLAN_NO_ROOM;
+	}
+	return CAN_SCHED_PLAN_OK;
+}
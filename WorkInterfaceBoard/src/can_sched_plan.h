@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Slot assignment for the time-triggered CAN schedule. All times are in CAN
+ * bit times. Pure arithmetic, no hardware access, so it builds on a host.
+ */
+
+#define CAN_SCHED_PLAN_MAX     8u // Largest schedule can_sched_plan() accepts
+
+typedef struct {
+	uint32_t period; // Repetition period
+	uint32_t phase;  // In: earliest offset wanted, out: assigned offset (< period)
+	uint32_t length; // Bus time the frame occupies, including intermission
+} can_sched_slot_t;
+
+typedef enum {
+	CAN_SCHED_PLAN_OK = 0,
+	CAN_SCHED_PLAN_BAD_PERIOD, // Period zero, too long, or not longer than the frame
+	CAN_SCHED_PLAN_NO_ROOM,    // No collision-free offset exists for a slot
+} can_sched_plan_result_t;
+
+uint32_t can_sched_ms_to_bits(uint32_t ms, uint32_t bitrate_bps); // Milliseconds to bit times
+bool can_sched_overlap(const can_sched_slot_t *a, const can_sched_slot_t *b); // True if the two periodic frames ever collide
+/* Assign collision-free phases, shortest period first. Each slot keeps its
+ * requested phase if possible, otherwise the next free offset in steps of
+ * step bit times. Periods must be below max_period. */
+can_sched_plan_result_t can_sched_plan(can_sched_slot_t *slots, uint32_t count, uint32_t max_period, uint32_t step);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+#include "can_signals.h"
+#include "can_node.h"
+#include <stddef.h>
+
+/* Decoder library generated from config/conf_can_signals.h. It has no
+ * hardware dependencies so bus tools can link it on a host PC. */
+
+#define CAN_GEN_DESC_SIG(msg, name, start, len, type, scale, offset, unit) \
+	{ can_##msg##_id, #msg, #name, (start), (len), CAN_SIG_IS_SIGNED(type), (scale), (offset), (unit) },
+#define CAN_GEN_DESC(msg, id, dlc, period_ms, SIGNALS) SIGNALS(CAN_GEN_DESC_SIG, msg)
+
+const can_signal_desc_t can_signal_descs[] = {
+	CAN_MESSAGE_TABLE(CAN_GEN_DESC)
+};
+const uint32_t can_signal_desc_count = sizeof(can_signal_descs) / sizeof(can_signal_descs[0]);
+
+int64_t can_signal_raw(const can_signal_desc_t *sig, uint32_t datal, uint32_t datah)
+{
+	uint64_t v = ((uint64_t)datah << 32) | datal;
+	uint64_t mask = CAN_SIG_MASK(sig->length);
+	uint64_t raw = (v >> sig->start) & mask;
+	if (sig->is_signed && ((raw >> (sig->length - 1)) & 1u)) {
+		raw |= ~mask; // Sign-extend
+	}
+	return (int64_t)raw;
+}
+
+double can_signal_physical(const can_signal_desc_t *sig, uint32_t datal, uint32_t datah)
+{
+	return (double)can_signal_raw(sig, datal, datah) * sig->scale + sig->offset;
+}
+
+uint32_t can_signals_message_id(uint32_t bus_id, uint32_t *node)
+{
+	uint32_t id = bus_id;
+	uint32_t addr = 0;
+	if (bus_id > 0x7FFu) {
+		// 29-bit: can_app.h ID in bits 28..18, extension in 17..8, node address in 7..0 (conf_can_node.h)
+		id = CAN_NODE_EXT_ID((bus_id >> 18) & 0x7FFu, (bus_id >> 8) & 0x3FFu);
+		addr = bus_id & 0xFFu;
+	} else if (id >= CAN_NODE_BLOCK_FIRST && id <= CAN_NODE_BLOCK_LAST) {
+		addr = id & CAN_NODE_ID_MASK;
+		id &= ~CAN_NODE_ID_MASK;
+	}
+	if ((id & ~0x7Fu) == CAN_ID_CLAIM) {
+		id = CAN_ID_CLAIM; // Low bits come from the sender's name
+	}
+	if (node != NULL) *node = addr;
+	return id;
+}
+
+uint32_t can_signals_decode(uint32_t id, uint32_t datal, uint32_t datah, can_signal_visit_t visit, void *ctx)
+{
+	id = can_signals_message_id(id, NULL);
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < can_signal_desc_count; i++) {
+		const can_signal_desc_t *sig = &can_signal_descs[i];
+		if (sig->id != id) continue;
+		int64_t raw = can_signal_raw(sig, datal, datah);
+		if (visit != NULL) visit(sig, raw, (double)raw * sig->scale + sig->offset, ctx);
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "can_app.h"
+#include "conf_can_signals.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frame layouts generated from config/conf_can_signals.h.
+ * For every CAN_MESSAGE(name, ...) this header provides:
+ *   can_<name>_t                         struct with one field per signal
+ *   CAN_MSG_ID/DLC/PERIOD_MS(name)       message constants
+ *   CAN_SIG_START/LEN/SIGNED(name, sig)  signal layout constants
+ *   can_pack_<name>(msg, &datal, &datah) build the two mailbox data words
+ *   can_unpack_<name>(datal, datah, msg) split the two mailbox data words
+ * Nothing here touches hardware, so it builds unchanged on a host.
+ */
+
+#define CAN_MSG_ID(msg)        can_##msg##_id        // CAN identifier of a described message
+#define CAN_MSG_DLC(msg)       can_##msg##_dlc       // Data length of a described message
+#define CAN_MSG_PERIOD_MS(msg) can_##msg##_period_ms // Nominal publish period of a described message
+
+#define CAN_SIG_MASK(len)      ((1ull << (len)) - 1u) // Raw mask, len <= 32
+#define CAN_SIG_IS_SIGNED(type) (((type)-1) < 1)
+
+/* Message constants */
+#define CAN_GEN_CONSTS(msg, id, dlc, period_ms, SIGNALS) \
+	enum { can_##msg##_id = (id), can_##msg##_dlc = (dlc), can_##msg##_period_ms = (period_ms) };
+CAN_MESSAGE_TABLE(CAN_GEN_CONSTS)
+
+/* Signal constants: CAN_SIG_START/LEN/SIGNED(msg, name) */
+#define CAN_SIG_START(msg, name)  can_##msg##_##name##_start
+#define CAN_SIG_LEN(msg, name)    can_##msg##_##name##_len
+#define CAN_SIG_SIGNED(msg, name) can_##msg##_##name##_signed
+#define CAN_GEN_SIG_CONST(msg, name, start, len, type, scale, offset, unit) \
+	CAN_SIG_START(msg, name) = (start), CAN_SIG_LEN(msg, name) = (len), CAN_SIG_SIGNED(msg, name) = CAN_SIG_IS_SIGNED(type),
+#define CAN_GEN_SIG_CONSTS(msg, id, dlc, period_ms, SIGNALS) \
+	enum { SIGNALS(CAN_GEN_SIG_CONST, msg) };
+CAN_MESSAGE_TABLE(CAN_GEN_SIG_CONSTS)
+
+/* Message structs */
+#define CAN_GEN_FIELD(msg, name, start, len, type, scale, offset, unit) type name;
+#define CAN_GEN_STRUCT(msg, id, dlc, period_ms, SIGNALS) \
+	typedef struct { SIGNALS(CAN_GEN_FIELD, msg) } can_##msg##_t;
+CAN_MESSAGE_TABLE(CAN_GEN_STRUCT)
+
+/* Packing: every signal is OR-ed into one 64-bit payload, written out as the
+ * CAN_MDL (bytes 0..3) and CAN_MDH (bytes 4..7) words. */
+#define CAN_GEN_PACK_SIG(msg, name, start, len, type, scale, offset, unit) \
+	v |= ((uint64_t)(uint32_t)p->name & CAN_SIG_MASK(len)) << (start);
+#define CAN_GEN_PACK(msg, id, dlc, period_ms, SIGNALS) \
+	static inline void can_pack_##msg(const can_##msg##_t *p, uint32_t *datal, uint32_t *datah) \
+	{ \
+		uint64_t v = 0; \
+		SIGNALS(CAN_GEN_PACK_SIG, msg) \
+		*datal = (uint32_t)v; \
+		*datah = (uint32_t)(v >> 32); \
+	}
+CAN_MESSAGE_TABLE(CAN_GEN_PACK)
+
+/* Unpacking: extract each field and sign-extend signed types */
+#define CAN_GEN_UNPACK_SIG(msg, name, start, len, type, scale, offset, unit) \
+	{ \
+		uint64_t raw = (v >> (start)) & CAN_SIG_MASK(len); \
+		if (CAN_SIG_IS_SIGNED(type) && ((raw >> ((len) - 1)) & 1u)) raw |= ~CAN_SIG_MASK(len); \
+		p->name = (type)raw; \
+	}
+#define CAN_GEN_UNPACK(msg, id, dlc, period_ms, SIGNALS) \
+	static inline void can_unpack_##msg(uint32_t datal, uint32_t datah, can_##msg##_t *p) \
+	{ \
+		uint64_t v = ((uint64_t)datah << 32) | datal; \
+		SIGNALS(CAN_GEN_UNPACK_SIG, msg) \
+	}
+CAN_MESSAGE_TABLE(CAN_GEN_UNPACK)
+
+/* Host-side decoder (can_signals.c): one descriptor per signal. Frames are
+ * looked up by bus ID: the node ID another board put into it is masked off,
+ * and any ID above 0x7FF is taken as a 29-bit one. */
+typedef struct {
+	uint32_t id;         // CAN identifier of the owning message
+	const char *message; // Message name from the description file
+	const char *name;    // Signal name
+	uint8_t start;       // First bit, little-endian numbering
+	uint8_t length;      // Width in bits
+	bool is_signed;      // Two's complement raw value
+	double scale;        // Physical = raw * scale + offset
+	double offset;
+	const char *unit;
+} can_signal_desc_t;
+
+typedef void (*can_signal_visit_t)(const can_signal_desc_t *sig, int64_t raw, double physical, void *ctx); // Decoder callback
+
+extern const can_signal_desc_t can_signal_descs[]; // All described signals
+extern const uint32_t can_signal_desc_count;
+int64_t can_signal_raw(const can_signal_desc_t *sig, uint32_t datal, uint32_t datah); // Raw value of one signal
+double can_signal_physical(const can_signal_desc_t *sig, uint32_t datal, uint32_t datah); // Scaled value of one signal
+uint32_t can_signals_message_id(uint32_t bus_id, uint32_t *node); // Node 0 message ID of a bus ID from any node (11- or 29-bit, see can_node.h); node may be NULL
+uint32_t can_signals_decode(uint32_t id, uint32_t datal, uint32_t datah, can_signal_visit_t visit, void *ctx); // Visit every signal of a frame from any node (bus ID), returns count
+
+#ifdef __cplusplus
+}
+#endif
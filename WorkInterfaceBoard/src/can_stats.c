@@ -0,0 +1,218 @@
+#include "can_stats.h"
+#include "can_app.h"
+#include "can_node.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Writers (can_stats_on_tx/on_rx) all run inside CAN0_Handler, readers take a
+ * task critical section, which masks CAN0 (it sits at the syscall priority).
+ */
+static uint32_t g_bitrate_bps = 500000u;
+
+static can_stats_id_t g_ids[CAN_STATS_MAX_IDS];
+static uint32_t g_id_count = 0;
+
+static can_stats_t g_stats;
+static uint64_t g_lat_sum_us = 0;
+static uint32_t g_lat_count = 0;
+static uint32_t g_window_bits = 0;   // Bits counted since the last tick
+static uint32_t g_window_frames = 0; // Frames counted since the last tick
+static uint32_t g_window_tx_bits = 0; // Of g_window_bits, sent by this node
+static uint32_t g_window_tx_frames = 0;
+static uint32_t g_window_tx_waited = 0;
+static uint32_t g_wait_us = 96u;      // CAN_STATS_WAIT_BITS at the current bitrate
+
+static uint32_t g_err_head = 0; // Next slot in g_stats.err_history (ring until snapshot)
+
+/* Table key of a frame ID, or false for another board's frame. can_rx.c
+ * hands those over as bus IDs: node bits set in the per-board block, or a
+ * 29-bit ID. On a shared bus they would otherwise fill the table before this
+ * node's own IDs show up. Claims from every board share one entry. */
+static bool can_stats_own_id(uint32_t *id)
+{
+	if (*id > 0x7FFu) return false;
+	if (*id >= CAN_NODE_BLOCK_FIRST && *id <= CAN_NODE_BLOCK_LAST && (*id & CAN_NODE_ID_MASK) != 0) return false;
+	if ((*id & ~0x7Fu) == CAN_ID_CLAIM) *id = CAN_ID_CLAIM;
+	return true;
+}
+
+static can_stats_id_t *can_stats_slot(uint32_t id)
+{
+	if (!can_stats_own_id(&id)) return NULL;
+	for (uint32_t i = 0; i < g_id_count; i++) {
+		if (g_ids[i].id == id) return &g_ids[i];
+	}
+	if (g_id_count < CAN_STATS_MAX_IDS) {
+		can_stats_id_t *slot = &g_ids[g_id_count++];
+		slot->id = id;
+		slot->tx = 0;
+		slot->rx = 0;
+		return slot;
+	}
+	return NULL; // Table full
+}
+
+static uint32_t can_stats_count(uint8_t len)
+{
+	uint32_t bits = can_stats_frame_bits(len);
+	g_window_bits += bits;
+	g_window_frames++;
+	return bits;
+}
+
+uint32_t can_stats_frame_bits(uint8_t len)
+{
+	if (len > 8) len = 8;
+	/* SOF..EOF plus 3-bit intermission is 47 + 8n bits; the 34 + 8n bits from
+	 * SOF to CRC can need one stuff bit per 4 bits in the worst case. An
+	 * extended ID adds SRR, IDE and 18 ID bits to both. */
+	uint32_t data_bits = 8u * len + (CONF_CAN_EXTENDED_ID ? 20u : 0u);
+	return 47u + data_bits + (34u + data_bits - 1u) / 4u;
+}
+
+void can_stats_init(uint32_t bitrate_bps)
+{
+	taskENTER_CRITICAL();
+	if (bitrate_bps != 0) g_bitrate_bps = bitrate_bps;
+	g_wait_us = (uint32_t)(((uint64_t)CAN_STATS_WAIT_BITS * 1000000u) / g_bitrate_bps);
+	g_id_count = 0;
+	g_stats = (can_stats_t){0};
+	g_stats.lat_min_us = UINT32_MAX;
+	g_lat_sum_us = 0;
+	g_lat_count = 0;
+	g_window_bits = 0;
+	g_window_frames = 0;
+	g_window_tx_bits = 0;
+	g_window_tx_frames = 0;
+	g_window_tx_waited = 0;
+	g_err_head = 0;
+	taskEXIT_CRITICAL();
+}
+
+void can_stats_on_tx(uint32_t id, uint8_t len, uint32_t latency_us)
+{
+	can_stats_id_t *slot = can_stats_slot(id);
+	if (slot != NULL) slot->tx++; else g_stats.untracked++;
+	g_stats.tx_frames++;
+	g_window_tx_bits += can_stats_count(len);
+	g_window_tx_frames++;
+	if (latency_us > g_wait_us) g_window_tx_waited++;
+
+	uint32_t bucket = 0;
+	if (latency_us >= CAN_STATS_LAT_FIRST_US) {
+		bucket = 32u - (uint32_t)__builtin_clz(latency_us / CAN_STATS_LAT_FIRST_US);
+		if (bucket >= CAN_STATS_LAT_BUCKETS) bucket = CAN_STATS_LAT_BUCKETS - 1u;
+	}
+	g_stats.lat_hist[bucket]++;
+	if (latency_us < g_stats.lat_min_us) g_stats.lat_min_us = latency_us;
+	if (latency_us > g_stats.lat_max_us) g_stats.lat_max_us = latency_us;
+	g_lat_sum_us += latency_us;
+	g_lat_count++;
+}
+
+void can_stats_on_rx(uint32_t id, uint8_t len)
+{
+	can_stats_id_t *slot = can_stats_slot(id);
+	if (slot != NULL) slot->rx++; else g_stats.untracked++;
+	g_stats.rx_frames++;
+	can_stats_count(len);
+}
+
+void can_stats_tick(uint32_t elapsed_ms, uint8_t tec, uint8_t rec)
+{
+	taskENTER_CRITICAL();
+	uint32_t bits = g_window_bits;
+	uint32_t frames = g_window_frames;
+	uint32_t tx_bits = g_window_tx_bits;
+	uint32_t tx_frames = g_window_tx_frames;
+	uint32_t tx_waited = g_window_tx_waited;
+	g_window_bits = 0;
+	g_window_frames = 0;
+	g_window_tx_bits = 0;
+	g_window_tx_frames = 0;
+	g_window_tx_waited = 0;
+	taskEXIT_CRITICAL();
+
+	// Seen load = bits of the frames this node sent or accepted / bits the
+	// bus could carry in the window: a lower bound of the bus load.
+	uint32_t permille = 0;
+	uint32_t tx_permille = 0;
+	if (elapsed_ms != 0) {
+		uint64_t capacity = (uint64_t)g_bitrate_bps * elapsed_ms; // bits * 1000
+		permille = (uint32_t)(((uint64_t)bits * 1000000u) / capacity);
+		if (permille > 1000u) permille = 1000u;
+		tx_permille = (uint32_t)(((uint64_t)tx_bits * 1000000u) / capacity);
+		if (tx_permille > permille) tx_permille = permille;
+	}
+
+	can_stats_err_t sample = { tec, rec };
+
+	taskENTER_CRITICAL();
+	g_stats.seen_load_permille = permille;
+	g_stats.tx_load_permille = tx_permille;
+	g_stats.window_frames = frames;
+	g_stats.window_tx_frames = tx_frames;
+	g_stats.window_tx_waited = tx_waited;
+	g_stats.window_ms = elapsed_ms;
+	g_stats.err_now = sample;
+	g_stats.err_history[g_err_head] = sample;
+	g_err_head = (g_err_head + 1u) % CAN_STATS_ERR_HISTORY;
+	if (g_stats.err_samples < CAN_STATS_ERR_HISTORY) g_stats.err_samples++;
+	taskEXIT_CRITICAL();
+}
+
+void can_stats_get(can_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = g_stats;
+	uint64_t sum = g_lat_sum_us;
+	uint32_t count = g_lat_count;
+	uint32_t head = g_err_head;
+	stats->id_count = g_id_count;
+	taskEXIT_CRITICAL();
+
+	stats->lat_mean_us = (count != 0) ? (uint32_t)(sum / count) : 0;
+	if (count == 0) stats->lat_min_us = 0;
+
+	// Unroll the error ring so err_history[0] is the oldest sample
+	uint32_t n = stats->err_samples;
+	uint32_t first = (head + CAN_STATS_ERR_HISTORY - n) % CAN_STATS_ERR_HISTORY;
+	can_stats_err_t ring[CAN_STATS_ERR_HISTORY];
+	can_stats_err_t max = { 0, 0 };
+	for (uint32_t i = 0; i < n; i++) {
+		ring[i] = stats->err_history[(first + i) % CAN_STATS_ERR_HISTORY];
+		if (ring[i].tec > max.tec) max.tec = ring[i].tec;
+		if (ring[i].rec > max.rec) max.rec = ring[i].rec;
+	}
+	for (uint32_t i = 0; i < CAN_STATS_ERR_HISTORY; i++) {
+		stats->err_history[i] = (i < n) ? ring[i] : (can_stats_err_t){ 0, 0 };
+	}
+	stats->err_max = max;
+}
+
+uint32_t can_stats_get_ids(can_stats_id_t *ids, uint32_t max)
+{
+	taskENTER_CRITICAL();
+	uint32_t n = (g_id_count < max) ? g_id_count : max;
+	for (uint32_t i = 0; i < n; i++) {
+		ids[i] = g_ids[i];
+	}
+	taskEXIT_CRITICAL();
+	return n;
+}
+
+bool can_stats_get_id(uint32_t id, can_stats_id_t *out)
+{
+	bool found = false;
+	taskENTER_CRITICAL();
+	for (uint32_t i = 0; i < g_id_count; i++) {
+		if (g_ids[i].id == id) {
+			*out = g_ids[i];
+			found = true;
+			break;
+		}
+	}
+	taskEXIT_CRITICAL();
+	return found;
+}
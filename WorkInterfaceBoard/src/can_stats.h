@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CAN traffic statistics: per-ID frame counters, enqueue-to-wire latency
+ * histogram, the load this node sees on the bus and a sliding window of error
+ * counters.
+ * can_tx.c / can_rx.c feed it from CAN0_Handler; can_status_task closes a
+ * measurement window once per second and publishes the summary on CAN_ID_DIAG.
+ * No register access here, the caller passes timer values and error counters.
+ */
+
+#define CAN_STATS_MAX_IDS      16u // Distinct IDs of this node tracked, first come first served
+#define CAN_STATS_LAT_BUCKETS  8u  // Latency buckets: <128us, <256us, ... <8192us, >=8192us
+#define CAN_STATS_LAT_FIRST_US 128u // Upper bound of the first latency bucket
+#define CAN_STATS_WAIT_BITS    48u  // A frame later than this many bit times waited for the bus (covers the timemark lead)
+#define CAN_STATS_ERR_HISTORY  16u // Error counter samples kept (one per can_stats_tick)
+
+typedef struct {
+	uint32_t id; // 11-bit CAN identifier
+	uint32_t tx; // Frames sent with this ID
+	uint32_t rx; // Frames received with this ID
+} can_stats_id_t;
+
+typedef struct {
+	uint8_t tec; // Transmit error counter
+	uint8_t rec; // Receive error counter
+} can_stats_err_t;
+
+typedef struct {
+	/* Load of the frames this node sent or accepted over the last window,
+	 * 1000 = 100 %. Frames the RX filters drop, error frames and other
+	 * boards' traffic are not seen, so this is a lower bound of the bus
+	 * load; can_rate.c estimates the rest from how long TX frames wait. */
+	uint32_t seen_load_permille;
+	uint32_t window_ms;         // Length of the last window
+	uint32_t window_frames;     // Frames seen (TX + RX) in the last window
+	uint32_t tx_load_permille;  // Part of seen_load_permille sent by this node
+	uint32_t window_tx_frames;  // Frames sent in the last window
+	uint32_t window_tx_waited;  // Of those, frames later than CAN_STATS_WAIT_BITS
+	uint32_t tx_frames;         // Total frames sent
+	uint32_t rx_frames;         // Total frames received
+	uint32_t untracked;         // Frames from other boards, or whose ID did not fit in the per-ID table
+	uint32_t lat_hist[CAN_STATS_LAT_BUCKETS]; // TX latency histogram
+	uint32_t lat_min_us;        // Shortest enqueue-to-wire latency
+	uint32_t lat_max_us;        // Longest enqueue-to-wire latency
+	uint32_t lat_mean_us;       // Mean enqueue-to-wire latency
+	can_stats_err_t err_now;    // Error counters at the last tick
+	can_stats_err_t err_max;    // Highest counters inside the history window
+	can_stats_err_t err_history[CAN_STATS_ERR_HISTORY]; // Oldest first
+	uint32_t err_samples;       // Valid entries in err_history
+	uint32_t id_count;          // Valid entries returned by can_stats_get_ids()
+} can_stats_t;
+
+void can_stats_init(uint32_t bitrate_bps); // Clear everything and set the bitrate used for the load estimate
+void can_stats_on_tx(uint32_t id, uint8_t len, uint32_t latency_us); // Frame left a TX mailbox (ISR)
+void can_stats_on_rx(uint32_t id, uint8_t len); // Frame taken from an RX mailbox (ISR)
+void can_stats_tick(uint32_t elapsed_ms, uint8_t tec, uint8_t rec); // Close the load window and sample error counters (task)
+void can_stats_get(can_stats_t *stats); // Snapshot of the summary counters
+uint32_t can_stats_get_ids(can_stats_id_t *ids, uint32_t max); // Copy the per-ID table, returns entries copied
+bool can_stats_get_id(uint32_t id, can_stats_id_t *out); // Counters for one ID, false if not tracked
+uint32_t can_stats_frame_bits(uint8_t len); // Worst-case bits on the wire for a standard frame
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,76 @@
+#include "can_time.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+static Can *g_time_can = NULL;
+static uint32_t g_bits_per_tick = 500u; // Bit times per RTOS tick
+static uint32_t g_bitrate_bps = 500000u;
+
+/* Last resolved (time, tick) pair. Updated by every read under the CAN0 mask
+ * (task critical section or CAN0_Handler itself). */
+static uint64_t g_ref_time = 0;
+static uint32_t g_ref_tick = 0;
+
+static uint64_t can_time_resolve(uint32_t tick)
+{
+	uint16_t tim = (uint16_t)(g_time_can->CAN_TIM & CAN_TIM_TIMER_Msk);
+	uint64_t estimate = g_ref_time + (uint64_t)(tick - g_ref_tick) * g_bits_per_tick;
+	/* The tick estimate is off by at most one tick (well under half a wrap),
+	 * so the signed 16-bit difference selects the right wrap. */
+	uint64_t now = estimate + (int16_t)(tim - (uint16_t)estimate);
+	if (now < g_ref_time) now = g_ref_time; // Never step backwards
+	g_ref_time = now;
+	g_ref_tick = tick;
+	return now;
+}
+
+void can_time_init(Can *p_can, uint32_t bitrate_bps)
+{
+	taskENTER_CRITICAL();
+	g_time_can = p_can;
+	if (bitrate_bps != 0) g_bitrate_bps = bitrate_bps;
+	g_bits_per_tick = g_bitrate_bps / configTICK_RATE_HZ;
+	g_ref_tick = (uint32_t)xTaskGetTickCount();
+	g_ref_time = p_can->CAN_TIM & CAN_TIM_TIMER_Msk;
+	taskEXIT_CRITICAL();
+}
+
+uint64_t can_time_now(void)
+{
+	taskENTER_CRITICAL();
+	uint64_t now = can_time_resolve((uint32_t)xTaskGetTickCount());
+	taskEXIT_CRITICAL();
+	return now;
+}
+
+uint64_t can_time_now_from_isr(void)
+{
+	return can_time_resolve((uint32_t)xTaskGetTickCountFromISR());
+}
+
+uint64_t can_time_extend_from_isr(uint16_t stamp)
+{
+	uint64_t now = can_time_now_from_isr();
+	uint64_t t = now - (uint16_t)((uint16_t)now - stamp); // Step back to the capture
+	return (t > now) ? 0 : t; // Capture before can_time_init()
+}
+
+uint16_t can_time_mailbox_stamp(uint32_t msr)
+{
+	/* Always the mailbox's own capture: CAN_TIMESTP only holds the most recent
+	 * frame on the bus, so when several mailboxes are serviced in one pass it
+	 * would give them all the latest frame's time. Only a capture that reads
+	 * 0 in time-triggered mode, where the mailbox stamp may not be updated,
+	 * falls back to CAN_TIMESTP. */
+	uint16_t stamp = (uint16_t)(msr & CAN_MSR_MTIMESTAMP_Msk);
+	if (stamp == 0 && (g_time_can->CAN_MR & CAN_MR_TTM)) {
+		return (uint16_t)(g_time_can->CAN_TIMESTP & CAN_TIMESTP_MTIMESTAMP_Msk);
+	}
+	return stamp;
+}
+
+uint64_t can_time_to_us(uint64_t t)
+{
+	return (t * 1000000u) / g_bitrate_bps;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "sam4e.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 64-bit CAN time base.
+ * The controller's 16-bit timer counts bit times and wraps every 65536 bits
+ * (131 ms at 500 kbit/s). Each read is extended by picking the 64-bit value
+ * congruent to CAN_TIM that lies closest to an estimate from the RTOS tick,
+ * which is exact while the tick estimate is within half a wrap. No overflow
+ * interrupt or CAN_SR read is needed, so task code can read the time too.
+ * Values count bit times since can_time_init().
+ */
+
+void can_time_init(Can *p_can, uint32_t bitrate_bps); // Restart the time base, call after anything that resets CAN_TIM
+uint64_t can_time_now(void); // Current time (task context)
+uint64_t can_time_now_from_isr(void); // Current time (CAN0_Handler)
+uint64_t can_time_extend_from_isr(uint16_t stamp); // Extend a timer value captured less than one wrap ago (CAN0_Handler)
+uint16_t can_time_mailbox_stamp(uint32_t msr); // Capture time of a mailbox event, from its CAN_MSR
+uint64_t can_time_to_us(uint64_t t); // Bit times to microseconds
+
+#ifdef __cplusplus
+}
+#endif
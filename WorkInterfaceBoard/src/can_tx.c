@@ -0,0 +1,381 @@
+#include "can_tx.h"
+#include "can_stats.h"
+#include "can_time.h"
+#include "can_node.h"
+#include "asf.h"
+#include "can.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+// One TX mailbox must stay with the queue (enums, so not an #if)
+typedef char can_tx_keeps_mailbox[(CAN_SCHED_MB_COUNT + CAN_PRODUCER_MB_COUNT + CAN_URGENT_MB_COUNT <= 4u) ? 1 : -1];
+
+/* The queue is a binary min-heap keyed on (bus ID, enqueue sequence), so the
+ * ISR always loads the most urgent frame and frames sharing an ID keep their
+ * enqueue order. A frame is only loaded when no mailbox already holds its ID,
+ * otherwise the controller could send two same-ID frames out of order. A
+ * frame held back that way does not block the others: the next most urgent
+ * frame with an ID not in flight takes the free mailbox.
+ */
+static Can *g_tx_can = NULL;
+static can_tx_frame_t g_tx_heap[CAN_TX_QUEUE_LEN + CAN_TX_MB_COUNT]; // Room for aborted frames coming back
+static uint32_t g_tx_count = 0;
+static uint32_t g_tx_seq = 0;
+
+static uint32_t g_mb_busy = 0; // CAN_SR-style mask of loaded TX mailboxes
+static bool g_tx_held = false; // Mailboxes are not loaded while set (can_tx_hold())
+static bool g_tx_completing = false; // can_tx_isr() is walking g_mb_frame, refill waits for it
+static can_tx_frame_t g_mb_frame[CAN_TX_MB_COUNT]; // Frame held by each loaded mailbox
+
+static can_tx_stats_t g_tx_stats = {0};
+static can_tx_complete_t g_tx_hook = NULL;
+
+static bool can_tx_before(const can_tx_frame_t *a, const can_tx_frame_t *b)
+{
+	if (a->id != b->id) {
+		return CAN_NODE_BUS_ORDER(a->id) < CAN_NODE_BUS_ORDER(b->id); // Lower bus ID wins arbitration
+	}
+	return (int32_t)(a->seq - b->seq) < 0; // Wrap-safe FIFO order
+}
+
+static void can_tx_heap_push(const can_tx_frame_t *frame)
+{
+	uint32_t i = g_tx_count++;
+	while (i > 0) {
+		uint32_t parent = (i - 1) / 2;
+		if (!can_tx_before(frame, &g_tx_heap[parent])) break;
+		g_tx_heap[i] = g_tx_heap[parent];
+		i = parent;
+	}
+	g_tx_heap[i] = *frame;
+}
+
+static void can_tx_heap_pop(void)
+{
+	const can_tx_frame_t last = g_tx_heap[--g_tx_count];
+	uint32_t i = 0;
+	for (;;) {
+		uint32_t child = 2 * i + 1;
+		if (child >= g_tx_count) break;
+		if (child + 1 < g_tx_count && can_tx_before(&g_tx_heap[child + 1], &g_tx_heap[child])) {
+			child++;
+		}
+		if (!can_tx_before(&g_tx_heap[child], &last)) break;
+		g_tx_heap[i] = g_tx_heap[child];
+		i = child;
+	}
+	g_tx_heap[i] = last;
+}
+
+// Remove the frame at heap index i
+static void can_tx_heap_remove(uint32_t i)
+{
+	const can_tx_frame_t last = g_tx_heap[--g_tx_count];
+	if (i == g_tx_count) return;
+	while (i > 0 && can_tx_before(&last, &g_tx_heap[(i - 1) / 2])) { // Up, if it beats the parent
+		g_tx_heap[i] = g_tx_heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	for (;;) { // Down otherwise
+		uint32_t child = 2 * i + 1;
+		if (child >= g_tx_count) break;
+		if (child + 1 < g_tx_count && can_tx_before(&g_tx_heap[child + 1], &g_tx_heap[child])) {
+			child++;
+		}
+		if (!can_tx_before(&g_tx_heap[child], &last)) break;
+		g_tx_heap[i] = g_tx_heap[child];
+		i = child;
+	}
+	g_tx_heap[i] = last;
+}
+
+static bool can_tx_id_in_flight(uint32_t id)
+{
+	for (uint32_t n = 0; n < CAN_TX_MB_COUNT; n++) {
+		if ((g_mb_busy & (1u << (CAN_TX_MB_FIRST + n))) && g_mb_frame[n].id == id) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Queued latest-value frame with this ID, NULL if none
+static can_tx_frame_t *can_tx_find_latest(uint32_t id)
+{
+	for (uint32_t i = 0; i < g_tx_count; i++) {
+		if (g_tx_heap[i].latest && g_tx_heap[i].id == id) return &g_tx_heap[i];
+	}
+	return NULL;
+}
+
+// Abort mailboxes still holding an older latest-value frame with this ID; can_tx_isr() drops them
+static void can_tx_abort_stale(uint32_t id)
+{
+	for (uint32_t n = 0; n < CAN_TX_MB_COUNT; n++) {
+		uint32_t mb = CAN_TX_MB_FIRST + n;
+		if ((g_mb_busy & (1u << mb)) && g_mb_frame[n].latest && g_mb_frame[n].id == id) {
+			g_tx_can->CAN_MB[mb].CAN_MCR = CAN_MCR_MACR; // No effect once the frame is on the wire
+		}
+	}
+}
+
+// Free mailbox for a frame with this ID, 0 if it has to wait (never a TX mailbox)
+static uint32_t can_tx_free_mb(uint32_t id)
+{
+	if (g_tx_held || g_tx_completing) return 0;
+	uint32_t free_mask = CAN_TX_MB_MASK & ~g_mb_busy;
+	if (free_mask == 0) return 0; // All TX mailboxes loaded
+	if (can_tx_id_in_flight(id)) return 0; // Preserve per-ID order and strict priority
+	return (uint32_t)__builtin_ctz(free_mask);
+}
+
+// Write a frame into mailbox mb and request transmission; CAN interrupt masked
+static void can_tx_load(uint32_t mb, const can_tx_frame_t *f)
+{
+	CanMb *p_mb = &g_tx_can->CAN_MB[mb];
+	/* Mailbox PRIOR follows the ID's top bits so the controller also
+	 * prefers lower IDs among already loaded mailboxes. In time-triggered
+	 * mode every TX mailbox waits for its timemark, so aim just ahead. */
+	uint32_t mmr = (p_mb->CAN_MMR & ~(CAN_MMR_PRIOR_Msk | CAN_MMR_MTIMEMARK_Msk)) | CAN_MMR_PRIOR((f->id & 0x7FFu) >> 7);
+	if (g_tx_can->CAN_MR & CAN_MR_TTM) mmr |= CAN_MMR_MTIMEMARK(can_sched_asap_timemark());
+	p_mb->CAN_MMR = mmr;
+	p_mb->CAN_MID = can_node_mid(f->id);
+	p_mb->CAN_MDL = f->datal;
+	p_mb->CAN_MDH = f->datah;
+	p_mb->CAN_MCR = CAN_MCR_MDLC(f->len) | CAN_MCR_MTCR; // Request transmission
+
+	g_mb_frame[mb - CAN_TX_MB_FIRST] = *f;
+	g_mb_busy |= (1u << mb);
+	g_tx_can->CAN_IER = (1u << mb); // MRDY interrupt signals completion
+}
+
+/* Load queued frames into free TX mailboxes. Caller must hold the CAN
+ * interrupt off (task critical section or CAN0_Handler itself).
+ */
+static void can_tx_refill(void)
+{
+	while (g_tx_count > 0) {
+		if (g_tx_held || g_tx_completing || (CAN_TX_MB_MASK & ~g_mb_busy) == 0) return;
+		uint32_t mb = can_tx_free_mb(g_tx_heap[0].id);
+		if (mb != 0) {
+			can_tx_load(mb, &g_tx_heap[0]);
+			can_tx_heap_pop();
+			continue;
+		}
+
+		/* The head waits for its own ID to leave a mailbox. Scan for the most
+		 * urgent frame that can go now; with a few mailboxes and a 32-frame
+		 * queue that is cheaper than keeping a heap per ID. */
+		uint32_t best = g_tx_count;
+		for (uint32_t i = 1; i < g_tx_count; i++) {
+			if (best < g_tx_count && !can_tx_before(&g_tx_heap[i], &g_tx_heap[best])) continue;
+			if (can_tx_id_in_flight(g_tx_heap[i].id)) continue;
+			best = i;
+		}
+		if (best == g_tx_count) return; // Every queued ID is in flight
+		can_tx_load(can_tx_free_mb(g_tx_heap[best].id), &g_tx_heap[best]);
+		can_tx_heap_remove(best);
+	}
+}
+
+/* Queue a frame, or with nothing queued and a mailbox idle write it straight
+ * into the mailbox: an empty heap means it would be popped right away anyway.
+ * CAN interrupt masked. */
+static bool can_tx_push(can_tx_frame_t *frame, uint64_t now, uint32_t *seq)
+{
+	can_tx_frame_t *stale = frame->latest ? can_tx_find_latest(frame->id) : NULL;
+	if (stale != NULL) {
+		// Same key (ID, seq), so the heap order holds
+		stale->datal = frame->datal;
+		stale->datah = frame->datah;
+		stale->len = frame->len;
+		stale->queued_at = now;
+		if (seq != NULL) *seq = stale->seq;
+		g_tx_stats.superseded++;
+		return true;
+	}
+	if (g_tx_count >= CAN_TX_QUEUE_LEN) {
+		g_tx_stats.dropped++;
+		return false;
+	}
+	frame->seq = g_tx_seq++;
+	frame->queued_at = now;
+	if (seq != NULL) *seq = frame->seq;
+	g_tx_stats.enqueued++;
+
+	uint32_t mb = (g_tx_count == 0) ? can_tx_free_mb(frame->id) : 0;
+	if (mb != 0) {
+		can_tx_load(mb, frame);
+		return true;
+	}
+	can_tx_heap_push(frame);
+	if (g_tx_count > g_tx_stats.high_water) g_tx_stats.high_water = g_tx_count;
+	can_tx_refill();
+	if (frame->latest) can_tx_abort_stale(frame->id);
+	return true;
+}
+
+void can_tx_init(Can *p_can)
+{
+	g_tx_can = p_can;
+	p_can->CAN_IDR = CAN_TX_MB_MASK; // No TX interrupts until a frame is loaded
+
+	for (uint32_t mb = CAN_TX_MB_FIRST; mb < CAN_TX_MB_FIRST + CAN_TX_MB_COUNT; mb++) {
+		can_mb_conf_t tx;
+		tx.ul_mb_idx = mb;
+		tx.uc_obj_type = CAN_MB_DISABLE_MODE; // Clear any stale state first
+		can_mailbox_init(p_can, &tx);
+
+		tx.uc_obj_type = CAN_MB_TX_MODE; // Transmit mode
+		tx.uc_tx_prio = 15; // Rewritten per frame in can_tx_refill()
+		tx.uc_id_ver = 0; // Standard ID
+		tx.ul_id_msk = 0; // Not used for TX
+		tx.ul_id = 0;
+		can_mailbox_init(p_can, &tx);
+	}
+
+	g_tx_count = 0;
+	g_mb_busy = 0;
+	g_tx_held = false;
+	can_tx_reset_stats();
+}
+
+bool can_tx_enqueue(uint32_t id, const uint8_t *data, uint8_t len)
+{
+	if (len > 8) len = 8; // Classic CAN payload limit
+	can_tx_frame_t frame = {0}; // Unused bytes go out as zero
+	memcpy(frame.data, data, len); // data[] overlays the mailbox words
+	return can_tx_enqueue_tagged(id, frame.datal, frame.datah, len, NULL);
+}
+
+static bool can_tx_enqueue_frame(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len, bool latest, uint32_t *seq)
+{
+	if (g_tx_can == NULL) return false; // can_tx_init() not called yet
+	if (len > 8) len = 8; // Classic CAN payload limit
+
+	can_tx_frame_t frame;
+	frame.id = id & CAN_NODE_MSG_MASK;
+	frame.len = len;
+	frame.datal = datal;
+	frame.datah = datah;
+	frame.latest = latest;
+
+	uint64_t now = can_time_now(); // Before the critical section, it takes its own
+	taskENTER_CRITICAL();
+	bool queued = can_tx_push(&frame, now, seq);
+	taskEXIT_CRITICAL();
+
+	return queued;
+}
+
+bool can_tx_enqueue_words(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len)
+{
+	return can_tx_enqueue_tagged(id, datal, datah, len, NULL);
+}
+
+bool can_tx_enqueue_tagged(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len, uint32_t *seq)
+{
+	return can_tx_enqueue_frame(id, datal, datah, len, false, seq);
+}
+
+bool can_tx_enqueue_latest(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len)
+{
+	return can_tx_enqueue_frame(id, datal, datah, len, true, NULL);
+}
+
+bool can_tx_enqueue_from_isr(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len)
+{
+	if (g_tx_can == NULL) return false;
+	if (len > 8) len = 8;
+
+	can_tx_frame_t frame;
+	frame.id = id & CAN_NODE_MSG_MASK;
+	frame.len = len;
+	frame.datal = datal;
+	frame.datah = datah;
+	frame.latest = false;
+	return can_tx_push(&frame, can_time_now_from_isr(), NULL);
+}
+
+void can_tx_isr(uint32_t can_sr)
+{
+	uint32_t done = can_sr & g_mb_busy; // Loaded mailboxes that became ready again
+	if (done == 0) return;
+
+	g_tx_can->CAN_IDR = done;
+	g_mb_busy &= ~done;
+
+	g_tx_completing = true; // The hook may enqueue; keep the freed mailboxes until the loop is done
+	for (uint32_t pending = done; pending != 0; pending &= pending - 1u) {
+		uint32_t mb = (uint32_t)__builtin_ctz(pending);
+		const can_tx_frame_t *f = &g_mb_frame[mb - CAN_TX_MB_FIRST];
+		uint32_t msr = g_tx_can->CAN_MB[mb].CAN_MSR;
+		if (msr & CAN_MSR_MABT) {
+			/* Not sent: aborted by can_tx_hold() or for a newer sample or, in
+			 * time-triggered mode, not started at its timemark. Original seq
+			 * keeps its place unless a newer sample already waits. */
+			if (f->latest && can_tx_find_latest(f->id) != NULL) {
+				g_tx_stats.superseded++;
+				continue;
+			}
+			can_tx_heap_push(f);
+			g_tx_stats.requeued++;
+			continue;
+		}
+		g_tx_stats.completed++;
+		// MTIMESTAMP latched the CAN timer when the frame went out
+		uint64_t sent_at = can_time_extend_from_isr(can_time_mailbox_stamp(msr));
+		uint64_t latency = (sent_at > f->queued_at) ? sent_at - f->queued_at : 0;
+		can_stats_on_tx(f->id, f->len, (uint32_t)can_time_to_us(latency));
+		if (g_tx_hook != NULL) g_tx_hook(f, sent_at);
+	}
+	g_tx_completing = false;
+
+	can_tx_refill();
+}
+
+void can_tx_hold(bool hold)
+{
+	g_tx_held = hold;
+	if (hold) {
+		g_tx_can->CAN_ACR = g_mb_busy; // Aborted mailboxes report MABT to can_tx_isr()
+	} else {
+		can_tx_refill();
+	}
+}
+
+bool can_tx_held(void)
+{
+	return g_tx_held;
+}
+
+void can_tx_set_complete_hook(can_tx_complete_t hook)
+{
+	taskENTER_CRITICAL();
+	g_tx_hook = hook;
+	taskEXIT_CRITICAL();
+}
+
+void can_tx_get_stats(can_tx_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = g_tx_stats;
+	stats->queued = g_tx_count;
+	stats->in_flight = (uint32_t)__builtin_popcount(g_mb_busy);
+	taskEXIT_CRITICAL();
+}
+
+void can_tx_reset_stats(void)
+{
+	taskENTER_CRITICAL();
+	g_tx_stats.enqueued = 0;
+	g_tx_stats.completed = 0;
+	g_tx_stats.dropped = 0;
+	g_tx_stats.requeued = 0;
+	g_tx_stats.superseded = 0;
+	g_tx_stats.high_water = g_tx_count;
+	taskEXIT_CRITICAL();
+}
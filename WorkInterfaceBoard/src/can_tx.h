@@ -0,0 +1,80 @@
+#pragma once
+#include "sam4e.h"
+#include "can_sched.h"
+#include "can_producer.h"
+#include "can_urgent.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Interrupt-driven CAN transmit queue.
+ * Tasks enqueue frames without blocking; CAN0_Handler drains the queue into the
+ * TX mailboxes, lowest CAN ID (highest bus priority) first. Frames sharing an
+ * ID go out in enqueue order, one mailbox at a time; while one waits for its
+ * predecessor to leave, the next most urgent other ID takes the free mailbox
+ * instead of the whole queue waiting behind it. MB2..MB5 are shared:
+ * the time-triggered schedule takes the top of that range (see can_sched.h),
+ * remote-frame producers the ones below (can_producer.h), and the queue keeps
+ * the rest. The shipped tables leave it MB2..MB3 in either mode.
+ * Latest-value frames (can_tx_enqueue_latest()) are overwritten in place while
+ * they wait, and a mailbox still holding an older one is aborted, so a busy bus
+ * delays the newest sample by one frame at most instead of queueing stale ones.
+ */
+
+#define CAN_TX_MB_FIRST        (CAN_URGENT_MB + CAN_URGENT_MB_COUNT) // First mailbox used for transmission
+#define CAN_TX_MB_COUNT        (CAN_PRODUCER_MB_FIRST - CAN_TX_MB_FIRST) // Number of queue TX mailboxes
+#define CAN_TX_QUEUE_LEN       32u // Frames buffered ahead of the mailboxes
+
+/* Mask of the TX mailboxes in CAN_SR / CAN_IER / CAN_TCR bit layout */
+#define CAN_TX_MB_MASK         (((1u << CAN_TX_MB_COUNT) - 1u) << CAN_TX_MB_FIRST)
+
+typedef struct {
+	uint32_t id;    // Node 0 message ID, extension included (can_node.h)
+	union {
+		struct {
+			uint32_t datal; // Data bytes 0..3 (CAN_MDL layout, byte 0 in bits 7..0)
+			uint32_t datah; // Data bytes 4..7 (CAN_MDH layout)
+		};
+		uint8_t data[8]; // The same bytes in bus order (little-endian core)
+	};
+	uint32_t seq;   // Enqueue sequence, keeps FIFO order between equal IDs
+	uint64_t queued_at; // Enqueue time in bit times (can_time.h)
+	uint8_t len;    // DLC 0..8
+	bool latest;    // Latest-value frame: a newer one with the same ID replaces it
+} can_tx_frame_t;
+
+/* Called from CAN0_Handler when a queued frame has left its mailbox; sent_at
+ * is the capture time in bit times (can_time.h). Keep it short; it may queue
+ * follow-up frames with can_tx_enqueue_from_isr(). */
+typedef void (*can_tx_complete_t)(const can_tx_frame_t *frame, uint64_t sent_at);
+
+typedef struct {
+	uint32_t enqueued;   // Frames accepted into the queue
+	uint32_t completed;  // Frames confirmed sent by a TX mailbox
+	uint32_t dropped;    // Frames rejected because the queue was full
+	uint32_t requeued;   // Aborted transmissions put back in the queue
+	uint32_t superseded; // Latest-value frames replaced by a newer sample before they were sent
+	uint32_t queued;     // Frames currently waiting in the queue
+	uint32_t in_flight;  // Frames currently loaded into TX mailboxes
+	uint32_t high_water; // Maximum queue depth seen since the last reset
+} can_tx_stats_t;
+
+void can_tx_init(Can *p_can); // Configure TX mailboxes and empty the queue
+bool can_tx_enqueue(uint32_t id, const uint8_t *data, uint8_t len); // Queue a frame (task context, non-blocking)
+bool can_tx_enqueue_words(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len); // Queue pre-packed CAN_MDL/CAN_MDH words
+bool can_tx_enqueue_tagged(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len, uint32_t *seq); // As above, returns the frame's seq for the completion hook
+bool can_tx_enqueue_latest(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len); // Queue a sample that replaces any unsent frame with this ID
+bool can_tx_enqueue_from_isr(uint32_t id, uint32_t datal, uint32_t datah, uint8_t len); // Queue pre-packed words from CAN0_Handler or with the CAN interrupt masked
+void can_tx_hold(bool hold); // Stop loading mailboxes and abort loaded ones back into the queue, or resume (CAN interrupt masked)
+bool can_tx_held(void); // True while can_tx_hold() keeps the mailboxes empty
+void can_tx_set_complete_hook(can_tx_complete_t hook); // Install (or clear with NULL) the TX completion callback
+void can_tx_isr(uint32_t can_sr); // Service TX mailboxes, called from CAN0_Handler with a CAN_SR snapshot
+void can_tx_get_stats(can_tx_stats_t *stats); // Snapshot completion/drop counters
+void can_tx_reset_stats(void); // Clear the completion/drop counters
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,121 @@
+#include "can_urgent.h"
+#include "can_app.h"
+#include "can_stats.h"
+#include "can_time.h"
+#include "can_node.h"
+#include "asf.h"
+#include "can.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef void (*can_urgent_handler_t)(const can_rx_frame_t *frame, bool *woken);
+
+typedef struct {
+	uint32_t id;
+	can_urgent_handler_t handler;
+} can_urgent_entry_t;
+
+#define CAN_URGENT_GEN_ENTRY(handler, id) { (id), handler },
+static const can_urgent_entry_t g_urgent[] = {
+	CAN_URGENT_TABLE(CAN_URGENT_GEN_ENTRY)
+};
+#define CAN_URGENT_COUNT       (sizeof(g_urgent) / sizeof(g_urgent[0]))
+
+/* Mailbox filter: the bits on which every urgent ID agrees */
+#define CAN_URGENT_GEN_OR(handler, id)  | (uint32_t)(id)
+#define CAN_URGENT_GEN_AND(handler, id) & (uint32_t)(id)
+#define CAN_URGENT_ID_ANY      (0u CAN_URGENT_TABLE(CAN_URGENT_GEN_OR))
+#define CAN_URGENT_ID_ALL      (0x7FFu CAN_URGENT_TABLE(CAN_URGENT_GEN_AND))
+#define CAN_URGENT_ID_MASK     (CAN_NODE_MSG_MASK & ~(CAN_URGENT_ID_ANY ^ CAN_URGENT_ID_ALL)) // Extension 0 only
+
+static Can *g_urgent_can = NULL;
+static can_urgent_stats_t g_urgent_stats = {0};
+
+void can_urgent_init(Can *p_can)
+{
+	taskENTER_CRITICAL();
+	g_urgent_can = p_can;
+	g_urgent_stats.shadowed = 0;
+	for (uint32_t i = 0; i < CAN_URGENT_COUNT; i++) {
+		if (can_rx_accepts(g_urgent[i].id)) g_urgent_stats.shadowed++; // Lands in the RX FIFO instead
+	}
+
+	can_mb_conf_t rx;
+	rx.ul_mb_idx = CAN_URGENT_MB;
+	rx.uc_obj_type = CAN_MB_DISABLE_MODE;
+	can_mailbox_init(p_can, &rx);
+	rx.uc_obj_type = CAN_MB_RX_OVER_WR_MODE; // The newest command counts
+	rx.uc_tx_prio = 0;
+	rx.uc_id_ver = 0; // IDE bit comes with the MAM/MID values (can_node.h)
+	rx.ul_id_msk = can_node_mam(CAN_URGENT_ID_ALL, CAN_URGENT_ID_MASK);
+	rx.ul_id = can_node_mid(CAN_URGENT_ID_ALL);
+	can_mailbox_init(p_can, &rx);
+	can_mailbox_send_transfer_cmd(p_can, &rx); // Arm for reception
+	p_can->CAN_IER = (1u << CAN_URGENT_MB);
+	taskEXIT_CRITICAL();
+}
+
+void can_urgent_set_node(void)
+{
+	CanMb *p_mb = &g_urgent_can->CAN_MB[CAN_URGENT_MB];
+	uint32_t mmr = p_mb->CAN_MMR;
+	p_mb->CAN_MMR = mmr & ~CAN_MMR_MOT_Msk; // MAM/MID are written with the mailbox disabled
+	p_mb->CAN_MAM = can_node_mam(CAN_URGENT_ID_ALL, CAN_URGENT_ID_MASK);
+	p_mb->CAN_MID = can_node_mid(CAN_URGENT_ID_ALL);
+	p_mb->CAN_MMR = mmr;
+	p_mb->CAN_MCR = CAN_MCR_MTCR;
+}
+
+bool can_urgent_isr(uint32_t can_sr)
+{
+	if (!(can_sr & (1u << CAN_URGENT_MB)) || g_urgent_can == NULL) return false;
+
+	CanMb *p_mb = &g_urgent_can->CAN_MB[CAN_URGENT_MB];
+	uint32_t msr = p_mb->CAN_MSR; // Reading MSR clears MMI
+	if (msr & CAN_MSR_MMI) g_urgent_stats.mb_overrun++;
+
+	can_rx_frame_t frame;
+	frame.id = can_node_from_mid(p_mb->CAN_MID);
+	frame.len = (uint8_t)((msr & CAN_MSR_MDLC_Msk) >> CAN_MSR_MDLC_Pos);
+	if (frame.len > 8) frame.len = 8;
+	frame.datal = p_mb->CAN_MDL;
+	frame.datah = p_mb->CAN_MDH;
+	frame.timestamp = can_time_extend_from_isr(can_time_mailbox_stamp(msr));
+	p_mb->CAN_MCR = CAN_MCR_MTCR; // Copied out, free for the next urgent frame
+	can_stats_on_rx(frame.id, frame.len);
+
+	for (uint32_t i = 0; i < CAN_URGENT_COUNT; i++) {
+		if (g_urgent[i].id != frame.id) continue;
+
+		uint64_t now = can_time_now_from_isr();
+		uint32_t lat = (uint32_t)can_time_to_us((now > frame.timestamp) ? now - frame.timestamp : 0);
+		g_urgent_stats.lat_last_us = lat;
+		if (lat > g_urgent_stats.lat_max_us) g_urgent_stats.lat_max_us = lat;
+		g_urgent_stats.handled++;
+
+		bool woken = false;
+		g_urgent[i].handler(&frame, &woken);
+		return woken;
+	}
+	g_urgent_stats.stray++; // Passed the shared-bits mask, not in the table
+	return false;
+}
+
+void can_urgent_get_stats(can_urgent_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = g_urgent_stats;
+	taskEXIT_CRITICAL();
+}
+
+void can_urgent_reset_stats(void)
+{
+	taskENTER_CRITICAL();
+	g_urgent_stats.handled = 0;
+	g_urgent_stats.stray = 0;
+	g_urgent_stats.mb_overrun = 0;
+	g_urgent_stats.lat_last_us = 0;
+	g_urgent_stats.lat_max_us = 0;
+	taskEXIT_CRITICAL();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "can_rx.h"
+#include "conf_can_urgent.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Priority lane for urgent commands (see config/conf_can_urgent.h).
+ * One RX mailbox, filtered to the urgent IDs, is served first in CAN0_Handler
+ * and its frames go straight to their handler. The latency from the frame's
+ * capture (start of frame, so its own time on the wire is included) to the
+ * handler call is measured on every frame.
+ */
+
+#define CAN_URGENT_MB          1u // Below the TX queue; nothing else receives these IDs
+#define CAN_URGENT_MB_COUNT    1u
+
+/* Handler prototypes, one per table entry */
+#define CAN_URGENT_PROTOTYPE(handler, id) void handler(const can_rx_frame_t *frame, bool *woken);
+CAN_URGENT_TABLE(CAN_URGENT_PROTOTYPE)
+
+typedef struct {
+	uint32_t handled;    // Frames passed to a handler
+	uint32_t stray;      // Frames the mailbox mask let through without a handler
+	uint32_t mb_overrun; // Urgent frames overwritten in the mailbox before the ISR ran
+	uint32_t shadowed;   // Table IDs an RX filter takes first (set by can_urgent_init())
+	uint32_t lat_last_us; // Start of frame to handler call, last frame
+	uint32_t lat_max_us;  // The same, worst case since the last reset
+} can_urgent_stats_t;
+
+void can_urgent_init(Can *p_can); // Arm the urgent mailbox, after can_rx_init() so shadowed IDs can be counted
+void can_urgent_set_node(void); // Re-program the mailbox for a new node ID (CAN interrupt masked, ready frame drained)
+bool can_urgent_isr(uint32_t can_sr); // Run handlers for received urgent frames, called first in CAN0_Handler; true if a task was woken
+void can_urgent_get_stats(can_urgent_stats_t *stats); // Snapshot of counters and latency
+void can_urgent_reset_stats(void); // Clear counters and the latency peak
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+/* Bit timings for known clock/bitrate pairs, resolved at compile time through
+ * CAN_BITTIMING_CONST_BR(). Each row is what can_bittiming_solve() returns
+ * for that pair with the sample point from can_app.h; pairs not listed are
+ * solved at run time.
+ *     X(..., mck_hz, bitrate, brp, propag, phase1, phase2, sjw)
+ */
+#define CAN_BITTIMING_KNOWN(X, ...) \
+	X(__VA_ARGS__, 96000000u,  125000u, 48, 8, 5, 2, 2) /* 16 TQ, 87.5 % */ \
+	X(__VA_ARGS__, 96000000u,  250000u, 24, 8, 5, 2, 2) /* 16 TQ, 87.5 % */ \
+	X(__VA_ARGS__, 96000000u,  500000u, 12, 8, 5, 2, 2) /* 16 TQ, 87.5 % */ \
+	X(__VA_ARGS__, 96000000u, 1000000u,  6, 7, 4, 4, 4) /* 16 TQ, 75 % */
+
+/* Autobaud at start-up (can_autobaud.h). The controller listens without
+ * acknowledging or sending error frames at each bitrate below, in order,
+ * and goes active at the first one that receives CAN_AUTOBAUD_MIN_FRAMES
+ * frames with no error. A silent bus falls back to CAN_BAUD_KBPS. The
+ * configured bitrate is always tried first.
+ */
+#define CONF_CAN_AUTOBAUD         1
+#define CAN_AUTOBAUD_BITRATES     1000000u, 500000u, 250000u, 125000u
+#define CAN_AUTOBAUD_WINDOW_MS    50u // Listening time per candidate, several 10 ms frame periods
+#define CAN_AUTOBAUD_MIN_FRAMES   2u  // Clean frames needed to lock
+#define CAN_AUTOBAUD_ROUNDS       2u  // Passes over the list before giving up
@@ -0,0 +1,17 @@
+#pragma once
+
+/* CAN command registration table.
+ *
+ * Each entry maps an inclusive 11-bit ID range to a handler:
+ *     CAN_COMMAND(handler, first_id, last_id)
+ * Use the same ID twice for a single command. The table is expanded at compile
+ * time into a direct-indexed lookup (see can_dispatch.c), so dispatch cost does
+ * not depend on the number of entries. When ranges overlap, the later entry
+ * wins, so list broad ranges before the specific IDs they contain.
+ * Handlers have the signature void handler(const can_rx_frame_t *frame) and
+ * must not block for long: they run in can_rx_task.
+ */
+#define CAN_COMMAND_TABLE(CAN_COMMAND) \
+	CAN_COMMAND(can_cmd_pot, CAN_ID_POT_COMMAND, CAN_ID_POT_COMMAND) /* Digipot control */ \
+	CAN_COMMAND(can_cmd_diag_request, CAN_ID_DIAG_REQUEST, CAN_ID_DIAG_REQUEST) /* Diagnostic read-out */ \
+	CAN_COMMAND(can_cmd_claim, CAN_ID_CLAIM, CAN_ID_CLAIM | 0x7Fu) // Node ID claims from other boards (can_node.c)
@@ -0,0 +1,18 @@
+#pragma once
+#include "conf_fw_update.h"
+
+/* ISO-TP (ISO 15765-2) channels, see can_isotp.h.
+ *
+ *     CAN_ISOTP(name, tx_id, rx_id, tx_size, rx_size, block_size, st_min)
+ * tx_id carries this node's frames (data and its flow control), rx_id the
+ * peer's. Buffers are static, sizes in bytes, at most 4095.
+ * block_size and st_min are what this node grants a sender, tuned for
+ * throughput: BS 0 = the whole message after one flow control frame, STmin 0 =
+ * back-to-back frames (raw ISO value: 1..127 ms, 0xF1..0xF9 = 100..900 us;
+ * sub-millisecond values are paced to the RTOS tick on this side).
+ * rx_id must pass the RX filter (can_rx.c) and is consumed in CAN0_Handler,
+ * so it never reaches conf_can_commands.h.
+ */
+#define CAN_ISOTP_TABLE(CAN_ISOTP) \
+	CAN_ISOTP(bulk, CAN_ID_ISOTP_TX, CAN_ID_ISOTP_RX, 1024, 1024, 0, 0) /* Capture buffers, config blocks, dumps */ \
+	CAN_ISOTP(fwu, CAN_ID_FWU_TX, CAN_ID_FWU_RX, FW_UPDATE_REPLY_MAX, FW_UPDATE_MSG_MAX, 0, 0) /* Firmware update requests (fw_update.h) */
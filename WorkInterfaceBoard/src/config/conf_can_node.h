@@ -0,0 +1,38 @@
+#pragma once
+
+/* Node ID assignment and identifier format (can_node.h).
+ *
+ * With CONF_CAN_NODE_CLAIM set, each board claims CONF_CAN_NODE_ID on the bus
+ * at start-up (CAN_ID_CLAIM) under a name from its chip unique ID; a board
+ * that loses a claim moves to the next free node ID and reconfigures its
+ * mailboxes. A board alone on the bus, and the first of several, keeps node
+ * 0. With it clear the board always uses CONF_CAN_NODE_ID and sends no claims.
+ *
+ * CONF_CAN_EXTENDED_ID selects how the node ID reaches the bus:
+ *   0: 11-bit IDs. The node ID goes into the low four bits of every ID in
+ *      0x100..0x2FF (can_app.h), so up to 16 boards share a bus.
+ *   1: 29-bit IDs, every frame extended:
+ *          28..26  priority      top three bits of the can_app.h ID
+ *          25..18  message type  low eight bits of the can_app.h ID
+ *          17..8   extension     0 for the can_app.h IDs, 1..1023 for
+ *                                message IDs only 29-bit frames carry
+ *           7..0   node address  node ID for IDs in 0x100..0x2FF, 0 for shared ones
+ *      Priority and type together are the can_app.h ID, so arbitration keeps
+ *      its order, an ID's extensions following it; up to 256 boards, and the
+ *      RX mailboxes compare the node address so other boards' traffic never
+ *      reaches the CPU.
+ * The bootloader (boot/fw_boot.c) always answers on the node 0 firmware update
+ * IDs in 11-bit format; update one board at a time.
+ *
+ * Node IDs needed the per-board IDs moved off the low four bits, so even node
+ * 0 differs from earlier firmware (0x121 -> 0x140, 0x122 -> 0x150, 0x123 ->
+ * 0x160, 0x201 -> 0x210, 0x202 -> 0x280, 0x221 -> 0x230, 0x241 -> 0x250,
+ * 0x242 -> 0x260, 0x243 -> 0x270; 0x010, 0x120, 0x130, 0x200, 0x220 and 0x240
+ * stay). CONF_CAN_LEGACY_IDS builds the earlier IDs for host tools that still
+ * expect them: one board per bus, node 0, no claims, 11-bit only.
+ */
+
+#define CONF_CAN_NODE_CLAIM           1
+#define CONF_CAN_NODE_ID              0 // Fixed node ID when claiming is off
+#define CONF_CAN_EXTENDED_ID          0
+#define CONF_CAN_LEGACY_IDS           0 // 1: earlier single-board IDs, needs the two above clear
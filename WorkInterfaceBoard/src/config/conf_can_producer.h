@@ -0,0 +1,29 @@
+#pragma once
+
+/* Remote-frame producers (can_producer.h).
+ *
+ *     CAN_PRODUCER(msg)
+ * msg is a message name from conf_can_signals.h. It gets a mailbox in producer
+ * mode holding its latest value; a remote frame (RTR) with its ID is answered
+ * by the controller straight from that mailbox, without an interrupt in
+ * between. The firmware only rewrites the mailbox when the value changes:
+ * at once when the mailbox is not armed (after a reply), otherwise by an
+ * abort and a reload in CAN0_Handler, at most once per
+ * CONF_CAN_PRODUCER_REFRESH_MS. A reply is that much older than the latest
+ * sample at worst, and a value that changes every sample costs one abort
+ * and one interrupt per period instead of one per sample.
+ *
+ * Each producer takes a TX mailbox from the top of the event queue range, one
+ * must stay with the queue. Producers need CONF_CAN_TIME_TRIGGERED off
+ * (conf_can_sched.h): in time-triggered mode the controller holds every
+ * transmit request, replies included, until the mailbox timemark.
+ * The ID must not pass an RX filter (can_rx.h): the lowest matching mailbox
+ * takes a frame, and the RX FIFO starts at MB0. status (0x200) is inside the
+ * default 0x200..0x2FF RX block, so binding it needs narrower filters.
+ */
+
+#define CONF_CAN_PRODUCER_REFRESH_MS 10 // Shortest time between aborts of an armed mailbox
+
+#define CAN_PRODUCER_TABLE(CAN_PRODUCER) \
+	CAN_PRODUCER(encoder1) \
+	CAN_PRODUCER(loadcell)
@@ -0,0 +1,31 @@
+#pragma once
+
+/* Change-driven publishing (can_publish.h).
+ *
+ *     CAN_PUBLISH(msg, inhibit_ms, heartbeat_ms, mode, DEADBANDS)
+ * msg is a message name from conf_can_signals.h. Its producer offers every
+ * sample with can_publish(); a frame goes out when a signal has moved by more
+ * than its deadband since the last frame sent, but never sooner than
+ * inhibit_ms after it. With nothing moving the last value is repeated every
+ * heartbeat_ms (0 = never). Producers must offer samples at least that often.
+ * mode is how an unsent frame waits in the TX queue: FIFO keeps every frame,
+ * LATEST overwrites it with the next one (can_tx_enqueue_latest()), for
+ * signals where only the current value matters. Scheduled messages always
+ * keep just the newest sample.
+ *
+ *     DB(..., signal, deadband)
+ * DEADBANDS lists per-signal deadbands in raw units. Signals not listed
+ * count as changed on any difference.
+ * Messages in conf_can_sched.h go out at their next timemark, so their
+ * schedule period is the added latency; others go through the TX queue.
+ */
+
+#define CAN_DEADBANDS_NONE(DB, ...)
+
+#define CAN_DEADBANDS_ENCODER1(DB, ...) \
+	DB(__VA_ARGS__, position, 4)   /* counts */ \
+	DB(__VA_ARGS__, velocity, 5000) /* counts/s x1000, low speeds still go out */
+
+#define CAN_PUBLISH_TABLE(CAN_PUBLISH) \
+	CAN_PUBLISH(encoder1, 10,  500, LATEST, CAN_DEADBANDS_ENCODER1) \
+	CAN_PUBLISH(loadcell, 20, 1000, FIFO,   CAN_DEADBANDS_NONE)
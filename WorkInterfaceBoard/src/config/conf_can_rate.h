@@ -0,0 +1,22 @@
+#pragma once
+
+/* Bus-load-adaptive telemetry rates (can_rate.h).
+ *
+ * With CONF_CAN_RATE_ADAPTIVE set, can_status_task re-plans once per load
+ * window: the load of other nodes is estimated from the traffic this node sees
+ * and from how often its own frames find the bus busy, and the room left under
+ * CONF_CAN_RATE_TARGET_PERMILLE is shared out by priority.
+ *
+ *     CAN_RATE(msg, min_ms, max_ms, priority)
+ * msg must be in conf_can_publish.h; its inhibit time is set between min_ms
+ * (fastest) and max_ms (slowest, kept even on an overloaded bus). Priority 0
+ * goes as fast as it can before priority 1 gets anything. Heartbeats and
+ * deadbands are unchanged, so a still signal sends less than its period.
+ */
+
+#define CONF_CAN_RATE_ADAPTIVE        1
+#define CONF_CAN_RATE_TARGET_PERMILLE 600 // Bus utilisation the plan stays under
+
+#define CAN_RATE_TABLE(CAN_RATE) \
+	CAN_RATE(encoder1, 10,  200, 0) \
+	CAN_RATE(loadcell, 20, 1000, 1)
@@ -0,0 +1,17 @@
+#pragma once
+#include "conf_can_sched.h"
+
+/* Receive FIFO depth of the default RX filters (can_rx.c): node ID claims,
+ * then this node's 0x200..0x2FF command/status block. Together they must fit
+ * the RX mailboxes of CAN_RX_MB_MASK (can_rx.h), or the build stops.
+ * A chain of n mailboxes loses nothing while CAN0_Handler gets to it within n
+ * frames: at 500 kbit/s the shortest frame takes 94 us, so one mailbox needs
+ * the handler within 94 us of the frame, two within 188 us.
+ */
+
+#define CONF_CAN_RX_CLAIM_DEPTH   1 // Claims are rare; a burst only needs the latest
+#if CONF_CAN_TIME_TRIGGERED
+#define CONF_CAN_RX_BLOCK_DEPTH   1 // MB7 is left out in time-triggered mode
+#else
+#define CONF_CAN_RX_BLOCK_DEPTH   2
+#endif
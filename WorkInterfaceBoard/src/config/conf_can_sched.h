@@ -0,0 +1,31 @@
+#pragma once
+
+/* Time-triggered CAN transmit schedule.
+ *
+ * With CONF_CAN_TIME_TRIGGERED set the controller runs in time-triggered mode
+ * (CAN_MR.TTM): each scheduled message owns a TX mailbox at the top of MB2..MB5
+ * and is sent when the free-running CAN timer reaches its timemark, so the
+ * send instant does not depend on task timing. The remaining TX mailboxes keep
+ * serving the event queue (can_tx.c). MB7 is left out of the RX FIFO because
+ * in this mode a frame received in the last mailbox resets the CAN timer.
+ *
+ *     CAN_SCHED(msg, period_ms, phase_ms)
+ * msg is a message name from conf_can_signals.h. The period must fit in one
+ * CAN timer wrap (65536 bit times: 131 ms at 500 kbit/s, 65 ms at 1 Mbit/s);
+ * can_sched.c stops the build if one does not at CAN_BAUD_KBPS. A faster bus
+ * found by autobaud can still make the plan fail at run time; the schedule
+ * then stays off and can_sched_stats_t.unplanned says so.
+ * phase_ms is the earliest offset wanted; can_sched_plan() moves it later if
+ * the frame would overlap another scheduled frame.
+ *
+ * Off by default. Turning it on costs the event queue: every queued frame
+ * waits for an "as soon as possible" timemark, and one that loses
+ * arbitration past it is aborted and requeued. Remote-frame producers
+ * (conf_can_producer.h) are compiled out and the RX FIFO loses MB7.
+ */
+
+#define CONF_CAN_TIME_TRIGGERED   0 // 1: opt in
+
+#define CAN_SCHED_TABLE(CAN_SCHED) \
+	CAN_SCHED(encoder1,  10, 0) /* Posted on change (conf_can_publish.h): the latency bound */ \
+	CAN_SCHED(loadcell, 100, 2)
@@ -0,0 +1,55 @@
+#pragma once
+
+/* CAN signal description (DBC-style), the single source of frame layouts.
+ *
+ * Messages:
+ *     CAN_MESSAGE(name, id, dlc, period_ms, signals)
+ * Signals (bit offsets are little-endian, bit 0 = byte 0 bit 0, up to 32 bits):
+ *     SIG(msg, name, start_bit, length, c_type, scale, offset, unit)
+ * A signed c_type makes the signal two's complement and sign-extended on unpack.
+ * Physical value = raw * scale + offset (used by the host-side decoder).
+ *
+ * can_signals.h expands this file into per-message structs and
+ * can_pack_<name>() / can_unpack_<name>() functions that work on the
+ * CAN_MDL/CAN_MDH words directly; can_signals.c expands it into a descriptor
+ * table for host decoding tools.
+ */
+
+#define CAN_SIGNALS_LOADCELL(SIG, ...) \
+	SIG(__VA_ARGS__, raw_msb,   0,  8, uint32_t, 1.0, 0.0, "")       /* Raw sample, high byte first on the wire */ \
+	SIG(__VA_ARGS__, raw_lsb,   8,  8, uint32_t, 1.0, 0.0, "")
+
+#define CAN_SIGNALS_ENCODER1(SIG, ...) \
+	SIG(__VA_ARGS__, position,  0, 32, int32_t,  1.0, 0.0, "counts") \
+	SIG(__VA_ARGS__, velocity, 32, 32, int32_t,  0.001, 0.0, "counts/s")
+
+#define CAN_SIGNALS_STATUS(SIG, ...) \
+	SIG(__VA_ARGS__, can_ok,    0,  8, uint32_t, 1.0, 0.0, "")       /* 1 = controller healthy */ \
+	SIG(__VA_ARGS__, err_state, 8,  8, uint32_t, 1.0, 0.0, "")       /* can_err_state_t */
+
+#define CAN_SIGNALS_DIAG(SIG, ...) \
+	SIG(__VA_ARGS__, seen_load, 0, 16, uint32_t, 0.1, 0.0, "%")      /* Own TX + accepted RX, last window: a lower bound */ \
+	SIG(__VA_ARGS__, tec,      16,  8, uint32_t, 1.0, 0.0, "")       /* Error counters now */ \
+	SIG(__VA_ARGS__, rec,      24,  8, uint32_t, 1.0, 0.0, "") \
+	SIG(__VA_ARGS__, tec_max,  32,  8, uint32_t, 1.0, 0.0, "")       /* Error counter peaks, history window */ \
+	SIG(__VA_ARGS__, rec_max,  40,  8, uint32_t, 1.0, 0.0, "") \
+	SIG(__VA_ARGS__, lat_max,  48, 16, uint32_t, 1.0, 0.0, "us")     /* Longest enqueue-to-wire latency */
+
+#define CAN_SIGNALS_DIAG_ID(SIG, ...) \
+	SIG(__VA_ARGS__, can_id,    0, 16, uint32_t, 1.0, 0.0, "") \
+	SIG(__VA_ARGS__, tx,       16, 24, uint32_t, 1.0, 0.0, "frames") /* Counters wrap at 2^24 */ \
+	SIG(__VA_ARGS__, rx,       40, 24, uint32_t, 1.0, 0.0, "frames")
+
+#define CAN_SIGNALS_CLAIM(SIG, ...) \
+	SIG(__VA_ARGS__, node,      0,  8, uint32_t, 1.0, 0.0, "")       /* Node ID claimed (can_node.h) */ \
+	SIG(__VA_ARGS__, held,      8,  8, uint32_t, 1.0, 0.0, "")       /* 1 = sender already holds it */ \
+	SIG(__VA_ARGS__, name_lo,  16, 32, uint32_t, 1.0, 0.0, "")       /* 48-bit name from the chip unique ID */ \
+	SIG(__VA_ARGS__, name_hi,  48, 16, uint32_t, 1.0, 0.0, "")
+
+#define CAN_MESSAGE_TABLE(CAN_MESSAGE) \
+	CAN_MESSAGE(loadcell, CAN_ID_LOADCELL, 2,   100, CAN_SIGNALS_LOADCELL) \
+	CAN_MESSAGE(encoder1, CAN_ID_ENCODER1, 8,    50, CAN_SIGNALS_ENCODER1) \
+	CAN_MESSAGE(status,   CAN_ID_STATUS,   2, 10000, CAN_SIGNALS_STATUS) \
+	CAN_MESSAGE(diag,     CAN_ID_DIAG,     8,  1000, CAN_SIGNALS_DIAG) \
+	CAN_MESSAGE(diag_id,  CAN_ID_DIAG_ID,  8,     0, CAN_SIGNALS_DIAG_ID) /* On request only */ \
+	CAN_MESSAGE(claim,    CAN_ID_CLAIM,    8,     0, CAN_SIGNALS_CLAIM) /* At start-up and when challenged */
@@ -0,0 +1,20 @@
+#pragma once
+
+/* Urgent CAN commands (can_urgent.h).
+ *
+ *     CAN_URGENT(handler, id)
+ * Frames with these IDs are received in a mailbox of their own and the handler
+ * runs inside CAN0_Handler, ahead of the RX FIFO, so routine traffic and task
+ * scheduling add nothing to the reaction time. Handlers have the signature
+ * void handler(const can_rx_frame_t *frame, bool *woken); keep them to a few
+ * microseconds, use only FreeRTOS ...FromISR calls and set *woken if one woke
+ * a task.
+ * The mailbox filter covers the bits all listed IDs share, so keep the IDs
+ * close together (0x010..0x013, not 0x010 and 0x400); other IDs it lets
+ * through are dropped and counted. IDs must lie outside the RX filters
+ * (can_rx.h), which sit in lower mailboxes and would take the frame first.
+ * They are not offset by the node ID (can_node.h): a stop reaches every board.
+ */
+
+#define CAN_URGENT_TABLE(CAN_URGENT) \
+	CAN_URGENT(can_cmd_stop, CAN_ID_STOP) /* Stop/release, latched */
@@ -0,0 +1,62 @@
+#pragma once
+
+/* Encoder sampling (encoder.h, encoder_ring.h).
+ *
+ * TC0 channel 2 runs as a periodic timer at CONF_ENCODER_SAMPLE_HZ; its RC
+ * compare interrupt latches the channel 0 quadrature count and the DWT cycle
+ * counter into a ring that encoder1_task drains in batches. Sample instants
+ * come from the timer, not from task scheduling.
+ * The same timer is the QDE speed time base: every sample carries the counts
+ * of the period before it, from which TC2_Handler keeps the position.
+ * The handler makes no FreeRTOS calls, so it sits above the kernel's
+ * interrupt priorities and critical sections do not delay it.
+ */
+
+#define CONF_ENCODER_SAMPLE_HZ        1000u // 1000..10000
+#define CONF_ENCODER_SAMPLE_IRQ_PRIO  (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY - 1) // NVIC priority, above CAN0 and the kernel
+#define CONF_ENCODER_PUBLISH_MS       10u   // encoder1_task batch period, also the CAN publish sample period
+
+/* Velocity (encoder_velocity.h): counts over the time between their edges,
+ * over at least the window, so slow speeds resolve to fractions of a count/s.
+ * Edges come from the sample that saw them (QDE) or the edge interrupt
+ * (software decoder). No edge for the stop time reads as standing still;
+ * 0.1 counts/s needs at least 10 s, the 32-bit DWT stamps allow up to 17 s
+ * at 120 MHz.
+ */
+#define CONF_ENCODER_VELOCITY_WINDOW_MS  10u    // Shortest M/T window
+#define CONF_ENCODER_VELOCITY_STOP_MS    15000u // No edge this long: velocity 0
+
+/* Encoder1 position is 64 bits (encoder1_read_position64()); CAN, the ring
+ * and encoder_data_t carry its low 32 bits. The QDE index input is TIOB1,
+ * PA16, which the pin map gives to ENC2's B line, so index tracking needs
+ * CONF_ENCODER2_CROSSCHECK (or ENC2 rewired) and ships off: with ENC2 on the
+ * pin, its B line would read as index pulses. TC0_Handler then counts
+ * revolutions on channel 1 and checks the distance between index pulses.
+ */
+#define CONF_ENCODER1_INDEX              0      // 1: index pulses on PA16/TIOB1, ENC2 off the pin
+#define CONF_ENCODER1_COUNTS_PER_REV     0      // Edges per revolution (4 x lines), 0: learn from the first revolution
+#define CONF_ENCODER1_INDEX_TOLERANCE    2      // Counts an index pulse may be off (read in the handler, not latched)
+#define CONF_ENCODER_INDEX_IRQ_PRIO      (CONF_ENCODER_SAMPLE_IRQ_PRIO + 1) // TC0 (QDE events), below the sampler, at the kernel's max syscall level
+
+/* Encoder instances (encoder.h). The chip has one TC block and its QDE takes
+ * TC0 channels 0-1, so only ENC1 decodes in hardware; ENC2 (PA15/PA16, enable
+ * PD27) is decoded in software from PIO edge interrupts (encoder_quad.h).
+ * With CONF_ENCODER2_CROSSCHECK the software decoder listens to ENC1's pins
+ * instead, alongside the QDE, and encoder1_task reports the difference.
+ */
+
+#define CONF_ENCODER2_CROSSCHECK      0     // 1: decode PA0/PA1 in software next to the QDE
+#define CONF_ENCODER_EDGE_IRQ_PRIO    (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY - 2) // PIO edge interrupt, above the sampler
+
+// name, decoder, input PIO, PIO ID, A, B, enable PIO (active low, NULL: none), enable pin
+#if CONF_ENCODER2_CROSSCHECK
+#define CONF_ENCODER2_ROW(ENC) \
+	ENC(encoder2, SOFT, PIOA, ID_PIOA, PIO_PA0,  PIO_PA1,  NULL, 0) /* ENC1's lines, its enable stays with encoder1 */
+#else
+#define CONF_ENCODER2_ROW(ENC) \
+	ENC(encoder2, SOFT, PIOA, ID_PIOA, PIO_PA15, PIO_PA16, PIOD, PIO_PD27)
+#endif
+
+#define CONF_ENCODER_TABLE(ENC) \
+	ENC(encoder1, QDE,  PIOA, ID_PIOA, PIO_PA0,  PIO_PA1,  PIOD, PIO_PD17) \
+	CONF_ENCODER2_ROW(ENC)
@@ -0,0 +1,28 @@
+#pragma once
+
+/* Flash map for field updates over CAN (fw_image.h, fw_update.h, boot/fw_boot.c).
+ *
+ *     0x00400000  boot      16 KB  CAN bootloader (small sectors 0 and 1)
+ *     0x00403C00  records    1 KB  two boot record pages, written alternately
+ *     0x00404000  app      248 KB  running application (flash.ld rom origin)
+ *     0x00442000  staging  248 KB  image received by the updater
+ *
+ * The record pages sit in a small sector so each can be rewritten alone with
+ * EWP. The app and staging slots are erased 8 pages (4 KB) per EPA command,
+ * the smallest group outside the small sectors, so each erase keeps the
+ * interrupts masked as briefly as the EFC allows (fw_flash_efc.c).
+ */
+#define FW_FLASH_BASE          0x00400000u
+#define FW_PAGE_SIZE           512u       // EFC write unit
+#define FW_ERASE_SIZE          4096u      // EPA 8 pages, the erase unit outside the small sectors
+
+#define FW_BOOT_ADDR           FW_FLASH_BASE
+#define FW_RECORD_ADDR_A       0x00403C00u
+#define FW_RECORD_ADDR_B       0x00403E00u
+#define FW_APP_ADDR            0x00404000u
+#define FW_STAGING_ADDR        0x00442000u
+#define FW_SLOT_SIZE           0x0003E000u // App and staging slots alike
+
+#define FW_UPDATE_BLOCK        2048u      // Image bytes per DATA request, four pages
+#define FW_UPDATE_MSG_MAX      (5u + FW_UPDATE_BLOCK) // DATA: command, offset, block
+#define FW_UPDATE_REPLY_MAX    8u         // Longest reply
@@ -8,11 +8,14 @@
  * - PA0/TIOA0: Encoder A input
  * - PA1/TIOB0: Encoder B input  
  * - PD17: Enable pin (active low)
+ * - TC0 channel 2: periodic sampling of the channel 0 count (TC2_Handler)
  */
 
 #include "encoder.h"
 #include "asf.h"
 #include "can_app.h"
+#include "can_signals.h"
+#include "can_publish.h"
 #include "FreeRTOS.h"
 #include "task.h"
 
@@ -28,10 +31,39 @@ typedef portTickType TickType_t; // Backward-compatible alias if TickType_t isn'
 #define portTICK_PERIOD_MS portTICK_RATE_MS // Legacy macro mapping
 #endif
 
-// Global encoder data
-static encoder_data_t g_encoder1_data = {0};
-static int32_t g_last_position = 0;
-static bool g_encoder_initialized = false;
+// Encoder instances, one per config/conf_encoder.h row
+#define ENCODER_GEN_CONFIG(name, dec, in_pio, in_id, a, b, en_pio, en_pin) \
+    { .decoder = ENCODER_DECODER_##dec, .pio = in_pio, .pio_id = in_id, .pin_a = a, .pin_b = b, \
+      .enable_pio = en_pio, .enable_pin = en_pin },
+static const encoder_config_t g_encoder_configs[ENCODER_COUNT] = {
+    CONF_ENCODER_TABLE(ENCODER_GEN_CONFIG)
+};
+#define ENCODER_GEN_INSTANCE(name, dec, in_pio, in_id, a, b, en_pio, en_pin) \
+    { .config = &g_encoder_configs[ENCODER_ID(name)] },
+static encoder_t g_encoders[ENCODER_COUNT] = {
+    CONF_ENCODER_TABLE(ENCODER_GEN_INSTANCE)
+};
+
+// The QDE exists once, so everything TC-related below stays encoder1-only
+static encoder_t *const g_encoder1 = &g_encoders[ENCODER_ID(encoder1)];
+
+// Timer-driven samples, filled by TC2_Handler and drained by encoder1_task
+static encoder_ring_t g_encoder1_ring;
+static volatile uint32_t g_encoder1_sample_hz = 0;
+
+// 64-bit position from TC_RA0/TC_CV0 (TC2_Handler, folds with interrupts
+// masked) and index pulses (TC0_Handler): revolutions from the QDE rotation
+// counter on channel 1 and the position at each pulse, checked against one
+// revolution. Each handler bumps its own sequence counter
+static encoder_position_t g_encoder1_pos;
+static volatile uint32_t g_encoder1_qde_errors = 0;
+
+#define ENCODER1_SAMPLE_TC     (TC0->TC_CHANNEL[ENCODER1_SAMPLE_TC_CHANNEL])
+#define ENCODER1_SAMPLE_BATCH  ((CONF_ENCODER_PUBLISH_MS * ENCODER_SAMPLE_HZ_MAX) / 1000u * 2u) // Two publish periods at the top rate
+
+typedef char encoder_sample_rate_in_range[(CONF_ENCODER_SAMPLE_HZ >= ENCODER_SAMPLE_HZ_MIN && CONF_ENCODER_SAMPLE_HZ <= ENCODER_SAMPLE_HZ_MAX) ? 1 : -1]; // Compile-time config check
+typedef char encoder_ring_holds_batch[(ENCODER1_SAMPLE_BATCH <= ENCODER_RING_LEN) ? 1 : -1];
+typedef char encoder1_index_pin_free[(!CONF_ENCODER1_INDEX || CONF_ENCODER2_CROSSCHECK) ? 1 : -1]; // TIOB1 is ENC2's B line
 
 // FreeRTOS task handle
 //static TaskHandle_t encoder1_task_handle = NULL;
@@ -40,43 +72,73 @@ static bool g_encoder_initialized = false;
 static void encoder1_configure_pins(void);
 static void encoder1_configure_tc(void);
 static void encoder1_configure_qde(void);
+static void encoder1_clear_count(void);
+static void encoder1_fold_count(void);
+static void encoder_soft_configure(encoder_t *enc);
 
-bool encoder1_init(void)
+encoder_t *encoder_get(uint32_t id)
 {
-    if (g_encoder_initialized) {
+    if (id >= ENCODER_COUNT) {
+        return NULL;
+    }
+    return &g_encoders[id];
+}
+
+bool encoder_init(encoder_t *enc)
+{
+    if (enc->initialized) {
         return true; // Already initialized
     }
+    const encoder_config_t *cfg = enc->config;
     
-    // Configure pins
-    encoder1_configure_pins();
-    
-    // Configure Timer Counter
-    encoder1_configure_tc();
+    // Edge and sample times come from the DWT cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    encoder_velocity_init(&enc->velocity, sysclk_get_cpu_hz(), CONF_ENCODER_VELOCITY_WINDOW_MS * 1000u,
+                          CONF_ENCODER_VELOCITY_STOP_MS);
     
-    // Configure Quadrature Decoder
-    encoder1_configure_qde();
-    
-    // Initialize enable pin (PD17) as output, initially disabled (high)
-    pio_configure(PIOD, PIO_OUTPUT_0, PIO_PD17, 0);
-    pio_set(PIOD, PIO_PD17); // Set high (disabled)
+    if (cfg->decoder == ENCODER_DECODER_QDE) {
+        encoder_position_init(&g_encoder1_pos, CONF_ENCODER1_COUNTS_PER_REV, CONF_ENCODER1_INDEX_TOLERANCE);
+        
+        // Configure pins
+        encoder1_configure_pins();
+        
+        // Configure Timer Counter
+        encoder1_configure_tc();
+        
+        // Configure Quadrature Decoder
+        encoder1_configure_qde();
+    } else {
+        encoder_soft_configure(enc);
+    }
     
-    // Debug: Check enable pin configuration
-    volatile bool debug_enable_pin_configured = (PIOD->PIO_OSR & PIO_PD17) != 0;
-    volatile bool debug_enable_pin_state = (PIOD->PIO_PDSR & PIO_PD17) != 0;
-    (void)debug_enable_pin_configured; (void)debug_enable_pin_state;
+    // Initialize enable pin as output, initially disabled (high)
+    if (cfg->enable_pio != NULL) {
+        pio_configure(cfg->enable_pio, PIO_OUTPUT_0, cfg->enable_pin, 0);
+        pio_set(cfg->enable_pio, cfg->enable_pin); // Set high (disabled)
+        
+        // Debug: Check enable pin configuration
+        volatile bool debug_enable_pin_configured = (cfg->enable_pio->PIO_OSR & cfg->enable_pin) != 0;
+        volatile bool debug_enable_pin_state = (cfg->enable_pio->PIO_PDSR & cfg->enable_pin) != 0;
+        (void)debug_enable_pin_configured; (void)debug_enable_pin_state;
+    }
     
     // Initialize encoder data
-    g_encoder1_data.position = 0;
-    g_encoder1_data.velocity = 0;
-    g_encoder1_data.enabled = false;
-    g_encoder1_data.valid = true;
-    g_last_position = 0;
+    enc->data.position = 0;
+    enc->data.velocity = 0;
+    enc->data.enabled = false;
+    enc->data.valid = true;
     
-    g_encoder_initialized = true;
+    enc->initialized = true;
     
     return true;
 }
 
+bool encoder1_init(void)
+{
+    return encoder_init(g_encoder1);
+}
+
 static void encoder1_configure_pins(void)
 {
     // Enable PIOA clock for TIOA0 and TIOB0 pins
@@ -88,6 +150,12 @@ static void encoder1_configure_pins(void)
     // Configure PA1 as TIOB0 (peripheral A)  
     pio_configure(PIOA, PIO_PERIPH_A, PIO_PA1, 0);
     
+#if CONF_ENCODER1_INDEX
+    // Configure PA16 as TIOB1 (peripheral B), the index input of the QDE
+    pio_configure(PIOA, PIO_PERIPH_B, PIO_PA16B_TIOB1, 0);
+    pmc_enable_periph_clk(ID_TC1);
+#endif
+    
     // Enable PIOA peripheral clock for Timer Counter 0
     pmc_enable_periph_clk(ID_TC0);
     
@@ -107,13 +175,16 @@ static void encoder1_configure_tc(void)
     // Configure TC0 Channel 0 for quadrature decoder mode
     // According to SAM4E datasheet section 38.6.16.1, for QDE mode:
     // - Use internal clock source (the QDE module handles encoder inputs separately)
-    // - Enable waveform mode
-    // - Set up for quadrature decoding
+    // - Capture mode, as the speed measurement requires (section 38.6.16.4)
     // Note: When QDE is enabled, TIOA0 and TIOB0 are used as encoder inputs, not clock sources
     // The TC channel needs an internal clock to function properly
+    // With SPEEDEN the channel 2 time base (TIOA2) is fed back as TIOA0: each
+    // rising edge loads the count into TC_RA0 and clears the counter. Until the
+    // sampler starts channel 2 there are no edges and TC_CV is the position
     TC0->TC_CHANNEL[0].TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK1 |  // Internal clock (QDE handles encoder inputs)
-                                 TC_CMR_WAVE |                  // Enable waveform mode
-                                 TC_CMR_WAVSEL_UP;              // UP mode for QDE
+                                 TC_CMR_ABETRG |                // TIOA (time base) is the trigger
+                                 TC_CMR_ETRGEDG_RISING |        // Clear the count on its rising edge
+                                 TC_CMR_LDRA_RISING;            // ...loading the count into RA
     
     // Enable the timer counter
     TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_CLKEN;
@@ -121,6 +192,12 @@ static void encoder1_configure_tc(void)
     // Wait for enable to take effect
     while (!(TC0->TC_CHANNEL[0].TC_SR & TC_SR_CLKSTA));
     
+#if CONF_ENCODER1_INDEX
+    // Channel 1 is the QDE rotation counter: index pulses, up or down
+    TC0->TC_CHANNEL[1].TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK1;
+    TC0->TC_CHANNEL[1].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+#endif
+    
     // Debug: Store configuration values
     volatile uint32_t debug_tc_cmr = TC0->TC_CHANNEL[0].TC_CMR;
     volatile uint32_t debug_tc_sr = TC0->TC_CHANNEL[0].TC_SR;
@@ -138,14 +215,20 @@ static void encoder1_configure_qde(void)
                   TC_BMR_FILTER |         // Enable input filter
                   TC_BMR_MAXFILT(0x3F);   // Set maximum filter value (63)
     
-    // Configure QDE interrupt enable (optional)
+    // Configure QDE interrupt enable, handled in TC0_Handler; direction
+    // changes stay off, an encoder resting on an edge would flood it
+    TC0->TC_QIDR = TC_QIDR_DIRCHG;
     TC0->TC_QIER = TC_QIER_IDX |          // Enable index interrupt
-                   TC_QIER_DIRCHG |       // Enable direction change interrupt
                    TC_QIER_QERR;          // Enable quadrature error interrupt
     
     // Reset the position counter to zero
     TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_SWTRG;
     
+    (void)TC0->TC_QISR; // Clear stale status
+    NVIC_ClearPendingIRQ(TC0_IRQn);
+    NVIC_SetPriority(TC0_IRQn, CONF_ENCODER_INDEX_IRQ_PRIO);
+    NVIC_EnableIRQ(TC0_IRQn);
+    
     // Debug: Store QDE configuration values
     volatile uint32_t debug_tc_bmr = TC0->TC_BMR;
     volatile uint32_t debug_tc_qier = TC0->TC_QIER;
@@ -153,131 +236,255 @@ static void encoder1_configure_qde(void)
     (void)debug_tc_bmr; (void)debug_tc_qier; (void)debug_tc_sr_after_reset;
 }
 
-bool encoder1_enable(bool enable)
+// Zero the count of either decoder
+static void encoder_clear_count(encoder_t *enc)
+{
+    if (enc->config->decoder == ENCODER_DECODER_QDE) {
+        encoder1_clear_count();
+    } else {
+        enc->quad.count = 0; // Aligned word store, the edge handler sees old or new
+    }
+    encoder_velocity_reset(&enc->velocity); // The jump to zero is no movement
+}
+
+bool encoder_enable(encoder_t *enc, bool enable)
 {
-    if (!g_encoder_initialized) {
+    if (!enc->initialized) {
         return false;
     }
+    const encoder_config_t *cfg = enc->config;
     
     if (enable) {
-        // Enable encoder (set PD17 low)
-        pio_clear(PIOD, PIO_PD17);
-        g_encoder1_data.enabled = true;
-        
-        // Reset position counter using direct register access
-        TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_SWTRG;
-        g_encoder1_data.position = 0;
-        g_last_position = 0;
+        // Enable encoder (set enable pin low)
+        if (cfg->enable_pio != NULL) {
+            pio_clear(cfg->enable_pio, cfg->enable_pin);
+        }
+        enc->data.enabled = true;
         
-        // Debug: Check enable pin state after enabling
-        volatile bool debug_enable_pin_state_after = (PIOD->PIO_PDSR & PIO_PD17) != 0;
-        (void)debug_enable_pin_state_after;
+        // Reset position counter
+        encoder_clear_count(enc);
+        enc->data.position = 0;
     } else {
-        // Disable encoder (set PD17 high)
-        pio_set(PIOD, PIO_PD17);
-        g_encoder1_data.enabled = false;
-        
-        // Debug: Check enable pin state after disabling
-        volatile bool debug_enable_pin_state_after = (PIOD->PIO_PDSR & PIO_PD17) != 0;
-        (void)debug_enable_pin_state_after;
+        // Disable encoder (set enable pin high)
+        if (cfg->enable_pio != NULL) {
+            pio_set(cfg->enable_pio, cfg->enable_pin);
+        }
+        enc->data.enabled = false;
     }
     
+    // Debug: Check enable pin state
+    volatile bool debug_enable_pin_state_after = cfg->enable_pio != NULL && (cfg->enable_pio->PIO_PDSR & cfg->enable_pin) != 0;
+    (void)debug_enable_pin_state_after;
+    
     return true;
 }
 
-int32_t encoder1_read_position(void)
+bool encoder1_enable(bool enable)
+{
+    return encoder_enable(g_encoder1, enable);
+}
+
+int32_t encoder_read_position(encoder_t *enc)
 {
-    if (!g_encoder_initialized || !g_encoder1_data.enabled) {
+    if (!enc->initialized || !enc->data.enabled) {
         return 0;
     }
     
-    // Read current position from Timer Counter using direct register access
-    // For quadrature decoder mode, we need to read the position from the QDE register
-    // The QDE position is available in TC_CV when QDE is enabled
-    uint32_t tc_value = TC0->TC_CHANNEL[0].TC_CV;
-    
-    // Debug: Store register values for analysis
-    volatile uint32_t debug_tc_cv = tc_value;
-    volatile uint32_t debug_tc_sr = TC0->TC_CHANNEL[0].TC_SR;
-    volatile uint32_t debug_tc_cmr = TC0->TC_CHANNEL[0].TC_CMR;
-    volatile uint32_t debug_tc_bmr = TC0->TC_BMR;
-    volatile uint32_t debug_tc_qier = TC0->TC_QIER;
-    
-    // Convert to signed 32-bit value
-    int32_t position = (int32_t)tc_value;
+    int32_t position;
+    if (enc->config->decoder == ENCODER_DECODER_QDE) {
+        // Low 32 bits of the multi-turn position; TC_CV alone restarts every
+        // time base period and wraps at 32 bits
+        uint32_t tc_value = (uint32_t)encoder1_read_position64();
+        
+        // Debug: Store register values for analysis (not TC_SR, reading it
+        // clears the LOVRS TC2_Handler checks)
+        volatile uint32_t debug_tc_cv = tc_value;
+        volatile uint32_t debug_tc_cmr = TC0->TC_CHANNEL[0].TC_CMR;
+        volatile uint32_t debug_tc_bmr = TC0->TC_BMR;
+        volatile uint32_t debug_tc_qier = TC0->TC_QIER;
+        (void)debug_tc_cv; (void)debug_tc_cmr; (void)debug_tc_bmr; (void)debug_tc_qier;
+        
+        // Convert to signed 32-bit value
+        position = (int32_t)tc_value;
+    } else {
+        position = enc->quad.count;
+    }
     
-    // Update global data
-    g_encoder1_data.position = position;
+    // Update instance data
+    enc->data.position = position;
     
     return position;
 }
 
-int32_t encoder1_read_velocity(void)
+int32_t encoder1_read_position(void)
 {
-    if (!g_encoder_initialized || !g_encoder1_data.enabled) {
-        return 0;
+    return encoder_read_position(g_encoder1);
+}
+
+void encoder_get_data(encoder_t *enc, encoder_data_t *data)
+{
+    // Update position and velocity
+    if (enc->initialized && enc->data.enabled) {
+        if (enc == g_encoder1 && g_encoder1_sample_hz) {
+            // encoder1_task feeds the observer from the sample ring
+            encoder_read_position(enc);
+        } else {
+            int32_t count;
+            uint32_t edge_stamp, now;
+            if (enc->config->decoder == ENCODER_DECODER_SOFT) {
+                // Count and the time of its edge from the same edge interrupt
+                uint32_t primask = __get_PRIMASK();
+                __disable_irq();
+                count = enc->quad.count;
+                edge_stamp = enc->edge_stamp;
+                now = DWT->CYCCNT;
+                __set_PRIMASK(primask);
+                enc->data.position = count;
+            } else {
+                // No sampler: an edge is only seen when read, so this is the time
+                count = encoder_read_position(enc);
+                now = DWT->CYCCNT;
+                edge_stamp = now;
+            }
+            enc->data.velocity = encoder_velocity_update(&enc->velocity, count, edge_stamp, now);
+        }
     }
     
-    // Read current position
-    int32_t current_position = encoder1_read_position();
-    
-    // Calculate velocity (difference from last reading)
-    int32_t velocity = current_position - g_last_position;
-    
-    // Update for next calculation
-    g_last_position = current_position;
-    
-    // Update global data
-    g_encoder1_data.velocity = velocity;
-    
-    return velocity;
+    *data = enc->data;
+}
+
+int32_t encoder1_read_velocity(void)
+{
+    encoder_data_t data;
+    encoder_get_data(g_encoder1, &data);
+    return data.velocity;
 }
 
 encoder_data_t encoder1_get_data(void)
 {
-    // Update position and velocity
-    encoder1_read_position();
-    encoder1_read_velocity();
-    
-    return g_encoder1_data;
+    encoder_data_t data;
+    encoder_get_data(g_encoder1, &data);
+    return data;
 }
 
-void encoder1_reset_position(void)
+void encoder_reset_position(encoder_t *enc)
 {
-    if (!g_encoder_initialized) {
+    if (!enc->initialized) {
         return;
     }
     
-    // Reset Timer Counter using direct register access
-    TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_SWTRG;
+    encoder_clear_count(enc);
     
-    // Reset global data
-    g_encoder1_data.position = 0;
-    g_last_position = 0;
-    g_encoder1_data.velocity = 0;
+    // Reset instance data
+    enc->data.position = 0;
+    enc->data.velocity = 0;
+}
+
+void encoder1_reset_position(void)
+{
+    encoder_reset_position(g_encoder1);
+}
+
+bool encoder_is_enabled(const encoder_t *enc)
+{
+    return enc->data.enabled;
 }
 
 bool encoder1_is_enabled(void)
 {
-    return g_encoder1_data.enabled;
+    return encoder_is_enabled(g_encoder1);
+}
+
+void encoder_get_soft_stats(const encoder_t *enc, encoder_soft_stats_t *stats)
+{
+    stats->steps = enc->quad.steps;
+    stats->errors = enc->quad.errors;
+    stats->isr_cycles_last = enc->isr_cycles_last;
+    stats->isr_cycles_max = enc->isr_cycles_max;
+}
+
+// Levels of an instance's A/B lines as encoder_quad.h bits
+static uint32_t encoder_soft_levels(const encoder_config_t *cfg)
+{
+    uint32_t pdsr = cfg->pio->PIO_PDSR;
+    return ((pdsr & cfg->pin_a) ? ENCODER_QUAD_A : 0u) | ((pdsr & cfg->pin_b) ? ENCODER_QUAD_B : 0u);
+}
+
+/* PIO edge callback for the software decoders, called by the ASF PIOA_Handler
+ * (pio_handler.c) with interrupts at CONF_ENCODER_EDGE_IRQ_PRIO. One port read
+ * and a table step per instance; no FreeRTOS calls. The cycle count covers
+ * this callback, the dispatcher in front of it adds its own */
+static void encoder_soft_edge(uint32_t id, uint32_t mask)
+{
+    uint32_t start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < ENCODER_COUNT; i++) {
+        encoder_t *enc = &g_encoders[i];
+        const encoder_config_t *cfg = enc->config;
+        if (cfg->decoder != ENCODER_DECODER_SOFT || cfg->pio_id != id) {
+            continue;
+        }
+        if ((cfg->pin_a | cfg->pin_b) & mask) {
+            if (encoder_quad_step(&enc->quad, encoder_soft_levels(cfg)) != 0) {
+                enc->edge_stamp = start; // For the velocity observer
+            }
+            uint32_t cycles = DWT->CYCCNT - start;
+            enc->isr_cycles_last = cycles;
+            if (cycles > enc->isr_cycles_max) {
+                enc->isr_cycles_max = cycles;
+            }
+        }
+    }
+}
+
+// True when a QDE instance already owns these lines (CONF_ENCODER2_CROSSCHECK)
+static bool encoder_soft_pins_shared(const encoder_config_t *cfg)
+{
+    for (uint32_t i = 0; i < ENCODER_COUNT; i++) {
+        const encoder_config_t *other = &g_encoder_configs[i];
+        if (other != cfg && other->decoder == ENCODER_DECODER_QDE && other->pio == cfg->pio &&
+            ((other->pin_a | other->pin_b) & (cfg->pin_a | cfg->pin_b))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void encoder_soft_configure(encoder_t *enc)
+{
+    const encoder_config_t *cfg = enc->config;
+    uint32_t pins = cfg->pin_a | cfg->pin_b;
+    
+    pmc_enable_periph_clk(cfg->pio_id);
+    if (!encoder_soft_pins_shared(cfg)) {
+        // Own lines: inputs with pull-up and glitch filter. Shared lines stay
+        // with the QDE; input change interrupts work on peripheral pins too
+        pio_configure(cfg->pio, PIO_INPUT, pins, PIO_PULLUP | PIO_DEGLITCH);
+    }
+    encoder_quad_init(&enc->quad, encoder_soft_levels(cfg));
+    
+    // Both edges of both lines
+    pio_handler_set(cfg->pio, cfg->pio_id, pins, PIO_IT_EDGE, encoder_soft_edge);
+    (void)pio_get_interrupt_status(cfg->pio); // Drop changes seen before now
+    pio_enable_interrupt(cfg->pio, pins);
+    NVIC_SetPriority((IRQn_Type)cfg->pio_id, CONF_ENCODER_EDGE_IRQ_PRIO);
+    NVIC_EnableIRQ((IRQn_Type)cfg->pio_id);
 }
 
 // Debug function to check encoder status
 void encoder1_debug_status(void)
 {
     volatile uint32_t debug_tc_cv = TC0->TC_CHANNEL[0].TC_CV;
-    volatile uint32_t debug_tc_sr = TC0->TC_CHANNEL[0].TC_SR;
     volatile uint32_t debug_tc_cmr = TC0->TC_CHANNEL[0].TC_CMR;
     volatile uint32_t debug_tc_bmr = TC0->TC_BMR;
     volatile uint32_t debug_tc_qier = TC0->TC_QIER;
     volatile uint32_t debug_pioa_pdsr = PIOA->PIO_PDSR;
     volatile uint32_t debug_piod_pdsr = PIOD->PIO_PDSR;
-    volatile bool debug_encoder_enabled = g_encoder1_data.enabled;
-    volatile bool debug_encoder_initialized = g_encoder_initialized;
-    volatile int32_t debug_position = g_encoder1_data.position;
+    volatile bool debug_encoder_enabled = g_encoder1->data.enabled;
+    volatile bool debug_encoder_initialized = g_encoder1->initialized;
+    volatile int32_t debug_position = g_encoder1->data.position;
     
     // Check QDE status according to datasheet section 38.6.16.1
-    volatile uint32_t debug_qde_status = TC0->TC_QISR;  // QDE Interrupt Status Register
+    volatile uint32_t debug_qde_status = TC0->TC_QIMR;  // QDE events enabled (TC_QISR clears on read, TC0_Handler's)
     volatile bool debug_qde_enabled = (TC0->TC_BMR & TC_BMR_QDEN) != 0;
     volatile bool debug_position_enabled = (TC0->TC_BMR & TC_BMR_POSEN) != 0;
     volatile bool debug_speed_enabled = (TC0->TC_BMR & TC_BMR_SPEEDEN) != 0;
@@ -297,7 +504,7 @@ void encoder1_debug_status(void)
     volatile bool debug_tiob0_state = (PIOA->PIO_PDSR & PIO_PA1) != 0;
     volatile bool debug_enable_pin_state = (PIOD->PIO_PDSR & PIO_PD17) != 0;
     
-    (void)debug_tc_cv; (void)debug_tc_sr; (void)debug_tc_cmr; (void)debug_tc_bmr; (void)debug_tc_qier;
+    (void)debug_tc_cv; (void)debug_tc_cmr; (void)debug_tc_bmr; (void)debug_tc_qier;
     (void)debug_pioa_pdsr; (void)debug_piod_pdsr; (void)debug_encoder_enabled; (void)debug_encoder_initialized;
     (void)debug_position; (void)debug_tioa0_configured; (void)debug_tiob0_configured; 
     (void)debug_enable_pin_configured; (void)debug_qde_status; (void)debug_qde_enabled;
@@ -309,7 +516,7 @@ void encoder1_debug_status(void)
 void encoder1_test_operation(void)
 {
     // Initialize encoder if not already done
-    if (!g_encoder_initialized) {
+    if (!g_encoder1->initialized) {
         encoder1_init();
     }
     
@@ -341,7 +548,7 @@ void encoder1_test_operation(void)
 void encoder1_simple_test(void)
 {
     // Initialize encoder if not already done
-    if (!g_encoder_initialized) {
+    if (!g_encoder1->initialized) {
         encoder1_init();
     }
     
@@ -362,30 +569,30 @@ void encoder1_simple_test(void)
 // Check QDE status according to datasheet section 38.6.16.1
 void encoder1_check_qde_status(void)
 {
-    // Check QDE interrupt status register
-    volatile uint32_t qde_status = TC0->TC_QISR;
-    volatile bool qde_error = (qde_status & TC_QISR_QERR) != 0;
-    volatile bool direction_changed = (qde_status & TC_QISR_DIRCHG) != 0;
-    volatile bool index_pulse = (qde_status & TC_QISR_IDX) != 0;
+    // Reading TC_QISR clears IDX and QERR before TC0_Handler sees them, so
+    // take what the handler counted and the enabled events instead
+    volatile uint32_t qde_status = TC0->TC_QIMR;
+    volatile bool qde_error = g_encoder1_qde_errors != 0;
+    volatile bool index_pulse = g_encoder1_pos.index_count != 0;
     
     // Check if QDE is properly enabled
     volatile bool qde_enabled = (TC0->TC_BMR & TC_BMR_QDEN) != 0;
     volatile bool position_enabled = (TC0->TC_BMR & TC_BMR_POSEN) != 0;
     volatile bool speed_enabled = (TC0->TC_BMR & TC_BMR_SPEEDEN) != 0;
     
-    // Check Timer Counter status
-    volatile uint32_t tc_status = TC0->TC_CHANNEL[0].TC_SR;
-    volatile bool tc_clock_enabled = (tc_status & TC_SR_CLKSTA) != 0;
-    volatile bool tc_overflow = (tc_status & TC_SR_LOVRS) != 0;
+    // Check Timer Counter status. TC_SR is not read here: reading it clears
+    // the LOVRS that TC2_Handler checks for missed periods
+    volatile uint32_t tc_mode = TC0->TC_CHANNEL[0].TC_CMR;
+    volatile bool tc_overflow = g_encoder1_pos.missed_periods != 0;
     
     // Check pin states
     volatile bool tioa0_state = (PIOA->PIO_PDSR & PIO_PA0) != 0;
     volatile bool tiob0_state = (PIOA->PIO_PDSR & PIO_PA1) != 0;
     
     // Store all debug values
-    (void)qde_status; (void)qde_error; (void)direction_changed; (void)index_pulse;
+    (void)qde_status; (void)qde_error; (void)index_pulse;
     (void)qde_enabled; (void)position_enabled; (void)speed_enabled;
-    (void)tc_status; (void)tc_clock_enabled; (void)tc_overflow;
+    (void)tc_mode; (void)tc_overflow;
     (void)tioa0_state; (void)tiob0_state;
 }
 
@@ -539,6 +746,169 @@ void encoder1_standalone_pin_test(void)
     }
 }
 
+bool encoder1_sampler_start(uint32_t rate_hz)
+{
+    if (!g_encoder1->initialized || rate_hz < ENCODER_SAMPLE_HZ_MIN || rate_hz > ENCODER_SAMPLE_HZ_MAX) {
+        return false;
+    }
+
+    // Channel 2 counts TIMER_CLOCK1 (MCK/2) up to RC and restarts; 16-bit would
+    // already do for 1 kHz at 120 MHz, the counters here are 32-bit.
+    // TIOA2 rises at RA and falls at RC, so it is also the QDE speed time base:
+    // one period per sample, and the sample interrupt is its rising edge
+    uint32_t rc = sysclk_get_peripheral_hz() / 2u / rate_hz;
+    if (rc < 2u) {
+        return false;
+    }
+
+    encoder1_sampler_stop();
+    encoder_ring_init(&g_encoder1_ring);
+
+    // Timestamps come from the DWT cycle counter (same setup as can_bench.c)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    pmc_enable_periph_clk(ID_TC2);
+    ENCODER1_SAMPLE_TC.TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK1 | // MCK/2
+                                TC_CMR_WAVE |                // Waveform mode
+                                TC_CMR_WAVSEL_UP_RC |        // Restart on RC compare
+                                TC_CMR_ACPA_SET |            // TIOA2 rises at RA (time base edge)
+                                TC_CMR_ACPC_CLEAR;           // ...and falls at RC
+    ENCODER1_SAMPLE_TC.TC_RA = rc / 2u;
+    ENCODER1_SAMPLE_TC.TC_RC = rc;
+    (void)ENCODER1_SAMPLE_TC.TC_SR; // Clear stale status
+    ENCODER1_SAMPLE_TC.TC_IER = TC_IER_CPAS;
+
+    // Fold TC_CV into the base and restart it, see encoder_position_restart()
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t cv = TC0->TC_CHANNEL[0].TC_CV;
+    TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_SWTRG;
+    (void)TC0->TC_CHANNEL[0].TC_SR; // Clear a stale LOVRS
+    encoder_position_restart(&g_encoder1_pos, cv, sysclk_get_cpu_hz() / rate_hz, DWT->CYCCNT);
+    g_encoder1_sample_hz = rate_hz;
+    __set_PRIMASK(primask);
+
+    NVIC_ClearPendingIRQ(TC2_IRQn);
+    NVIC_SetPriority(TC2_IRQn, CONF_ENCODER_SAMPLE_IRQ_PRIO);
+    NVIC_EnableIRQ(TC2_IRQn);
+    ENCODER1_SAMPLE_TC.TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+
+    // Debug: Store sampler configuration
+    volatile uint32_t debug_sample_rc = ENCODER1_SAMPLE_TC.TC_RC;
+    volatile uint32_t debug_sample_cmr = ENCODER1_SAMPLE_TC.TC_CMR;
+    (void)debug_sample_rc; (void)debug_sample_cmr;
+    return true;
+}
+
+void encoder1_sampler_stop(void)
+{
+    ENCODER1_SAMPLE_TC.TC_IDR = TC_IDR_CPAS;
+    ENCODER1_SAMPLE_TC.TC_CCR = TC_CCR_CLKDIS;
+    NVIC_DisableIRQ(TC2_IRQn);
+    g_encoder1_sample_hz = 0;
+    // The count since the last time base edge is still in TC_CV with
+    // cv_ref 0, so position reads carry on by folding it in
+}
+
+// Zero the position (TC_CV, the count the sampler has accumulated, the
+// revolutions) without a sample or index interrupt in between
+static void encoder1_clear_count(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_SWTRG;
+#if CONF_ENCODER1_INDEX
+    TC0->TC_CHANNEL[1].TC_CCR = TC_CCR_SWTRG;
+#endif
+    encoder_position_clear(&g_encoder1_pos);
+    __set_PRIMASK(primask);
+}
+
+// Without the time base: take TC_CV's movement since the last fold into the
+// base, often enough that it cannot wrap unseen (2^31 counts)
+static void encoder1_fold_count(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!g_encoder1_sample_hz) {
+        encoder_position_fold(&g_encoder1_pos, TC0->TC_CHANNEL[0].TC_CV);
+    }
+    __set_PRIMASK(primask);
+}
+
+int64_t encoder1_read_position64(void)
+{
+    encoder1_fold_count();
+    return encoder_position_read(&g_encoder1_pos);
+}
+
+// Position right now, from an interrupt below TC2_Handler. Right after a time
+// base edge TC_CV is already cleared while TC2_Handler is still on its way to
+// add TC_RA0, so wait for it
+static int64_t encoder1_live_position(void)
+{
+    int64_t position;
+    uint32_t seq;
+    do {
+        seq = g_encoder1_pos.seq;
+        position = encoder_position_at(&g_encoder1_pos, TC0->TC_CHANNEL[0].TC_CV);
+    } while (seq != g_encoder1_pos.seq || (g_encoder1_sample_hz && NVIC_GetPendingIRQ(TC2_IRQn)));
+    return position;
+}
+
+void encoder1_get_index_stats(encoder_index_stats_t *stats)
+{
+    encoder_position_get_index(&g_encoder1_pos, stats);
+    stats->qde_errors = g_encoder1_qde_errors;
+}
+
+// QDE events (TC_QIER): index pulses and quadrature errors. Below the sampler,
+// at the kernel's max syscall priority so critical sections hold it off; no
+// FreeRTOS calls
+void TC0_Handler(void)
+{
+    uint32_t qisr = TC0->TC_QISR; // Reading TC_QISR clears it
+    if (qisr & TC_QISR_QERR) {
+        g_encoder1_qde_errors++;
+    }
+    if (qisr & TC_QISR_IDX) {
+        encoder_position_index(&g_encoder1_pos, encoder1_live_position(), (int32_t)TC0->TC_CHANNEL[1].TC_CV);
+    }
+}
+
+uint32_t encoder1_read_samples(encoder_sample_t *out, uint32_t max)
+{
+    return encoder_ring_read(&g_encoder1_ring, out, max);
+}
+
+void encoder1_sampler_get_stats(encoder_sampler_stats_t *stats)
+{
+    stats->rate_hz = g_encoder1_sample_hz;
+    stats->samples = g_encoder1_ring.pushed;
+    stats->overruns = g_encoder1_ring.overruns;
+    stats->high_water = g_encoder1_ring.high_water;
+    stats->missed_periods = g_encoder1_pos.missed_periods;
+}
+
+// Sampling timer, at the rising edge of the speed time base: the hardware has
+// just moved the period's count to TC_RA0 and cleared TC_CV. Latch speed,
+// position and the cycle counter together. Runs above the kernel's
+// priorities, so no FreeRTOS calls here. A handler a whole period late finds
+// TC_RA0 loaded again (LOVRS): the periods in between are counted from the
+// cycle stamps and taken at this period's speed, so the position is an
+// estimate from then on (missed_periods; with the index, drift_errors)
+void TC2_Handler(void)
+{
+    if (ENCODER1_SAMPLE_TC.TC_SR & TC_SR_CPAS) { // Reading TC_SR clears it
+        uint32_t stamp = DWT->CYCCNT;
+        bool overrun = (TC0->TC_CHANNEL[0].TC_SR & TC_SR_LOVRS) != 0; // Reading clears it too
+        int32_t speed = (int32_t)TC0->TC_CHANNEL[0].TC_RA;
+        int64_t position = encoder_position_period(&g_encoder1_pos, speed, TC0->TC_CHANNEL[0].TC_CV, overrun, stamp);
+        (void)encoder_ring_push(&g_encoder1_ring, (int32_t)position, speed, stamp); // Low 32 bits, differences stay exact
+    }
+}
+
 // FreeRTOS task for encoder reading and CAN transmission
 void encoder1_task(void *arg)
 {
@@ -558,42 +928,98 @@ void encoder1_task(void *arg)
     // Run simple test once at startup
     encoder1_simple_test();
     
+    // Sample from TC0 channel 2; the task only drains the ring, so its own
+    // scheduling jitter no longer moves the sample instants
+    bool sampling = encoder1_sampler_start(CONF_ENCODER_SAMPLE_HZ);
+    static encoder_sample_t batch[ENCODER1_SAMPLE_BATCH];
+    
+    // Encoder2 decodes in software from PIO edges (config/conf_encoder.h)
+    encoder_t *enc2 = encoder_get(ENCODER_ID(encoder2));
+    if (encoder_init(enc2)) {
+        encoder_enable(enc2, true);
+    }
+#if CONF_ENCODER2_CROSSCHECK
+    // Same lines as the QDE: start both from zero together
+    encoder1_reset_position();
+    encoder_reset_position(enc2);
+    int32_t crosscheck_max = 0;
+#endif
+    
     // Task variables
     uint32_t task_interval = 0;
-    const uint32_t SAMPLE_RATE_MS = 10; // 100 Hz sampling rate
-    const uint32_t CAN_TX_INTERVAL_MS = 50; // 20 Hz CAN transmission rate
+    const uint32_t SAMPLE_RATE_MS = CONF_ENCODER_PUBLISH_MS; // Publish period
     const uint32_t DEBUG_INTERVAL_MS = 1000; // 1 Hz debug rate
+    TickType_t last_wake = xTaskGetTickCount();
     
     for (;;) {
-        // Read encoder data
-        encoder_data_t enc_data = encoder1_get_data();
+        encoder_data_t enc_data;
+        if (sampling) {
+            // Drain everything taken since the last period; the newest sample
+            // is the position, and every sample goes through the M/T velocity
+            // observer, a count change stamped with the sample that saw it
+            uint32_t n, total = 0;
+            uint32_t start = DWT->CYCCNT;
+            while ((n = encoder1_read_samples(batch, ENCODER1_SAMPLE_BATCH)) > 0) {
+                for (uint32_t i = 0; i < n; i++) {
+                    g_encoder1->data.velocity = encoder_velocity_update(&g_encoder1->velocity, batch[i].position,
+                                                                        batch[i].stamp, batch[i].stamp);
+                }
+                g_encoder1->data.position = batch[n - 1].position;
+                total += n;
+            }
+            if (total > 0) {
+                // Debug: observer cost per sample
+                volatile uint32_t debug_encoder1_velocity_cycles = (DWT->CYCCNT - start) / total;
+                (void)debug_encoder1_velocity_cycles;
+            }
+            enc_data = g_encoder1->data;
+        } else {
+            // Sampler could not start: read the counter from the task as before
+            enc_data = encoder1_get_data();
+        }
         
         // Call debug function periodically
         if (task_interval % DEBUG_INTERVAL_MS == 0) {
             encoder1_debug_status();
             encoder1_check_qde_status();
-        }
-        
-        // Send encoder data over CAN every CAN_TX_INTERVAL_MS
-        if (task_interval % CAN_TX_INTERVAL_MS == 0) {
-            // Always send encoder data for debugging, even if not enabled
-            // Prepare CAN data: 8 bytes
-            // Byte 0-3: Position (32-bit signed, little-endian)
-            // Byte 4-7: Velocity (32-bit signed, little-endian)
-            uint8_t can_data[8];
-            
-            // Pack position (little-endian)
-            can_data[0] = (uint8_t)(enc_data.position & 0xFF);
-            can_data[1] = (uint8_t)((enc_data.position >> 8) & 0xFF);
-            can_data[2] = (uint8_t)((enc_data.position >> 16) & 0xFF);
-            can_data[3] = (uint8_t)((enc_data.position >> 24) & 0xFF);
             
-            // Pack velocity (little-endian)
-            can_data[4] = (uint8_t)(enc_data.velocity & 0xFF);
-            can_data[5] = (uint8_t)((enc_data.velocity >> 8) & 0xFF);
-            can_data[6] = (uint8_t)((enc_data.velocity >> 16) & 0xFF);
-            can_data[7] = (uint8_t)((enc_data.velocity >> 24) & 0xFF);
+            encoder_soft_stats_t enc2_stats;
+            encoder_get_soft_stats(enc2, &enc2_stats);
+            encoder_index_stats_t index_stats;
+            encoder1_get_index_stats(&index_stats);
+            volatile int64_t debug_encoder1_position64 = encoder1_read_position64();
+            volatile int32_t debug_encoder1_revolutions = index_stats.revolutions;
+            volatile uint32_t debug_encoder1_index_drift_errors = index_stats.drift_errors;
+            (void)debug_encoder1_position64; (void)debug_encoder1_revolutions; (void)debug_encoder1_index_drift_errors;
             
+            volatile uint32_t debug_encoder2_errors = enc2_stats.errors;
+            volatile uint32_t debug_encoder2_isr_cycles_max = enc2_stats.isr_cycles_max;
+            (void)debug_encoder2_errors; (void)debug_encoder2_isr_cycles_max;
+#if CONF_ENCODER2_CROSSCHECK
+            // Exact when standing still; moving, the QDE sample may be up to
+            // one sample period older than the software count
+            int32_t diff = enc_data.position - encoder_read_position(enc2);
+            int32_t mag = (diff < 0) ? -diff : diff;
+            if (mag > crosscheck_max) {
+                crosscheck_max = mag;
+            }
+            volatile int32_t debug_encoder_crosscheck_diff = diff;
+            volatile int32_t debug_encoder_crosscheck_max = crosscheck_max;
+            (void)debug_encoder_crosscheck_diff; (void)debug_encoder_crosscheck_max;
+#endif
+        }
+        
+        // Always send encoder data for debugging, even if not enabled
+        // Layout comes from config/conf_can_signals.h (position, velocity)
+        can_encoder1_t msg;
+        msg.position = enc_data.position;
+        msg.velocity = enc_data.velocity;
+        uint32_t datal, datah;
+        can_pack_encoder1(&msg, &datal, &datah);
+        
+        // Every sample is offered; config/conf_can_publish.h decides whether it goes
+        // out (movement beyond the deadband, inhibit time, heartbeat)
+        if (can_publish(CAN_PUBLISH_SLOT(encoder1), datal, datah)) {
             // Debug: Store encoder status for analysis
             volatile bool debug_encoder_enabled = enc_data.enabled;
             volatile bool debug_encoder_valid = enc_data.valid;
@@ -601,9 +1027,6 @@ void encoder1_task(void *arg)
             volatile int32_t debug_velocity = enc_data.velocity;
             (void)debug_encoder_enabled; (void)debug_encoder_valid;
             (void)debug_position; (void)debug_velocity;
-            
-            // Send over CAN
-            can_app_tx(CAN_ID_ENCODER1, can_data, 8);
         }
         
         // Increment task interval
@@ -612,7 +1035,7 @@ void encoder1_task(void *arg)
             task_interval = 0; // Reset every second
         }
         
-        // Wait for next sample
-        vTaskDelay(pdMS_TO_TICKS(SAMPLE_RATE_MS));
+        // Wait for next publish period (fixed rate, the batch absorbs any lateness)
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(SAMPLE_RATE_MS));
     }
 }
\ No newline at end of file
@@ -8,12 +8,23 @@
  * - PA0/TIOA0: Encoder A input
  * - PA1/TIOB0: Encoder B input  
  * - PD17: Enable pin (active low)
+ * - TC0 channel 2: sampling timer and speed time base (config/conf_encoder.h)
+ *
+ * Encoder2 (software quadrature from PIO edge interrupts)
+ * - PA15: Encoder A input
+ * - PA16: Encoder B input
+ * - PD27: Enable pin (active low)
  */
 
 #ifndef ENCODER_H_
 #define ENCODER_H_
 
 #include "sam4e.h"
+#include "encoder_ring.h"
+#include "encoder_quad.h"
+#include "encoder_velocity.h"
+#include "encoder_position.h"
+#include "conf_encoder.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -26,23 +37,88 @@ extern "C" {
 #define ENCODER1_TIOA_PIN      PIO_PA0_IDX  // PA0/TIOA0
 #define ENCODER1_TIOB_PIN      PIO_PA1_IDX  // PA1/TIOB0
 #define ENCODER1_ENABLE_PIN    PIO_PD17_IDX // PD17 (active low)
-
-// CAN ID for encoder data
-#define CAN_ID_ENCODER1        0x130u
+#define ENCODER1_SAMPLE_TC_CHANNEL 2 // TC0 channel 2 paces the samples (TC2_Handler) and is the QDE speed time base
+#define ENCODER_SAMPLE_HZ_MIN  1000u  // Sampling rate range for encoder1_sampler_start()
+#define ENCODER_SAMPLE_HZ_MAX  10000u
 
 // Encoder data structure
 typedef struct {
-    int32_t position;        // Current encoder position (counts)
-    int32_t velocity;        // Encoder velocity (counts per sample)
+    int32_t position;        // Current encoder position (counts; low 32 bits of encoder1_read_position64())
+    int32_t velocity;        // Encoder velocity (counts/s x ENCODER_VELOCITY_SCALE, M/T observer)
     bool enabled;           // Encoder enable status
     bool valid;             // Data validity flag
 } encoder_data_t;
 
-// Function prototypes
+// How an instance decodes its A/B lines (config/conf_encoder.h)
+typedef enum {
+    ENCODER_DECODER_QDE = 0, // TC0 quadrature decoder, one per chip
+    ENCODER_DECODER_SOFT,    // encoder_quad.h from PIO edge interrupts
+} encoder_decoder_t;
+
+typedef struct {
+    encoder_decoder_t decoder;
+    Pio *pio;              // A/B inputs
+    uint32_t pio_id;       // ID_PIOx of the inputs
+    uint32_t pin_a;        // PIO mask of line A
+    uint32_t pin_b;        // PIO mask of line B
+    Pio *enable_pio;       // Enable output (active low), NULL if none
+    uint32_t enable_pin;
+} encoder_config_t;
+
+// One encoder; get it with encoder_get(ENCODER_ID(name))
+typedef struct {
+    const encoder_config_t *config;
+    encoder_data_t data;
+    bool initialized;
+    encoder_quad_t quad;                // ENCODER_DECODER_SOFT
+    volatile uint32_t edge_stamp;       // DWT time of the last count change (ENCODER_DECODER_SOFT)
+    encoder_velocity_t velocity;        // Observer behind data.velocity
+    volatile uint32_t isr_cycles_last;  // Edge handler cost, DWT cycles (ENCODER_DECODER_SOFT)
+    volatile uint32_t isr_cycles_max;
+} encoder_t;
+
+// Software decoder counters
+typedef struct {
+    uint32_t steps;           // Level changes decoded
+    uint32_t errors;          // Both lines changed between two reads, not counted
+    uint32_t isr_cycles_last; // Edge handler cost in DWT cycles, after the ASF PIO dispatcher
+    uint32_t isr_cycles_max;
+} encoder_soft_stats_t;
+
+#define ENCODER_ID(name)       encoder_id_##name // Instance index of a config/conf_encoder.h row
+
+#define ENCODER_GEN_ID(name, decoder, pio, pio_id, pin_a, pin_b, enable_pio, enable_pin) ENCODER_ID(name),
+enum {
+    CONF_ENCODER_TABLE(ENCODER_GEN_ID)
+    ENCODER_COUNT
+};
+
+// Timer-driven sampler counters
+typedef struct {
+    uint32_t rate_hz;    // Sampling rate in use, 0 = stopped
+    uint32_t samples;    // Samples stored in the ring
+    uint32_t overruns;   // Samples dropped because the ring was full
+    uint32_t high_water; // Most samples waiting at once
+    uint32_t missed_periods; // Time base periods TC_RA0 was overwritten in, counts estimated
+} encoder_sampler_stats_t;
+
+// Instance API
+encoder_t *encoder_get(uint32_t id); // Instance of ENCODER_ID(name), NULL if out of range
+bool encoder_init(encoder_t *enc); // Pins, decoder and enable output; the enable starts high (disabled)
+bool encoder_enable(encoder_t *enc, bool enable); // Drive the enable pin and zero the position
+int32_t encoder_read_position(encoder_t *enc); // Counts since the last reset
+void encoder_reset_position(encoder_t *enc);
+bool encoder_is_enabled(const encoder_t *enc);
+void encoder_get_data(encoder_t *enc, encoder_data_t *data); // Position, velocity (M/T observer) and flags
+void encoder_get_soft_stats(const encoder_t *enc, encoder_soft_stats_t *stats); // ENCODER_DECODER_SOFT counters
+
+// Encoder1 (QDE) entry points, on the encoder1 instance
 bool encoder1_init(void);
 bool encoder1_enable(bool enable);
 int32_t encoder1_read_position(void);
-int32_t encoder1_read_velocity(void);
+int64_t encoder1_read_position64(void); // Multi-turn position in counts, no 32-bit wrap; safe from any task
+void encoder1_get_index_stats(encoder_index_stats_t *stats); // Snapshot of the index tracking
+int32_t encoder1_read_velocity(void); // Counts/s x ENCODER_VELOCITY_SCALE from the M/T observer
 encoder_data_t encoder1_get_data(void);
 void encoder1_reset_position(void);
 bool encoder1_is_enabled(void);
@@ -51,6 +127,12 @@ void encoder1_test_operation(void);
 void encoder1_simple_test(void);
 void encoder1_check_qde_status(void);
 
+// Timer-driven sampling: TC0 channel 2 latches position and time into a ring
+bool encoder1_sampler_start(uint32_t rate_hz); // Start sampling at ENCODER_SAMPLE_HZ_MIN..MAX, after encoder1_init()
+void encoder1_sampler_stop(void); // Stop the sampling timer, samples already taken stay readable
+uint32_t encoder1_read_samples(encoder_sample_t *out, uint32_t max); // Oldest samples first, returns the number read (one consumer task)
+void encoder1_sampler_get_stats(encoder_sampler_stats_t *stats); // Snapshot of the sampler counters
+
 // Pin toggle test functions for oscilloscope verification
 void encoder1_pin_toggle_test(void);
 void encoder1_configure_pins_as_gpio(void);
@@ -0,0 +1,128 @@
+#include "encoder_position.h"
+#include <string.h>
+
+void encoder_position_init(encoder_position_t *p, int32_t counts_per_rev, int32_t tolerance)
+{
+	memset((void *)p, 0, sizeof(*p));
+	p->period_cycles = 1;
+	p->counts_per_rev = counts_per_rev;
+	p->tolerance = tolerance;
+}
+
+void encoder_position_clear(encoder_position_t *p)
+{
+	p->count_base = 0;
+	p->cv_ref = 0;
+	p->position = 0;
+	p->seq++;
+	p->index_count = 0;
+	p->revolutions = 0;
+	p->index_seq++;
+}
+
+void encoder_position_fold(encoder_position_t *p, uint32_t cv)
+{
+	int64_t base = p->count_base + (int32_t)(cv - p->cv_ref);
+	p->count_base = base;
+	p->cv_ref = cv;
+	p->position = base;
+	p->seq++;
+}
+
+// The first time base edge hands over everything in TC_CV since it was last
+// cleared, modulo 32 bits, so TC_CV is cleared here and cv taken in now
+void encoder_position_restart(encoder_position_t *p, uint32_t cv, uint32_t period_cycles, uint32_t stamp)
+{
+	p->count_base += (int32_t)(cv - p->cv_ref);
+	p->cv_ref = 0;
+	p->position = p->count_base;
+	p->period_cycles = (period_cycles != 0) ? period_cycles : 1u;
+	p->stamp = stamp;
+	p->seq++;
+}
+
+/* A whole period late, TC_RA has been loaded again (LOVRS) and the periods in
+ * between are gone: count them from the stamps and take them at this
+ * period's speed, so the position is an estimate from then on */
+int64_t encoder_position_period(encoder_position_t *p, int32_t ra, uint32_t cv, bool overrun, uint32_t stamp)
+{
+	int64_t base = p->count_base + ra;
+	if (overrun) {
+		uint32_t cycles = p->period_cycles;
+		uint32_t periods = (stamp - p->stamp + cycles / 2u) / cycles;
+		uint32_t missed = (periods > 1u) ? periods - 1u : 1u;
+		base += (int64_t)ra * missed;
+		p->missed_periods += missed;
+	}
+	p->stamp = stamp;
+	int64_t position = base + (int32_t)cv; // Plus the few counts since the edge
+	p->count_base = base;
+	p->position = position;
+	p->seq++;
+	return position;
+}
+
+int64_t encoder_position_at(const encoder_position_t *p, uint32_t cv)
+{
+	return p->count_base + (int32_t)(cv - p->cv_ref);
+}
+
+int64_t encoder_position_read(const encoder_position_t *p)
+{
+	int64_t position;
+	uint32_t seq;
+	do {
+		seq = p->seq;
+		position = p->position;
+	} while (seq != p->seq);
+	return position;
+}
+
+/* The distance to the previous pulse must be about zero (the same mark passed
+ * back) or one revolution. The first revolution seen sets counts_per_rev when
+ * it is 0. The position is read in the handler, not latched by the hardware,
+ * hence the tolerance */
+void encoder_position_index(encoder_position_t *p, int64_t position, int32_t revolutions)
+{
+	if (p->index_count > 0) {
+		int64_t span = position - p->index_position;
+		if (span < 0) {
+			span = -span;
+		}
+		if (span > p->tolerance) {
+			if (p->counts_per_rev == 0) {
+				p->counts_per_rev = (span < INT32_MAX) ? (int32_t)span : INT32_MAX;
+			} else {
+				int64_t drift = span - p->counts_per_rev;
+				if (drift < 0) {
+					drift = -drift;
+				}
+				if (drift > p->tolerance) {
+					p->drift_errors++; // Lost or extra counts, or a missed index
+				}
+				if (drift > p->drift_max) {
+					p->drift_max = (drift < INT32_MAX) ? (int32_t)drift : INT32_MAX;
+				}
+			}
+		}
+	}
+
+	p->index_position = position;
+	p->revolutions = revolutions;
+	p->index_count++;
+	p->index_seq++;
+}
+
+void encoder_position_get_index(const encoder_position_t *p, encoder_index_stats_t *stats)
+{
+	uint32_t seq;
+	do {
+		seq = p->index_seq;
+		stats->index_position = p->index_position;
+		stats->revolutions = p->revolutions;
+		stats->index_count = p->index_count;
+		stats->counts_per_rev = p->counts_per_rev;
+		stats->drift_errors = p->drift_errors;
+		stats->drift_max = p->drift_max;
+	} while (seq != p->index_seq);
+}
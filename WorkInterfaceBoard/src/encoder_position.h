@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 64-bit position of the QDE and its index pulses, kept from the register
+ * values the handlers read. No hardware or RTOS access, so it runs on a host.
+ *
+ * Position = count_base + (int32_t)(TC_CV - cv_ref). With the speed time base
+ * running, TC_CV restarts every period and encoder_position_period() moves
+ * the period's count (TC_RA) into the base, cv_ref staying 0; without it,
+ * encoder_position_fold() takes TC_CV's movement in before it can wrap
+ * (2^31 counts).
+ * Each half has its own sequence counter with one writer at a time: seq for
+ * the sampling interrupt and code running with interrupts masked, index_seq
+ * for the index interrupt and encoder_position_clear(). A writer bumps its
+ * counter once done; readers run below the writers, so a read is whole when
+ * the counter did not move meanwhile.
+ */
+
+// Index pulses and QDE errors, one snapshot
+typedef struct {
+	int64_t index_position;   // Position at the last index pulse
+	int32_t revolutions;      // QDE rotation counter (channel 1)
+	uint32_t index_count;     // Index pulses since the last reset
+	int32_t counts_per_rev;   // Expected distance between pulses, 0 until learned
+	uint32_t drift_errors;    // Pulses off by more than the tolerance
+	int32_t drift_max;        // Largest deviation seen, counts
+	uint32_t qde_errors;      // Quadrature errors flagged by the QDE (encoder.c)
+} encoder_index_stats_t;
+
+typedef struct {
+	/* Position, seq */
+	volatile int64_t count_base;      // Counts before the last time base edge or fold
+	volatile uint32_t cv_ref;         // TC_CV at the last fold
+	volatile int64_t position;        // Position at the last sample or fold
+	volatile uint32_t seq;
+	uint32_t period_cycles;           // Stamp clock cycles per time base period
+	uint32_t stamp;                   // Stamp of the last period
+	volatile uint32_t missed_periods; // Periods whose TC_RA was overwritten before it was read
+
+	/* Index, index_seq */
+	volatile int64_t index_position;
+	volatile int32_t revolutions;
+	volatile uint32_t index_count;
+	volatile int32_t counts_per_rev;  // 0 until learned
+	volatile uint32_t drift_errors;
+	volatile int32_t drift_max;
+	int32_t tolerance;                // Counts an index pulse may be off
+	volatile uint32_t index_seq;
+} encoder_position_t;
+
+void encoder_position_init(encoder_position_t *p, int32_t counts_per_rev, int32_t tolerance); // Zero, with the index settings
+void encoder_position_clear(encoder_position_t *p); // Position and revolutions to zero, TC_CV just cleared (writers masked)
+void encoder_position_fold(encoder_position_t *p, uint32_t cv); // No time base: take TC_CV's movement into the base (writers masked)
+void encoder_position_restart(encoder_position_t *p, uint32_t cv, uint32_t period_cycles, uint32_t stamp); // Time base starting: take cv in, TC_CV just cleared (writers masked)
+int64_t encoder_position_period(encoder_position_t *p, int32_t ra, uint32_t cv, bool overrun, uint32_t stamp); // Time base edge: TC_RA, TC_CV since, LOVRS; returns the position
+int64_t encoder_position_at(const encoder_position_t *p, uint32_t cv); // Position with TC_CV now; the caller retries while seq moves
+int64_t encoder_position_read(const encoder_position_t *p); // Position at the last period or fold
+void encoder_position_index(encoder_position_t *p, int64_t position, int32_t revolutions); // Index pulse at position
+void encoder_position_get_index(const encoder_position_t *p, encoder_index_stats_t *stats); // Snapshot, qde_errors left alone
+
+#ifdef __cplusplus
+}
+#endif
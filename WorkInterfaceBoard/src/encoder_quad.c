@@ -0,0 +1,34 @@
+#include "encoder_quad.h"
+
+#define ENCODER_QUAD_ERR       2 // Table marker: both lines changed
+
+// Index: previous levels << 2 | new levels; forward is 00 -> A -> AB -> B -> 00
+static const int8_t g_encoder_quad_table[16] = {
+	 0, +1, -1, ENCODER_QUAD_ERR, // from 00
+	-1,  0, ENCODER_QUAD_ERR, +1, // from A
+	+1, ENCODER_QUAD_ERR,  0, -1, // from B
+	ENCODER_QUAD_ERR, -1, +1,  0, // from AB
+};
+
+void encoder_quad_init(encoder_quad_t *q, uint32_t ab)
+{
+	q->state = (uint8_t)(ab & (ENCODER_QUAD_A | ENCODER_QUAD_B));
+	q->count = 0;
+	q->steps = 0;
+	q->errors = 0;
+}
+
+int32_t encoder_quad_step(encoder_quad_t *q, uint32_t ab)
+{
+	ab &= ENCODER_QUAD_A | ENCODER_QUAD_B;
+	if (ab == q->state) return 0; // Edge pair already undone, or nothing new
+	int32_t d = g_encoder_quad_table[((uint32_t)q->state << 2) | ab];
+	q->state = (uint8_t)ab;
+	q->steps++;
+	if (d == ENCODER_QUAD_ERR) {
+		q->errors++;
+		return 0;
+	}
+	q->count += d;
+	return d;
+}
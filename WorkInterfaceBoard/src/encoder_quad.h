@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 4x quadrature decoding in software. Each step gets the A/B levels read after
+ * a pin change; a 16-entry table indexed by the previous and the new levels
+ * gives -1, 0 or +1. A glitch on one line that is gone by the read is no step,
+ * one seen both ways cancels out. A step where both lines changed cannot say
+ * which way it went (missed edge); it is counted as an error and not counted.
+ * No hardware access, so it runs on a host.
+ */
+
+#define ENCODER_QUAD_A         0x1u // Bit of line A in the levels passed in
+#define ENCODER_QUAD_B         0x2u // Bit of line B
+
+typedef struct {
+	volatile int32_t count;   // Position in edges, + when A leads B
+	volatile uint32_t steps;  // Level changes seen, either way
+	volatile uint32_t errors; // Steps with both lines changed, not counted
+	uint8_t state;            // Levels at the last step
+} encoder_quad_t;
+
+void encoder_quad_init(encoder_quad_t *q, uint32_t ab); // Start from the current levels with a zero count
+int32_t encoder_quad_step(encoder_quad_t *q, uint32_t ab); // New levels, returns the count change (0 on an error)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,51 @@
+#include "encoder_ring.h"
+
+typedef char encoder_ring_len_pow2[((ENCODER_RING_LEN & (ENCODER_RING_LEN - 1u)) == 0) ? 1 : -1]; // Compile-time check
+
+void encoder_ring_init(encoder_ring_t *r)
+{
+	r->head = 0;
+	r->tail = 0;
+	r->pushed = 0;
+	r->overruns = 0;
+	r->high_water = 0;
+}
+
+bool encoder_ring_push(encoder_ring_t *r, int32_t position, int32_t speed, uint32_t stamp)
+{
+	uint32_t head = r->head;
+	uint32_t used = head - r->tail;
+	if (used >= ENCODER_RING_LEN) {
+		r->overruns++; // Keep the older samples, the consumer is behind
+		return false;
+	}
+
+	encoder_sample_t *s = &r->buf[head & (ENCODER_RING_LEN - 1u)];
+	s->position = position;
+	s->speed = speed;
+	s->stamp = stamp;
+	__sync_synchronize(); // Sample stored before it is published
+	r->head = head + 1;
+	r->pushed++;
+	if (used + 1 > r->high_water) r->high_water = used + 1;
+	return true;
+}
+
+uint32_t encoder_ring_read(encoder_ring_t *r, encoder_sample_t *out, uint32_t max)
+{
+	uint32_t tail = r->tail;
+	uint32_t avail = r->head - tail;
+	__sync_synchronize(); // Samples read only after head says they are there
+	uint32_t n = (avail < max) ? avail : max;
+	for (uint32_t i = 0; i < n; i++) {
+		out[i] = r->buf[(tail + i) & (ENCODER_RING_LEN - 1u)];
+	}
+	__sync_synchronize(); // Copied out before the slots are handed back
+	r->tail = tail + n;
+	return n;
+}
+
+uint32_t encoder_ring_count(const encoder_ring_t *r)
+{
+	return r->head - r->tail;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Single-producer / single-consumer ring of timestamped encoder samples.
+ * The sampling interrupt pushes, one task reads in batches. Indices run freely
+ * and are masked on access; only the producer writes head and only the
+ * consumer writes tail, so no lock is needed. No hardware or RTOS access, so
+ * it runs on a host against a mocked timer.
+ */
+
+#define ENCODER_RING_LEN       512u // Samples, must be a power of two (51 ms at 10 kHz)
+
+typedef struct {
+	int32_t position; // Counter value at the sample
+	int32_t speed;    // Counts in the speed time base that ended before the sample (QDE TC_RA0)
+	uint32_t stamp;   // Time of the sample, producer's clock (DWT cycles on target)
+} encoder_sample_t;
+
+typedef struct {
+	encoder_sample_t buf[ENCODER_RING_LEN];
+	volatile uint32_t head;     // Next slot to fill (producer)
+	volatile uint32_t tail;     // Next slot to read (consumer)
+	volatile uint32_t pushed;   // Samples stored (producer)
+	volatile uint32_t overruns; // Samples dropped because the ring was full (producer)
+	volatile uint32_t high_water; // Most samples waiting at once (producer)
+} encoder_ring_t;
+
+void encoder_ring_init(encoder_ring_t *r); // Empty the ring and clear its counters (nothing may push meanwhile)
+bool encoder_ring_push(encoder_ring_t *r, int32_t position, int32_t speed, uint32_t stamp); // Producer: store a sample, false (and counted) if full
+uint32_t encoder_ring_read(encoder_ring_t *r, encoder_sample_t *out, uint32_t max); // Consumer: move up to max oldest samples to out, returns the number moved
+uint32_t encoder_ring_count(const encoder_ring_t *r); // Samples waiting
+
+#ifdef __cplusplus
+}
+#endif
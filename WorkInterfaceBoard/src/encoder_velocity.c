@@ -0,0 +1,57 @@
+#include "encoder_velocity.h"
+
+void encoder_velocity_init(encoder_velocity_t *v, uint32_t clock_hz, uint32_t window_us, uint32_t stop_ms)
+{
+	uint64_t stop = (uint64_t)clock_hz * stop_ms / 1000u;
+	v->clock_hz = clock_hz;
+	v->min_window = (uint32_t)((uint64_t)clock_hz * window_us / 1000000u);
+	v->stop = (stop < 0x7FFFFFFFu) ? (uint32_t)stop : 0x7FFFFFFFu; // Stamp differences must not wrap
+	encoder_velocity_reset(v);
+}
+
+void encoder_velocity_reset(encoder_velocity_t *v)
+{
+	v->started = false;
+	v->velocity = 0;
+}
+
+int32_t encoder_velocity_update(encoder_velocity_t *v, int32_t count, uint32_t edge_stamp, uint32_t now)
+{
+	if (!v->started) {
+		v->ref_count = v->edge_count = count;
+		v->ref_stamp = v->edge_stamp = edge_stamp;
+		v->started = true;
+		v->velocity = 0;
+		return 0;
+	}
+
+	if (count != v->edge_count) {
+		v->edge_count = count;
+		v->edge_stamp = edge_stamp;
+		uint32_t span = edge_stamp - v->ref_stamp;
+		if (span >= v->min_window && span > 0) {
+			// M/T: whole counts over the exact time they took
+			int64_t counts = (int32_t)((uint32_t)count - (uint32_t)v->ref_count); // Counts may wrap
+			v->velocity = (int32_t)(counts * (int64_t)v->clock_hz * ENCODER_VELOCITY_SCALE / (int64_t)span);
+			v->ref_count = count;
+			v->ref_stamp = edge_stamp;
+		}
+		return v->velocity;
+	}
+
+	uint32_t idle = now - v->edge_stamp;
+	if (idle >= v->stop) {
+		// Stopped; keep both stamps within reach so the differences never wrap
+		v->velocity = 0;
+		v->edge_stamp = now - v->stop;
+		v->ref_count = v->edge_count;
+		v->ref_stamp = v->edge_stamp;
+		return 0;
+	}
+
+	// No edge yet: at most one count over the time since the last one
+	int64_t bound = (int64_t)v->clock_hz * ENCODER_VELOCITY_SCALE / (int64_t)(idle ? idle : 1u);
+	if (v->velocity > bound) v->velocity = (int32_t)bound;
+	else if (v->velocity < -bound) v->velocity = (int32_t)-bound;
+	return v->velocity;
+}
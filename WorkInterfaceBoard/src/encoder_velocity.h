@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* M/T velocity estimate: counts between two edges divided by the time between
+ * those edges, over a window of at least min_window. Fast, it averages many
+ * counts; slow, one count over the exact edge interval, so speeds far below
+ * one count per sample come out smooth instead of as 0/1 steps. While no edge
+ * arrives the speed can be at most one count over the time since the last
+ * one, and after stop_cycles without an edge it is 0. Integer only, times are
+ * free-running 32-bit cycle stamps. No hardware access, so it runs on a host.
+ */
+
+#define ENCODER_VELOCITY_SCALE 1000 // Velocity units per count/s
+
+typedef struct {
+	uint32_t clock_hz;   // Stamp clock
+	uint32_t min_window; // Shortest edge-to-edge window, cycles
+	uint32_t stop;       // No edge this long: stopped, cycles
+	int32_t ref_count;   // Window start: count at an edge
+	uint32_t ref_stamp;  // ...and its time
+	int32_t edge_count;  // Count at the latest edge
+	uint32_t edge_stamp; // ...and its time
+	bool started;
+	int32_t velocity;    // Counts/s x ENCODER_VELOCITY_SCALE
+} encoder_velocity_t;
+
+void encoder_velocity_init(encoder_velocity_t *v, uint32_t clock_hz, uint32_t window_us, uint32_t stop_ms); // stop_ms is capped below half the stamp wrap
+void encoder_velocity_reset(encoder_velocity_t *v); // Forget the edges, e.g. after the count was zeroed; velocity 0
+int32_t encoder_velocity_update(encoder_velocity_t *v, int32_t count, uint32_t edge_stamp, uint32_t now); // Count, time of the edge that made it (any value if unchanged), current time; returns the velocity
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+#include "conf_fw_update.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Flash access used by the updater and the bootloader.
+ * fw_image and fw_update only program through these calls, so a simulated
+ * flash array stands in for the EFC on a host. Addresses are absolute.
+ */
+typedef struct {
+	bool (*erase)(void *ctx, uint32_t addr);                          // Erase FW_ERASE_SIZE bytes at an FW_ERASE_SIZE boundary
+	bool (*write_page)(void *ctx, uint32_t addr, const uint32_t *data); // Program one erased page (FW_PAGE_SIZE bytes)
+	bool (*rewrite_page)(void *ctx, uint32_t addr, const uint32_t *data); // Erase and program one small-sector page
+	void (*read)(void *ctx, uint32_t addr, void *buf, uint32_t len);
+	void *ctx;
+} fw_flash_t;
+
+const fw_flash_t *fw_flash_efc(void); // The on-chip flash through the EFC
+
+#ifdef __cplusplus
+}
+#endif
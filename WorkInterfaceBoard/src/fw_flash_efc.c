@@ -0,0 +1,92 @@
+#include "fw_flash.h"
+#include "asf.h"
+#include <string.h>
+
+#define FW_EFC_EPA_8           0x1u // EPA FARG[1:0]: 8 pages from an 8-page boundary
+#define FW_EFC_ERRORS          (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE | EEFC_FSR_FLERR)
+
+static uint32_t fw_efc_page(uint32_t addr)
+{
+	return (addr - FW_FLASH_BASE) / FW_PAGE_SIZE;
+}
+
+/* Runs from RAM because the flash cannot be read until the command is done.
+ * Interrupts are masked for the same reason: their handlers live in flash.
+ * A page write holds them for about 1.5 ms, an erase for tens of ms, long
+ * enough for CAN frames beyond the RX mailboxes and several ticks to be lost.
+ * fw_update therefore erases one FW_ERASE_SIZE group per DATA request at
+ * most, while the tester waits for the reply, never the whole slot at once.
+ */
+RAMFUNC static uint32_t fw_efc_command(uint32_t fcmd, uint32_t farg)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	EFC->EEFC_FCR = EEFC_FCR_FKEY_PASSWD | EEFC_FCR_FARG(farg) | fcmd;
+	uint32_t fsr;
+	do {
+		fsr = EFC->EEFC_FSR;
+	} while (!(fsr & EEFC_FSR_FRDY));
+	__set_PRIMASK(primask);
+	return fsr;
+}
+
+// Fill the page latch: any word writes into the page's address range
+static void fw_efc_latch(uint32_t addr, const uint32_t *data)
+{
+	volatile uint32_t *latch = (volatile uint32_t *)addr;
+	for (uint32_t i = 0; i < FW_PAGE_SIZE / 4u; i++) {
+		latch[i] = data[i];
+	}
+	__DSB();
+}
+
+// The bootloader itself is never erased or programmed through these
+static bool fw_efc_in_slots(uint32_t addr, uint32_t len)
+{
+	return addr >= FW_APP_ADDR && addr + len <= FW_FLASH_BASE + IFLASH_SIZE;
+}
+
+static bool fw_efc_erase(void *ctx, uint32_t addr)
+{
+	(void)ctx;
+	if (!fw_efc_in_slots(addr, FW_ERASE_SIZE) || (addr % FW_ERASE_SIZE) != 0) return false;
+	uint32_t fsr = fw_efc_command(EEFC_FCR_FCMD_EPA, fw_efc_page(addr) | FW_EFC_EPA_8);
+	return (fsr & FW_EFC_ERRORS) == 0;
+}
+
+static bool fw_efc_write_page(void *ctx, uint32_t addr, const uint32_t *data)
+{
+	(void)ctx;
+	if (!fw_efc_in_slots(addr, FW_PAGE_SIZE) || (addr % FW_PAGE_SIZE) != 0) return false;
+	fw_efc_latch(addr, data);
+	uint32_t fsr = fw_efc_command(EEFC_FCR_FCMD_WP, fw_efc_page(addr));
+	return (fsr & FW_EFC_ERRORS) == 0;
+}
+
+static bool fw_efc_rewrite_page(void *ctx, uint32_t addr, const uint32_t *data)
+{
+	(void)ctx;
+	if (addr != FW_RECORD_ADDR_A && addr != FW_RECORD_ADDR_B) return false; // EWP only works in the small sectors
+	fw_efc_latch(addr, data);
+	uint32_t fsr = fw_efc_command(EEFC_FCR_FCMD_EWP, fw_efc_page(addr));
+	return (fsr & FW_EFC_ERRORS) == 0;
+}
+
+static void fw_efc_read(void *ctx, uint32_t addr, void *buf, uint32_t len)
+{
+	(void)ctx;
+	memcpy(buf, (const void *)addr, len); // Memory mapped
+}
+
+static const fw_flash_t g_fw_flash_efc = {
+	.erase = fw_efc_erase,
+	.write_page = fw_efc_write_page,
+	.rewrite_page = fw_efc_rewrite_page,
+	.read = fw_efc_read,
+	.ctx = NULL,
+};
+
+const fw_flash_t *fw_flash_efc(void)
+{
+	return &g_fw_flash_efc;
+}
@@ -0,0 +1,139 @@
+#include "fw_image.h"
+#include <stddef.h>
+#include <string.h>
+
+// Nibble table: 64 bytes, small enough for the bootloader
+static const uint32_t g_crc32_nibble[16] = {
+	0x00000000u, 0x1DB71064u, 0x3B6E20C8u, 0x26D930ACu,
+	0x76DC4190u, 0x6B6B51F4u, 0x4DB26158u, 0x5005713Cu,
+	0xEDB88320u, 0xF00F9344u, 0xD6D6A3E8u, 0xCB61B38Cu,
+	0x9B64C2B0u, 0x86D3D2D4u, 0xA00AE278u, 0xBDBDF21Cu,
+};
+
+uint32_t fw_crc32(uint32_t crc, const void *data, uint32_t len)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	crc = ~crc;
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ g_crc32_nibble[crc & 0x0Fu];
+		crc = (crc >> 4) ^ g_crc32_nibble[crc & 0x0Fu];
+	}
+	return ~crc;
+}
+
+uint32_t fw_image_crc(const fw_flash_t *flash, uint32_t addr, uint32_t size)
+{
+	uint32_t buf[16];
+	uint32_t crc = 0;
+	while (size != 0) {
+		uint32_t n = (size < sizeof(buf)) ? size : sizeof(buf);
+		flash->read(flash->ctx, addr, buf, n);
+		crc = fw_crc32(crc, buf, n);
+		addr += n;
+		size -= n;
+	}
+	return crc;
+}
+
+bool fw_image_erase(const fw_flash_t *flash, uint32_t addr, uint32_t size)
+{
+	for (uint32_t off = 0; off < size; off += FW_ERASE_SIZE) {
+		if (!flash->erase(flash->ctx, addr + off)) return false;
+	}
+	return true;
+}
+
+static uint32_t fw_record_check(const fw_record_t *rec)
+{
+	return fw_crc32(0, rec, offsetof(fw_record_t, check));
+}
+
+bool fw_record_valid(const fw_record_t *rec)
+{
+	return rec->magic == FW_RECORD_MAGIC &&
+	       rec->state >= FW_RECORD_PENDING && rec->state <= FW_RECORD_REJECTED &&
+	       rec->size != 0 && rec->size <= FW_SLOT_SIZE &&
+	       rec->check == fw_record_check(rec);
+}
+
+bool fw_record_newest(const fw_flash_t *flash, fw_record_t *rec, uint32_t *addr)
+{
+	fw_record_t a, b;
+	flash->read(flash->ctx, FW_RECORD_ADDR_A, &a, sizeof(a));
+	flash->read(flash->ctx, FW_RECORD_ADDR_B, &b, sizeof(b));
+	bool a_ok = fw_record_valid(&a);
+	bool b_ok = fw_record_valid(&b);
+	if (!a_ok && !b_ok) return false;
+
+	bool use_b = b_ok && (!a_ok || (int32_t)(b.seq - a.seq) > 0); // Wrap-safe
+	*rec = use_b ? b : a;
+	if (addr != NULL) *addr = use_b ? FW_RECORD_ADDR_B : FW_RECORD_ADDR_A;
+	return true;
+}
+
+bool fw_record_write(const fw_flash_t *flash, fw_record_state_t state, uint32_t size, uint32_t crc)
+{
+	fw_record_t last;
+	uint32_t last_addr;
+	uint32_t seq = 1;
+	uint32_t addr = FW_RECORD_ADDR_A;
+	if (fw_record_newest(flash, &last, &last_addr)) {
+		seq = last.seq + 1u;
+		addr = (last_addr == FW_RECORD_ADDR_A) ? FW_RECORD_ADDR_B : FW_RECORD_ADDR_A; // Keep the one in force intact
+	}
+
+	uint32_t page[FW_PAGE_SIZE / 4u];
+	memset(page, 0xFF, sizeof(page));
+	fw_record_t *rec = (fw_record_t *)page;
+	rec->magic = FW_RECORD_MAGIC;
+	rec->seq = seq;
+	rec->state = (uint32_t)state;
+	rec->size = size;
+	rec->crc = crc;
+	rec->check = fw_record_check(rec);
+	if (!flash->rewrite_page(flash->ctx, addr, page)) return false;
+
+	fw_record_t readback;
+	flash->read(flash->ctx, addr, &readback, sizeof(readback));
+	return memcmp(&readback, rec, sizeof(readback)) == 0;
+}
+
+// Staging to app slot, page by page; the last page is padded with erased bytes
+static bool fw_image_copy(const fw_flash_t *flash, const fw_record_t *rec)
+{
+	if (!fw_image_erase(flash, FW_APP_ADDR, rec->size)) return false;
+
+	uint32_t page[FW_PAGE_SIZE / 4u];
+	for (uint32_t off = 0; off < rec->size; off += FW_PAGE_SIZE) {
+		uint32_t n = rec->size - off;
+		if (n > FW_PAGE_SIZE) n = FW_PAGE_SIZE;
+		memset(page, 0xFF, sizeof(page));
+		flash->read(flash->ctx, FW_STAGING_ADDR + off, page, n);
+		if (!flash->write_page(flash->ctx, FW_APP_ADDR + off, page)) return false;
+	}
+	return fw_image_crc(flash, FW_APP_ADDR, rec->size) == rec->crc;
+}
+
+fw_boot_result_t fw_image_boot(const fw_flash_t *flash)
+{
+	fw_record_t rec;
+	if (!fw_record_newest(flash, &rec, NULL) || rec.state != FW_RECORD_PENDING) {
+		return FW_BOOT_RUN;
+	}
+
+	// Staging was verified before the record was written; check it again before erasing the app
+	if (fw_image_crc(flash, FW_STAGING_ADDR, rec.size) != rec.crc) {
+		fw_record_write(flash, FW_RECORD_REJECTED, rec.size, rec.crc);
+		return FW_BOOT_REJECTED;
+	}
+
+	for (uint32_t tries = 0; tries < FW_INSTALL_TRIES; tries++) {
+		if (fw_image_copy(flash, &rec)) {
+			// If this write is lost the record is still pending and the copy runs again
+			fw_record_write(flash, FW_RECORD_INSTALLED, rec.size, rec.crc);
+			return FW_BOOT_INSTALLED;
+		}
+	}
+	return FW_BOOT_FAILED;
+}
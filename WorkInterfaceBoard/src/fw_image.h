@@ -0,0 +1,55 @@
+#pragma once
+#include "fw_flash.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Firmware images and boot records (flash map in config/conf_fw_update.h).
+ * A boot record names the image in the staging slot by size and CRC-32. Two
+ * record pages are written alternately, each new record one sequence number
+ * above the newest, so a reset during a record write leaves the previous one
+ * in force: writing a PENDING record is the switch to the new image.
+ * The bootloader copies a pending image into the app slot and marks it
+ * INSTALLED; the copy is repeated from scratch if it is interrupted.
+ * Only fw_flash_t calls, so it runs on a host against a simulated flash.
+ */
+
+#define FW_RECORD_MAGIC        0x46424957u // "WIBF"
+#define FW_INSTALL_TRIES       3u          // Copy attempts per boot before giving up
+
+typedef enum {
+	FW_RECORD_PENDING = 1,   // Staging holds a verified image, install on the next boot
+	FW_RECORD_INSTALLED = 2, // Copied into the app slot and verified
+	FW_RECORD_REJECTED = 3,  // Staging no longer matched the record, app slot untouched
+} fw_record_state_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t seq;   // The valid record with the highest seq is in force
+	uint32_t state; // fw_record_state_t
+	uint32_t size;  // Image bytes
+	uint32_t crc;   // CRC-32 of the image
+	uint32_t check; // CRC-32 of the fields above
+} fw_record_t;
+
+typedef enum {
+	FW_BOOT_RUN = 0,   // Nothing pending, run the app slot as it is
+	FW_BOOT_INSTALLED, // Pending image copied into the app slot
+	FW_BOOT_REJECTED,  // Pending image failed its CRC, kept the old app
+	FW_BOOT_FAILED,    // App slot could not be written, no app to run
+} fw_boot_result_t;
+
+uint32_t fw_crc32(uint32_t crc, const void *data, uint32_t len); // CRC-32 (IEEE), start with 0 and chain
+uint32_t fw_image_crc(const fw_flash_t *flash, uint32_t addr, uint32_t size); // CRC-32 of a flash range
+bool fw_image_erase(const fw_flash_t *flash, uint32_t addr, uint32_t size); // Erase the erase blocks covering a range
+bool fw_record_valid(const fw_record_t *rec); // Magic, state and check word are right
+bool fw_record_newest(const fw_flash_t *flash, fw_record_t *rec, uint32_t *addr); // The record in force and its page, false if none
+bool fw_record_write(const fw_flash_t *flash, fw_record_state_t state, uint32_t size, uint32_t crc); // New record over the older page
+fw_boot_result_t fw_image_boot(const fw_flash_t *flash); // Bootloader step: install a pending image
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,160 @@
+#include "fw_update.h"
+#include "fw_image.h"
+#include <string.h>
+
+enum { FWU_IDLE, FWU_RECEIVING, FWU_COMPLETE };
+
+// Erase groups line up with DATA blocks, so one block needs one erase at most
+typedef char fw_update_erase_per_block[(FW_ERASE_SIZE % FW_UPDATE_BLOCK == 0) ? 1 : -1];
+
+static uint32_t fw_update_get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void fw_update_put32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+// Program the buffered page (padded with erased bytes) at its place in staging
+static bool fw_update_flush(fw_update_t *u)
+{
+	if (u->page_fill == 0) return true;
+	uint8_t *bytes = (uint8_t *)u->page;
+	memset(&bytes[u->page_fill], 0xFF, FW_PAGE_SIZE - u->page_fill);
+	uint32_t addr = FW_STAGING_ADDR + (u->offset - u->page_fill);
+	if (addr >= FW_STAGING_ADDR + u->erased) { // First page of the next erase group
+		if (!u->flash->erase(u->flash->ctx, FW_STAGING_ADDR + u->erased)) return false;
+		u->erased += FW_ERASE_SIZE;
+		u->stats.erases++;
+	}
+	if (!u->flash->write_page(u->flash->ctx, addr, u->page)) return false;
+	u->page_fill = 0;
+	u->stats.pages++;
+	return true;
+}
+
+static fw_update_status_t fw_update_begin(fw_update_t *u, const uint8_t *req, uint32_t len)
+{
+	if (len < 9u) return FW_UPDATE_ERR_LEN;
+	uint32_t size = fw_update_get32(&req[1]);
+	if (size == 0 || size > FW_SLOT_SIZE) return FW_UPDATE_ERR_SIZE;
+
+	u->size = size;
+	u->crc = fw_update_get32(&req[5]);
+	u->offset = 0;
+	u->erased = 0; // Erased as the data arrives
+	u->page_fill = 0;
+	u->state = FWU_RECEIVING;
+	u->stats.started++;
+	return FW_UPDATE_OK;
+}
+
+static fw_update_status_t fw_update_data(fw_update_t *u, const uint8_t *req, uint32_t len)
+{
+	if (len < 5u) return FW_UPDATE_ERR_LEN;
+	if (u->state != FWU_RECEIVING) return FW_UPDATE_ERR_STATE;
+	uint32_t offset = fw_update_get32(&req[1]);
+	uint32_t n = len - 5u;
+	const uint8_t *data = &req[5];
+	if (n > FW_UPDATE_BLOCK) return FW_UPDATE_ERR_LEN;
+	if (offset > u->size || n > u->size - offset) return FW_UPDATE_ERR_SIZE;
+
+	if (offset != u->offset) {
+		if (offset + n <= u->offset) { // Our reply was lost and the block sent again
+			u->stats.repeats++;
+			return FW_UPDATE_OK;
+		}
+		return FW_UPDATE_ERR_OFFSET;
+	}
+
+	uint8_t *bytes = (uint8_t *)u->page;
+	while (n != 0) {
+		uint32_t take = FW_PAGE_SIZE - u->page_fill;
+		if (take > n) take = n;
+		memcpy(&bytes[u->page_fill], data, take);
+		u->page_fill += take;
+		u->offset += take;
+		data += take;
+		n -= take;
+		if (u->page_fill == FW_PAGE_SIZE && !fw_update_flush(u)) {
+			u->state = FWU_IDLE;
+			return FW_UPDATE_ERR_FLASH;
+		}
+	}
+	return FW_UPDATE_OK;
+}
+
+static fw_update_status_t fw_update_end(fw_update_t *u)
+{
+	if (u->state != FWU_RECEIVING || u->offset != u->size) return FW_UPDATE_ERR_STATE;
+	u->state = FWU_IDLE;
+	if (!fw_update_flush(u)) return FW_UPDATE_ERR_FLASH;
+
+	// Read back from flash: covers the transfer and the programming
+	if (fw_image_crc(u->flash, FW_STAGING_ADDR, u->size) != u->crc) return FW_UPDATE_ERR_CRC;
+	if (!fw_record_write(u->flash, FW_RECORD_PENDING, u->size, u->crc)) return FW_UPDATE_ERR_FLASH;
+	u->state = FWU_COMPLETE;
+	u->stats.completed++;
+	return FW_UPDATE_OK;
+}
+
+void fw_update_init(fw_update_t *u, const fw_flash_t *flash)
+{
+	memset(u, 0, sizeof(*u));
+	u->flash = flash;
+	u->state = FWU_IDLE;
+}
+
+uint32_t fw_update_handle(fw_update_t *u, const uint8_t *req, uint32_t len, uint8_t *reply, uint32_t max)
+{
+	if (len == 0 || max < FW_UPDATE_REPLY_MAX) return 0;
+
+	uint8_t cmd = req[0];
+	fw_update_status_t status;
+	uint32_t reply_len = 2;
+	switch (cmd) {
+	case FW_UPDATE_CMD_BEGIN:
+		status = fw_update_begin(u, req, len);
+		reply[2] = (uint8_t)FW_UPDATE_BLOCK;
+		reply[3] = (uint8_t)(FW_UPDATE_BLOCK >> 8);
+		reply_len = 4;
+		break;
+	case FW_UPDATE_CMD_DATA:
+		status = fw_update_data(u, req, len);
+		fw_update_put32(&reply[2], u->offset);
+		reply_len = 6;
+		break;
+	case FW_UPDATE_CMD_END:
+		status = fw_update_end(u);
+		break;
+	case FW_UPDATE_CMD_RESET:
+		status = FW_UPDATE_OK;
+		u->reset_requested = true;
+		break;
+	case FW_UPDATE_CMD_ABORT:
+		status = FW_UPDATE_OK;
+		u->state = FWU_IDLE;
+		break;
+	default:
+		u->stats.errors++;
+		reply[0] = FW_UPDATE_NEGATIVE;
+		reply[1] = cmd;
+		reply[2] = (uint8_t)FW_UPDATE_ERR_CMD;
+		return 3;
+	}
+
+	if (status != FW_UPDATE_OK) u->stats.errors++;
+	reply[0] = (uint8_t)(cmd | FW_UPDATE_REPLY);
+	reply[1] = (uint8_t)status;
+	return reply_len;
+}
+
+bool fw_update_reset_requested(const fw_update_t *u)
+{
+	return u->reset_requested;
+}
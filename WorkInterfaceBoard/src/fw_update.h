@@ -0,0 +1,77 @@
+#pragma once
+#include "fw_flash.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Application-side updater: receives an image into the staging slot.
+ * Transport-neutral request/reply engine, carried over the ISO-TP "fwu"
+ * channel by can_fwu_task. Requests, multi-byte fields little-endian:
+ *
+ *     0x01 BEGIN   size u32, crc u32   start a transfer of size bytes (CRC-32 of the image)
+ *     0x02 DATA    offset u32, bytes   up to FW_UPDATE_BLOCK image bytes at offset
+ *     0x03 END                         check the CRC in flash, write the PENDING record
+ *     0x04 RESET                       restart into the bootloader after the reply
+ *     0x05 ABORT                       forget the transfer
+ *
+ * Replies are the command | 0x40 and a fw_update_status_t, followed for BEGIN
+ * by the block size (u16) and for DATA by the next offset expected (u32).
+ * Unknown commands get 0x7F, command, FW_UPDATE_ERR_CMD.
+ * Staging is erased FW_ERASE_SIZE at a time as DATA reaches it, at most one
+ * erase per DATA, so no request masks interrupts for longer than one erase
+ * and a page write (fw_flash_efc.c). DATA is answered once its pages are in
+ * flash. A DATA the node already has (reply lost) is acknowledged again
+ * without writing.
+ */
+
+#define FW_UPDATE_CMD_BEGIN    0x01u
+#define FW_UPDATE_CMD_DATA     0x02u
+#define FW_UPDATE_CMD_END      0x03u
+#define FW_UPDATE_CMD_RESET    0x04u
+#define FW_UPDATE_CMD_ABORT    0x05u
+#define FW_UPDATE_REPLY        0x40u // Added to the command in the reply
+#define FW_UPDATE_NEGATIVE     0x7Fu // Reply to an unknown command
+
+typedef enum {
+	FW_UPDATE_OK = 0,
+	FW_UPDATE_ERR_CMD,    // Unknown command
+	FW_UPDATE_ERR_LEN,    // Request too short or block too long
+	FW_UPDATE_ERR_STATE,  // No transfer running, or it is not complete
+	FW_UPDATE_ERR_SIZE,   // Image does not fit the slot, or data past its end
+	FW_UPDATE_ERR_OFFSET, // Gap in the data, reply carries the offset expected
+	FW_UPDATE_ERR_FLASH,  // Erase or program failed, transfer dropped
+	FW_UPDATE_ERR_CRC,    // Staging does not match the CRC from BEGIN
+} fw_update_status_t;
+
+typedef struct {
+	uint32_t started;   // BEGIN accepted
+	uint32_t completed; // END accepted, record written
+	uint32_t pages;     // Pages programmed
+	uint32_t erases;    // FW_ERASE_SIZE groups erased
+	uint32_t repeats;   // DATA already received
+	uint32_t errors;    // Requests answered with an error
+} fw_update_stats_t;
+
+typedef struct {
+	const fw_flash_t *flash;
+	uint8_t state;
+	bool reset_requested;
+	uint32_t size;      // From BEGIN
+	uint32_t crc;       // From BEGIN
+	uint32_t offset;    // Image bytes accepted
+	uint32_t erased;    // Staging bytes erased for this transfer
+	uint32_t page_fill; // Of those, bytes still in page[]
+	uint32_t page[FW_PAGE_SIZE / 4u];
+	fw_update_stats_t stats;
+} fw_update_t;
+
+void fw_update_init(fw_update_t *u, const fw_flash_t *flash);
+uint32_t fw_update_handle(fw_update_t *u, const uint8_t *req, uint32_t len, uint8_t *reply, uint32_t max); // Serve one request, returns the reply length
+bool fw_update_reset_requested(const fw_update_t *u); // RESET was acknowledged
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,6 +4,8 @@
 #include "task.h"
 #include "semphr.h"
 #include "can_app.h"
+#include "can_signals.h"
+#include "can_publish.h"
 #include "spi0.h"
 #include "encoder.h"
 
@@ -25,11 +27,14 @@ typedef portTickType TickType_t; // Backward-compatible alias if TickType_t isn'
 
 void task_test(void *arg){
 	(void)arg; // Unused parameter
-	uint8_t msb=0xAA, lsb=0x55; 
+	can_loadcell_t sample;
+	sample.raw_msb = 0xAA;
+	sample.raw_lsb = 0x55;
 	while(1) {
-		uint8_t payload[2] = { msb, lsb };
-		can_app_tx(CAN_ID_LOADCELL, payload, 2); // Publish loadcell sample over CAN
-		vTaskDelay(pdMS_TO_TICKS(100)); // Sample at ~500 Hz  == 2 milli seconds
+		uint32_t datal, datah;
+		can_pack_loadcell(&sample, &datal, &datah);
+		can_publish(CAN_PUBLISH_SLOT(loadcell), datal, datah); // Sent only when the sample changes, or as a heartbeat
+		vTaskDelay(pdMS_TO_TICKS(CAN_MSG_PERIOD_MS(loadcell))); // Sample period from the signal description
 		}
 }
 void create_application_tasks(void)
@@ -37,6 +42,7 @@ void create_application_tasks(void)
 	
 	xTaskCreate(can_rx_task, "canrx", 512, 0, tskIDLE_PRIORITY+2, 0); // CAN RX handler task
 	xTaskCreate(can_status_task, "canstatus", 256, 0, tskIDLE_PRIORITY+1, 0); // CAN status monitoring task
+	xTaskCreate(can_fwu_task, "canfwu", 512, 0, tskIDLE_PRIORITY+1, 0); // Firmware update over CAN (ISO-TP fwu channel)
 	xTaskCreate(task_test, "testTask", 512, 0, tskIDLE_PRIORITY+2, 0); // Load cell sampling task
 	xTaskCreate(encoder1_task, "encoder1", 512, 0, tskIDLE_PRIORITY+2, 0); // Encoder1 reading and CAN transmission task
 } // End create_application_tasks
\ No newline at end of file
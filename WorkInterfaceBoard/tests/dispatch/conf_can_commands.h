@@ -0,0 +1,30 @@
+#pragma once
+
+/* Command table for test_can_dispatch, in place of config/conf_can_commands.h.
+ * TEST_DISPATCH_IDS (5 or 200) commands, test_cmd_<n> on ID 0x40 + 9 n, so
+ * the entries spread over the whole 11-bit range.
+ */
+#define TEST_CMD(CAN_COMMAND, t, u) \
+	CAN_COMMAND(test_cmd_##t##u, 0x40u + 9u * ((t) * 10u + (u)), 0x40u + 9u * ((t) * 10u + (u)))
+#define TEST_CMD_TENS(CAN_COMMAND, t) \
+	TEST_CMD(CAN_COMMAND, t, 0) TEST_CMD(CAN_COMMAND, t, 1) TEST_CMD(CAN_COMMAND, t, 2) \
+	TEST_CMD(CAN_COMMAND, t, 3) TEST_CMD(CAN_COMMAND, t, 4) TEST_CMD(CAN_COMMAND, t, 5) \
+	TEST_CMD(CAN_COMMAND, t, 6) TEST_CMD(CAN_COMMAND, t, 7) TEST_CMD(CAN_COMMAND, t, 8) \
+	TEST_CMD(CAN_COMMAND, t, 9)
+
+#if TEST_DISPATCH_IDS == 5
+#define CAN_COMMAND_TABLE(CAN_COMMAND) \
+	TEST_CMD(CAN_COMMAND, 0, 0) TEST_CMD(CAN_COMMAND, 0, 1) TEST_CMD(CAN_COMMAND, 0, 2) \
+	TEST_CMD(CAN_COMMAND, 0, 3) TEST_CMD(CAN_COMMAND, 0, 4)
+#elif TEST_DISPATCH_IDS == 200
+#define CAN_COMMAND_TABLE(CAN_COMMAND) \
+	TEST_CMD_TENS(CAN_COMMAND, 0) TEST_CMD_TENS(CAN_COMMAND, 1) TEST_CMD_TENS(CAN_COMMAND, 2) \
+	TEST_CMD_TENS(CAN_COMMAND, 3) TEST_CMD_TENS(CAN_COMMAND, 4) TEST_CMD_TENS(CAN_COMMAND, 5) \
+	TEST_CMD_TENS(CAN_COMMAND, 6) TEST_CMD_TENS(CAN_COMMAND, 7) TEST_CMD_TENS(CAN_COMMAND, 8) \
+	TEST_CMD_TENS(CAN_COMMAND, 9) TEST_CMD_TENS(CAN_COMMAND, 10) TEST_CMD_TENS(CAN_COMMAND, 11) \
+	TEST_CMD_TENS(CAN_COMMAND, 12) TEST_CMD_TENS(CAN_COMMAND, 13) TEST_CMD_TENS(CAN_COMMAND, 14) \
+	TEST_CMD_TENS(CAN_COMMAND, 15) TEST_CMD_TENS(CAN_COMMAND, 16) TEST_CMD_TENS(CAN_COMMAND, 17) \
+	TEST_CMD_TENS(CAN_COMMAND, 18) TEST_CMD_TENS(CAN_COMMAND, 19)
+#else
+#error TEST_DISPATCH_IDS must be 5 or 200
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+
+/* Node settings for test_can_node, in place of config/conf_can_node.h: a
+ * fixed node ID and no claims, with the identifier format from
+ * TEST_NODE_EXTENDED (0: 11-bit, 1: 29-bit).
+ */
+#define CONF_CAN_NODE_CLAIM           0
+#define CONF_CAN_NODE_ID              5
+#define CONF_CAN_EXTENDED_ID          TEST_NODE_EXTENDED
+#define CONF_CAN_LEGACY_IDS           0
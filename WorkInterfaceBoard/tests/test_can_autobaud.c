@@ -0,0 +1,93 @@
+/* can_autobaud detection against a simulated listen-mode controller. The
+ * probe decodes the CAN_BR value it is given, as the real one programs it,
+ * and reports what a listener would see on the simulated bus: clean frames
+ * when its bitrate matches the bus within the oscillator tolerance, error
+ * flags otherwise, nothing on a silent bus, only errors on a bus where every
+ * frame is destroyed by error frames.
+ */
+#include "test_host.h"
+#include "can_autobaud.h"
+#include "can_app.h"
+
+#define MCK_HZ 96000000u
+
+typedef struct {
+	uint32_t bus_bps;        // Bitrate the other nodes use, 0 for a silent bus
+	bool error_frames_only;  // Every frame on the bus is broken by an error frame
+	uint32_t quiet_probes;   // Bus silent for this many probes, then traffic starts
+	uint32_t probes;         // Probes made
+} bus_sim_t;
+
+static void probe(void *ctx, const can_bittiming_t *bt, uint32_t can_br, can_autobaud_obs_t *obs)
+{
+	bus_sim_t *bus = ctx;
+	bus->probes++;
+
+	can_bittiming_t programmed;
+	can_bittiming_from_br(can_br, MCK_HZ, &programmed);
+	TEST_CHECK(programmed.brp == bt->brp && programmed.phase2 == bt->phase2);
+
+	if (bus->bus_bps == 0 || bus->probes <= bus->quiet_probes) return; // Nothing on the wire
+	uint64_t frames = (uint64_t)CAN_AUTOBAUD_WINDOW_MS / 10u; // One frame per 10 ms from the other nodes
+	uint32_t diff = (programmed.bitrate > bus->bus_bps) ? programmed.bitrate - bus->bus_bps : bus->bus_bps - programmed.bitrate;
+	bool in_tolerance = (uint64_t)diff * 1000000u / bus->bus_bps <= CAN_BITTIMING_MAX_ERR_PPM;
+	if (!in_tolerance || bus->error_frames_only) {
+		obs->errors = (uint32_t)frames; // Stuffing/form/CRC errors, or the error flags themselves
+		return;
+	}
+	obs->frames = (uint32_t)frames;
+}
+
+int main(void)
+{
+	can_bittiming_t cands[CAN_AUTOBAUD_MAX_CANDIDATES];
+	uint32_t n = can_autobaud_candidates(MCK_HZ, CAN_BAUD_KBPS * 1000u, cands, CAN_AUTOBAUD_MAX_CANDIDATES);
+	printf("candidates:");
+	for (uint32_t i = 0; i < n; i++) printf(" %u", (unsigned)cands[i].bitrate);
+	printf("\n");
+	TEST_CHECK(n == 4);
+	TEST_CHECK(cands[0].bitrate == CAN_BAUD_KBPS * 1000u); // Configured rate first, then the list without it
+
+	// Right rate: every supported bus bitrate locks on its own timing
+	const uint32_t rates[] = { CAN_AUTOBAUD_BITRATES };
+	for (uint32_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+		bus_sim_t bus = { .bus_bps = rates[i] };
+		can_bittiming_t locked = {0};
+		TEST_CHECK(can_autobaud_detect(cands, n, probe, &bus, &locked));
+		TEST_CHECK(locked.bitrate == rates[i]);
+		TEST_CHECK(CAN_BITTIMING_CONST_BR(MCK_HZ, rates[i]) == can_bittiming_to_br(&locked));
+		printf("bus at %7u bit/s: locked at %7u after %u probes\n", (unsigned)rates[i], (unsigned)locked.bitrate,
+		       (unsigned)bus.probes);
+	}
+
+	// Silent bus: every candidate is tried for every round, nothing locks
+	bus_sim_t silent = { .bus_bps = 0 };
+	TEST_CHECK(!can_autobaud_detect(cands, n, probe, &silent, NULL));
+	TEST_CHECK(silent.probes == n * CAN_AUTOBAUD_ROUNDS);
+	printf("silent bus: no lock after %u probes\n", (unsigned)silent.probes);
+
+	// Error frames only, at the right rate: errors never lock, whatever the frame count
+	bus_sim_t broken = { .bus_bps = 500000u, .error_frames_only = true };
+	TEST_CHECK(!can_autobaud_detect(cands, n, probe, &broken, NULL));
+	TEST_CHECK(broken.probes == n * CAN_AUTOBAUD_ROUNDS);
+	printf("error-frame-only bus: no lock after %u probes\n", (unsigned)broken.probes);
+
+	// A bitrate not in the list is not mistaken for a neighbour
+	bus_sim_t odd = { .bus_bps = 333333u };
+	TEST_CHECK(!can_autobaud_detect(cands, n, probe, &odd, NULL));
+
+	// Traffic starts during the second round: still found, at the right rate
+	bus_sim_t late = { .bus_bps = 125000u, .quiet_probes = n };
+	can_bittiming_t locked = {0};
+	TEST_CHECK(can_autobaud_detect(cands, n, probe, &late, &locked) && locked.bitrate == 125000u);
+
+	// Acceptance itself
+	can_autobaud_obs_t obs = { CAN_AUTOBAUD_MIN_FRAMES, 0 };
+	TEST_CHECK(can_autobaud_accept(&obs));
+	obs.errors = 1;
+	TEST_CHECK(!can_autobaud_accept(&obs));
+	obs = (can_autobaud_obs_t){ CAN_AUTOBAUD_MIN_FRAMES - 1u, 0 };
+	TEST_CHECK(!can_autobaud_accept(&obs));
+
+	return test_result("can_autobaud");
+}
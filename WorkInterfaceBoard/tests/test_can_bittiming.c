@@ -0,0 +1,130 @@
+/* can_bittiming_solve() over every MCK from 48 to 120 MHz in 250 kHz steps
+ * and every supported bitrate (CAN_AUTOBAUD_BITRATES), against a brute-force
+ * search of all register values ranked by the same criteria. Also checks the
+ * hardware limits, the CAN_BR round trip and the compile-time table in
+ * config/conf_can_bittiming.h. */
+#include "test_host.h"
+#include "can_bittiming.h"
+
+static const uint32_t g_rates[] = { CAN_AUTOBAUD_BITRATES };
+#define RATE_COUNT (sizeof(g_rates) / sizeof(g_rates[0]))
+
+static int64_t absdiff(int64_t a, int64_t b)
+{
+	return (a > b) ? a - b : b - a;
+}
+
+// Ranking key, smaller is better: error, sample point distance, -SJW, -TQ, -PROPAG
+static void rank(int64_t key[5], uint32_t err, uint32_t sp, uint32_t wanted_sp, uint32_t sjw, uint32_t tq, uint32_t propag)
+{
+	key[0] = err;
+	key[1] = absdiff(sp, wanted_sp);
+	key[2] = -(int64_t)sjw;
+	key[3] = -(int64_t)tq;
+	key[4] = -(int64_t)propag;
+}
+
+static bool key_less(const int64_t a[5], const int64_t b[5])
+{
+	for (uint32_t k = 0; k < 5; k++) {
+		if (a[k] != b[k]) return a[k] < b[k];
+	}
+	return false;
+}
+
+// Every register value the hardware accepts; false if none is within tolerance
+static bool reference_best(uint32_t mck, uint32_t bps, uint32_t sp, int64_t best[5])
+{
+	bool found = false;
+	for (uint32_t brp = 2; brp <= 128; brp++) {
+		for (uint32_t propag = 1; propag <= 8; propag++) {
+			for (uint32_t phase1 = 1; phase1 <= 8; phase1++) {
+				for (uint32_t phase2 = 2; phase2 <= 8; phase2++) {
+					uint32_t tq = 1 + propag + phase1 + phase2;
+					if (tq < 8 || tq > 25) continue;
+					uint64_t div = (uint64_t)brp * tq;
+					uint32_t rate = (uint32_t)((mck + div / 2u) / div);
+					uint32_t err = (uint32_t)((uint64_t)absdiff(rate, bps) * 1000000u / bps);
+					if (err > CAN_BITTIMING_MAX_ERR_PPM) continue;
+					uint32_t cand_sp = ((1 + propag + phase1) * 1000u + tq / 2u) / tq;
+					uint32_t sjw = phase1 < phase2 ? phase1 : phase2;
+					if (sjw > 4) sjw = 4;
+					int64_t key[5];
+					rank(key, err, cand_sp, sp, sjw, tq, propag);
+					if (!found || key_less(key, best)) {
+						for (uint32_t k = 0; k < 5; k++) best[k] = key[k];
+						found = true;
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
+
+static void test_exhaustive(void)
+{
+	uint32_t checked = 0, solved = 0;
+	uint32_t unsolved[RATE_COUNT] = {0};
+	for (uint32_t mck = 48000000u; mck <= 120000000u; mck += 250000u) {
+		for (uint32_t r = 0; r < RATE_COUNT; r++) {
+			uint32_t bps = g_rates[r];
+			uint32_t sp = CAN_BITTIMING_SAMPLE_POINT(bps);
+			can_bittiming_t bt;
+			int64_t best[5];
+			bool ok = can_bittiming_solve(mck, bps, (uint16_t)sp, &bt);
+			bool exists = reference_best(mck, bps, sp, best);
+			checked++;
+			TEST_CHECK(ok == exists);
+			if (!ok || !exists) {
+				unsolved[r]++;
+				continue;
+			}
+			solved++;
+
+			uint32_t tq = 1u + bt.propag + bt.phase1 + bt.phase2;
+			int64_t key[5];
+			rank(key, bt.err_ppm, bt.sample_point, sp, bt.sjw, tq, bt.propag);
+			TEST_CHECK(!key_less(best, key) && !key_less(key, best)); // Same rank as the best
+
+			TEST_CHECK(bt.brp >= 2 && bt.brp <= 128);
+			TEST_CHECK(bt.propag >= 1 && bt.propag <= 8 && bt.phase1 >= 1 && bt.phase1 <= 8);
+			TEST_CHECK(bt.phase2 >= 2 && bt.phase2 <= 8 && tq >= 8 && tq <= 25);
+			TEST_CHECK(bt.sjw >= 1 && bt.sjw <= 4 && bt.sjw <= bt.phase1 && bt.sjw <= bt.phase2);
+			TEST_CHECK(bt.err_ppm <= CAN_BITTIMING_MAX_ERR_PPM);
+
+			can_bittiming_t back;
+			can_bittiming_from_br(can_bittiming_to_br(&bt), mck, &back);
+			TEST_CHECK(back.brp == bt.brp && back.propag == bt.propag && back.phase1 == bt.phase1);
+			TEST_CHECK(back.phase2 == bt.phase2 && back.sjw == bt.sjw && back.sample_point == bt.sample_point);
+		}
+	}
+	printf("%u clock/bitrate pairs, %u solved; unsolvable within %u ppm:", (unsigned)checked, (unsigned)solved,
+	       (unsigned)CAN_BITTIMING_MAX_ERR_PPM);
+	for (uint32_t r = 0; r < RATE_COUNT; r++) printf(" %u at %u bit/s", (unsigned)unsolved[r], (unsigned)g_rates[r]);
+	printf("\n");
+}
+
+// The compile-time rows must be what the solver returns
+#define KNOWN_ROW(unused, mck, bps, brp, propag, phase1, phase2, sjw) { mck, bps, CAN_BITTIMING_BR(brp, propag, phase1, phase2, sjw) },
+static const uint32_t g_known[][3] = {
+	CAN_BITTIMING_KNOWN(KNOWN_ROW, 0)
+};
+
+static void test_known_table(void)
+{
+	for (uint32_t i = 0; i < sizeof(g_known) / sizeof(g_known[0]); i++) {
+		can_bittiming_t bt;
+		TEST_CHECK(can_bittiming_solve(g_known[i][0], g_known[i][1], CAN_BITTIMING_SAMPLE_POINT(g_known[i][1]), &bt));
+		TEST_CHECK(can_bittiming_to_br(&bt) == g_known[i][2]);
+		TEST_CHECK(CAN_BITTIMING_CONST_BR(g_known[i][0], g_known[i][1]) == g_known[i][2]);
+	}
+	TEST_CHECK(CAN_BITTIMING_CONST_BR(48000000u, 500000u) == 0); // Not listed
+}
+
+int main(void)
+{
+	test_exhaustive();
+	test_known_table();
+	return test_result("can_bittiming");
+}
@@ -0,0 +1,91 @@
+/* can_dispatch.c built twice, with 5 and with 200 registered commands
+ * (dispatch/conf_can_commands.h), each under its own names. Every ID must reach
+ * its handler. The request was constant cost from 5 to 200 IDs, so the cost of
+ * the first and last entry in both builds is reported, read from the time
+ * stamp counter where there is one, else in ns. The spread is printed, not
+ * checked: on a shared host it is timer and scheduler noise as much as code.
+ */
+#include "test_host.h"
+#include "can_dispatch.h" // Built with TEST_DISPATCH_IDS=200, so all handlers are declared
+
+bool can_dispatch_5(const can_rx_frame_t *frame);
+can_cmd_handler_t can_dispatch_lookup_5(uint32_t id);
+bool can_dispatch_200(const can_rx_frame_t *frame);
+can_cmd_handler_t can_dispatch_lookup_200(uint32_t id);
+
+static uint32_t g_last_handler;
+static uint32_t g_last_id;
+
+#define TEST_HANDLER(handler, first_id, last_id) \
+	void handler(const can_rx_frame_t *frame) { g_last_handler = (first_id); g_last_id = frame->id; }
+CAN_COMMAND_TABLE(TEST_HANDLER)
+
+typedef bool (*dispatch_fn_t)(const can_rx_frame_t *frame);
+
+static void check_routing(dispatch_fn_t dispatch, uint32_t count)
+{
+	for (uint32_t id = 0; id < 0x800u; id++) {
+		can_rx_frame_t frame = {0};
+		frame.id = id;
+		g_last_handler = 0xFFFFFFFFu;
+		bool registered = id >= 0x40u && (id - 0x40u) % 9u == 0 && (id - 0x40u) / 9u < count;
+		TEST_CHECK(dispatch(&frame) == registered);
+		if (registered) TEST_CHECK(g_last_handler == id && g_last_id == id);
+	}
+	can_rx_frame_t bad = {0};
+	bad.id = 0x800u; // Not an 11-bit ID
+	TEST_CHECK(!dispatch(&bad));
+}
+
+// Cheapest of many batches of dispatches of one ID, per dispatch
+static double dispatch_cost(dispatch_fn_t dispatch, uint32_t id)
+{
+	enum { BATCH = 1000, TRIALS = 2000 };
+	can_rx_frame_t frame = {0};
+	frame.id = id;
+	uint64_t best = UINT64_MAX;
+	for (uint32_t t = 0; t < TRIALS; t++) {
+		uint64_t start = test_cost_now();
+		for (uint32_t i = 0; i < BATCH; i++) {
+			__asm__ volatile("" ::: "memory"); // Keep every call
+			(void)dispatch(&frame);
+		}
+		uint64_t cost = test_cost_now() - start;
+		if (cost < best) best = cost;
+	}
+	return (double)best / BATCH;
+}
+
+int main(void)
+{
+	check_routing(can_dispatch_5, 5);
+	check_routing(can_dispatch_200, 200);
+
+	const struct {
+		const char *what;
+		dispatch_fn_t dispatch;
+		uint32_t id;
+	} cases[] = {
+		{"5 IDs, first entry", can_dispatch_5, 0x40u},
+		{"5 IDs, last entry", can_dispatch_5, 0x40u + 9u * 4u},
+		{"5 IDs, unregistered", can_dispatch_5, 0x7FFu},
+		{"200 IDs, first entry", can_dispatch_200, 0x40u},
+		{"200 IDs, last entry", can_dispatch_200, 0x40u + 9u * 199u},
+		{"200 IDs, unregistered", can_dispatch_200, 0x7FFu},
+	};
+	double cost[6];
+	for (uint32_t i = 0; i < 6; i++) {
+		cost[i] = dispatch_cost(cases[i].dispatch, cases[i].id);
+		printf("%-22s %6.2f %s per dispatch\n", cases[i].what, cost[i], TEST_COST_UNIT);
+	}
+	// Registered IDs: same work whatever the table size or position
+	double lo = cost[0], hi = cost[0];
+	const uint32_t registered[] = {0, 1, 3, 4};
+	for (uint32_t i = 0; i < 4; i++) {
+		if (cost[registered[i]] < lo) lo = cost[registered[i]];
+		if (cost[registered[i]] > hi) hi = cost[registered[i]];
+	}
+	printf("spread over table sizes and positions: %.2f (reported only)\n", hi / lo);
+
+	return test_result("can_dispatch");
+}
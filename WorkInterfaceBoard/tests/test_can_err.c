@@ -0,0 +1,207 @@
+/* can_err.c against a mocked controller: CAN_SR/CAN_ECR are set by hand and
+ * CAN_IER/CAN_IDR writes are folded into an interrupt mask, so CAN0_Handler
+ * only runs for flags it enabled. Walks error active -> warning -> passive ->
+ * bus-off -> recovery, then repeated bus-offs through the backoff hold.
+ * Time is in bit times at 500 kbit/s (2 us each); 1 ms is 500 bits.
+ */
+#include "test_host.h"
+#include "can_err.h"
+#include "can.h"
+#include "FreeRTOS.h"
+#include "timers.h"
+
+#define BITS_PER_MS    500u
+#define RECOVERY_BITS  (128u * 11u) // Bus-off recovery sequence
+
+static Can g_can;
+static uint32_t g_imr; // Interrupts enabled through CAN_IER/CAN_IDR
+static uint64_t g_now;
+static bool g_held;
+static uint64_t g_released_at;
+static tmrTIMER_CALLBACK g_timer_cb;
+static int64_t g_timer_expiry = -1; // Bit time the backoff timer fires, -1 while stopped
+
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+void vPortYieldFromISR(void) {}
+uint64_t can_time_now(void) { return g_now; }
+uint64_t can_time_now_from_isr(void) { return g_now; }
+uint64_t can_time_to_us(uint64_t t) { return t * 2u; }
+uint8_t can_get_tx_error_cnt(Can *p_can) { return (uint8_t)(p_can->CAN_ECR >> 16); }
+uint8_t can_get_rx_error_cnt(Can *p_can) { return (uint8_t)p_can->CAN_ECR; }
+
+void can_tx_hold(bool hold)
+{
+	g_held = hold;
+	if (!hold) g_released_at = g_now;
+}
+
+xTimerHandle xTimerCreate(const signed char *pcTimerName, portTickType xTimerPeriodInTicks, unsigned portBASE_TYPE uxAutoReload,
+                          void *pvTimerID, tmrTIMER_CALLBACK pxCallbackFunction)
+{
+	g_timer_cb = pxCallbackFunction;
+	return (xTimerHandle)&g_timer_cb;
+}
+
+portBASE_TYPE xTimerGenericCommand(xTimerHandle xTimer, portBASE_TYPE xCommandID, portTickType xOptionalValue,
+                                   signed portBASE_TYPE *pxHigherPriorityTaskWoken, portTickType xBlockTime)
+{
+	TEST_CHECK(xCommandID == tmrCOMMAND_CHANGE_PERIOD); // Starts the one-shot
+	g_timer_expiry = (int64_t)(g_now + (uint64_t)xOptionalValue * portTICK_RATE_MS * BITS_PER_MS);
+	if (pxHigherPriorityTaskWoken != NULL) *pxHigherPriorityTaskWoken = pdTRUE;
+	return pdPASS;
+}
+
+static void fold_irq_writes(void)
+{
+	g_imr = (g_imr | g_can.CAN_IER) & ~g_can.CAN_IDR;
+	g_can.CAN_IER = 0;
+	g_can.CAN_IDR = 0;
+}
+
+// Controller reports new flags and counters; the ISR runs if an enabled flag is set
+static void controller(uint32_t sr, uint8_t tec, uint8_t rec)
+{
+	TEST_SET_RO(g_can.CAN_SR, sr);
+	TEST_SET_RO(g_can.CAN_ECR, ((uint32_t)tec << 16) | rec);
+	if (sr & g_imr) (void)can_err_isr(sr);
+	fold_irq_writes();
+}
+
+// Let time pass, firing the backoff timer when it is due
+static void advance(uint64_t bits)
+{
+	uint64_t until = g_now + bits;
+	while (g_now < until) {
+		g_now++;
+		if (g_timer_expiry >= 0 && (int64_t)g_now >= g_timer_expiry) {
+			g_timer_expiry = -1;
+			g_timer_cb(NULL);
+		}
+	}
+}
+
+/* One bus-off: enter, recover after the 128 x 11 bit sequence, wait for the
+ * TX queue to be released. Returns entry-to-release in us. */
+static uint64_t bus_off_cycle(void)
+{
+	uint64_t entered = g_now;
+	controller(CAN_SR_BOFF, 255, 0);
+	TEST_CHECK(can_err_state() == CAN_ERR_BUS_OFF);
+	TEST_CHECK(g_held);
+	TEST_CHECK(g_imr == CAN_SR_ERRA); // Only the way out
+	advance(RECOVERY_BITS);
+	controller(CAN_SR_ERRA, 0, 0);
+	TEST_CHECK(g_imr == (CAN_SR_WARN | CAN_SR_ERRP | CAN_SR_BOFF));
+	for (uint32_t guard = 0; g_held && guard < 2000u * BITS_PER_MS; guard++) advance(1);
+	TEST_CHECK(!g_held);
+	TEST_CHECK(can_err_state() == CAN_ERR_ACTIVE);
+	return (g_released_at - entered) * 2u;
+}
+
+static void test_confinement_states(void)
+{
+	TEST_SET_RO(g_can.CAN_SR, CAN_SR_ERRA);
+	TEST_CHECK(can_err_init(&g_can, 500000u));
+	fold_irq_writes();
+	TEST_CHECK(can_err_state() == CAN_ERR_ACTIVE);
+	TEST_CHECK(g_imr == (CAN_SR_WARN | CAN_SR_ERRP | CAN_SR_BOFF));
+
+	advance(100);
+	controller(CAN_SR_ERRA | CAN_SR_WARN, 96, 0);
+	TEST_CHECK(can_err_state() == CAN_ERR_WARNING);
+	TEST_CHECK(g_imr == (CAN_SR_ERRP | CAN_SR_BOFF));
+
+	controller(CAN_SR_ERRA | CAN_SR_WARN, 110, 0); // Level still set, no interrupt enabled for it
+	TEST_CHECK(can_err_state() == CAN_ERR_WARNING);
+
+	advance(100);
+	controller(CAN_SR_WARN | CAN_SR_ERRP, 128, 0);
+	TEST_CHECK(can_err_state() == CAN_ERR_PASSIVE);
+	TEST_CHECK(g_imr == (CAN_SR_ERRA | CAN_SR_BOFF));
+	TEST_CHECK(!g_held); // Passive still transmits
+
+	// Back to active raises ERRA, which passive enabled
+	controller(CAN_SR_ERRA, 20, 0);
+	TEST_CHECK(can_err_state() == CAN_ERR_ACTIVE);
+	TEST_CHECK(g_imr == (CAN_SR_WARN | CAN_SR_ERRP | CAN_SR_BOFF));
+
+	// Passive again, then bus-off
+	controller(CAN_SR_WARN | CAN_SR_ERRP, 200, 0);
+	advance(1000);
+	uint64_t us = bus_off_cycle();
+	printf("first bus-off: TX released %llu us after entry (recovery sequence %u us)\n",
+	       (unsigned long long)us, (unsigned)(RECOVERY_BITS * 2u));
+	TEST_CHECK(us == RECOVERY_BITS * 2u); // No backoff for a single bus-off
+
+	can_err_event_t log[CAN_ERR_LOG_LEN];
+	uint32_t n = can_err_get_log(log, CAN_ERR_LOG_LEN);
+	const uint8_t expected[][2] = {
+		{CAN_ERR_ACTIVE, CAN_ERR_WARNING}, {CAN_ERR_WARNING, CAN_ERR_PASSIVE}, {CAN_ERR_PASSIVE, CAN_ERR_ACTIVE},
+		{CAN_ERR_ACTIVE, CAN_ERR_PASSIVE}, {CAN_ERR_PASSIVE, CAN_ERR_BUS_OFF}, {CAN_ERR_BUS_OFF, CAN_ERR_ACTIVE},
+	};
+	TEST_CHECK(n == 6);
+	for (uint32_t i = 0; i < n && i < 6; i++) {
+		TEST_CHECK(log[i].from == expected[i][0] && log[i].to == expected[i][1]);
+	}
+	TEST_CHECK(n >= 5 && log[4].tec == 255);
+}
+
+static void test_backoff(void)
+{
+	// Repeats within CAN_ERR_STREAK_MS of the last release: 10 ms, 20 ms, 40 ms ... up to the maximum
+	uint64_t expected_backoff_ms = CAN_ERR_BACKOFF_FIRST_MS;
+	for (uint32_t repeat = 2; repeat <= 10; repeat++) {
+		advance(100u * BITS_PER_MS);
+		uint64_t us = bus_off_cycle();
+		can_err_stats_t st;
+		can_err_get_stats(&st);
+		printf("bus-off %u in a row: backoff %u ms, released after %llu us\n", (unsigned)st.streak,
+		       (unsigned)st.backoff_ms, (unsigned long long)us);
+		TEST_CHECK(st.streak == repeat);
+		TEST_CHECK(st.backoff_ms == expected_backoff_ms);
+		TEST_CHECK(us == RECOVERY_BITS * 2u + expected_backoff_ms * 1000u);
+		TEST_CHECK(st.backoff_ms == can_err_backoff_ms(repeat));
+		expected_backoff_ms *= 2u;
+		if (expected_backoff_ms > CAN_ERR_BACKOFF_MAX_MS) expected_backoff_ms = CAN_ERR_BACKOFF_MAX_MS;
+	}
+
+	// Bus-off while the backoff still holds TX: the hold carries on, streak grows
+	can_err_stats_t before;
+	can_err_get_stats(&before);
+	advance(100u * BITS_PER_MS);
+	controller(CAN_SR_BOFF, 255, 0);
+	advance(RECOVERY_BITS);
+	controller(CAN_SR_ERRA, 0, 0);
+	TEST_CHECK(can_err_state() == CAN_ERR_BACKOFF);
+	TEST_CHECK(g_held);
+	TEST_CHECK(g_imr == (CAN_SR_WARN | CAN_SR_ERRP | CAN_SR_BOFF));
+	advance(5u * BITS_PER_MS);
+	controller(CAN_SR_BOFF, 255, 0);
+	TEST_CHECK(can_err_state() == CAN_ERR_BUS_OFF);
+	can_err_stats_t during;
+	can_err_get_stats(&during);
+	TEST_CHECK(during.streak == before.streak + 2u);
+	advance(RECOVERY_BITS);
+	controller(CAN_SR_ERRA, 0, 0);
+	for (uint32_t guard = 0; g_held && guard < 2000u * BITS_PER_MS; guard++) advance(1);
+	TEST_CHECK(!g_held && can_err_state() == CAN_ERR_ACTIVE);
+
+	// Quiet for longer than CAN_ERR_STREAK_MS: the next bus-off counts as the first again
+	advance((CAN_ERR_STREAK_MS + 10u) * BITS_PER_MS);
+	uint64_t us = bus_off_cycle();
+	can_err_stats_t st;
+	can_err_get_stats(&st);
+	TEST_CHECK(st.streak == 1 && st.backoff_ms == 0);
+	TEST_CHECK(us == RECOVERY_BITS * 2u);
+	TEST_CHECK(st.max_recovery_us == RECOVERY_BITS * 2u + CAN_ERR_BACKOFF_MAX_MS * 1000u);
+	printf("after %u ms quiet: released after %llu us; %u bus-offs, longest recovery %u us\n",
+	       (unsigned)(CAN_ERR_STREAK_MS + 10u), (unsigned long long)us, (unsigned)st.bus_off, (unsigned)st.max_recovery_us);
+}
+
+int main(void)
+{
+	test_confinement_states();
+	test_backoff();
+	return test_result("can_err");
+}
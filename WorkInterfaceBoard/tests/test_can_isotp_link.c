@@ -0,0 +1,203 @@
+/* Two can_isotp_link engines back to back on a simulated 500 kbit/s bus:
+ * frames go out one at a time in queue order, each taking its stuffed bit
+ * length on the wire, then complete on the sender and arrive at the peer.
+ * Reports payload throughput in kB/s, checks the data arrives intact, and
+ * that a frame which never leaves its mailbox ends the transfer after N_As.
+ */
+#include "test_host.h"
+#include "can_isotp_link.h"
+#include <string.h>
+
+#define BUS_BPS      500000u
+#define QUEUE_LEN    32u
+
+typedef struct {
+	uint8_t from; // Link index
+	uint8_t len;
+	uint8_t data[8];
+} wire_t;
+
+static wire_t g_queue[QUEUE_LEN];
+static uint32_t g_head, g_count;
+static bool g_stuck;  // Frames are queued but never sent
+static uint32_t g_refuse_every; // Refuse every nth emit, as a full TX queue would (0 = never)
+static uint32_t g_emits;
+
+static can_isotp_link_t g_link[2];
+static uint8_t g_buf[4][CAN_ISOTP_MAX_LEN];
+
+static bool emit(void *ctx, const uint8_t *data, uint8_t len)
+{
+	g_emits++;
+	if (g_count == QUEUE_LEN || (g_refuse_every != 0 && g_emits % g_refuse_every == 0)) return false;
+	wire_t *w = &g_queue[(g_head + g_count++) % QUEUE_LEN];
+	w->from = (uint8_t)(uintptr_t)ctx;
+	w->len = len;
+	memcpy(w->data, data, len);
+	return true;
+}
+
+// Classic data frame with an 11-bit ID: 47 bits of framing plus the worst case stuff bits
+static uint64_t frame_us(uint8_t len)
+{
+	uint32_t bits = 47u + 8u * len + (34u + 8u * len - 1u) / 4u;
+	return (uint64_t)bits * 1000000u / BUS_BPS;
+}
+
+static void setup(uint8_t block_size, uint8_t st_min)
+{
+	for (uint32_t i = 0; i < 2; i++) {
+		memset(&g_link[i], 0, sizeof(g_link[i]));
+		g_link[i].emit = emit;
+		g_link[i].ctx = (void *)(uintptr_t)i;
+		g_link[i].tx_buf = g_buf[2 * i];
+		g_link[i].tx_size = CAN_ISOTP_MAX_LEN;
+		g_link[i].rx_buf = g_buf[2 * i + 1];
+		g_link[i].rx_size = CAN_ISOTP_MAX_LEN;
+		g_link[i].block_size = block_size;
+		g_link[i].st_min = st_min;
+		can_isotp_link_init(&g_link[i]);
+	}
+	g_head = g_count = 0;
+	g_stuck = false;
+	g_refuse_every = 0;
+	g_emits = 0;
+}
+
+// Run the bus and the timers until both links are idle or until; returns the time reached
+static uint64_t run(uint64_t now, uint64_t until)
+{
+	while (now < until) {
+		if (g_count != 0 && !g_stuck) {
+			wire_t w = g_queue[g_head];
+			g_head = (g_head + 1u) % QUEUE_LEN;
+			g_count--;
+			now += frame_us(w.len);
+			can_isotp_link_on_tx_done(&g_link[w.from], now);
+			can_isotp_link_on_frame(&g_link[w.from ^ 1u], w.data, w.len, now);
+			continue;
+		}
+		uint64_t next = can_isotp_link_next_event(&g_link[0]);
+		uint64_t t = can_isotp_link_next_event(&g_link[1]);
+		if (t < next) next = t;
+		if (next == CAN_ISOTP_NO_EVENT) break;
+		if (next > now) now = next;
+		can_isotp_link_poll(&g_link[0], now);
+		can_isotp_link_poll(&g_link[1], now);
+	}
+	return now;
+}
+
+static uint32_t rng_state = 2024u;
+static uint8_t rng(void)
+{
+	rng_state = rng_state * 1664525u + 1013904223u;
+	return (uint8_t)(rng_state >> 24);
+}
+
+// Send messages of len bytes from link 0 to link 1; returns payload kB/s on the simulated bus
+static double transfer(uint32_t len, uint32_t messages, uint8_t block_size, uint8_t st_min)
+{
+	static uint8_t msg[CAN_ISOTP_MAX_LEN], got[CAN_ISOTP_MAX_LEN];
+	setup(block_size, st_min);
+	uint64_t now = 0;
+	for (uint32_t m = 0; m < messages; m++) {
+		for (uint32_t i = 0; i < len; i++) msg[i] = rng();
+		TEST_CHECK(can_isotp_link_send(&g_link[0], msg, len, now));
+		now = run(now, UINT64_MAX);
+		TEST_CHECK(!can_isotp_link_tx_busy(&g_link[0]));
+		TEST_CHECK(can_isotp_link_read(&g_link[1], got, sizeof(got)) == (int32_t)len);
+		TEST_CHECK(memcmp(msg, got, len) == 0);
+	}
+	TEST_CHECK(g_link[0].stats.tx_done == messages && g_link[1].stats.rx_done == messages);
+	TEST_CHECK(g_link[0].stats.tx_stalled == 0);
+	return (double)len * messages * 1e3 / (double)now; // bytes per ms = kB/s
+}
+
+static void test_throughput(void)
+{
+	// Raw payload limit: 8-byte frames back to back, of which a CF carries 7
+	double wire = 7.0 * 1e3 / (double)frame_us(8);
+	printf("bus %u kbit/s, CF carries at most %.1f kB/s\n", (unsigned)(BUS_BPS / 1000u), wire);
+
+	const struct { uint32_t len; uint8_t bs; uint8_t st; } cases[] = {
+		{ 7, 0, 0 }, { 64, 0, 0 }, { 1024, 0, 0 }, { 4095, 0, 0 }, { 4095, 8, 0 }, { 4095, 0, 1 },
+	};
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		double kbs = transfer(cases[i].len, 20, cases[i].bs, cases[i].st);
+		printf("%4u-byte messages, BS %u, STmin %u ms: %.1f kB/s\n", (unsigned)cases[i].len,
+		       (unsigned)cases[i].bs, (unsigned)cases[i].st, kbs);
+		if (cases[i].len == 4095u && cases[i].bs == 0 && cases[i].st == 0) TEST_CHECK(kbs > 0.9 * wire);
+	}
+
+	// A TX queue that refuses every fifth frame still gets everything across
+	static uint8_t msg[1000], got[1000];
+	setup(0, 0);
+	g_refuse_every = 5;
+	for (uint32_t i = 0; i < sizeof(msg); i++) msg[i] = rng();
+	uint64_t now = 0;
+	for (uint32_t tries = 0; !can_isotp_link_send(&g_link[0], msg, sizeof(msg), now) && tries < 2; tries++) {}
+	now = run(now, UINT64_MAX);
+	TEST_CHECK(can_isotp_link_read(&g_link[1], got, sizeof(got)) == (int32_t)sizeof(msg));
+	TEST_CHECK(memcmp(msg, got, sizeof(msg)) == 0);
+}
+
+static void test_n_as(void)
+{
+	static uint8_t msg[100];
+	setup(0, 0);
+
+	// First frame queued but the bus never takes it (bus-off, TX held)
+	g_stuck = true;
+	TEST_CHECK(can_isotp_link_send(&g_link[0], msg, sizeof(msg), 0));
+	TEST_CHECK(can_isotp_link_next_event(&g_link[0]) == CAN_ISOTP_N_AS_US);
+	can_isotp_link_poll(&g_link[0], CAN_ISOTP_N_AS_US - 1u);
+	TEST_CHECK(can_isotp_link_tx_busy(&g_link[0]));
+	uint64_t now = run(0, 10u * CAN_ISOTP_N_AS_US);
+	TEST_CHECK(now == CAN_ISOTP_N_AS_US);
+	TEST_CHECK(!can_isotp_link_tx_busy(&g_link[0]));
+	TEST_CHECK(g_link[0].tx_in_flight == 0);
+	TEST_CHECK(g_link[0].stats.tx_stalled == 1 && g_link[0].stats.tx_timeout == 0);
+	TEST_CHECK(can_isotp_link_next_event(&g_link[0]) == CAN_ISOTP_NO_EVENT);
+
+	// Stuck in the middle of the consecutive frames, single frame stuck in TX_DRAIN
+	setup(0, 0);
+	TEST_CHECK(can_isotp_link_send(&g_link[0], msg, sizeof(msg), 0));
+	now = run(0, 1000); // First frame, flow control and a few CFs
+	TEST_CHECK(g_link[0].tx_in_flight != 0 && g_link[0].tx_pos > 6u);
+	g_stuck = true;
+	now = run(now, now + 10u * CAN_ISOTP_N_AS_US);
+	TEST_CHECK(!can_isotp_link_tx_busy(&g_link[0]) && g_link[0].stats.tx_stalled == 1);
+	setup(0, 0);
+	g_stuck = true;
+	TEST_CHECK(can_isotp_link_send(&g_link[0], msg, 5, 0));
+	run(0, 10u * CAN_ISOTP_N_AS_US);
+	TEST_CHECK(!can_isotp_link_tx_busy(&g_link[0]) && g_link[0].stats.tx_stalled == 1);
+
+	// The bus comes back: the stale frame's late completion is ignored and the link is usable again
+	g_stuck = false;
+	now = run(10u * CAN_ISOTP_N_AS_US, UINT64_MAX);
+	static uint8_t got[sizeof(msg)];
+	TEST_CHECK(g_link[0].tx_in_flight == 0 && !can_isotp_link_tx_busy(&g_link[0]));
+	TEST_CHECK(can_isotp_link_read(&g_link[1], got, sizeof(got)) == 5);
+	for (uint32_t i = 0; i < sizeof(msg); i++) msg[i] = (uint8_t)i;
+	TEST_CHECK(can_isotp_link_send(&g_link[0], msg, sizeof(msg), now));
+	run(now, UINT64_MAX);
+	TEST_CHECK(can_isotp_link_read(&g_link[1], got, sizeof(got)) == (int32_t)sizeof(msg));
+	TEST_CHECK(memcmp(msg, got, sizeof(msg)) == 0);
+	TEST_CHECK(g_link[0].stats.tx_done == 1);
+
+	// Slow but moving: each completion restarts N_As, so a long message is not cut short
+	setup(0, 0);
+	static uint8_t big[CAN_ISOTP_MAX_LEN];
+	TEST_CHECK(can_isotp_link_send(&g_link[0], big, sizeof(big), 0));
+	now = run(0, UINT64_MAX);
+	TEST_CHECK(now > CAN_ISOTP_N_AS_US / 10u && g_link[0].stats.tx_done == 1 && g_link[0].stats.tx_stalled == 0);
+}
+
+int main(void)
+{
+	test_throughput();
+	test_n_as();
+	return test_result("can_isotp_link");
+}
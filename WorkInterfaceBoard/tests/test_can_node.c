@@ -0,0 +1,152 @@
+/* can_node.c's bus ID mapping at node 5, built once per identifier format
+ * (TEST_NODE_EXTENDED): message IDs become CAN_MID values and come back from
+ * them, RX filters from can_node_mam() take this node's frames and no other
+ * board's, and with 29-bit IDs a message ID's extension reaches the bus and
+ * the filters compare it. Then can_tx.c on a mocked controller: extended
+ * message IDs keep their extension through the queue and leave in bus ID
+ * order.
+ */
+#include "test_host.h"
+#include "can_node.h"
+#include "can_tx.h"
+#include "can_app.h"
+#include "can.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define NODE           5u
+#define OTHER          6u
+
+static Can g_can;
+
+// Collaborators of can_node.c and can_tx.c
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+void can_mailbox_init(Can *p_can, can_mb_conf_t *p_mailbox) { (void)p_can; (void)p_mailbox; }
+uint16_t can_sched_asap_timemark(void) { return 0; }
+void can_stats_on_tx(uint32_t id, uint8_t len, uint32_t latency_us) {}
+uint64_t can_time_now(void) { return 0; }
+uint64_t can_time_now_from_isr(void) { return 0; }
+uint64_t can_time_extend_from_isr(uint16_t stamp) { return stamp; }
+uint16_t can_time_mailbox_stamp(uint32_t msr) { return 0; }
+uint64_t can_time_to_us(uint64_t t) { return t; }
+
+// Acceptance as the controller decides it: IDE too once CAN_MAM.MIDE is set
+static bool accepts(uint32_t mam, uint32_t mb_mid, uint32_t frame_mid)
+{
+	uint32_t cmp = mam & (CAN_MAM_MIDvA_Msk | CAN_MAM_MIDvB_Msk | CAN_MAM_MIDE);
+	return ((mb_mid ^ frame_mid) & cmp) == 0;
+}
+
+// CAN_MID of a frame another board sends with message ID id
+static uint32_t other_mid(uint32_t id)
+{
+#if CONF_CAN_EXTENDED_ID
+	return (can_node_mid(id) & ~CAN_MID_MIDvB(0xFFu)) | CAN_MID_MIDvB((((id >> 11) & 0x3FFu) << 8) | OTHER);
+#else
+	return CAN_MID_MIDvA(id | OTHER);
+#endif
+}
+
+static void test_mapping(void)
+{
+	const uint32_t ids[] = { CAN_ID_STOP, CAN_ID_ENCODER1, CAN_ID_DIAG_REQUEST, CAN_ID_FWU_RX, CAN_ID_CLAIM | 0x35u };
+	for (uint32_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+		uint32_t id = ids[i];
+		bool block = id >= CAN_NODE_BLOCK_FIRST && id <= CAN_NODE_BLOCK_LAST;
+		uint32_t mid = can_node_mid(id);
+		TEST_CHECK(can_node_from_mid(mid) == id);
+		TEST_CHECK(((mid & CAN_MID_MIDE) != 0) == (CONF_CAN_EXTENDED_ID != 0));
+		uint32_t mam = can_node_mam(id, CAN_NODE_MSG_MASK);
+		TEST_CHECK(accepts(mam, mid, mid));
+		if (block) {
+			TEST_CHECK(can_node_from_mid(other_mid(id)) != id);
+			TEST_CHECK(!accepts(mam, mid, other_mid(id)));
+		}
+		TEST_CHECK(!accepts(mam, mid, can_node_mid(id ^ 0x400u)));
+	}
+
+	// A range filter (can_rx.c): the block's IDs for this node only
+	uint32_t mam = can_node_mam(0x200u, 0x700u), mid = can_node_mid(0x200u);
+	TEST_CHECK(accepts(mam, mid, can_node_mid(CAN_ID_DIAG_REQUEST)));
+	TEST_CHECK(!accepts(mam, mid, other_mid(CAN_ID_DIAG_REQUEST)));
+	TEST_CHECK(!accepts(mam, mid, can_node_mid(CAN_ID_ENCODER1)));
+
+#if CONF_CAN_EXTENDED_ID
+	// Extensions: the upper ten bits of a message ID fill bits 17..8 of the bus ID
+	const uint32_t ext_ids[] = { CAN_NODE_EXT_ID(CAN_ID_ENCODER1, 1u), CAN_NODE_EXT_ID(CAN_ID_ENCODER1, 0x3FFu),
+	                             CAN_NODE_EXT_ID(CAN_ID_STOP, 0x2AAu) };
+	for (uint32_t i = 0; i < sizeof(ext_ids) / sizeof(ext_ids[0]); i++) {
+		uint32_t id = ext_ids[i], base = id & 0x7FFu;
+		uint32_t mid = can_node_mid(id);
+		uint32_t bus = mid & (CAN_MID_MIDvA_Msk | CAN_MID_MIDvB_Msk);
+		bool block = base >= CAN_NODE_BLOCK_FIRST && base <= CAN_NODE_BLOCK_LAST;
+		TEST_CHECK(bus == ((base << 18) | ((id >> 11) << 8) | (block ? NODE : 0u)));
+		TEST_CHECK(can_node_from_mid(mid) == id);
+		uint32_t mam = can_node_mam(id, CAN_NODE_MSG_MASK);
+		TEST_CHECK(accepts(mam, mid, mid));
+		TEST_CHECK(!accepts(mam, mid, can_node_mid(base))); // Exact filter: other extensions stay out
+		TEST_CHECK(!accepts(can_node_mam(base, CAN_NODE_MSG_MASK), can_node_mid(base), mid));
+		TEST_CHECK(accepts(can_node_mam(base, 0x7FFu), can_node_mid(base), mid)); // Any extension
+		if (block) TEST_CHECK(!accepts(mam, mid, other_mid(id)));
+	}
+	// Standard frames stay out of 29-bit filters, whatever their ID
+	TEST_CHECK(!accepts(can_node_mam(CAN_ID_STOP, 0u), can_node_mid(CAN_ID_STOP), CAN_MID_MIDvA(CAN_ID_STOP)));
+#else
+	// 11-bit IDs have no room for an extension: it is dropped
+	TEST_CHECK(can_node_mid(CAN_NODE_EXT_ID(CAN_ID_ENCODER1, 1u)) == can_node_mid(CAN_ID_ENCODER1));
+#endif
+}
+
+/* Frames queued while held leave in bus ID order with their extension
+ * intact; of the loaded mailboxes the lowest bus ID wins, as on the wire */
+static void test_tx(void)
+{
+#if CONF_CAN_EXTENDED_ID
+	const uint32_t ids[] = {
+		CAN_NODE_EXT_ID(CAN_ID_STATUS, 3u), CAN_ID_STATUS, CAN_NODE_EXT_ID(CAN_ID_ENCODER1, 0x3FFu),
+		CAN_NODE_EXT_ID(CAN_ID_STOP, 1u), CAN_ID_ENCODER1, CAN_NODE_EXT_ID(CAN_ID_STATUS, 1u),
+	};
+#else
+	const uint32_t ids[] = { CAN_ID_STATUS, CAN_ID_DIAG, CAN_ID_STOP, CAN_ID_ENCODER1, CAN_ID_LOADCELL };
+#endif
+	const uint32_t n = sizeof(ids) / sizeof(ids[0]);
+	can_tx_init(&g_can);
+	can_tx_hold(true);
+	for (uint32_t i = 0; i < n; i++) TEST_CHECK(can_tx_enqueue_words(ids[i], i, 0, 8));
+	can_tx_hold(false);
+
+	uint32_t loaded = 0, sent = 0, last = 0;
+	uint32_t mb_bus[CAN_TX_MB_FIRST + CAN_TX_MB_COUNT];
+	for (;;) {
+		for (uint32_t mb = CAN_TX_MB_FIRST; mb < CAN_TX_MB_FIRST + CAN_TX_MB_COUNT; mb++) {
+			CanMb *p_mb = &g_can.CAN_MB[mb];
+			if (!(p_mb->CAN_MCR & CAN_MCR_MTCR)) continue;
+			p_mb->CAN_MCR = 0;
+			TEST_CHECK(can_node_from_mid(p_mb->CAN_MID) == ids[p_mb->CAN_MDL]);
+			mb_bus[mb] = p_mb->CAN_MID & (CAN_MID_MIDvA_Msk | CAN_MID_MIDvB_Msk);
+			loaded |= 1u << mb;
+		}
+		if (loaded == 0) break;
+		uint32_t win = 32u;
+		for (uint32_t b = loaded; b != 0; b &= b - 1u) {
+			uint32_t mb = (uint32_t)__builtin_ctz(b);
+			if (win == 32u || mb_bus[mb] < mb_bus[win]) win = mb;
+		}
+		TEST_CHECK(sent == 0 || mb_bus[win] > last);
+		last = mb_bus[win];
+		sent++;
+		loaded &= ~(1u << win);
+		TEST_SET_RO(g_can.CAN_MB[win].CAN_MSR, 0);
+		can_tx_isr(1u << win);
+	}
+	TEST_CHECK(sent == n);
+}
+
+int main(void)
+{
+	TEST_CHECK(can_node_init() == NODE);
+	test_mapping();
+	test_tx();
+	return test_result(CONF_CAN_EXTENDED_ID ? "can_node (29-bit)" : "can_node (11-bit)");
+}
@@ -0,0 +1,245 @@
+/* can_node_claim.c with up to 16 boards on a simulated bus: claims go out in
+ * CAN ID order (CAN_ID_CLAIM plus seven bits of the board's first name, as
+ * can_node_announce() sends them, then queue order), 250 us a frame, and
+ * every other board receives each one. A board has one claim waiting at most,
+ * replaced by a newer one as a latest-value frame. Boards answer as can_node.c does: defend, move and
+ * claim again, or take the next name round. However the unique IDs fall,
+ * including 16 boards whose claims share one CAN ID and two whose unique IDs
+ * fold to the same name, every board ends up holding its own node ID, the
+ * lowest name of a power-up holds node 0 and a lone board keeps node 0 (the
+ * IDs without a node offset). A late board never takes a held node ID.
+ */
+#include "test_host.h"
+#include "can_node_claim.h"
+#include <string.h>
+
+#define BOARDS         16u
+#define NODES          16u  // CAN_NODE_COUNT, 11-bit IDs
+#define FRAME_US       250u
+#define QUEUE_LEN      BOARDS // One claim per board
+#define SPREAD         0x7Fu // CAN_NODE_ID_CLAIM_SPREAD
+
+typedef struct {
+	uint32_t uid[4];
+	uint32_t round;
+	uint32_t claim_id; // Seven bits of the first name
+	can_node_claim_t c;
+	bool on;
+} board_t;
+
+typedef struct {
+	uint32_t id;   // Claim CAN ID, low bits
+	uint32_t seq;  // Queue order between equal IDs
+	uint32_t from;
+	can_node_claim_msg_t m;
+} frame_t;
+
+static board_t g_boards[BOARDS];
+static frame_t g_queue[QUEUE_LEN];
+static uint32_t g_count, g_seq;
+static uint64_t g_us;
+static uint32_t g_frames, g_same_id; // Frames sent; sends with another claim of the same ID waiting
+
+static uint32_t rng_state = 1u;
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 1664525u + 1013904223u;
+	return rng_state;
+}
+
+static uint32_t now_ms(void)
+{
+	return (uint32_t)(g_us / 1000u);
+}
+
+static void announce(uint32_t b)
+{
+	for (uint32_t i = 0; i < g_count; i++) {
+		if (g_queue[i].from == b) {
+			can_node_claim_msg(&g_boards[b].c, &g_queue[i].m); // Replaced in place
+			return;
+		}
+	}
+	TEST_CHECK(g_count < QUEUE_LEN);
+	if (g_count == QUEUE_LEN) return;
+	frame_t *f = &g_queue[g_count++];
+	can_node_claim_msg(&g_boards[b].c, &f->m);
+	f->id = g_boards[b].claim_id;
+	f->seq = g_seq++;
+	f->from = b;
+}
+
+static void boot(uint32_t b, uint64_t name)
+{
+	g_boards[b].on = true;
+	g_boards[b].round = 0;
+	g_boards[b].claim_id = (uint32_t)(name & SPREAD);
+	can_node_claim_start(&g_boards[b].c, name, NODES, 0, now_ms());
+	announce(b);
+}
+
+static void boot_uid(uint32_t b)
+{
+	boot(b, can_node_claim_name(g_boards[b].uid, 0));
+}
+
+// Send the claims in bus order and age the claims until every board holds
+static void run(void)
+{
+	for (;;) {
+		while (g_count != 0) {
+			uint32_t best = 0;
+			for (uint32_t i = 1; i < g_count; i++) {
+				if (g_queue[i].id < g_queue[best].id ||
+				    (g_queue[i].id == g_queue[best].id && g_queue[i].seq < g_queue[best].seq)) {
+					best = i;
+				}
+			}
+			frame_t f = g_queue[best];
+			g_queue[best] = g_queue[--g_count];
+			for (uint32_t i = 0; i < g_count; i++) {
+				if (g_queue[i].id == f.id && g_queue[i].from != f.from) {
+					g_same_id++;
+					break;
+				}
+			}
+			g_us += FRAME_US;
+			g_frames++;
+			for (uint32_t b = 0; b < BOARDS; b++) {
+				if (!g_boards[b].on || b == f.from) continue;
+				board_t *bd = &g_boards[b];
+				can_node_claim_action_t a = can_node_claim_on_msg(&bd->c, &f.m, now_ms());
+				if (a == CAN_NODE_CLAIM_RENAME) {
+					can_node_claim_rename(&bd->c, can_node_claim_name(bd->uid, ++bd->round), now_ms());
+				}
+				if (a != CAN_NODE_CLAIM_NONE) announce(b);
+			}
+		}
+		g_us += (CAN_NODE_CLAIM_MS + 1u) * 1000u;
+		bool all = true;
+		for (uint32_t b = 0; b < BOARDS; b++) {
+			if (!g_boards[b].on) continue;
+			(void)can_node_claim_tick(&g_boards[b].c, now_ms());
+			all &= g_boards[b].c.held;
+		}
+		if (all && g_count == 0) return;
+	}
+}
+
+static void reset(void)
+{
+	memset(g_boards, 0, sizeof(g_boards));
+	g_count = 0;
+	g_us = 0;
+	g_frames = 0;
+	g_same_id = 0;
+}
+
+static void random_uid(uint32_t uid[4])
+{
+	for (uint32_t i = 0; i < 4u; i++) uid[i] = rng();
+}
+
+// Every board on holds a node ID of its own, and with lowest_at_0 the lowest name holds node 0
+static bool settled(bool lowest_at_0)
+{
+	uint32_t seen = 0, lowest = BOARDS;
+	for (uint32_t b = 0; b < BOARDS; b++) {
+		if (!g_boards[b].on) continue;
+		const can_node_claim_t *c = &g_boards[b].c;
+		if (!c->held || c->node >= NODES || (seen & (1u << c->node))) return false;
+		seen |= 1u << c->node;
+		if (lowest == BOARDS || c->name < g_boards[lowest].c.name) lowest = b;
+	}
+	return !lowest_at_0 || lowest == BOARDS || g_boards[lowest].c.node == 0;
+}
+
+int main(void)
+{
+	// Alone on the bus: node 0, nothing to answer
+	reset();
+	random_uid(g_boards[0].uid);
+	boot_uid(0);
+	run();
+	TEST_CHECK(settled(true) && g_boards[0].c.node == 0 && g_boards[0].c.moves == 0 && g_frames == 1u);
+
+	// 16 boards powered together, 200 sets of unique IDs
+	uint32_t frames_max = 0, ok = 0, same_id = 0;
+	for (uint32_t run_no = 0; run_no < 200u; run_no++) {
+		reset();
+		for (uint32_t b = 0; b < BOARDS; b++) random_uid(g_boards[b].uid);
+		for (uint32_t b = 0; b < BOARDS; b++) boot_uid(b);
+		run();
+		ok += settled(true) ? 1u : 0u;
+		if (g_frames > frames_max) frames_max = g_frames;
+		same_id += g_same_id;
+	}
+	printf("16 boards, 200 boots: %u settled, up to %u claim frames, %u sends with an equal claim ID waiting\n",
+	       (unsigned)ok, (unsigned)frames_max, (unsigned)same_id);
+	TEST_CHECK(ok == 200u);
+
+	// 16 boards whose claims all share one CAN ID: the names still decide
+	reset();
+	uint32_t found = 0;
+	while (found < BOARDS) {
+		uint32_t uid[4];
+		random_uid(uid);
+		if ((can_node_claim_name(uid, 0) & SPREAD) != 0x2Au) continue;
+		memcpy(g_boards[found++].uid, uid, sizeof(uid));
+	}
+	for (uint32_t b = 0; b < BOARDS; b++) boot_uid(b);
+	run();
+	uint32_t moves_max = 0;
+	for (uint32_t b = 0; b < BOARDS; b++) {
+		if (g_boards[b].c.moves > moves_max) moves_max = g_boards[b].c.moves;
+	}
+	printf("16 boards on one claim ID: %u claim frames, %u moves at most\n", (unsigned)g_frames, (unsigned)moves_max);
+	TEST_CHECK(settled(true) && g_same_id > 0);
+
+	// Two unique IDs folding to the same name, booted together: the first to hear the
+	// other takes its next round, and its waiting claim goes out under the new name
+	reset();
+	random_uid(g_boards[0].uid);
+	random_uid(g_boards[1].uid);
+	uint64_t clash = can_node_claim_name(g_boards[0].uid, 0);
+	boot(0, clash);
+	boot(1, clash);
+	run();
+	TEST_CHECK(settled(true) && g_boards[0].c.renames + g_boards[1].c.renames == 1u);
+	uint32_t renamed = (g_boards[1].c.renames != 0) ? 1u : 0u;
+	TEST_CHECK(g_boards[renamed].c.name == can_node_claim_name(g_boards[renamed].uid, 1));
+	TEST_CHECK(g_boards[renamed ^ 1u].c.name == clash);
+
+	// The same clash when one of them already holds node 0, with other boards around
+	reset();
+	for (uint32_t b = 0; b < 5u; b++) {
+		random_uid(g_boards[b].uid);
+		boot_uid(b);
+	}
+	run();
+	uint32_t holder = 0;
+	for (uint32_t b = 0; b < 5u; b++) {
+		if (g_boards[b].c.node == 0) holder = b;
+	}
+	random_uid(g_boards[5].uid);
+	boot(5, g_boards[holder].c.name);
+	run();
+	// Only the holder hears the clash; its new name goes against the newcomer's for node 0
+	TEST_CHECK(settled(false) && g_boards[holder].c.renames == 1u && g_boards[5].c.renames == 0u);
+
+	// A late board with the lowest name possible: held node IDs stay, it takes the next free one
+	reset();
+	uint32_t nodes[4];
+	for (uint32_t b = 0; b < 4u; b++) {
+		random_uid(g_boards[b].uid);
+		boot_uid(b);
+	}
+	run();
+	for (uint32_t b = 0; b < 4u; b++) nodes[b] = g_boards[b].c.node;
+	boot(4, 1u);
+	run();
+	for (uint32_t b = 0; b < 4u; b++) TEST_CHECK(g_boards[b].c.node == nodes[b]);
+	TEST_CHECK(g_boards[4].c.held && g_boards[4].c.node == 4u && g_boards[4].c.moves == 4u);
+
+	return test_result("can_node_claim");
+}
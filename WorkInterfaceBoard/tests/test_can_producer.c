@@ -0,0 +1,156 @@
+/* can_producer.c against a mocked controller: the encoder1 producer mailbox
+ * answers remote frames from whatever it was last loaded with, MACR aborts it
+ * unless the reply is already on the wire, and CAN0_Handler runs right after
+ * either. The value changes every 1 ms sample while a master polls every
+ * 7 or 25 ms: every poll is answered with a value at most
+ * CONF_CAN_PRODUCER_REFRESH_MS old, and the mailbox is aborted at most once
+ * per CONF_CAN_PRODUCER_REFRESH_MS rather than once per sample. A steady value
+ * costs nothing, and an abort that comes too late still counts the reply.
+ */
+#include "test_host.h"
+#include "can_producer.h"
+#include "can_signals.h"
+#include "can.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define SECONDS        10u
+
+static Can g_can;
+static portTickType g_ms;
+
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+portTickType xTaskGetTickCount(void) { return g_ms; }
+portTickType xTaskGetTickCountFromISR(void) { return g_ms; }
+bool can_rx_accepts(uint32_t id) { return false; }
+uint32_t can_node_mid(uint32_t id) { return CAN_MID_MIDvA(id); }
+uint32_t can_node_mam(uint32_t id, uint32_t mask) { return CAN_MAM_MIDvA(mask); }
+
+static uint8_t g_mb_type[CANMB_NUMBER];
+void can_mailbox_init(Can *p_can, can_mb_conf_t *p_mailbox) { g_mb_type[p_mailbox->ul_mb_idx] = p_mailbox->uc_obj_type; }
+
+#define MB             (CAN_PRODUCER_MB_FIRST + can_producer_slot_encoder1)
+
+static bool g_armed;       // Waiting for a remote frame
+static uint32_t g_value;   // What it would answer with
+static bool g_on_wire;     // The next MACR comes too late
+static uint32_t g_irqs;
+
+static void isr(uint32_t msr)
+{
+	TEST_SET_RO(g_can.CAN_MB[MB].CAN_MSR, msr);
+	g_irqs++;
+	can_producer_isr(1u << MB);
+}
+
+// Pick up what can_producer wrote to the mailbox
+static void notice(void)
+{
+	for (;;) {
+		uint32_t mcr = g_can.CAN_MB[MB].CAN_MCR;
+		g_can.CAN_MB[MB].CAN_MCR = 0;
+		if (mcr & CAN_MCR_MTCR) {
+			g_armed = true;
+			g_value = g_can.CAN_MB[MB].CAN_MDL;
+			TEST_CHECK(((mcr & CAN_MCR_MDLC_Msk) >> CAN_MCR_MDLC_Pos) == CAN_MSG_DLC(encoder1));
+		} else if ((mcr & CAN_MCR_MACR) && g_armed) {
+			g_armed = false;
+			isr(g_on_wire ? CAN_MSR_MRDY : (CAN_MSR_MRDY | CAN_MSR_MABT)); // Reply sent anyway, or aborted
+			g_on_wire = false;
+		} else {
+			return;
+		}
+	}
+}
+
+// A remote frame for encoder1: the reply if armed, UINT32_MAX if not
+static uint32_t poll(void)
+{
+	if (!g_armed) return UINT32_MAX;
+	uint32_t reply = g_value;
+	g_armed = false;
+	isr(CAN_MSR_MRDY);
+	notice();
+	return reply;
+}
+
+// A new value every 1 ms sample (the sample time, so a reply shows its age), a poll every poll_ms
+static void run(uint32_t poll_ms)
+{
+	can_producer_stats_t before, st;
+	can_producer_get_stats(&before);
+	uint32_t polls = 0, replies = 0, age_max = 0, irqs = g_irqs;
+	for (uint32_t i = 1; i <= SECONDS * 1000u; i++, g_ms++) {
+		TEST_CHECK(can_producer_update(CAN_MSG_ID(encoder1), (uint32_t)g_ms, 0));
+		notice();
+		if (i % poll_ms != 0) continue;
+		polls++;
+		uint32_t reply = poll();
+		if (reply == UINT32_MAX) continue;
+		replies++;
+		if (g_ms - reply > age_max) age_max = g_ms - reply;
+	}
+	can_producer_get_stats(&st);
+	uint32_t answered = st.answered - before.answered, aborts = st.aborts - before.aborts;
+	printf("value every 1 ms, poll every %2u ms for %u s: %u polls, %u answered, reply up to %u ms old, "
+	       "%u aborts, %u interrupts (%u samples)\n",
+	       (unsigned)poll_ms, (unsigned)SECONDS, (unsigned)polls, (unsigned)answered, (unsigned)age_max,
+	       (unsigned)aborts, (unsigned)(g_irqs - irqs), (unsigned)(SECONDS * 1000u));
+	TEST_CHECK(replies == polls && answered == polls);
+	TEST_CHECK(age_max <= CONF_CAN_PRODUCER_REFRESH_MS);
+	TEST_CHECK(aborts <= SECONDS * 1000u / CONF_CAN_PRODUCER_REFRESH_MS + 1u);
+	TEST_CHECK(g_irqs - irqs == answered + aborts);
+}
+
+int main(void)
+{
+	g_ms = 1;
+	TEST_CHECK(can_producer_init(&g_can) == CAN_PRODUCER_COUNT);
+	TEST_CHECK(g_mb_type[MB] == CAN_MB_PRODUCER_MODE);
+	notice();
+	TEST_CHECK(!g_armed); // Nothing to answer with yet
+
+	// Polled faster than the refresh limit: every reply re-arms, nothing to abort
+	run(7);
+	can_producer_stats_t st;
+	can_producer_get_stats(&st);
+	TEST_CHECK(st.aborts == 0);
+	// Polled slower: the armed value is replaced at most once per refresh period
+	run(25);
+	can_producer_get_stats(&st);
+	TEST_CHECK(st.aborts > 0);
+
+	// A steady value: after it is loaded, no aborts and no interrupts but the polls
+	uint32_t steady = (uint32_t)g_ms;
+	for (uint32_t i = 0; i < 1000u; i++, g_ms++) {
+		TEST_CHECK(can_producer_update(CAN_MSG_ID(encoder1), steady, 0));
+		notice();
+	}
+	can_producer_stats_t before;
+	can_producer_get_stats(&before);
+	uint32_t irqs = g_irqs;
+	for (uint32_t i = 0; i < 1000u; i++, g_ms++) {
+		TEST_CHECK(can_producer_update(CAN_MSG_ID(encoder1), steady, 0));
+		notice();
+		if (i % 7u == 0) TEST_CHECK(poll() == steady);
+	}
+	can_producer_get_stats(&st);
+	TEST_CHECK(st.aborts == before.aborts && st.updates == before.updates);
+	TEST_CHECK(g_irqs - irqs == st.answered - before.answered);
+
+	// The abort loses the race with a remote frame: the reply still counts, the new value follows
+	g_ms += CONF_CAN_PRODUCER_REFRESH_MS;
+	g_on_wire = true;
+	TEST_CHECK(can_producer_update(CAN_MSG_ID(encoder1), steady + 1u, 0));
+	notice();
+	can_producer_stats_t after;
+	can_producer_get_stats(&after);
+	TEST_CHECK(after.aborts == st.aborts + 1u && after.answered == st.answered + 1u);
+	TEST_CHECK(g_armed && g_value == steady + 1u);
+
+	// No producer for an ID outside the table
+	TEST_CHECK(!can_producer_update(0x7FEu, 0, 0));
+
+	return test_result("can_producer");
+}
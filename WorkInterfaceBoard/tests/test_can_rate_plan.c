@@ -0,0 +1,129 @@
+/* can_rate_other_load() and can_rate_plan() on a simulated shared bus at
+ * 500 kbit/s: N boards with the configured CAN_RATE_TABLE each plan on their
+ * own, one load window per step. A board sees only its own frames (the RX
+ * filters hide the rest) and learns about the others from how many of its
+ * frames find the bus busy, drawn with a probability equal to their load.
+ * Once settled, the bus must stay under CONF_CAN_RATE_TARGET_PERMILLE for
+ * every node count, and close to it when the boards are throttled.
+ */
+#include "test_host.h"
+#include "can_rate_plan.h"
+#include "can_stats.h"
+#include "can_signals.h"
+#include "conf_can_rate.h"
+
+#define BITRATE      500000u
+#define WINDOW_MS    1000u
+#define MAX_NODES    64u
+#define WINDOWS      200u
+#define SETTLED      50u // Windows allowed for the estimates to converge
+
+#define GEN_SIGNAL(msg, min, max, prio) { .min_ms = (min), .max_ms = (max), .priority = (prio) },
+#define GEN_DLC(msg, min, max, prio) CAN_MSG_DLC(msg),
+static const uint8_t g_dlc[] = { CAN_RATE_TABLE(GEN_DLC) };
+#define SIGNALS (sizeof(g_dlc) / sizeof(g_dlc[0]))
+
+typedef struct {
+	can_rate_state_t state;
+	uint32_t period_ms[SIGNALS];
+	uint32_t load_milli; // Own load, permille x 1000
+	uint32_t plan_permille; // can_rate_status_t.plan_permille
+} node_t;
+
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+
+static can_rate_signal_t g_sig[SIGNALS] = { CAN_RATE_TABLE(GEN_SIGNAL) };
+static node_t g_node[MAX_NODES];
+
+static uint32_t rng_state = 99u;
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 1664525u + 1013904223u;
+	return rng_state >> 8;
+}
+
+static uint32_t node_load_milli(const node_t *n, uint32_t *frames)
+{
+	uint64_t milli = 0;
+	*frames = 0;
+	for (uint32_t i = 0; i < SIGNALS; i++) {
+		milli += (uint64_t)g_sig[i].frame_bits * 1000000000u / ((uint64_t)n->period_ms[i] * BITRATE);
+		*frames += WINDOW_MS / n->period_ms[i];
+	}
+	return (uint32_t)milli;
+}
+
+/* nodes boards on a bus that also carries background_permille of fixed traffic;
+ * returns the highest bus load after SETTLED windows, *mean the average */
+static uint32_t simulate(uint32_t nodes, uint32_t background_permille, uint32_t *mean)
+{
+	for (uint32_t k = 0; k < nodes; k++) {
+		g_node[k] = (node_t){0};
+		g_node[k].plan_permille = can_rate_plan(g_sig, SIGNALS, 1000u, BITRATE, g_node[k].period_ms); // can_rate_init()
+	}
+
+	uint32_t worst = 0;
+	uint64_t sum = 0;
+	for (uint32_t w = 0; w < WINDOWS; w++) {
+		uint32_t frames[MAX_NODES];
+		uint64_t total_milli = (uint64_t)background_permille * 1000u;
+		for (uint32_t k = 0; k < nodes; k++) {
+			g_node[k].load_milli = node_load_milli(&g_node[k], &frames[k]);
+			total_milli += g_node[k].load_milli;
+		}
+		uint32_t total = (uint32_t)((total_milli + 999u) / 1000u);
+		if (total > 1000u) total = 1000u;
+		if (w >= SETTLED) {
+			if (total > worst) worst = total;
+			sum += total;
+		}
+
+		for (uint32_t k = 0; k < nodes; k++) {
+			uint64_t others = total_milli - g_node[k].load_milli;
+			can_rate_window_t win = {0};
+			win.own_permille = (g_node[k].load_milli + 999u) / 1000u;
+			win.seen_permille = win.own_permille;
+			win.tx_frames = frames[k];
+			for (uint32_t f = 0; f < frames[k]; f++) {
+				if ((uint64_t)(rng() % 1000000u) < others) win.tx_waited++;
+			}
+			uint32_t other = can_rate_other_load(&g_node[k].state, &win);
+			uint32_t budget = can_rate_budget(CONF_CAN_RATE_TARGET_PERMILLE, other, g_node[k].plan_permille);
+			g_node[k].plan_permille = can_rate_plan(g_sig, SIGNALS, budget, BITRATE, g_node[k].period_ms);
+		}
+	}
+	*mean = (uint32_t)(sum / (WINDOWS - SETTLED));
+	return worst;
+}
+
+int main(void)
+{
+	uint64_t floor_milli = 0, full_milli = 0;
+	for (uint32_t i = 0; i < SIGNALS; i++) {
+		g_sig[i].frame_bits = can_stats_frame_bits(g_dlc[i]);
+		floor_milli += (uint64_t)g_sig[i].frame_bits * 1000000000u / ((uint64_t)g_sig[i].max_ms * BITRATE);
+		full_milli += (uint64_t)g_sig[i].frame_bits * 1000000000u / ((uint64_t)g_sig[i].min_ms * BITRATE);
+	}
+	printf("per board: %.1f permille at min_ms, %.2f at max_ms; target %u permille\n",
+	       full_milli / 1000.0, floor_milli / 1000.0, (unsigned)CONF_CAN_RATE_TARGET_PERMILLE);
+
+	const uint32_t backgrounds[] = { 0, 200 };
+	for (uint32_t b = 0; b < sizeof(backgrounds) / sizeof(backgrounds[0]); b++) {
+		for (uint32_t nodes = 1; nodes <= MAX_NODES; nodes *= 2) {
+			uint32_t mean;
+			uint32_t worst = simulate(nodes, backgrounds[b], &mean);
+			uint32_t unplanned = backgrounds[b] + (uint32_t)((full_milli * nodes) / 1000u);
+			printf("%2u boards, background %3u: bus %3u permille mean, %3u worst (%4u without planning), encoder1 %u ms\n",
+			       (unsigned)nodes, (unsigned)backgrounds[b], (unsigned)mean, (unsigned)worst, (unsigned)unplanned,
+			       (unsigned)g_node[0].period_ms[0]);
+			TEST_CHECK(worst <= CONF_CAN_RATE_TARGET_PERMILLE);
+			if (unplanned <= CONF_CAN_RATE_TARGET_PERMILLE) {
+				TEST_CHECK(g_node[0].period_ms[0] == g_sig[0].min_ms); // Room for everyone: full rate
+			} else {
+				TEST_CHECK(mean >= CONF_CAN_RATE_TARGET_PERMILLE * 9u / 10u); // Throttled, but the room is used
+			}
+		}
+	}
+	return test_result("can_rate_plan");
+}
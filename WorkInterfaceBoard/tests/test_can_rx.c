@@ -0,0 +1,302 @@
+/* can_rx.c with the real can_time.c against a mocked controller on a 500
+ * kbit/s bus at 100 % load: back-to-back frames of random length, mostly this
+ * node's command/status block, some claims, some for nobody. The controller
+ * puts a frame in the lowest free mailbox of the chain its filter set up and
+ * overwrites the last one when all are full. CAN0_Handler runs a random
+ * latency after a mailbox fills and spends a few microseconds per frame, and
+ * frames keep arriving meanwhile, so a pass can re-arm MB6 while MB7 still
+ * holds an older frame. Every accepted frame must reach the ring in bus order
+ * with its own start-of-frame capture as long as the handler keeps within the
+ * chain depth (conf_can_rx.h); past it the losses must show in mb_overrun
+ * and no frame may be a mix of two.
+ */
+#include "test_host.h"
+#include "can_rx.h"
+#include "can_time.h"
+#include "can_app.h"
+#include "conf_can_rx.h"
+#include "can.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include <string.h>
+
+#define BITRATE        500000u
+#define US_PER_BIT     2u
+#define SECONDS        10u
+#define MAX_FRAMES     (BITRATE * SECONDS / 47u + 1u) // Shortest frame plus intermission
+
+static Can g_can;
+static portTickType g_tick;
+
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+portTickType xTaskGetTickCount(void) { return g_tick; }
+portTickType xTaskGetTickCountFromISR(void) { return g_tick; }
+xQueueHandle xQueueGenericCreate(unsigned portBASE_TYPE len, unsigned portBASE_TYPE size, unsigned char type)
+{
+	static int sem;
+	return (xQueueHandle)&sem;
+}
+signed portBASE_TYPE xQueueGenericSend(xQueueHandle q, const void *const item, portTickType wait, portBASE_TYPE pos) { return pdTRUE; }
+signed portBASE_TYPE xQueueGenericSendFromISR(xQueueHandle q, const void *const item, signed portBASE_TYPE *woken, portBASE_TYPE pos) { return pdTRUE; }
+signed portBASE_TYPE xQueueGenericReceive(xQueueHandle q, void *const item, portTickType wait, portBASE_TYPE peek) { return pdFALSE; }
+uint32_t can_node_mid(uint32_t id) { return CAN_MID_MIDvA(id); }
+uint32_t can_node_mam(uint32_t id, uint32_t mask) { return CAN_MAM_MIDvA(mask); }
+uint32_t can_node_from_mid(uint32_t mid) { return (mid & CAN_MID_MIDvA_Msk) >> CAN_MID_MIDvA_Pos; }
+void can_stats_on_rx(uint32_t id, uint8_t len) { (void)id; (void)len; }
+
+// What can_rx_init() set up in each mailbox
+static struct {
+	bool rx;
+	bool overwrite;
+	uint32_t id;
+	uint32_t mask;
+} g_mb[CANMB_NUMBER];
+
+void can_mailbox_init(Can *p_can, can_mb_conf_t *p_mailbox)
+{
+	uint32_t mb = p_mailbox->ul_mb_idx;
+	g_mb[mb].rx = (p_mailbox->uc_obj_type == CAN_MB_RX_MODE || p_mailbox->uc_obj_type == CAN_MB_RX_OVER_WR_MODE);
+	g_mb[mb].overwrite = (p_mailbox->uc_obj_type == CAN_MB_RX_OVER_WR_MODE);
+	g_mb[mb].id = p_mailbox->ul_id;
+	g_mb[mb].mask = p_mailbox->ul_id_msk;
+	TEST_SET_RO(p_can->CAN_MB[mb].CAN_MSR, 0);
+}
+void can_mailbox_send_transfer_cmd(Can *p_can, can_mb_conf_t *p_mailbox) {}
+
+static uint32_t rng_state = 29u;
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 1664525u + 1013904223u;
+	return rng_state >> 8;
+}
+
+typedef struct {
+	uint64_t sof; // Start of frame, bit times
+	uint64_t end; // End of frame, where the controller stores it
+	uint32_t id;
+	uint8_t len;
+	int8_t mb;    // Mailbox it landed in, -1 if no filter took it
+} bus_frame_t;
+
+static bus_frame_t g_frames[MAX_FRAMES];
+static uint32_t g_sent;      // Frames finished on the bus
+static uint32_t g_mb_seq[CANMB_NUMBER]; // Frame held by each mailbox
+static uint64_t g_now;       // Bit times
+static uint64_t g_pending;   // When the CAN0 interrupt became pending, 0 if not
+static uint32_t g_cost_bits; // Handler time per frame, bit times
+static int32_t g_last_mb;    // Mailbox the handler served last in this pass
+static uint32_t g_reordered; // Passes that served a higher mailbox before a lower one
+static uint64_t g_lat_max;   // End of frame to handler, bit times
+
+static void set_time(uint64_t bits)
+{
+	g_now = bits;
+	TEST_SET_RO(g_can.CAN_TIM, (uint32_t)(bits & CAN_TIM_TIMER_Msk));
+	g_tick = (portTickType)(bits / (BITRATE / configTICK_RATE_HZ));
+}
+
+// Back to back: random ID class and length, 0..20 % stuff bits, 3 bits of intermission
+static void next_frame(uint32_t n, uint64_t sof)
+{
+	bus_frame_t *f = &g_frames[n];
+	uint32_t kind = rng() % 100u;
+	f->id = (kind < 85u) ? (CAN_ID_STATUS & 0x700u) | (rng() & 0xFFu) : (kind < 90u) ? CAN_ID_CLAIM | (rng() & 0x7Fu) : 0x100u | (rng() & 0xFFu);
+	f->len = (uint8_t)(rng() % 9u);
+	uint32_t bits = 44u + 8u * f->len;
+	f->sof = sof;
+	f->end = sof + bits + rng() % (bits / 5u + 1u);
+	f->mb = -1;
+}
+
+// The controller: lowest free matching mailbox, else overwrite the last of the chain
+static void store(uint32_t n)
+{
+	bus_frame_t *f = &g_frames[n];
+	int32_t free_mb = -1, over_mb = -1;
+	for (uint32_t mb = 0; mb < CANMB_NUMBER; mb++) {
+		if (!g_mb[mb].rx || ((CAN_MID_MIDvA(f->id) ^ g_mb[mb].id) & g_mb[mb].mask) != 0) continue;
+		if (free_mb < 0 && !(g_can.CAN_MB[mb].CAN_MSR & CAN_MSR_MRDY)) free_mb = (int32_t)mb;
+		if (g_mb[mb].overwrite) over_mb = (int32_t)mb;
+	}
+	uint32_t mmi = 0;
+	if (free_mb < 0) {
+		if (over_mb < 0) return;
+		free_mb = over_mb;
+		mmi = CAN_MSR_MMI;
+	}
+	CanMb *p_mb = &g_can.CAN_MB[free_mb];
+	p_mb->CAN_MID = CAN_MID_MIDvA(f->id);
+	p_mb->CAN_MDL = n;
+	p_mb->CAN_MDH = ~n;
+	TEST_SET_RO(p_mb->CAN_MSR, CAN_MSR_MRDY | mmi | ((uint32_t)f->len << CAN_MSR_MDLC_Pos) | (uint32_t)(f->sof & 0xFFFFu));
+	if (mmi) g_frames[g_mb_seq[free_mb]].mb = -1; // Overwritten
+	g_mb_seq[free_mb] = n;
+	f->mb = (int8_t)free_mb;
+	if (g_pending == 0) g_pending = f->end;
+}
+
+// Let the bus run to t; mailboxes the handler re-armed (MTCR) are free again first
+static void advance(uint64_t t)
+{
+	for (uint32_t mb = 0; mb < CANMB_NUMBER; mb++) {
+		if (g_can.CAN_MB[mb].CAN_MCR & CAN_MCR_MTCR) {
+			g_can.CAN_MB[mb].CAN_MCR = 0;
+			TEST_SET_RO(g_can.CAN_MB[mb].CAN_MSR, 0);
+		}
+	}
+	while (g_frames[g_sent].end <= t) {
+		set_time(g_frames[g_sent].end);
+		store(g_sent);
+		next_frame(g_sent + 1u, g_frames[g_sent].end + 3u);
+		g_sent++;
+	}
+	set_time(t);
+}
+
+// CAN0_Handler's time per frame, during which the bus goes on
+static bool hook(const can_rx_frame_t *frame, bool *woken)
+{
+	uint32_t n = frame->datal;
+	int32_t mb = g_frames[n].mb;
+	if (mb >= 0 && mb < g_last_mb) g_reordered++;
+	if (mb >= 0) g_last_mb = mb;
+	if (g_now - g_frames[n].end > g_lat_max) g_lat_max = g_now - g_frames[n].end;
+	advance(g_now + g_cost_bits);
+	return false;
+}
+
+typedef struct {
+	uint32_t accepted;   // Frames that landed in a mailbox
+	uint32_t lost;       // Of those, overwritten before the handler came
+	uint32_t lost_block; // Of those, in the command/status block chain
+	uint32_t received;
+	uint32_t mb_overrun;
+	uint32_t last;       // Newest frame read so far
+	bool in_order;
+	bool stamps;
+} run_t;
+
+// CAN0_Handler pass over the mailboxes ready now
+static void pass(void)
+{
+	uint32_t sr = 0;
+	for (uint32_t mb = 0; mb < CANMB_NUMBER; mb++) {
+		if (g_can.CAN_MB[mb].CAN_MSR & CAN_MSR_MRDY) sr |= 1u << mb;
+	}
+	g_pending = 0;
+	g_last_mb = -1;
+	(void)can_rx_isr(sr);
+	advance(g_now); // Its last re-arm
+	for (uint32_t mb = 0; mb < CANMB_NUMBER; mb++) {
+		if ((g_can.CAN_MB[mb].CAN_MSR & CAN_MSR_MRDY) && g_pending == 0) g_pending = g_now; // Filled during the pass
+	}
+}
+
+// can_rx_task: everything in the ring, checked against what went over the bus
+static void drain(run_t *r)
+{
+	const can_rx_frame_t *frame;
+	while (can_rx_available() && (frame = can_rx_peek(0)) != NULL) {
+		uint32_t n = frame->datal;
+		if (r->received != 0 && n <= r->last) r->in_order = false;
+		if (frame->timestamp != g_frames[n].sof || frame->id != g_frames[n].id || frame->len != g_frames[n].len ||
+		    frame->datah != ~n) {
+			r->stamps = false;
+		}
+		r->last = n;
+		r->received++;
+		can_rx_release();
+	}
+}
+
+// SECONDS of full bus load, the handler within lat_us of the first ready mailbox
+static run_t run(uint32_t lat_us, uint32_t cost_us)
+{
+	memset(g_mb, 0, sizeof(g_mb));
+	memset(&g_can, 0, sizeof(g_can));
+	set_time(1000u);
+	can_time_init(&g_can, BITRATE);
+	TEST_CHECK(can_rx_init(&g_can));
+	can_rx_set_isr_hook(hook);
+	can_rx_reset_stats();
+	g_sent = 0;
+	g_pending = 0;
+	g_cost_bits = cost_us / US_PER_BIT;
+	g_reordered = 0;
+	g_lat_max = 0;
+	next_frame(0, g_now);
+
+	run_t r = { .in_order = true, .stamps = true };
+	const uint64_t end = g_now + (uint64_t)BITRATE * SECONDS;
+	uint64_t drain_at = g_now;
+	uint64_t isr = UINT64_MAX; // When the pending interrupt gets served
+	while (g_now < end) {
+		if (g_pending != 0 && isr == UINT64_MAX) isr = g_pending + (rng() % (lat_us + 1u)) / US_PER_BIT;
+		uint64_t next = g_frames[g_sent].end;
+		if (drain_at < next) next = drain_at;
+		if (isr <= next) {
+			advance(isr > g_now ? isr : g_now);
+			isr = UINT64_MAX;
+			pass();
+			continue;
+		}
+		advance(next);
+		if (g_now < drain_at) continue;
+		drain(&r);
+		drain_at = g_now + 1000u / US_PER_BIT; // Every millisecond
+	}
+	pass(); // The bus goes quiet, the last frames come in
+	drain(&r);
+
+	for (uint32_t n = 0; n < g_sent; n++) {
+		bool took = false;
+		for (uint32_t mb = 0; mb < CANMB_NUMBER; mb++) {
+			if (g_mb[mb].rx && ((CAN_MID_MIDvA(g_frames[n].id) ^ g_mb[mb].id) & g_mb[mb].mask) == 0) took = true;
+		}
+		if (!took) continue;
+		r.accepted++;
+		if (g_frames[n].mb >= 0) continue;
+		r.lost++;
+		if ((g_frames[n].id & 0x700u) == (CAN_ID_STATUS & 0x700u)) r.lost_block++;
+	}
+	can_rx_stats_t st;
+	can_rx_get_stats(&st);
+	r.mb_overrun = st.mb_overrun;
+	TEST_CHECK(st.ring_overrun == 0 && st.received == r.received);
+	printf("handler within %3u us, %2u us per frame: %u frames, %u accepted, %u received, %u lost (%u in the block, "
+	       "%u overruns), %u passes out of mailbox order, latest handler %llu us after the frame\n",
+	       (unsigned)lat_us, (unsigned)cost_us, (unsigned)g_sent, (unsigned)r.accepted, (unsigned)r.received,
+	       (unsigned)r.lost, (unsigned)r.lost_block, (unsigned)r.mb_overrun, (unsigned)g_reordered,
+	       (unsigned long long)(g_lat_max * US_PER_BIT));
+	return r;
+}
+
+int main(void)
+{
+	// The depths in conf_can_rx.h: claims in MB0, the block chained over MB6..MB7
+	TEST_CHECK(CONF_CAN_RX_CLAIM_DEPTH + CONF_CAN_RX_BLOCK_DEPTH <= CAN_RX_MB_COUNT);
+
+	// Within one shortest frame (94 us): nothing lost on either chain, in bus order, own captures
+	run_t r = run(90u, 4u);
+	TEST_CHECK(r.lost == 0 && r.mb_overrun == 0 && r.received == r.accepted);
+	TEST_CHECK(r.in_order && r.stamps);
+
+	/* Within two (188 us): the two-deep block chain still loses nothing, but a
+	 * pass now often re-arms MB6 while MB7 waits and MB6 takes the next frame;
+	 * in mailbox order those would come out swapped. MB0 alone can drop claims. */
+	r = run(170u, 4u);
+	TEST_CHECK(r.lost_block == 0 && r.received + r.lost == r.accepted);
+	TEST_CHECK(r.in_order && r.stamps);
+	TEST_CHECK(g_reordered > 0);
+
+	/* Far behind: frames are overwritten and every pass that finds one counts
+	 * it. A frame overwritten during the pass is taken whole, never mixed with
+	 * the one it replaced, though it can then come out ahead of older ones. */
+	r = run(400u, 4u);
+	TEST_CHECK(r.lost_block > 0 && r.mb_overrun > 0 && r.mb_overrun <= r.lost);
+	TEST_CHECK(r.received + r.lost == r.accepted && r.stamps);
+
+	return test_result("can_rx");
+}
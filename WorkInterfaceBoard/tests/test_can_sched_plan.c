@@ -0,0 +1,135 @@
+/* can_sched_plan(): the configured schedule (config/conf_can_sched.h) at every
+ * supported bitrate, then random tables, checked for collisions by marking
+ * every frame's bit times over the hyperperiod, independent of the closed
+ * form in can_sched_overlap(). */
+#include "test_host.h"
+#include "can_sched_plan.h"
+#include "can_sched.h"
+#include "can_signals.h"
+#include "can_stats.h"
+#include <string.h>
+
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+
+#define MAX_PERIOD   (0x10000u - CAN_SCHED_MARGIN_BITS) // As can_sched_init()
+#define BUS_MAX      (1u << 20)
+
+static uint8_t g_bus[BUS_MAX];
+
+static uint64_t gcd64(uint64_t a, uint64_t b)
+{
+	while (b != 0) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// Mark every frame over the hyperperiod; false if two share a bit time
+static bool collision_free(const can_sched_slot_t *slots, uint32_t count)
+{
+	uint64_t h = 1;
+	for (uint32_t i = 0; i < count; i++) h = h / gcd64(h, slots[i].period) * slots[i].period;
+	if (h > BUS_MAX) {
+		printf("hyperperiod %llu too long to walk\n", (unsigned long long)h);
+		return false;
+	}
+	memset(g_bus, 0, (size_t)h);
+	for (uint32_t i = 0; i < count; i++) {
+		for (uint64_t start = slots[i].phase; start < h; start += slots[i].period) {
+			for (uint32_t b = 0; b < slots[i].length; b++) {
+				uint8_t *bit = &g_bus[(start + b) % h];
+				if (*bit) return false;
+				*bit = 1;
+			}
+		}
+	}
+	return true;
+}
+
+#define SCHED_SLOT(msg, period_ms, phase_ms) { (period_ms), (phase_ms), CAN_MSG_DLC(msg) },
+static const uint32_t g_table[][3] = {
+	CAN_SCHED_TABLE(SCHED_SLOT)
+};
+#define TABLE_COUNT (sizeof(g_table) / sizeof(g_table[0]))
+
+static void test_configured_table(void)
+{
+	const uint32_t rates[] = {125000u, 250000u, 500000u, 1000000u};
+	for (uint32_t r = 0; r < 4; r++) {
+		can_sched_slot_t slots[TABLE_COUNT];
+		bool fits = true;
+		for (uint32_t n = 0; n < TABLE_COUNT; n++) {
+			slots[n].period = can_sched_ms_to_bits(g_table[n][0], rates[r]);
+			slots[n].phase = can_sched_ms_to_bits(g_table[n][1], rates[r]);
+			slots[n].length = can_stats_frame_bits((uint8_t)g_table[n][2]);
+			if (slots[n].period >= MAX_PERIOD) fits = false;
+		}
+		can_sched_plan_result_t result = can_sched_plan(slots, TABLE_COUNT, MAX_PERIOD, 16u);
+		printf("%7u bit/s: ", (unsigned)rates[r]);
+		if (!fits) {
+			// Longer than a timer wrap: can_sched_init() falls back to the event queue
+			printf("period beyond one timer wrap, not scheduled\n");
+			TEST_CHECK(result == CAN_SCHED_PLAN_BAD_PERIOD);
+			continue;
+		}
+		TEST_CHECK(result == CAN_SCHED_PLAN_OK);
+		for (uint32_t n = 0; n < TABLE_COUNT; n++) {
+			printf("[period %u phase %u length %u] ", (unsigned)slots[n].period, (unsigned)slots[n].phase, (unsigned)slots[n].length);
+			TEST_CHECK(slots[n].phase < slots[n].period);
+		}
+		printf("\n");
+		TEST_CHECK(collision_free(slots, TABLE_COUNT));
+	}
+}
+
+static uint32_t rng_state = 777u;
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 1664525u + 1013904223u;
+	return rng_state >> 8;
+}
+
+// Random tables: every OK plan is collision free, and the pairwise test agrees with the walk
+static void test_random_tables(void)
+{
+	const uint32_t periods[] = {800u, 1000u, 1600u, 2000u, 3200u, 4000u, 6400u, 8000u, 16000u, 32000u, 64000u};
+	uint32_t planned = 0, no_room = 0;
+	for (uint32_t trial = 0; trial < 3000; trial++) {
+		uint32_t count = 1u + rng() % CAN_SCHED_PLAN_MAX;
+		can_sched_slot_t slots[CAN_SCHED_PLAN_MAX];
+		for (uint32_t n = 0; n < count; n++) {
+			slots[n].period = periods[rng() % (sizeof(periods) / sizeof(periods[0]))];
+			slots[n].phase = rng() % slots[n].period;
+			slots[n].length = can_stats_frame_bits((uint8_t)(rng() % 9u));
+		}
+		can_sched_plan_result_t result = can_sched_plan(slots, count, MAX_PERIOD, 16u);
+		if (result == CAN_SCHED_PLAN_NO_ROOM) {
+			no_room++;
+			continue;
+		}
+		TEST_CHECK(result == CAN_SCHED_PLAN_OK);
+		planned++;
+		TEST_CHECK(collision_free(slots, count));
+		for (uint32_t a = 0; a < count; a++) {
+			for (uint32_t b = a + 1; b < count; b++) {
+				can_sched_slot_t pair[2] = {slots[a], slots[b]};
+				TEST_CHECK(!can_sched_overlap(&pair[0], &pair[1]));
+				// Shift b onto a: the closed form and the walk must both see it
+				pair[1].phase = (pair[0].phase + pair[0].length / 2u) % pair[1].period;
+				TEST_CHECK(can_sched_overlap(&pair[0], &pair[1]) && !collision_free(pair, 2));
+			}
+		}
+	}
+	printf("random tables: %u planned collision free, %u without room\n", (unsigned)planned, (unsigned)no_room);
+	TEST_CHECK(planned > 1000u);
+}
+
+int main(void)
+{
+	test_configured_table();
+	test_random_tables();
+	return test_result("can_sched_plan");
+}
@@ -0,0 +1,150 @@
+/* Every message of config/conf_can_signals.h, through the same X-macros as
+ * can_signals.h: random values in every signal's range survive pack/unpack
+ * and the host decoder, and the signals neither overlap nor leave the DLC.
+ * Then frames from other nodes (11-bit node bits, 29-bit node address, claim
+ * name bits) decode as their message. */
+#include "test_host.h"
+#include "can_signals.h"
+#include "can_node.h"
+#include <math.h>
+#include <string.h>
+
+typedef struct {
+	uint32_t count;
+	double position;
+	double velocity;
+	const char *message;
+} seen_t;
+
+static void visit(const can_signal_desc_t *sig, int64_t raw, double physical, void *ctx)
+{
+	seen_t *seen = ctx;
+	seen->count++;
+	seen->message = sig->message;
+	if (strcmp(sig->name, "position") == 0) seen->position = physical;
+	if (strcmp(sig->name, "velocity") == 0) seen->velocity = physical;
+}
+
+static uint32_t rng_state = 4321u;
+static uint64_t rng64(void)
+{
+	uint64_t v = 0;
+	for (uint32_t i = 0; i < 3; i++) {
+		rng_state = rng_state * 1664525u + 1013904223u;
+		v = (v << 24) ^ (rng_state >> 8);
+	}
+	return v;
+}
+
+typedef struct {
+	int64_t raw[16]; // Expected raw values, in signal order
+	uint32_t count;
+	bool match;
+} expect_t;
+
+static void check_raw(const can_signal_desc_t *sig, int64_t raw, double physical, void *ctx)
+{
+	expect_t *ex = ctx;
+	if (ex->count >= 16 || raw != ex->raw[ex->count]) ex->match = false;
+	if (physical != (double)raw * sig->scale + sig->offset) ex->match = false;
+	ex->count++;
+}
+
+// A value in the signal's range: len random bits, sign-extended for signed types
+#define GEN_FILL(msg, name, start, len, type, scale, offset, unit) \
+	{ \
+		uint64_t raw = rng64() & CAN_SIG_MASK(len); \
+		if (CAN_SIG_IS_SIGNED(type) && ((raw >> ((len) - 1)) & 1u)) raw |= ~CAN_SIG_MASK(len); \
+		in.name = (type)raw; \
+		ex.raw[ex.count++] = CAN_SIG_IS_SIGNED(type) ? (int64_t)in.name : (int64_t)(uint64_t)in.name; \
+	}
+#define GEN_COMPARE(msg, name, start, len, type, scale, offset, unit) TEST_CHECK(out.name == in.name);
+// One signal all ones: exactly its bits, inside the DLC, clear of the others
+#define GEN_LAYOUT(msg, name, start, len, type, scale, offset, unit) \
+	{ \
+		can_##msg##_t one; \
+		memset(&one, 0, sizeof(one)); \
+		one.name = (type)~(type)0; \
+		uint32_t l, h; \
+		can_pack_##msg(&one, &l, &h); \
+		uint64_t v = ((uint64_t)h << 32) | l; \
+		TEST_CHECK(v == CAN_SIG_MASK(len) << (start)); \
+		TEST_CHECK((v & used) == 0); \
+		TEST_CHECK((start) + (len) <= 8u * CAN_MSG_DLC(msg)); \
+		TEST_CHECK(CAN_SIG_START(msg, name) == (start) && CAN_SIG_LEN(msg, name) == (len)); \
+		used |= v; \
+		signals++; \
+	}
+#define GEN_ROUND_TRIP(msg, id, dlc, period_ms, SIGNALS) \
+	static void round_trip_##msg(void) \
+	{ \
+		uint64_t used = 0; \
+		uint32_t signals = 0; \
+		SIGNALS(GEN_LAYOUT, msg) \
+		for (uint32_t trial = 0; trial < 10000; trial++) { \
+			can_##msg##_t in, out; \
+			expect_t ex = { .match = true }; \
+			memset(&in, 0, sizeof(in)); \
+			SIGNALS(GEN_FILL, msg) \
+			uint32_t datal, datah; \
+			can_pack_##msg(&in, &datal, &datah); \
+			memset(&out, 0xA5, sizeof(out)); \
+			can_unpack_##msg(datal, datah, &out); \
+			SIGNALS(GEN_COMPARE, msg) \
+			TEST_CHECK((((uint64_t)datah << 32 | datal) & ~used) == 0); \
+			ex.count = 0; \
+			TEST_CHECK(can_signals_decode(CAN_MSG_ID(msg), datal, datah, check_raw, &ex) == signals); \
+			TEST_CHECK(ex.match && ex.count == signals); \
+		} \
+		printf("%-9s %u signals, %u of %u bits used: round trip ok\n", #msg, (unsigned)signals, \
+		       (unsigned)__builtin_popcountll(used), (unsigned)(8u * CAN_MSG_DLC(msg))); \
+	}
+CAN_MESSAGE_TABLE(GEN_ROUND_TRIP)
+
+#define GEN_CALL(msg, id, dlc, period_ms, SIGNALS) round_trip_##msg();
+
+int main(void)
+{
+	CAN_MESSAGE_TABLE(GEN_CALL)
+
+	can_encoder1_t e = {-5, 123456}, d;
+	uint32_t datal, datah;
+	can_pack_encoder1(&e, &datal, &datah);
+	can_unpack_encoder1(datal, datah, &d);
+	TEST_CHECK(d.position == -5 && d.velocity == 123456);
+
+	const struct {
+		uint32_t bus_id;
+		uint32_t node;
+	} frames[] = {
+		{CAN_MSG_ID(encoder1), 0},
+		{CAN_MSG_ID(encoder1) | 5u, 5},                 // 11-bit, node 5
+		{CAN_MSG_ID(encoder1) | 15u, 15},
+		{((uint32_t)CAN_MSG_ID(encoder1) << 18) | 200u, 200}, // 29-bit, node address 200
+	};
+	for (uint32_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+		uint32_t node = 0xFFFFFFFFu;
+		TEST_CHECK(can_signals_message_id(frames[i].bus_id, &node) == CAN_MSG_ID(encoder1));
+		TEST_CHECK(node == frames[i].node);
+		seen_t seen = {0};
+		TEST_CHECK(can_signals_decode(frames[i].bus_id, datal, datah, visit, &seen) == 2);
+		TEST_CHECK(seen.count == 2 && seen.message != NULL && strcmp(seen.message, "encoder1") == 0);
+		TEST_CHECK(seen.position == -5.0 && fabs(seen.velocity - 123.456) < 1e-9);
+	}
+
+	// Shared IDs keep their low bits; claim IDs carry name bits there
+	uint32_t node = 1;
+	TEST_CHECK(can_signals_message_id(CAN_ID_STOP, &node) == CAN_ID_STOP && node == 0);
+	TEST_CHECK(can_signals_message_id(CAN_ID_CLAIM | 0x35u, NULL) == CAN_ID_CLAIM);
+	seen_t seen = {0};
+	TEST_CHECK(can_signals_decode(CAN_ID_CLAIM | 0x7Fu, 0, 0, visit, &seen) > 0);
+	TEST_CHECK(seen.message != NULL && strcmp(seen.message, "claim") == 0);
+	TEST_CHECK(can_signals_decode(0x300u, 0, 0, NULL, NULL) == 0); // Nothing described there
+
+	// 29-bit with an extension: its own message ID, not the can_app.h one
+	uint32_t ext_bus = ((uint32_t)CAN_MSG_ID(encoder1) << 18) | (0x155u << 8) | 7u;
+	TEST_CHECK(can_signals_message_id(ext_bus, &node) == CAN_NODE_EXT_ID(CAN_MSG_ID(encoder1), 0x155u) && node == 7u);
+	TEST_CHECK(can_signals_decode(ext_bus, datal, datah, NULL, NULL) == 0);
+
+	return test_result("can_signals");
+}
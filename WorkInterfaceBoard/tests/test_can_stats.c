@@ -0,0 +1,52 @@
+/* can_stats.c per-ID table on a shared bus: other boards' frames (node bits
+ * set, 29-bit IDs) are counted as untracked and leave the table to this
+ * node's IDs; claims from every board share one entry. */
+#include "test_host.h"
+#include "can_stats.h"
+#include "can_app.h"
+
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+
+int main(void)
+{
+	can_stats_init(500000u);
+
+	// Other boards talk first, more IDs than the table holds
+	uint32_t foreign = 0;
+	for (uint32_t node = 1; node < 16u; node++) {
+		can_stats_on_rx(CAN_ID_ENCODER1 | node, 8);
+		can_stats_on_rx(CAN_ID_LOADCELL | node, 2);
+		foreign += 2;
+	}
+	for (uint32_t node = 1; node < 40u; node++) {
+		can_stats_on_rx(((uint32_t)CAN_ID_STATUS << 18) | node, 2); // 29-bit, as can_node_from_mid() returns it
+		foreign++;
+	}
+	for (uint32_t name = 0; name < 0x80u; name++) {
+		can_stats_on_rx(CAN_ID_CLAIM | name, 8);
+	}
+
+	// Then this node's own traffic
+	can_stats_on_tx(CAN_ID_ENCODER1, 8, 100);
+	can_stats_on_tx(CAN_ID_ENCODER1, 8, 100);
+	can_stats_on_tx(CAN_ID_LOADCELL, 2, 100);
+	can_stats_on_rx(CAN_ID_POT_COMMAND, 3);
+	can_stats_on_rx(CAN_ID_STOP, 1); // Shared ID, counted for every sender
+
+	can_stats_id_t entry;
+	TEST_CHECK(can_stats_get_id(CAN_ID_ENCODER1, &entry) && entry.tx == 2 && entry.rx == 0);
+	TEST_CHECK(can_stats_get_id(CAN_ID_LOADCELL, &entry) && entry.tx == 1);
+	TEST_CHECK(can_stats_get_id(CAN_ID_POT_COMMAND, &entry) && entry.rx == 1);
+	TEST_CHECK(can_stats_get_id(CAN_ID_STOP, &entry) && entry.rx == 1);
+	TEST_CHECK(can_stats_get_id(CAN_ID_CLAIM, &entry) && entry.rx == 0x80u);
+	TEST_CHECK(!can_stats_get_id(CAN_ID_ENCODER1 | 1u, &entry));
+
+	can_stats_t st;
+	can_stats_get(&st);
+	TEST_CHECK(st.id_count == 5);
+	TEST_CHECK(st.untracked == foreign);
+	TEST_CHECK(st.rx_frames == foreign + 0x80u + 2u && st.tx_frames == 3);
+
+	return test_result("can_stats");
+}
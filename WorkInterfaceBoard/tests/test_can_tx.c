@@ -0,0 +1,605 @@
+/* can_tx.c against a mock controller: frames leave in (ID, enqueue order)
+ * order whatever order they were queued in, except past an ID that waits for
+ * its own predecessor to leave a mailbox; push/pop throughput, and the
+ * two paths can_bench_tx() compares on the target, timed on the host.
+ * Every loaded mailbox is noticed by its MTCR write and completed by hand,
+ * one at a time, so the load order is the order frames reach the bus.
+ * Latest-value frames are replaced while queued, while loaded (MACR, then
+ * MABT) and after an abort, and go out one frame after the newest sample at
+ * most on a bus with other nodes' traffic. Under sustained load with the
+ * queue full, a frame waiting for its own ID to leave a mailbox must not
+ * leave the other mailbox idle.
+ */
+#include "test_host.h"
+#include "can_tx.h"
+#include "can_stats.h"
+#include "can.h"
+#include "can_signals.h"
+#include <string.h>
+
+static Can g_can; // Register block in RAM
+
+// Collaborators of can_tx.c
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+void can_mailbox_init(Can *p_can, can_mb_conf_t *p_mailbox) { (void)p_can; (void)p_mailbox; }
+uint32_t can_node_mid(uint32_t id) { return CAN_MID_MIDvA(id); }
+uint16_t can_sched_asap_timemark(void) { return 0; }
+
+#define US_PER_BIT     2u // 500 kbit/s
+
+static uint64_t g_bits;           // Bus time in bit times
+static uint32_t g_latency_max_us; // Largest can_stats_on_tx() latency
+static uint32_t g_waited;         // Frames later than CAN_STATS_WAIT_BITS
+void can_stats_on_tx(uint32_t id, uint8_t len, uint32_t latency_us)
+{
+	if (latency_us > g_latency_max_us) g_latency_max_us = latency_us;
+	if (latency_us > CAN_STATS_WAIT_BITS * US_PER_BIT) g_waited++;
+}
+uint64_t can_time_now(void) { return g_bits; }
+uint64_t can_time_now_from_isr(void) { return g_bits; }
+uint64_t can_time_extend_from_isr(uint16_t stamp) { return g_bits - (uint16_t)((uint16_t)g_bits - stamp); }
+uint16_t can_time_mailbox_stamp(uint32_t msr) { return (uint16_t)(msr & CAN_MSR_MTIMESTAMP_Msk); }
+uint64_t can_time_to_us(uint64_t t) { return t * US_PER_BIT; }
+
+typedef struct {
+	uint32_t id;
+	uint32_t tag; // Enqueue order, sent as datal
+} sent_t;
+
+#define FRAMES 4096u
+
+static sent_t g_sent[FRAMES];
+static uint32_t g_sent_count;
+
+// Record mailboxes loaded since the last call (ascending, as can_tx fills them)
+static uint32_t collect_loaded(void)
+{
+	uint32_t loaded = 0;
+	for (uint32_t mb = CAN_TX_MB_FIRST; mb < CAN_TX_MB_FIRST + CAN_TX_MB_COUNT; mb++) {
+		CanMb *p_mb = &g_can.CAN_MB[mb];
+		if (!(p_mb->CAN_MCR & CAN_MCR_MTCR)) continue;
+		p_mb->CAN_MCR = 0;
+		if (g_sent_count < FRAMES) {
+			g_sent[g_sent_count].id = (p_mb->CAN_MID & CAN_MID_MIDvA_Msk) >> CAN_MID_MIDvA_Pos;
+			g_sent[g_sent_count].tag = p_mb->CAN_MDL;
+			g_sent_count++;
+		}
+		loaded |= 1u << mb;
+	}
+	return loaded;
+}
+
+// Complete loaded mailboxes in load order until the queue is empty
+static void drain(void)
+{
+	uint32_t busy = collect_loaded();
+	uint32_t order[CAN_TX_MB_COUNT + 1];
+	uint32_t n = 0;
+	for (uint32_t b = busy; b != 0; b &= b - 1u) order[n++] = (uint32_t)__builtin_ctz(b);
+
+	while (n > 0) {
+		uint32_t mb = order[0];
+		for (uint32_t i = 1; i < n; i++) order[i - 1] = order[i];
+		n--;
+		TEST_SET_RO(g_can.CAN_MB[mb].CAN_MSR, 0); // Sent, not aborted
+		can_tx_isr(1u << mb);
+		for (uint32_t b = collect_loaded(); b != 0; b &= b - 1u) order[n++] = (uint32_t)__builtin_ctz(b);
+	}
+}
+
+static uint32_t rng_state = 12345u;
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 1664525u + 1013904223u;
+	return rng_state >> 8;
+}
+
+/* Burst queued while held: same-ID frames in enqueue order, and a frame only
+ * goes ahead of a lower ID while that ID is in a mailbox already (drain()
+ * completes in load order, so the previous CAN_TX_MB_COUNT - 1 loads) */
+static void test_priority_order(void)
+{
+	can_tx_init(&g_can);
+	g_sent_count = 0;
+	uint32_t queued = 0;
+
+	for (uint32_t round = 0; round < 64; round++) {
+		can_tx_hold(true);
+		for (uint32_t i = 0; i < CAN_TX_QUEUE_LEN; i++) {
+			uint32_t id = 0x100u + rng() % 12u; // Few IDs, so many repeats
+			TEST_CHECK(can_tx_enqueue_words(id, queued++, 0, 8));
+		}
+		uint32_t first = g_sent_count;
+		can_tx_hold(false);
+		drain();
+		TEST_CHECK(g_sent_count - first == CAN_TX_QUEUE_LEN);
+		for (uint32_t i = first; i < g_sent_count; i++) {
+			for (uint32_t j = i + 1; j < g_sent_count; j++) {
+				if (g_sent[j].id == g_sent[i].id) TEST_CHECK(g_sent[j].tag > g_sent[i].tag);
+				if (g_sent[j].id >= g_sent[i].id) continue;
+				bool in_flight = false;
+				for (uint32_t k = (i - first >= CAN_TX_MB_COUNT - 1u) ? i - (CAN_TX_MB_COUNT - 1u) : first; k < i; k++) {
+					if (g_sent[k].id == g_sent[j].id) in_flight = true;
+				}
+				TEST_CHECK(in_flight);
+			}
+		}
+	}
+
+	can_tx_stats_t st;
+	can_tx_get_stats(&st);
+	TEST_CHECK(st.completed == queued);
+	TEST_CHECK(st.dropped == 0);
+	TEST_CHECK(st.queued == 0 && st.in_flight == 0);
+}
+
+// Frames queued while others are on the bus: per-ID FIFO holds throughout
+static void test_fifo_while_busy(void)
+{
+	can_tx_init(&g_can);
+	g_sent_count = 0;
+	uint32_t next_tag[4] = {0};
+	uint32_t tag_base[4] = {0, 100000u, 200000u, 300000u};
+
+	for (uint32_t step = 0; step < 2000; step++) {
+		uint32_t k = rng() % 4u;
+		if (can_tx_enqueue_words(0x200u + k, tag_base[k] + next_tag[k], 0, 8)) next_tag[k]++;
+		if (rng() % 3u == 0) {
+			uint32_t busy = collect_loaded();
+			if (busy != 0) {
+				uint32_t mb = (uint32_t)__builtin_ctz(busy);
+				TEST_SET_RO(g_can.CAN_MB[mb].CAN_MSR, 0);
+				can_tx_isr(1u << mb);
+			}
+		}
+	}
+	can_tx_hold(true); // Abort whatever is loaded back into the queue
+	for (uint32_t mb = CAN_TX_MB_FIRST; mb < CAN_TX_MB_FIRST + CAN_TX_MB_COUNT; mb++) {
+		if (g_can.CAN_ACR & (1u << mb)) {
+			TEST_SET_RO(g_can.CAN_MB[mb].CAN_MSR, CAN_MSR_MABT);
+			can_tx_isr(1u << mb);
+		}
+	}
+	g_can.CAN_ACR = 0;
+	can_tx_hold(false);
+	drain();
+
+	// Aborted frames are loaded again, so a tag may repeat but never go backwards
+	uint32_t last[4] = {0};
+	bool seen[4] = {false};
+	for (uint32_t i = 0; i < g_sent_count; i++) {
+		uint32_t k = g_sent[i].id - 0x200u;
+		uint32_t tag = g_sent[i].tag - tag_base[k];
+		if (seen[k]) TEST_CHECK(tag >= last[k]);
+		last[k] = tag;
+		seen[k] = true;
+	}
+	can_tx_stats_t st;
+	can_tx_get_stats(&st);
+	TEST_CHECK(st.queued == 0 && st.in_flight == 0);
+	TEST_CHECK(st.completed == next_tag[0] + next_tag[1] + next_tag[2] + next_tag[3]);
+}
+
+// The mailbox can_tx just asked to abort (MACR), 0 if none
+static uint32_t take_abort(void)
+{
+	for (uint32_t mb = CAN_TX_MB_FIRST; mb < CAN_TX_MB_FIRST + CAN_TX_MB_COUNT; mb++) {
+		if (g_can.CAN_MB[mb].CAN_MCR & CAN_MCR_MACR) {
+			g_can.CAN_MB[mb].CAN_MCR = 0;
+			return mb;
+		}
+	}
+	return 0;
+}
+
+// Complete (or with MABT, abort) mailbox mb
+static void finish(uint32_t mb, uint32_t msr)
+{
+	TEST_SET_RO(g_can.CAN_MB[mb].CAN_MSR, msr);
+	can_tx_isr(1u << mb);
+}
+
+// g_sent logs loads here: which samples reached a mailbox, and which went out
+static void test_latest_supersede(void)
+{
+	can_tx_init(&g_can);
+	can_tx_stats_t st;
+
+	// Queued behind a hold: replaced in place, only the newest is loaded
+	g_sent_count = 0;
+	can_tx_hold(true);
+	TEST_CHECK(can_tx_enqueue_latest(0x300u, 1, 0, 8));
+	TEST_CHECK(can_tx_enqueue_latest(0x300u, 2, 0, 8));
+	can_tx_hold(false);
+	drain();
+	can_tx_get_stats(&st);
+	TEST_CHECK(g_sent_count == 1 && g_sent[0].tag == 2);
+	TEST_CHECK(st.superseded == 1 && st.completed == 1);
+
+	// Loaded: the newer sample waits, the mailbox is aborted and its MABT drops the stale one
+	can_tx_reset_stats();
+	g_sent_count = 0;
+	TEST_CHECK(can_tx_enqueue_latest(0x300u, 3, 0, 8));
+	uint32_t mb = (uint32_t)__builtin_ctz(collect_loaded());
+	TEST_CHECK(can_tx_enqueue_latest(0x300u, 4, 0, 8));
+	TEST_CHECK(collect_loaded() == 0); // Same ID in flight: not loaded beside it
+	TEST_CHECK(take_abort() == mb);
+	finish(mb, CAN_MSR_MABT);
+	uint32_t loaded = collect_loaded();
+	TEST_CHECK(loaded != 0 && g_sent_count == 2 && g_sent[1].tag == 4);
+	finish((uint32_t)__builtin_ctz(loaded), 0);
+	can_tx_get_stats(&st);
+	TEST_CHECK(st.superseded == 1 && st.requeued == 0 && st.completed == 1 && st.in_flight == 0);
+
+	// Already on the wire: MACR does nothing, the old sample completes and the new one follows
+	can_tx_reset_stats();
+	g_sent_count = 0;
+	TEST_CHECK(can_tx_enqueue_latest(0x300u, 5, 0, 8));
+	mb = (uint32_t)__builtin_ctz(collect_loaded());
+	TEST_CHECK(can_tx_enqueue_latest(0x300u, 6, 0, 8));
+	TEST_CHECK(take_abort() == mb);
+	finish(mb, 0);
+	loaded = collect_loaded();
+	TEST_CHECK(loaded != 0 && g_sent_count == 2 && g_sent[1].tag == 6);
+	finish((uint32_t)__builtin_ctz(loaded), 0);
+	can_tx_get_stats(&st);
+	TEST_CHECK(st.superseded == 0 && st.completed == 2);
+
+	// Aborted by a hold first: back in the queue, where the next sample replaces it
+	can_tx_reset_stats();
+	g_sent_count = 0;
+	TEST_CHECK(can_tx_enqueue_latest(0x300u, 7, 0, 8));
+	mb = (uint32_t)__builtin_ctz(collect_loaded());
+	can_tx_hold(true);
+	TEST_CHECK(g_can.CAN_ACR & (1u << mb));
+	g_can.CAN_ACR = 0;
+	finish(mb, CAN_MSR_MABT);
+	can_tx_get_stats(&st);
+	TEST_CHECK(st.requeued == 1 && st.queued == 1);
+	TEST_CHECK(can_tx_enqueue_latest(0x300u, 8, 0, 8));
+	can_tx_hold(false);
+	drain();
+	can_tx_get_stats(&st);
+	TEST_CHECK(g_sent_count == 2 && g_sent[1].tag == 8);
+	TEST_CHECK(st.superseded == 1 && st.completed == 1 && st.queued == 0);
+}
+
+/* Bus model for the timed tests: the TX mailboxes as loaded (seen by their
+ * MTCR writes, aborted by MACR unless on the wire), other nodes' frames,
+ * arbitration on the lowest ID, 3 bits of intermission and the mailbox
+ * interrupt served at once. */
+typedef struct {
+	bool loaded;
+	uint32_t id;
+	uint32_t tag;
+	uint8_t len;
+} bus_mb_t;
+
+static bus_mb_t g_bus_mb[CAN_TX_MB_FIRST + CAN_TX_MB_COUNT];
+static int32_t g_wire_mb;       // Mailbox on the wire, -1 for none or another node
+static uint64_t g_wire_sof;
+static uint64_t g_wire_end;
+static uint64_t g_bus_free;     // End of the intermission
+static uint32_t g_foreign_pct;  // Chance another node has a frame ready when the bus frees
+static uint32_t g_foreign_id;   // Lowest ID the other nodes use
+static bool g_foreign_ready;
+static uint32_t g_isr_bits;     // Completion interrupt this long after the end of frame
+static int32_t g_isr_mb;        // Mailbox whose completion is pending, -1 if none
+static uint64_t g_isr_at;
+static uint64_t g_isr_sof;
+static uint32_t g_bus_busy;     // Bit times on the wire
+static uint32_t g_hol;          // Times a mailbox sat idle while a frame it could take waited
+static uint32_t g_queued_per_id[0x800];
+
+static uint32_t frame_bits(uint8_t len)
+{
+	uint32_t bits = 47u + 8u * len;
+	return bits + rng() % (bits / 5u + 1u); // Stuff bits
+}
+
+// Pick up mailbox writes until can_tx has nothing more to load or abort
+static void bus_notice(void)
+{
+	bool again = true;
+	while (again) {
+		again = false;
+		for (uint32_t mb = CAN_TX_MB_FIRST; mb < CAN_TX_MB_FIRST + CAN_TX_MB_COUNT; mb++) {
+			CanMb *p_mb = &g_can.CAN_MB[mb];
+			uint32_t mcr = p_mb->CAN_MCR;
+			p_mb->CAN_MCR = 0;
+			if (mcr & CAN_MCR_MTCR) {
+				bus_mb_t *b = &g_bus_mb[mb];
+				b->loaded = true;
+				b->id = (p_mb->CAN_MID & CAN_MID_MIDvA_Msk) >> CAN_MID_MIDvA_Pos;
+				b->tag = p_mb->CAN_MDL;
+				b->len = (uint8_t)((mcr & CAN_MCR_MDLC_Msk) >> CAN_MCR_MDLC_Pos);
+				g_queued_per_id[b->id]--;
+			}
+			if ((mcr & CAN_MCR_MACR) && g_bus_mb[mb].loaded && g_wire_mb != (int32_t)mb) {
+				g_bus_mb[mb].loaded = false;
+				g_queued_per_id[g_bus_mb[mb].id]++; // Back in the queue until can_tx says otherwise
+				finish(mb, CAN_MSR_MABT);
+				again = true;
+			}
+		}
+	}
+}
+
+// A free mailbox while a queued ID has none in flight
+static void check_hol(void)
+{
+	bool free_mb = false;
+	for (uint32_t mb = CAN_TX_MB_FIRST; mb < CAN_TX_MB_FIRST + CAN_TX_MB_COUNT; mb++) {
+		if (!g_bus_mb[mb].loaded && g_isr_mb != (int32_t)mb) free_mb = true; // can_tx knows it is free
+	}
+	if (!free_mb) return;
+	for (uint32_t id = 0; id < 0x800u; id++) {
+		if (g_queued_per_id[id] == 0) continue;
+		bool in_flight = false;
+		for (uint32_t mb = CAN_TX_MB_FIRST; mb < CAN_TX_MB_FIRST + CAN_TX_MB_COUNT; mb++) {
+			if (g_bus_mb[mb].loaded && g_bus_mb[mb].id == id) in_flight = true;
+		}
+		if (!in_flight) {
+			g_hol++;
+			return;
+		}
+	}
+}
+
+// Run the bus up to bit time t; frames of ours that go out are logged in g_sent
+static void bus_run(uint64_t t)
+{
+	for (;;) {
+		// Completion interrupt, unless the next frame ends first (a second one could be pending by then)
+		if (g_isr_mb >= 0 && g_isr_at <= t && (g_wire_end == 0 || g_isr_at <= g_wire_end)) {
+			g_bits = g_isr_at;
+			uint32_t mb = (uint32_t)g_isr_mb;
+			g_isr_mb = -1;
+			finish(mb, (uint32_t)(g_isr_sof & 0xFFFFu));
+			bus_notice();
+			check_hol();
+			continue;
+		}
+		if (g_wire_end != 0) {
+			if (g_wire_end > t) break;
+			g_bits = g_wire_end;
+			g_bus_busy += (uint32_t)(g_wire_end - g_wire_sof);
+			g_bus_free = g_wire_end + 3u;
+			g_wire_end = 0;
+			g_foreign_ready = (rng() % 100u < g_foreign_pct);
+			if (g_wire_mb >= 0) {
+				uint32_t mb = (uint32_t)g_wire_mb;
+				g_bus_mb[mb].loaded = false; // MRDY: free to the controller, can_tx learns it in the interrupt
+				if (g_sent_count < FRAMES) {
+					g_sent[g_sent_count].id = g_bus_mb[mb].id;
+					g_sent[g_sent_count].tag = g_bus_mb[mb].tag;
+					g_sent_count++;
+				}
+				g_wire_mb = -1;
+				g_isr_mb = (int32_t)mb;
+				g_isr_at = g_bits + g_isr_bits;
+				g_isr_sof = g_wire_sof;
+			}
+			continue;
+		}
+
+		// Idle: arbitration at the end of the intermission, or as soon as something is loaded
+		uint64_t sof = (g_bus_free > g_bits) ? g_bus_free : g_bits;
+		if (g_isr_mb >= 0 && g_isr_at < sof) sof = g_isr_at; // Served first, above
+		if (sof > t) break;
+		if (g_isr_mb >= 0 && g_isr_at <= sof) continue;
+		int32_t win = -1;
+		uint32_t win_id = g_foreign_ready ? g_foreign_id + rng() % (0x800u - g_foreign_id) : 0x800u;
+		for (uint32_t mb = CAN_TX_MB_FIRST; mb < CAN_TX_MB_FIRST + CAN_TX_MB_COUNT; mb++) {
+			if (g_bus_mb[mb].loaded && g_bus_mb[mb].id < win_id) {
+				win = (int32_t)mb;
+				win_id = g_bus_mb[mb].id;
+			}
+		}
+		if (win_id == 0x800u) {
+			// Nothing to send until the next event
+			if (g_isr_mb >= 0 && g_isr_at <= t) {
+				g_bits = g_isr_at;
+				continue;
+			}
+			break;
+		}
+		if (win < 0) g_foreign_ready = false;
+		g_wire_mb = win;
+		g_wire_sof = sof;
+		g_wire_end = sof + frame_bits(win >= 0 ? g_bus_mb[win].len : 8u);
+		g_bits = sof;
+	}
+	g_bits = t;
+}
+
+static void bus_reset(uint32_t foreign_pct, uint32_t foreign_id, uint32_t isr_bits)
+{
+	memset(&g_can, 0, sizeof(g_can));
+	memset(g_bus_mb, 0, sizeof(g_bus_mb));
+	memset(g_queued_per_id, 0, sizeof(g_queued_per_id));
+	g_bits = 1000u;
+	g_wire_mb = -1;
+	g_wire_end = 0;
+	g_bus_free = 0;
+	g_bus_busy = 0;
+	g_foreign_pct = foreign_pct;
+	g_foreign_id = foreign_id;
+	g_foreign_ready = false;
+	g_isr_bits = isr_bits;
+	g_isr_mb = -1;
+	g_hol = 0;
+	g_sent_count = 0;
+	g_latency_max_us = 0;
+	g_waited = 0;
+	can_tx_init(&g_can);
+}
+
+/* A sample every 100 bit times, faster than 8-byte frames go out, among
+ * other nodes' frames at higher IDs: every frame that leaves carries a sample
+ * no older than the frame that was on the wire when it was taken, so its
+ * queue-to-wire latency stays within one frame. Alone on the bus it leaves
+ * within CAN_STATS_WAIT_BITS. */
+static void test_latest_latency(void)
+{
+	const uint32_t max_frame = 47u + 64u + (47u + 64u) / 5u + 3u; // Longest 8-byte frame plus intermission
+	for (uint32_t busy = 0; busy < 2; busy++) {
+		bus_reset(busy ? 70u : 0u, 0x400u, 0);
+		uint32_t samples = 0;
+		for (uint32_t n = 0; n < 3000u; n++) {
+			bus_run(g_bits + (busy ? 100u : 400u));
+			TEST_CHECK(can_tx_enqueue_latest(0x180u, ++samples, 0, 8));
+			bus_notice();
+		}
+		bus_run(g_bits + 1000u);
+
+		bool newer = true;
+		for (uint32_t i = 1; i < g_sent_count; i++) {
+			if (g_sent[i].tag <= g_sent[i - 1].tag) newer = false;
+		}
+		can_tx_stats_t st;
+		can_tx_get_stats(&st);
+		printf("latest-value %s: %u samples, %u sent, %u superseded, latency max %u us (one frame %u us), "
+		       "%u later than %u bit times\n",
+		       busy ? "among 70 % other traffic" : "alone on the bus", (unsigned)samples, (unsigned)g_sent_count,
+		       (unsigned)st.superseded, (unsigned)g_latency_max_us, (unsigned)(max_frame * US_PER_BIT),
+		       (unsigned)g_waited, (unsigned)CAN_STATS_WAIT_BITS);
+		TEST_CHECK(newer && g_sent[g_sent_count - 1u].tag == samples); // The last sample made it
+		TEST_CHECK(st.completed == g_sent_count && st.completed + st.superseded == samples);
+		TEST_CHECK(st.queued == 0 && st.in_flight == 0);
+		if (busy) {
+			TEST_CHECK(g_latency_max_us <= max_frame * US_PER_BIT);
+			TEST_CHECK(st.superseded > samples / 10u); // The abort path ran
+		} else {
+			TEST_CHECK(g_waited == 0 && st.superseded == 0);
+		}
+	}
+}
+
+/* Sustained load with the queue full: an ISO-TP-like stream on one ID that
+ * keeps the queue full, and status frames on 16 higher IDs, with the
+ * completion interrupt 20 us after the end of frame. While the stream's next
+ * frame waits for its own ID to leave a mailbox, the other mailbox must take
+ * a status frame rather than sit idle behind it (a blocked head left it idle
+ * about once per stream frame). Every frame still goes out in per-ID order. */
+static void test_sustained_load(void)
+{
+	bus_reset(0, 0x800u, 10u);
+	uint32_t tag[0x800] = {0};
+	uint32_t enqueued = 0, dropped = 0;
+	for (uint32_t n = 0; n < 4000u; n++) {
+		bus_run(g_bits + 50u);
+		uint32_t id = (rng() % 4u == 0) ? 0x300u + rng() % 16u : 0x240u;
+		if (can_tx_enqueue_words(id, ++tag[id], 0, 8)) {
+			g_queued_per_id[id]++;
+			enqueued++;
+		} else {
+			dropped++;
+		}
+		bus_notice();
+		check_hol();
+	}
+	double load = 100.0 * g_bus_busy / (double)(g_bits - 1000u);
+	uint32_t under_load = g_sent_count, status_under_load = 0;
+	for (uint32_t i = 0; i < under_load; i++) {
+		if (g_sent[i].id != 0x240u) status_under_load++;
+	}
+	bus_run(g_bits + 1000000u);
+
+	uint32_t last[0x800] = {0};
+	bool fifo = true;
+	for (uint32_t i = 0; i < g_sent_count; i++) {
+		if (g_sent[i].tag <= last[g_sent[i].id]) fifo = false;
+		last[g_sent[i].id] = g_sent[i].tag;
+	}
+	can_tx_stats_t st;
+	can_tx_get_stats(&st);
+	printf("sustained load: %u queued, %u dropped (queue full), high water %u; under load %u sent, %u of them "
+	       "status, bus %.0f %% busy, %u idle mailboxes beside a waiting frame\n",
+	       (unsigned)enqueued, (unsigned)dropped, (unsigned)st.high_water, (unsigned)under_load,
+	       (unsigned)status_under_load, load, (unsigned)g_hol);
+	TEST_CHECK(dropped > 0 && st.high_water == CAN_TX_QUEUE_LEN); // It did run full
+	TEST_CHECK(g_sent_count == enqueued && st.completed == enqueued && fifo);
+	TEST_CHECK(g_hol == 0 && status_under_load > 0);
+}
+
+// Enqueue a full queue of random IDs, then drain it through the mailboxes
+static void bench_push_pop(void)
+{
+	can_tx_init(&g_can);
+	const uint32_t rounds = 20000;
+	uint64_t frames = 0;
+	uint64_t start = test_now_ns();
+	for (uint32_t round = 0; round < rounds; round++) {
+		g_sent_count = 0;
+		can_tx_hold(true);
+		for (uint32_t i = 0; i < CAN_TX_QUEUE_LEN; i++) {
+			(void)can_tx_enqueue_words(rng() & 0x7FFu, i, 0, 8);
+		}
+		can_tx_hold(false);
+		drain();
+		frames += g_sent_count;
+	}
+	uint64_t ns = test_now_ns() - start;
+	TEST_CHECK(frames == (uint64_t)rounds * CAN_TX_QUEUE_LEN);
+	printf("push/pop: %llu frames, %.1f ns per frame (enqueue, heap, mailbox load, completion), %.2f Mframes/s\n",
+	       (unsigned long long)frames, (double)ns / (double)frames, (double)frames * 1e3 / (double)ns);
+}
+
+/* can_bench.c's two paths from an encoder sample to a loaded mailbox, with
+ * the queue empty so the frame goes straight to a mailbox: fields shifted
+ * into bytes for can_tx_enqueue(), or can_pack_encoder1() into the mailbox
+ * words for can_tx_enqueue_words(). The mailbox is completed between frames,
+ * outside the timed part. */
+static void bench_bytes_vs_words(void)
+{
+	can_tx_init(&g_can);
+	const uint32_t frames = 200000;
+	uint64_t sum[2] = {0, 0};
+	uint64_t min[2] = {UINT64_MAX, UINT64_MAX};
+	for (uint32_t n = 0; n < frames; n++) {
+		for (uint32_t path = 0; path < 2; path++) {
+			int32_t position = (int32_t)(n * 7919u);
+			int32_t velocity = -(int32_t)n;
+			bool ok;
+			uint64_t start = test_cost_now();
+			if (path != 0) {
+				can_encoder1_t msg = { position, velocity };
+				uint32_t datal, datah;
+				can_pack_encoder1(&msg, &datal, &datah);
+				ok = can_tx_enqueue_words(0x6FFu, datal, datah, CAN_MSG_DLC(encoder1));
+			} else {
+				uint8_t data[8];
+				for (uint8_t i = 0; i < 4; i++) data[i] = (uint8_t)((uint32_t)position >> (i * 8));
+				for (uint8_t i = 0; i < 4; i++) data[i + 4] = (uint8_t)((uint32_t)velocity >> (i * 8));
+				ok = can_tx_enqueue(0x6FFu, data, sizeof(data));
+			}
+			uint64_t cost = test_cost_now() - start;
+			TEST_CHECK(ok);
+			sum[path] += cost;
+			if (cost < min[path]) min[path] = cost;
+			g_sent_count = 0;
+			drain();
+			TEST_CHECK(g_sent_count == 1);
+		}
+	}
+	printf("sample to mailbox, bytes + can_tx_enqueue(): min %llu, avg %.1f %s\n", (unsigned long long)min[0],
+	       (double)sum[0] / frames, TEST_COST_UNIT);
+	printf("sample to mailbox, words + can_tx_enqueue_words(): min %llu, avg %.1f %s\n", (unsigned long long)min[1],
+	       (double)sum[1] / frames, TEST_COST_UNIT);
+}
+
+int main(void)
+{
+	printf("TX mailboxes %u..%u, queue %u\n", (unsigned)CAN_TX_MB_FIRST,
+	       (unsigned)(CAN_TX_MB_FIRST + CAN_TX_MB_COUNT - 1u), (unsigned)CAN_TX_QUEUE_LEN);
+	test_priority_order();
+	test_fifo_while_busy();
+	test_latest_supersede();
+	test_latest_latency();
+	test_sustained_load();
+	bench_push_pop();
+	bench_bytes_vs_words();
+	return test_result("can_tx");
+}
@@ -0,0 +1,113 @@
+/* can_urgent.c with the real can_time.c against a mocked controller at
+ * 500 kbit/s: the start-of-frame to handler latency comes from the urgent
+ * mailbox's own CAN_MSR capture, in time-triggered mode as well, where
+ * CAN_TIMESTP may already hold a later frame. Also times can_urgent_isr()
+ * itself on the host.
+ */
+#include "test_host.h"
+#include "can_urgent.h"
+#include "can_time.h"
+#include "can_app.h"
+#include "can.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define BITRATE      500000u
+#define US_PER_BIT   2u
+
+static Can g_can;
+static portTickType g_tick;
+static uint32_t g_stops;
+static uint64_t g_stop_stamp;
+
+void vPortEnterCritical(void) {}
+void vPortExitCritical(void) {}
+portTickType xTaskGetTickCount(void) { return g_tick; }
+portTickType xTaskGetTickCountFromISR(void) { return g_tick; }
+void can_mailbox_init(Can *p_can, can_mb_conf_t *p_mailbox) { (void)p_can; (void)p_mailbox; }
+void can_mailbox_send_transfer_cmd(Can *p_can, can_mb_conf_t *p_mailbox) { (void)p_can; (void)p_mailbox; }
+bool can_rx_accepts(uint32_t id) { return false; }
+uint32_t can_node_mid(uint32_t id) { return CAN_MID_MIDvA(id); }
+uint32_t can_node_mam(uint32_t id, uint32_t mask) { return CAN_MAM_MIDvA(mask); }
+uint32_t can_node_from_mid(uint32_t mid) { return (mid & CAN_MID_MIDvA_Msk) >> CAN_MID_MIDvA_Pos; }
+void can_stats_on_rx(uint32_t id, uint8_t len) { (void)id; (void)len; }
+
+void can_cmd_stop(const can_rx_frame_t *frame, bool *woken)
+{
+	g_stops++;
+	g_stop_stamp = frame->timestamp;
+}
+
+// The CAN timer and the tick at a time in bit times
+static void set_time(uint64_t bits)
+{
+	TEST_SET_RO(g_can.CAN_TIM, (uint32_t)(bits & CAN_TIM_TIMER_Msk));
+	g_tick = (portTickType)(bits / (BITRATE / configTICK_RATE_HZ));
+}
+
+/* A stop frame starts at sof, later bus traffic is captured at later_sof,
+ * and the ISR runs at isr; returns the latency can_urgent recorded */
+static uint32_t urgent_frame(uint64_t sof, uint64_t later_sof, uint64_t isr)
+{
+	CanMb *p_mb = &g_can.CAN_MB[CAN_URGENT_MB];
+	p_mb->CAN_MID = CAN_MID_MIDvA(CAN_ID_STOP);
+	TEST_SET_RO(p_mb->CAN_MSR, CAN_MSR_MRDY | (1u << CAN_MSR_MDLC_Pos) | (uint32_t)(sof & 0xFFFFu));
+	TEST_SET_RO(g_can.CAN_TIMESTP, (uint32_t)(later_sof & 0xFFFFu));
+	set_time(isr);
+	uint32_t stops = g_stops;
+	(void)can_urgent_isr(1u << CAN_URGENT_MB);
+	TEST_CHECK(g_stops == stops + 1u);
+	TEST_CHECK(g_stop_stamp == sof);
+	can_urgent_stats_t st;
+	can_urgent_get_stats(&st);
+	return st.lat_last_us;
+}
+
+int main(void)
+{
+	set_time(0);
+	can_time_init(&g_can, BITRATE);
+	can_urgent_init(&g_can);
+
+	// 1-byte stop frame: 55 bits on the wire, then 45 bits until the ISR runs
+	uint64_t t = 100000u;
+	uint32_t lat = urgent_frame(t, t + 60u, t + 100u);
+	printf("event-driven mode: frame at %llu, ISR 100 bits later, latency %u us\n", (unsigned long long)t, (unsigned)lat);
+	TEST_CHECK(lat == 100u * US_PER_BIT);
+
+	// TTM: another frame started after the stop and before the ISR; CAN_TIMESTP has its capture
+	g_can.CAN_MR |= CAN_MR_TTM;
+	t = 300000u;
+	lat = urgent_frame(t, t + 90u, t + 100u);
+	printf("time-triggered mode, later frame in CAN_TIMESTP: latency %u us (CAN_TIMESTP would give %u us)\n",
+	       (unsigned)lat, (unsigned)(10u * US_PER_BIT));
+	TEST_CHECK(lat == 100u * US_PER_BIT);
+
+	// Capture just before the 16-bit timer wraps, ISR after it
+	t = 0x5FFF0u;
+	lat = urgent_frame(t, t + 30u, t + 0x40u);
+	TEST_CHECK(lat == 0x40u * US_PER_BIT);
+	g_can.CAN_MR = 0;
+
+	can_urgent_stats_t st;
+	can_urgent_get_stats(&st);
+	TEST_CHECK(st.handled == 3 && st.stray == 0 && st.lat_max_us == 100u * US_PER_BIT);
+
+	// Cost of the ISR path itself: mailbox read, time extension, table search, handler
+	const uint32_t runs = 100000;
+	uint64_t min = UINT64_MAX, sum = 0;
+	for (uint32_t i = 0; i < runs; i++) {
+		t = 400000u + (uint64_t)i * 200u;
+		TEST_SET_RO(g_can.CAN_MB[CAN_URGENT_MB].CAN_MSR, CAN_MSR_MRDY | (1u << CAN_MSR_MDLC_Pos) | (uint32_t)(t & 0xFFFFu));
+		set_time(t + 100u);
+		uint64_t start = test_cost_now();
+		(void)can_urgent_isr(1u << CAN_URGENT_MB);
+		uint64_t cost = test_cost_now() - start;
+		sum += cost;
+		if (cost < min) min = cost;
+	}
+	printf("can_urgent_isr(): min %llu, avg %.1f %s per urgent frame\n", (unsigned long long)min,
+	       (double)sum / runs, TEST_COST_UNIT);
+
+	return test_result("can_urgent");
+}
@@ -0,0 +1,227 @@
+/* encoder_position.c: the 64-bit position kept from a 32-bit TC_CV0 and the
+ * index pulse tracking. Folds and time base periods carry the position past
+ * +-2^32 with TC_CV0 wrapping underneath; a late handler's missed periods
+ * are estimated across a cycle counter wrap; index pulses beyond 2^32 learn
+ * the revolution, flag drift and accept the same mark passed back; each
+ * writer bumps only its own sequence counter. Last, a SIGALRM handler plays
+ * the interrupt writing while the main thread reads below it, as tasks and
+ * TC0_Handler do: no read may come back torn.
+ */
+#include "test_host.h"
+#include "encoder_position.h"
+#include <signal.h>
+#include <sys/time.h>
+
+#define TWO_32         4294967296LL
+#define STEP           (1u << 30) // TC_CV0 movement between folds, under the 2^31 limit
+
+static encoder_position_t g_pos;
+
+static void test_fold(void)
+{
+	encoder_position_init(&g_pos, 0, 0);
+	uint32_t cv = 0;
+	for (int32_t i = 1; i <= 10; i++) {
+		cv += STEP;
+		encoder_position_fold(&g_pos, cv);
+		TEST_CHECK(encoder_position_read(&g_pos) == (int64_t)i * STEP);
+	}
+	TEST_CHECK(encoder_position_read(&g_pos) > 2 * TWO_32);
+	TEST_CHECK(encoder_position_at(&g_pos, cv + 123u) == 10LL * STEP + 123);
+	TEST_CHECK(encoder_position_at(&g_pos, cv - 123u) == 10LL * STEP - 123);
+	for (int32_t i = 9; i >= -10; i--) {
+		cv -= STEP;
+		encoder_position_fold(&g_pos, cv);
+		TEST_CHECK(encoder_position_read(&g_pos) == (int64_t)i * STEP);
+	}
+	TEST_CHECK(encoder_position_read(&g_pos) < -2 * TWO_32);
+	TEST_CHECK(encoder_position_at(&g_pos, cv - 1u) == -10LL * STEP - 1);
+}
+
+// The time base starts after folds, runs past 2^32 and misses periods across a stamp wrap
+static void test_period(void)
+{
+	const uint32_t cycles = 12000u;
+	encoder_position_init(&g_pos, 0, 0);
+	uint32_t cv = 0;
+	for (int32_t i = 0; i < 3; i++) {
+		cv += STEP;
+		encoder_position_fold(&g_pos, cv);
+	}
+	int64_t truth = 3LL * STEP + 77; // TC_CV0 moved 77 more before the restart
+	uint32_t stamp = 0xFFFFFFFFu - 40u * cycles; // Wraps within the run
+	encoder_position_restart(&g_pos, cv + 77u, cycles, stamp);
+	TEST_CHECK(encoder_position_read(&g_pos) == truth);
+	TEST_CHECK(encoder_position_at(&g_pos, 5u) == truth + 5);
+
+	// 2^31 - 1 counts per period, the most TC_RA0 can say
+	const int32_t ra = INT32_MAX;
+	for (uint32_t i = 0; i < 20u; i++) {
+		stamp += cycles;
+		truth += ra;
+		TEST_CHECK(encoder_position_period(&g_pos, ra, 3u, false, stamp) == truth + 3);
+	}
+	TEST_CHECK(encoder_position_read(&g_pos) == truth + 3 && truth > 4 * TWO_32);
+	TEST_CHECK(g_pos.missed_periods == 0);
+
+	// Three periods late (2 missed) through the stamp wrap, and at a bit of extra latency
+	stamp += 3u * cycles + cycles / 3u;
+	truth += 3LL * ra;
+	TEST_CHECK(encoder_position_period(&g_pos, ra, 0u, true, stamp) == truth);
+	TEST_CHECK(g_pos.missed_periods == 2u);
+	// LOVRS with the stamps saying one period: still at least one missed
+	stamp += cycles;
+	truth += 2LL * ra;
+	TEST_CHECK(encoder_position_period(&g_pos, ra, 0u, true, stamp) == truth);
+	TEST_CHECK(g_pos.missed_periods == 3u);
+
+	// Backwards, down through zero and past -2^32
+	for (uint32_t i = 0; i < 60u; i++) {
+		stamp += cycles;
+		truth -= ra;
+		TEST_CHECK(encoder_position_period(&g_pos, -ra, (uint32_t)-2, false, stamp) == truth - 2);
+	}
+	TEST_CHECK(truth < -4 * TWO_32 && encoder_position_read(&g_pos) == truth - 2);
+}
+
+static void test_index(void)
+{
+	const int64_t at = 5 * TWO_32 + 12345;
+	encoder_index_stats_t st;
+	encoder_position_init(&g_pos, 0, 2);
+
+	encoder_position_index(&g_pos, at, 0);
+	encoder_position_index(&g_pos, at + 4000, 1);          // Learns the revolution
+	encoder_position_get_index(&g_pos, &st);
+	TEST_CHECK(st.counts_per_rev == 4000 && st.index_count == 2u && st.drift_errors == 0u);
+	TEST_CHECK(st.index_position == at + 4000 && st.revolutions == 1);
+
+	encoder_position_index(&g_pos, at + 8002, 2);          // Within the tolerance
+	encoder_position_index(&g_pos, at + 8001, 2);          // Same mark passed back
+	encoder_position_index(&g_pos, at + 4001, 1);          // One revolution back
+	encoder_position_get_index(&g_pos, &st);
+	TEST_CHECK(st.drift_errors == 0u && st.drift_max == 2 && st.index_count == 5u);
+
+	encoder_position_index(&g_pos, at + 8011, 2);          // 9 counts off: lost counts
+	encoder_position_index(&g_pos, at + 8011 + 8000, 4);   // A missed index
+	encoder_position_get_index(&g_pos, &st);
+	TEST_CHECK(st.drift_errors == 2u && st.drift_max == 4000 && st.counts_per_rev == 4000);
+	TEST_CHECK(st.index_position == at + 16011 && st.revolutions == 4);
+
+	// Configured revolution: the first span is checked, not learned
+	encoder_position_init(&g_pos, 1000, 2);
+	encoder_position_index(&g_pos, -at, 0);
+	encoder_position_index(&g_pos, -at - 1500, -1);
+	encoder_position_get_index(&g_pos, &st);
+	TEST_CHECK(st.counts_per_rev == 1000 && st.drift_errors == 1u && st.drift_max == 500);
+
+	// Clear: position and revolutions from zero, the learned revolution stays
+	uint32_t seq = g_pos.seq, index_seq = g_pos.index_seq;
+	encoder_position_fold(&g_pos, 99u);
+	encoder_position_clear(&g_pos);
+	encoder_position_get_index(&g_pos, &st);
+	TEST_CHECK(encoder_position_read(&g_pos) == 0 && encoder_position_at(&g_pos, 7u) == 7);
+	TEST_CHECK(st.index_count == 0u && st.revolutions == 0 && st.counts_per_rev == 1000);
+	TEST_CHECK(g_pos.seq == seq + 2u && g_pos.index_seq == index_seq + 1u);
+}
+
+// TC2_Handler and TC0_Handler each bump their own counter only
+static void test_writers(void)
+{
+	encoder_position_init(&g_pos, 0, 2);
+	encoder_position_restart(&g_pos, 0u, 1000u, 0u);
+	uint32_t seq = g_pos.seq, index_seq = g_pos.index_seq;
+	(void)encoder_position_period(&g_pos, 10, 0u, false, 1000u);
+	TEST_CHECK(g_pos.seq == seq + 1u && g_pos.index_seq == index_seq);
+	encoder_position_index(&g_pos, 10, 0);
+	TEST_CHECK(g_pos.seq == seq + 1u && g_pos.index_seq == index_seq + 1u);
+	encoder_position_fold(&g_pos, 0u);
+	TEST_CHECK(g_pos.seq == seq + 2u && g_pos.index_seq == index_seq + 1u);
+}
+
+/* The handler moves the simulated TC_CV0 by a step, folds it and every other
+ * time passes an index mark one revolution on. The main thread reads the
+ * live position the way encoder1_live_position() does and the index stats
+ * the way encoder1_get_index_stats() does; it also keeps what at() gave on
+ * the first try, unchecked, to show the sequence counter is what holds. */
+#define HANDLER_US     20u
+#define READ_NS        300000000u
+#define REV            1000003LL
+
+static volatile uint64_t g_hw;      // Counts since the start; TC_CV0 is its low 32 bits
+static volatile uint32_t g_signals;
+static const int64_t g_start = TWO_32 - 3LL * STEP; // Crosses 2^32 early on
+
+static void handler(int sig)
+{
+	(void)sig;
+	g_hw += STEP / 4u + 1u;
+	encoder_position_fold(&g_pos, (uint32_t)g_hw);
+	g_signals++;
+	if (g_signals % 2u == 0) {
+		int32_t rev = (int32_t)(g_signals / 2u);
+		encoder_position_index(&g_pos, REV * rev, rev);
+	}
+}
+
+static void test_preempted(void)
+{
+	encoder_position_init(&g_pos, 0, 2);
+	g_pos.count_base = g_start;
+	g_pos.position = g_start;
+	g_hw = 0;
+	g_signals = 0;
+
+	struct sigaction sa = {0};
+	sa.sa_handler = handler;
+	TEST_CHECK(sigaction(SIGALRM, &sa, NULL) == 0);
+	struct itimerval it = { { 0, HANDLER_US }, { 0, HANDLER_US } };
+	TEST_CHECK(setitimer(ITIMER_REAL, &it, NULL) == 0);
+
+	uint64_t reads = 0, retries = 0, torn = 0, wrong = 0, index_reads = 0, index_wrong = 0;
+	uint64_t until = test_now_ns() + READ_NS;
+	while (test_now_ns() < until) {
+		for (uint32_t k = 0; k < 1000u; k++) {
+			uint64_t hw;
+			int64_t position;
+			uint32_t seq, tries = 0;
+			do {
+				seq = g_pos.seq;
+				hw = g_hw;
+				position = encoder_position_at(&g_pos, (uint32_t)hw);
+				if (tries++ == 0 && position != g_start + (int64_t)hw) torn++;
+			} while (seq != g_pos.seq);
+			retries += tries - 1u;
+			reads++;
+			if (position != g_start + (int64_t)hw) wrong++;
+
+			encoder_index_stats_t st;
+			encoder_position_get_index(&g_pos, &st);
+			index_reads++;
+			if (st.index_position != REV * st.revolutions || st.index_count != (uint32_t)st.revolutions) index_wrong++;
+		}
+	}
+	struct itimerval off = {0};
+	setitimer(ITIMER_REAL, &off, NULL);
+
+	encoder_index_stats_t st;
+	encoder_position_get_index(&g_pos, &st);
+	printf("handler every %u us: %u runs, position to %.1f x 2^32; %llu reads, %llu retried, %llu torn on the first "
+	       "try, %llu wrong; %llu index reads, %llu wrong\n", (unsigned)HANDLER_US, (unsigned)g_signals,
+	       (double)encoder_position_read(&g_pos) / (double)TWO_32, (unsigned long long)reads,
+	       (unsigned long long)retries, (unsigned long long)torn, (unsigned long long)wrong,
+	       (unsigned long long)index_reads, (unsigned long long)index_wrong);
+	TEST_CHECK(g_signals > 1000u && encoder_position_read(&g_pos) > 2 * TWO_32);
+	TEST_CHECK(wrong == 0 && index_wrong == 0);
+	TEST_CHECK(st.counts_per_rev == REV && st.drift_errors == 0u);
+}
+
+int main(void)
+{
+	test_fold();
+	test_period();
+	test_index();
+	test_writers();
+	test_preempted();
+	return test_result("encoder_position");
+}
@@ -0,0 +1,136 @@
+/* encoder_quad against synthetic A/B streams: random steps with reversals,
+ * one-line glitches the edge interrupt sees zero, one or two times, and
+ * jumps where both lines changed between two reads (a missed edge). The
+ * decoder must follow a reference counter exactly, as the QDE would, except
+ * for the jumps, which it counts as errors and leaves out. Also times
+ * encoder_quad_step() itself on the host.
+ */
+#include "test_host.h"
+#include "encoder_quad.h"
+
+#define STEPS          1000000u
+
+// Levels at each phase, forward: 00 -> A -> AB -> B
+static const uint32_t g_phase_ab[4] = { 0u, ENCODER_QUAD_A, ENCODER_QUAD_A | ENCODER_QUAD_B, ENCODER_QUAD_B };
+
+static uint32_t rng_state = 11u;
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 1664525u + 1013904223u;
+	return rng_state >> 8;
+}
+
+typedef struct {
+	uint32_t phase;  // Line levels, as an index into g_phase_ab
+	int32_t truth;   // Where the shaft is, in edges (what the QDE counts)
+	int32_t skipped; // Edges lost to jumps, signed
+	uint32_t jumps;
+	uint32_t glitches;
+	uint32_t reversals;
+} stream_t;
+
+// Move the lines by d edges and let the decoder see the result once
+static void move(stream_t *s, encoder_quad_t *q, int32_t d)
+{
+	s->phase = (s->phase + 4u + (uint32_t)d) & 3u;
+	s->truth += d;
+	(void)encoder_quad_step(q, g_phase_ab[s->phase]);
+}
+
+/* Random walk: runs of 1-200 edges in one direction, then a reversal. With
+ * glitch_per_1000 one line pulses and returns before or after the read; with
+ * jump_per_1000 two edges pass between reads. */
+static void run(encoder_quad_t *q, stream_t *s, uint32_t glitch_per_1000, uint32_t jump_per_1000)
+{
+	int32_t dir = 1;
+	uint32_t run_left = 0;
+	bool exact = true;
+	for (uint32_t i = 0; i < STEPS; i++) {
+		if (run_left == 0) {
+			run_left = 1u + rng() % 200u;
+			if (rng() & 1u) {
+				dir = -dir;
+				s->reversals++;
+			}
+		}
+		run_left--;
+
+		if (rng() % 1000u < jump_per_1000) {
+			s->phase = (s->phase + 4u + (uint32_t)(2 * dir)) & 3u; // Both lines changed: no way to tell the direction
+			s->truth += 2 * dir;
+			s->skipped += 2 * dir;
+			s->jumps++;
+			(void)encoder_quad_step(q, g_phase_ab[s->phase]);
+		} else {
+			move(s, q, dir);
+		}
+
+		if (rng() % 1000u < glitch_per_1000) {
+			uint32_t glitch = g_phase_ab[s->phase] ^ ((rng() & 1u) ? ENCODER_QUAD_A : ENCODER_QUAD_B);
+			uint32_t seen = rng() % 3u; // Pulse gone before the read, read once, read twice
+			for (uint32_t k = 0; k < seen; k++) (void)encoder_quad_step(q, glitch);
+			(void)encoder_quad_step(q, g_phase_ab[s->phase]);
+			s->glitches++;
+		}
+		if (q->count != s->truth - s->skipped) exact = false;
+	}
+	TEST_CHECK(exact);
+}
+
+int main(void)
+{
+	encoder_quad_t q;
+	stream_t s;
+
+	// Clean stream with reversals: edge for edge with the reference
+	s = (stream_t){0};
+	encoder_quad_init(&q, g_phase_ab[0]);
+	run(&q, &s, 0, 0);
+	printf("clean: %u steps, %u reversals, count %d, truth %d, %u errors\n", (unsigned)q.steps,
+	       (unsigned)s.reversals, (int)q.count, (int)s.truth, (unsigned)q.errors);
+	TEST_CHECK(q.count == s.truth && q.errors == 0 && q.steps == STEPS);
+
+	// One-line glitches on 10 % of the steps: they cancel, never an error
+	s = (stream_t){0};
+	encoder_quad_init(&q, g_phase_ab[0]);
+	run(&q, &s, 100, 0);
+	printf("glitches: %u glitches, count %d, truth %d, %u errors\n", (unsigned)s.glitches, (int)q.count,
+	       (int)s.truth, (unsigned)q.errors);
+	TEST_CHECK(s.glitches > STEPS / 20u);
+	TEST_CHECK(q.count == s.truth && q.errors == 0);
+
+	// Double-line jumps on 1 % of the steps, glitches too: each jump is one error, its 2 edges left out
+	s = (stream_t){0};
+	encoder_quad_init(&q, g_phase_ab[0]);
+	run(&q, &s, 100, 10);
+	printf("jumps: %u jumps, %u errors, count %d, truth %d, %d edges skipped\n", (unsigned)s.jumps,
+	       (unsigned)q.errors, (int)q.count, (int)s.truth, (int)s.skipped);
+	TEST_CHECK(s.jumps > STEPS / 200u);
+	TEST_CHECK(q.errors == s.jumps && q.count == s.truth - s.skipped);
+
+	// Starting between edges: the first read sets the phase, counts from there
+	encoder_quad_init(&q, g_phase_ab[2]);
+	TEST_CHECK(encoder_quad_step(&q, g_phase_ab[3]) == 1 && encoder_quad_step(&q, g_phase_ab[2]) == -1);
+	TEST_CHECK(encoder_quad_step(&q, g_phase_ab[2]) == 0 && q.steps == 2 && q.count == 0);
+
+	// Cost of a step as the edge interrupt makes it, on a stream with reversals and glitches
+	static uint32_t ab[STEPS];
+	uint32_t phase = 0;
+	for (uint32_t i = 0; i < STEPS; i++) {
+		phase = (phase + ((rng() % 8u == 0) ? 3u : 1u)) & 3u;
+		ab[i] = (rng() % 16u == 0) ? g_phase_ab[phase] ^ ENCODER_QUAD_A : g_phase_ab[phase];
+	}
+	encoder_quad_init(&q, g_phase_ab[0]);
+	uint64_t min = UINT64_MAX, sum = 0;
+	for (uint32_t i = 0; i < STEPS; i++) {
+		uint64_t start = test_cost_now();
+		(void)encoder_quad_step(&q, ab[i]);
+		uint64_t cost = test_cost_now() - start;
+		sum += cost;
+		if (cost < min) min = cost;
+	}
+	printf("encoder_quad_step(): min %llu, avg %.1f %s per edge\n", (unsigned long long)min, (double)sum / STEPS,
+	       TEST_COST_UNIT);
+
+	return test_result("encoder_quad");
+}
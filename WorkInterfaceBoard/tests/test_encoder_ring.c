@@ -0,0 +1,218 @@
+/* encoder_ring against a mocked TC0: channel 2 fires at 10 kHz, the handler
+ * does what TC2_Handler does (period count from TC_RA0, position from it
+ * plus TC_CV0, cycle counter stamp) and encoder1_task drains the ring every
+ * CONF_ENCODER_PUBLISH_MS with scheduling jitter and the odd long stall.
+ * The position bookkeeping is encoder_position.c, as in the firmware.
+ * Every sample must arrive, in order, with the position the counter had.
+ * When the handler misses whole periods, TC_RA0 is overwritten and LOVRS
+ * set: the missed periods must be counted and their counts estimated from
+ * the speed. A second run pushes and reads from two threads to check the
+ * lock-free hand-over itself: no sample torn, lost or repeated.
+ */
+#include "test_host.h"
+#include "encoder_ring.h"
+#include "encoder_position.h"
+#include "conf_encoder.h"
+#include <pthread.h>
+#include <sched.h>
+
+#define SAMPLE_HZ      10000u
+#define CPU_HZ         120000000u
+#define SECONDS        60u
+#define BATCH          ((CONF_ENCODER_PUBLISH_MS * SAMPLE_HZ) / 1000u * 2u) // encoder1_task's ENCODER1_SAMPLE_BATCH
+
+typedef struct {
+	int32_t cv;    // TC_CV0, cleared at every time base edge
+	int32_t ra;    // TC_RA0, counts of the period that just ended
+	bool unread;   // RA loaded since the handler last read it
+	bool lovrs;    // Loaded again before that read
+} tc_mock_t;
+
+static encoder_ring_t g_ring;
+static tc_mock_t g_tc;
+static encoder_position_t g_pos; // g_encoder1_pos
+
+static uint32_t rng_state = 7u;
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 1664525u + 1013904223u;
+	return rng_state >> 8;
+}
+
+// Time base edge: the period's counts go to RA, the counter restarts
+static void time_base_edge(int32_t ra, int32_t cv)
+{
+	if (g_tc.unread) g_tc.lovrs = true;
+	g_tc.unread = true;
+	g_tc.ra = ra;
+	g_tc.cv = cv;
+}
+
+// encoder1_sampler_start(): the time base starts at stamp 0 with TC_CV0 cleared
+static void sampler_start(void)
+{
+	encoder_ring_init(&g_ring);
+	g_tc = (tc_mock_t){0};
+	encoder_position_init(&g_pos, 0, 0);
+	encoder_position_restart(&g_pos, 0, CPU_HZ / SAMPLE_HZ, 0);
+}
+
+// TC2_Handler on the mock
+static void sample_isr(uint32_t cyccnt)
+{
+	bool overrun = g_tc.lovrs;
+	g_tc.lovrs = false;
+	int32_t speed = g_tc.ra;
+	g_tc.unread = false;
+	int64_t position = encoder_position_period(&g_pos, speed, (uint32_t)g_tc.cv, overrun, cyccnt);
+	(void)encoder_ring_push(&g_ring, (int32_t)position, speed, cyccnt);
+}
+
+static void test_sampled(void)
+{
+	sampler_start();
+	const uint32_t period_us = 1000000u / SAMPLE_HZ;
+	const uint32_t samples = SAMPLE_HZ * SECONDS;
+	static int64_t truth[SAMPLE_HZ * SECONDS + 1u]; // Where the encoder really was at each sample
+	uint64_t next_drain_us = CONF_ENCODER_PUBLISH_MS * 1000u;
+	uint32_t got = 0, stalls = 0, max_batch = 0;
+	bool in_order = true, positions = true;
+	static encoder_sample_t batch[BATCH];
+
+	for (uint32_t s = 1; s <= samples; s++) {
+		// The period's counts; the last few land between the edge and the handler
+		int32_t moved = (int32_t)(rng() % 41u) - 20;
+		int32_t late = (int32_t)(rng() % 3u) - 1;
+		time_base_edge(g_tc.cv + moved - late, late);
+		truth[s] = truth[s - 1u] + moved;
+		sample_isr(s * period_us * (CPU_HZ / 1000000u));
+
+		uint64_t now_us = (uint64_t)s * period_us;
+		if (now_us < next_drain_us) continue;
+		uint32_t n;
+		while ((n = encoder_ring_read(&g_ring, batch, BATCH)) > 0) {
+			if (n > max_batch) max_batch = n;
+			for (uint32_t i = 0; i < n; i++) {
+				got++;
+				if (batch[i].stamp != got * period_us * (CPU_HZ / 1000000u)) in_order = false;
+				if (batch[i].position != (int32_t)truth[got]) positions = false;
+			}
+		}
+
+		// Publish period plus -1..+3 ms of jitter; a 35 ms stall now and then
+		uint32_t wait_us = CONF_ENCODER_PUBLISH_MS * 1000u - 1000u + rng() % 4000u;
+		if (rng() % 100u == 0) {
+			wait_us = 35000u;
+			stalls++;
+		}
+		next_drain_us = now_us + wait_us;
+	}
+	got += encoder_ring_read(&g_ring, batch, BATCH);
+
+	printf("%u Hz for %u s: %u samples, %u read, %u overruns, high water %u of %u, largest batch %u, %u stalls\n",
+	       (unsigned)SAMPLE_HZ, (unsigned)SECONDS, (unsigned)g_ring.pushed, (unsigned)got, (unsigned)g_ring.overruns,
+	       (unsigned)g_ring.high_water, (unsigned)ENCODER_RING_LEN, (unsigned)max_batch, (unsigned)stalls);
+	TEST_CHECK(g_ring.pushed == samples && got == samples && g_ring.overruns == 0);
+	TEST_CHECK(in_order && positions);
+	TEST_CHECK(g_ring.high_water < ENCODER_RING_LEN);
+	TEST_CHECK(g_pos.missed_periods == 0);
+
+	// A consumer gone for longer than the ring: the older samples stay, the rest are counted
+	encoder_ring_init(&g_ring);
+	for (uint32_t s = 0; s < ENCODER_RING_LEN + 10u; s++) sample_isr(s);
+	TEST_CHECK(g_ring.overruns == 10u && encoder_ring_count(&g_ring) == ENCODER_RING_LEN);
+	TEST_CHECK(encoder_ring_read(&g_ring, batch, 1) == 1 && batch[0].stamp == 0);
+}
+
+/* The handler now and then 1-3 periods late, at up to 0.4 period of extra
+ * latency, while the speed drifts by at most 1 count per period: each missed
+ * period is counted, and its counts taken at the next period's speed are off
+ * by at most the drift. Dropping them would lose whole periods' counts. */
+static void test_late(void)
+{
+	sampler_start();
+	const uint32_t cycles = CPU_HZ / SAMPLE_HZ;
+	const uint32_t periods = SAMPLE_HZ * 10u;
+	int64_t truth = 0, dropped = 0, err_max = 0;
+	int32_t speed = 40;
+	uint32_t events = 0, skipped = 0, skip = 0, drift_bound = 0;
+	static encoder_sample_t batch[BATCH];
+	for (uint32_t p = 1; p <= periods; p++) {
+		if (rng() % 8u == 0) speed += (rng() & 1u) ? 1 : -1;
+		truth += speed;
+		time_base_edge(g_tc.cv + speed, 0);
+		if (skip == 0 && rng() % 500u == 0) {
+			skip = 1u + rng() % 3u;
+			events++;
+			skipped += skip;
+			drift_bound += skip * (skip + 1u) / 2u; // Each missed period at most its distance in drift off
+			dropped += (int64_t)speed * skip;
+		}
+		if (skip != 0) {
+			skip--;
+			continue;
+		}
+		sample_isr(p * cycles + rng() % (cycles * 2u / 5u));
+		int64_t err = encoder_position_read(&g_pos) - g_tc.cv - truth;
+		if (err < 0) err = -err;
+		if (err > err_max) err_max = err;
+		while (encoder_ring_read(&g_ring, batch, BATCH) > 0) {}
+	}
+	printf("handler 1-3 periods late %u times: %u periods missed, %u counted, position off by up to %lld "
+	       "(about %lld counts lost without the estimate)\n", (unsigned)events,
+	       (unsigned)skipped, (unsigned)g_pos.missed_periods, (long long)err_max, (long long)dropped);
+	TEST_CHECK(skipped > 0 && g_pos.missed_periods == skipped);
+	TEST_CHECK(err_max <= (int64_t)drift_bound);
+}
+
+#define THREAD_SAMPLES 200000u
+
+static volatile bool g_done;
+
+static void *producer(void *arg)
+{
+	(void)arg;
+	for (uint32_t s = 1; s <= THREAD_SAMPLES; s++) {
+		while (!encoder_ring_push(&g_ring, (int32_t)s, (int32_t)~s, s)) sched_yield(); // Full: retry, so every sample crosses
+	}
+	__sync_synchronize();
+	g_done = true;
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	encoder_ring_init(&g_ring);
+	g_done = false;
+	pthread_t thread;
+	TEST_CHECK(pthread_create(&thread, NULL, producer, NULL) == 0);
+
+	static encoder_sample_t batch[BATCH];
+	uint32_t got = 0, last = 0;
+	bool intact = true, in_order = true;
+	for (;;) {
+		bool done = g_done;
+		uint32_t n = encoder_ring_read(&g_ring, batch, BATCH);
+		for (uint32_t i = 0; i < n; i++) {
+			if ((uint32_t)batch[i].position != batch[i].stamp || (uint32_t)batch[i].speed != ~batch[i].stamp) intact = false;
+			if (batch[i].stamp != last + 1u) in_order = false;
+			last = batch[i].stamp;
+		}
+		got += n;
+		if (done && n == 0) break;
+	}
+	pthread_join(thread, NULL);
+
+	printf("two threads: %u pushed, %u read, %u pushes found the ring full\n", (unsigned)g_ring.pushed, (unsigned)got,
+	       (unsigned)g_ring.overruns);
+	TEST_CHECK(intact && in_order);
+	TEST_CHECK(got == THREAD_SAMPLES && g_ring.pushed == THREAD_SAMPLES);
+}
+
+int main(void)
+{
+	test_sampled();
+	test_late();
+	test_threads();
+	return test_result("encoder_ring");
+}
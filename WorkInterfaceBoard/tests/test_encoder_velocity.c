@@ -0,0 +1,102 @@
+/* encoder_velocity on synthetic encoder traces from 0.1 to 10k counts/s:
+ * each speed has a +-20 % ripple slow enough to span about 50 counts, the
+ * stamps run at 120 MHz and wrap. Edges are stamped exactly (software
+ * decoder, edge interrupt) or at the CONF_ENCODER_SAMPLE_HZ sample that saw
+ * them (QDE, encoder1_task feeding the ring). Reports the RMS error against
+ * the true speed next to counts per 10 ms publish period, and the cost of an
+ * update. No recorded traces yet; a board capture can be replayed through
+ * replay() the same way.
+ */
+#include "test_host.h"
+#include "encoder_velocity.h"
+#include "conf_encoder.h"
+#include <math.h>
+
+#define CPU_HZ         120000000u
+#define SAMPLE_HZ      CONF_ENCODER_SAMPLE_HZ
+#define RIPPLE         0.2
+
+typedef struct {
+	double rms_mt;   // M/T observer, relative RMS error
+	double rms_diff; // Counts per publish period
+	double worst_mt; // Largest relative error of one update
+} result_t;
+
+// Replay cps counts/s with ripple; edges stamped at the edge (exact) or at the sample that saw them
+static result_t replay(double cps, bool exact)
+{
+	encoder_velocity_t v;
+	encoder_velocity_init(&v, CPU_HZ, CONF_ENCODER_VELOCITY_WINDOW_MS * 1000u, CONF_ENCODER_VELOCITY_STOP_MS);
+
+	const double ripple_s = fmax(2.0, 50.0 / cps);
+	const double settle_s = ripple_s + 1.0; // First window and a full ripple period
+	const double end_s = settle_s + 3.0 * ripple_s;
+	const double dt = 1.0 / SAMPLE_HZ;
+	const uint32_t publish = SAMPLE_HZ * CONF_ENCODER_PUBLISH_MS / 1000u;
+
+	double pos = 0.5, err_mt = 0, err_diff = 0, power = 0, worst = 0, diff = 0;
+	int32_t count = 0, published = 0;
+	uint32_t edge = 0, k = 0;
+	for (uint64_t n = 0; n * dt < end_s; n++) {
+		double t = n * dt;
+		double speed = cps * (1.0 + RIPPLE * sin(2.0 * M_PI * t / ripple_s));
+		double next = pos + speed * dt;
+		int32_t c = (int32_t)floor(next);
+		if (c != count) {
+			double at = t + ((double)c - pos) / speed; // Last edge inside the sample period
+			edge = (uint32_t)(uint64_t)((exact ? at : t + dt) * CPU_HZ);
+			count = c;
+		}
+		pos = next;
+		int32_t out = encoder_velocity_update(&v, count, edge, (uint32_t)(uint64_t)((t + dt) * CPU_HZ));
+		if (++k == publish) {
+			k = 0;
+			diff = (double)(count - published) * 1000.0 / CONF_ENCODER_PUBLISH_MS;
+			published = count;
+		}
+
+		if (t < settle_s) continue;
+		double e = (double)out / ENCODER_VELOCITY_SCALE - speed;
+		err_mt += e * e;
+		err_diff += (diff - speed) * (diff - speed);
+		power += speed * speed;
+		if (fabs(e) / speed > worst) worst = fabs(e) / speed;
+	}
+	return (result_t){ sqrt(err_mt / power), sqrt(err_diff / power), worst };
+}
+
+int main(void)
+{
+	const double speeds[] = { 0.1, 1.0, 10.0, 100.0, 1000.0, 10000.0 };
+	for (uint32_t m = 0; m < 2; m++) {
+		bool exact = (m == 0);
+		for (uint32_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+			result_t r = replay(speeds[i], exact);
+			printf("%s %8.1f counts/s: M/T %6.2f %% rms (%6.2f %% worst), per %u ms period %8.2f %% rms\n",
+			       exact ? "edge-stamped" : "sampled     ", speeds[i], 100.0 * r.rms_mt, 100.0 * r.worst_mt,
+			       (unsigned)CONF_ENCODER_PUBLISH_MS, 100.0 * r.rms_diff);
+			TEST_CHECK(r.rms_mt < 0.05);
+			TEST_CHECK(r.rms_mt < r.rms_diff || speeds[i] >= 1000.0); // Differencing only keeps up at high speed
+		}
+	}
+
+	// Cost of an update, half of them with a new edge
+	encoder_velocity_t v;
+	encoder_velocity_init(&v, CPU_HZ, CONF_ENCODER_VELOCITY_WINDOW_MS * 1000u, CONF_ENCODER_VELOCITY_STOP_MS);
+	const uint32_t runs = 1000000;
+	uint64_t min = UINT64_MAX, sum = 0;
+	volatile int32_t sink = 0;
+	for (uint32_t i = 0; i < runs; i++) {
+		uint32_t now = i * 12000u; // 10 kHz
+		uint64_t start = test_cost_now();
+		sink += encoder_velocity_update(&v, (int32_t)(i / 2u), now, now);
+		uint64_t cost = test_cost_now() - start;
+		sum += cost;
+		if (cost < min) min = cost;
+	}
+	(void)sink;
+	printf("encoder_velocity_update(): min %llu, avg %.1f %s per update\n", (unsigned long long)min,
+	       (double)sum / runs, TEST_COST_UNIT);
+
+	return test_result("encoder_velocity");
+}
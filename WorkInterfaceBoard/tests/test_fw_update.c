@@ -0,0 +1,347 @@
+/* fw_update and fw_image against a simulated EFC through the fw_flash_t
+ * vtable. Programming only clears bits, as on the real flash, so a page
+ * programmed without an erase shows up as corruption. A power cut can be
+ * armed at any flash operation: that operation is left half done (half a
+ * page programmed, or a record page erased but not written) and every later
+ * one fails until the next "reset", after which fw_image_boot() runs again
+ * as the bootloader would. Staging is erased as the data arrives, never
+ * more than one erase per request.
+ */
+#include "test_host.h"
+#include "fw_update.h"
+#include "fw_image.h"
+#include <string.h>
+
+#define FLASH_SIZE   (FW_STAGING_ADDR + FW_SLOT_SIZE - FW_FLASH_BASE)
+
+typedef struct {
+	uint8_t mem[FLASH_SIZE];
+	uint32_t ops;       // Flash operations since the last reset
+	int64_t cut_at;     // Operation the power fails in, -1 for none
+	bool dead;          // Power is gone until the next reset
+	uint32_t overwrites; // Pages programmed over bits already at 0
+	uint32_t erases;
+} efc_sim_t;
+
+static efc_sim_t g_efc;
+
+static uint8_t *efc_at(uint32_t addr)
+{
+	uint32_t off = addr - FW_FLASH_BASE;
+	TEST_CHECK(addr >= FW_FLASH_BASE && off < FLASH_SIZE);
+	return &g_efc.mem[off % FLASH_SIZE];
+}
+
+// False if the power is gone; true if the op may run; *cut set if it is the one the power fails in
+static bool efc_begin(bool *cut)
+{
+	*cut = false;
+	if (g_efc.dead) return false;
+	if ((int64_t)g_efc.ops++ == g_efc.cut_at) {
+		g_efc.dead = true;
+		*cut = true;
+	}
+	return true;
+}
+
+static void efc_program(uint32_t addr, const uint32_t *data, uint32_t len)
+{
+	uint8_t *p = efc_at(addr);
+	const uint8_t *src = (const uint8_t *)data;
+	for (uint32_t i = 0; i < len; i++) {
+		if ((p[i] & src[i]) != src[i]) g_efc.overwrites++;
+		p[i] &= src[i];
+	}
+}
+
+static bool efc_erase(void *ctx, uint32_t addr)
+{
+	bool cut;
+	TEST_CHECK((addr - FW_FLASH_BASE) % FW_ERASE_SIZE == 0);
+	TEST_CHECK(addr >= FW_APP_ADDR); // The boot and record sectors are never erased in blocks
+	if (!efc_begin(&cut)) return false;
+	g_efc.erases++;
+	memset(efc_at(addr), 0xFF, cut ? FW_ERASE_SIZE / 2u : FW_ERASE_SIZE);
+	return !cut;
+}
+
+static bool efc_write_page(void *ctx, uint32_t addr, const uint32_t *data)
+{
+	bool cut;
+	TEST_CHECK((addr - FW_FLASH_BASE) % FW_PAGE_SIZE == 0);
+	if (!efc_begin(&cut)) return false;
+	efc_program(addr, data, cut ? FW_PAGE_SIZE / 2u : FW_PAGE_SIZE);
+	return !cut;
+}
+
+static bool efc_rewrite_page(void *ctx, uint32_t addr, const uint32_t *data)
+{
+	bool cut;
+	TEST_CHECK(addr == FW_RECORD_ADDR_A || addr == FW_RECORD_ADDR_B);
+	if (!efc_begin(&cut)) return false;
+	memset(efc_at(addr), 0xFF, FW_PAGE_SIZE); // EWP: the erase half happens first
+	if (!cut) efc_program(addr, data, FW_PAGE_SIZE);
+	return !cut;
+}
+
+static void efc_read(void *ctx, uint32_t addr, void *buf, uint32_t len)
+{
+	memcpy(buf, efc_at(addr), len);
+}
+
+static const fw_flash_t g_flash = { efc_erase, efc_write_page, efc_rewrite_page, efc_read, &g_efc };
+
+static void efc_reset(int64_t cut_at)
+{
+	g_efc.ops = 0;
+	g_efc.cut_at = cut_at;
+	g_efc.dead = false;
+}
+
+// Image data of the given seed
+static void make_image(uint8_t *img, uint32_t size, uint32_t seed)
+{
+	for (uint32_t i = 0; i < size; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		img[i] = (uint8_t)(seed >> 24);
+	}
+}
+
+// Erased flash, an installed old image in the app slot and its record
+static void efc_factory(const uint8_t *old, uint32_t size)
+{
+	memset(g_efc.mem, 0xFF, sizeof(g_efc.mem));
+	memcpy(efc_at(FW_APP_ADDR), old, size);
+	efc_reset(-1);
+	g_efc.overwrites = 0;
+	TEST_CHECK(fw_record_write(&g_flash, FW_RECORD_INSTALLED, size, fw_crc32(0, old, size)));
+}
+
+static uint32_t put32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+	return 4;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static fw_update_t g_update;
+static uint8_t g_reply[FW_UPDATE_REPLY_MAX];
+static uint32_t g_erases_max; // Most erases one request made
+
+// One request; returns the status byte, or -1 for a malformed reply
+static int request(const uint8_t *req, uint32_t len)
+{
+	uint32_t erases = g_efc.erases;
+	uint32_t n = fw_update_handle(&g_update, req, len, g_reply, sizeof(g_reply));
+	if (g_efc.erases - erases > g_erases_max) g_erases_max = g_efc.erases - erases;
+	if (n < 2 || g_reply[0] != (uint8_t)(req[0] | FW_UPDATE_REPLY)) return -1;
+	return g_reply[1];
+}
+
+static int begin(uint32_t size, uint32_t crc)
+{
+	uint8_t req[9] = { FW_UPDATE_CMD_BEGIN };
+	put32(&req[1], size);
+	put32(&req[5], crc);
+	return request(req, sizeof(req));
+}
+
+static int data(const uint8_t *img, uint32_t size, uint32_t offset)
+{
+	static uint8_t req[FW_UPDATE_MSG_MAX];
+	uint32_t n = size - offset;
+	if (n > FW_UPDATE_BLOCK) n = FW_UPDATE_BLOCK;
+	req[0] = FW_UPDATE_CMD_DATA;
+	put32(&req[1], offset);
+	memcpy(&req[5], &img[offset], n);
+	return request(req, 5u + n);
+}
+
+static int end(void)
+{
+	uint8_t req[1] = { FW_UPDATE_CMD_END };
+	return request(req, sizeof(req));
+}
+
+// BEGIN, every block (each sent twice when resend is set, as after a lost reply), END
+static int transfer(const uint8_t *img, uint32_t size, uint32_t crc, bool resend)
+{
+	fw_update_init(&g_update, &g_flash);
+	if (begin(size, crc) != FW_UPDATE_OK) return -1;
+	for (uint32_t off = 0; off < size; off += FW_UPDATE_BLOCK) {
+		if (data(img, size, off) != FW_UPDATE_OK) return -1;
+		uint32_t next = get32(&g_reply[2]);
+		TEST_CHECK(next == ((size - off > FW_UPDATE_BLOCK) ? off + FW_UPDATE_BLOCK : size));
+		if (resend) {
+			TEST_CHECK(data(img, size, off) == FW_UPDATE_OK);
+			TEST_CHECK(get32(&g_reply[2]) == next); // Acknowledged again, nothing written
+		}
+	}
+	return end();
+}
+
+static bool slot_holds(uint32_t addr, const uint8_t *img, uint32_t size)
+{
+	return memcmp(efc_at(addr), img, size) == 0;
+}
+
+static uint32_t record_state(void)
+{
+	fw_record_t rec;
+	return fw_record_newest(&g_flash, &rec, NULL) ? rec.state : 0;
+}
+
+#define OLD_SIZE   5000u
+#define NEW_SIZE   (3u * FW_UPDATE_BLOCK + 700u) // Last block and last page partial
+
+static uint8_t g_old[OLD_SIZE], g_new[NEW_SIZE];
+
+static void test_update_and_install(void)
+{
+	efc_factory(g_old, OLD_SIZE);
+	memset(efc_at(FW_STAGING_ADDR), 0x00, FW_SLOT_SIZE); // Left over from an earlier transfer
+	uint32_t crc = fw_crc32(0, g_new, NEW_SIZE);
+	fw_update_init(&g_update, &g_flash);
+	g_efc.erases = 0;
+	TEST_CHECK(begin(NEW_SIZE, crc) == FW_UPDATE_OK && g_efc.erases == 0); // Nothing erased up front
+	g_erases_max = 0;
+	TEST_CHECK(transfer(g_new, NEW_SIZE, crc, true) == FW_UPDATE_OK);
+	TEST_CHECK(g_erases_max == 1 && g_update.stats.erases == (NEW_SIZE + FW_ERASE_SIZE - 1u) / FW_ERASE_SIZE);
+	TEST_CHECK(g_update.stats.repeats == (NEW_SIZE + FW_UPDATE_BLOCK - 1u) / FW_UPDATE_BLOCK);
+	TEST_CHECK(g_update.stats.pages == (NEW_SIZE + FW_PAGE_SIZE - 1u) / FW_PAGE_SIZE); // Repeats wrote nothing
+	TEST_CHECK(g_efc.overwrites == 0);
+	TEST_CHECK(slot_holds(FW_STAGING_ADDR, g_new, NEW_SIZE));
+	TEST_CHECK(record_state() == FW_RECORD_PENDING);
+	TEST_CHECK(slot_holds(FW_APP_ADDR, g_old, OLD_SIZE)); // The running app is untouched until the reset
+
+	efc_reset(-1);
+	TEST_CHECK(fw_image_boot(&g_flash) == FW_BOOT_INSTALLED);
+	TEST_CHECK(slot_holds(FW_APP_ADDR, g_new, NEW_SIZE));
+	TEST_CHECK(record_state() == FW_RECORD_INSTALLED);
+	TEST_CHECK(g_efc.overwrites == 0);
+	efc_reset(-1);
+	TEST_CHECK(fw_image_boot(&g_flash) == FW_BOOT_RUN); // Installed once only
+}
+
+// A gap is refused with the offset expected; END before the last block is refused
+static void test_gap(void)
+{
+	efc_factory(g_old, OLD_SIZE);
+	fw_update_init(&g_update, &g_flash);
+	TEST_CHECK(begin(NEW_SIZE, fw_crc32(0, g_new, NEW_SIZE)) == FW_UPDATE_OK);
+	TEST_CHECK(data(g_new, NEW_SIZE, 0) == FW_UPDATE_OK);
+	TEST_CHECK(data(g_new, NEW_SIZE, 2u * FW_UPDATE_BLOCK) == FW_UPDATE_ERR_OFFSET);
+	TEST_CHECK(get32(&g_reply[2]) == FW_UPDATE_BLOCK);
+	TEST_CHECK(end() == FW_UPDATE_ERR_STATE);
+	TEST_CHECK(record_state() == FW_RECORD_INSTALLED);
+}
+
+static void test_crc_mismatch(void)
+{
+	efc_factory(g_old, OLD_SIZE);
+	uint32_t crc = fw_crc32(0, g_new, NEW_SIZE);
+	TEST_CHECK(transfer(g_new, NEW_SIZE, crc ^ 1u, false) == FW_UPDATE_ERR_CRC);
+	TEST_CHECK(record_state() == FW_RECORD_INSTALLED); // No pending record for a bad image
+	TEST_CHECK(fw_image_boot(&g_flash) == FW_BOOT_RUN);
+	TEST_CHECK(slot_holds(FW_APP_ADDR, g_old, OLD_SIZE));
+
+	// Staging damaged after END: the bootloader checks again and keeps the old app
+	efc_factory(g_old, OLD_SIZE);
+	TEST_CHECK(transfer(g_new, NEW_SIZE, crc, false) == FW_UPDATE_OK);
+	*efc_at(FW_STAGING_ADDR + 100u) ^= 0x10u; // One bit flipped
+	TEST_CHECK(fw_image_boot(&g_flash) == FW_BOOT_REJECTED);
+	TEST_CHECK(record_state() == FW_RECORD_REJECTED);
+	TEST_CHECK(slot_holds(FW_APP_ADDR, g_old, OLD_SIZE));
+	TEST_CHECK(fw_image_boot(&g_flash) == FW_BOOT_RUN);
+}
+
+/* Power cut at every flash operation of END and of the install, then resets
+ * until the bootloader settles: the board always ends up running a whole
+ * image, the new one once the PENDING record made it to flash. */
+static void test_power_cuts(void)
+{
+	uint32_t crc = fw_crc32(0, g_new, NEW_SIZE);
+
+	// Operations of the last DATA flush, CRC read-back and PENDING record write at END
+	efc_factory(g_old, OLD_SIZE);
+	fw_update_init(&g_update, &g_flash);
+	TEST_CHECK(begin(NEW_SIZE, crc) == FW_UPDATE_OK);
+	for (uint32_t off = 0; off < NEW_SIZE; off += FW_UPDATE_BLOCK) TEST_CHECK(data(g_new, NEW_SIZE, off) == FW_UPDATE_OK);
+	static efc_sim_t before_end;
+	fw_update_t update_before_end = g_update;
+	before_end = g_efc;
+	efc_reset(-1);
+	TEST_CHECK(end() == FW_UPDATE_OK);
+	uint32_t end_ops = g_efc.ops;
+
+	uint32_t kept_old = 0, got_new = 0;
+	for (uint32_t cut = 0; cut < end_ops; cut++) {
+		g_efc = before_end;
+		g_update = update_before_end;
+		efc_reset(cut);
+		TEST_CHECK(end() != FW_UPDATE_OK);
+		efc_reset(-1);
+		fw_boot_result_t r = fw_image_boot(&g_flash);
+		if (r == FW_BOOT_RUN) {
+			TEST_CHECK(slot_holds(FW_APP_ADDR, g_old, OLD_SIZE) && record_state() == FW_RECORD_INSTALLED);
+			kept_old++;
+		} else {
+			TEST_CHECK(r == FW_BOOT_INSTALLED && slot_holds(FW_APP_ADDR, g_new, NEW_SIZE));
+			got_new++;
+		}
+	}
+	printf("power cut in END, at each of its %u flash operations: old app kept %u times, new installed %u\n",
+	       (unsigned)end_ops, (unsigned)kept_old, (unsigned)got_new);
+	TEST_CHECK(kept_old == end_ops); // The PENDING write is END's last op, so a cut in it loses the update
+
+	// Operations of the install: erase, copy, verify, INSTALLED record
+	efc_factory(g_old, OLD_SIZE);
+	TEST_CHECK(transfer(g_new, NEW_SIZE, crc, false) == FW_UPDATE_OK);
+	static efc_sim_t pending;
+	pending = g_efc;
+	efc_reset(-1);
+	TEST_CHECK(fw_image_boot(&g_flash) == FW_BOOT_INSTALLED);
+	uint32_t boot_ops = g_efc.ops;
+
+	uint32_t between_records = 0;
+	for (uint32_t cut = 0; cut < boot_ops; cut++) {
+		g_efc = pending;
+		efc_reset(cut);
+		(void)fw_image_boot(&g_flash);
+		if (cut == boot_ops - 1u) {
+			// Between the two record writes: copied, PENDING still in force, INSTALLED not written
+			TEST_CHECK(slot_holds(FW_APP_ADDR, g_new, NEW_SIZE) && record_state() == FW_RECORD_PENDING);
+			between_records++;
+		}
+		uint32_t boots = 0;
+		fw_boot_result_t r;
+		do {
+			efc_reset(-1);
+			r = fw_image_boot(&g_flash);
+			boots++;
+		} while (r == FW_BOOT_INSTALLED && boots < 3);
+		TEST_CHECK(r == FW_BOOT_RUN && boots == 2); // Installs again once, then runs
+		TEST_CHECK(slot_holds(FW_APP_ADDR, g_new, NEW_SIZE));
+		TEST_CHECK(record_state() == FW_RECORD_INSTALLED);
+	}
+	printf("power cut in install: all %u flash operations recovered on the next boot\n", (unsigned)boot_ops);
+	TEST_CHECK(between_records == 1);
+}
+
+int main(void)
+{
+	make_image(g_old, OLD_SIZE, 1);
+	make_image(g_new, NEW_SIZE, 2);
+	test_update_and_install();
+	test_gap();
+	test_crc_mismatch();
+	test_power_cuts();
+	return test_result("fw_update");
+}
@@ -0,0 +1,219 @@
+/* A whole image update as can_fwu_task serves it: a tester link sends BEGIN,
+ * every DATA block and END over ISO-TP to the node's fwu link on a simulated
+ * 500 kbit/s bus, and waits for each reply before the next request. The node
+ * runs fw_update on a simulated flash that takes 1.5 ms per page write and
+ * 40 ms per erase, during which the bus is idle as on the board (interrupts
+ * masked, tester waiting). Reports the image throughput in bytes/s against
+ * what the consecutive frames could carry on the bus alone.
+ */
+#include "test_host.h"
+#include "can_isotp_link.h"
+#include "fw_update.h"
+#include "fw_image.h"
+#include <string.h>
+
+#define BUS_BPS      500000u
+#define QUEUE_LEN    32u
+#define PAGE_US      1500u
+#define ERASE_US     40000u
+#define IMAGE_SIZE   (200u * 1024u)
+#define FLASH_SIZE   (FW_STAGING_ADDR + FW_SLOT_SIZE - FW_FLASH_BASE)
+
+enum { TESTER, NODE };
+
+typedef struct {
+	uint8_t from; // Link index
+	uint8_t len;
+	uint8_t data[8];
+} wire_t;
+
+static wire_t g_queue[QUEUE_LEN];
+static uint32_t g_head, g_count;
+
+static can_isotp_link_t g_link[2];
+static uint8_t g_tester_tx[FW_UPDATE_MSG_MAX], g_tester_rx[FW_UPDATE_REPLY_MAX];
+static uint8_t g_node_tx[FW_UPDATE_REPLY_MAX], g_node_rx[FW_UPDATE_MSG_MAX];
+
+static uint8_t g_flash_mem[FLASH_SIZE];
+static uint64_t g_flash_us; // Time the flash operations of one request took
+static uint64_t g_flash_total_us;
+
+static bool emit(void *ctx, const uint8_t *data, uint8_t len)
+{
+	if (g_count == QUEUE_LEN) return false;
+	wire_t *w = &g_queue[(g_head + g_count++) % QUEUE_LEN];
+	w->from = (uint8_t)(uintptr_t)ctx;
+	w->len = len;
+	memcpy(w->data, data, len);
+	return true;
+}
+
+// Classic data frame with an 11-bit ID: 47 bits of framing plus the worst case stuff bits
+static uint64_t frame_us(uint8_t len)
+{
+	uint32_t bits = 47u + 8u * len + (34u + 8u * len - 1u) / 4u;
+	return (uint64_t)bits * 1000000u / BUS_BPS;
+}
+
+static uint8_t *flash_at(uint32_t addr)
+{
+	TEST_CHECK(addr >= FW_FLASH_BASE && addr - FW_FLASH_BASE < FLASH_SIZE);
+	return &g_flash_mem[(addr - FW_FLASH_BASE) % FLASH_SIZE];
+}
+
+static bool flash_erase(void *ctx, uint32_t addr)
+{
+	memset(flash_at(addr), 0xFF, FW_ERASE_SIZE);
+	g_flash_us += ERASE_US;
+	return true;
+}
+
+static bool flash_write_page(void *ctx, uint32_t addr, const uint32_t *data)
+{
+	uint8_t *p = flash_at(addr);
+	const uint8_t *src = (const uint8_t *)data;
+	for (uint32_t i = 0; i < FW_PAGE_SIZE; i++) p[i] &= src[i];
+	g_flash_us += PAGE_US;
+	return true;
+}
+
+static bool flash_rewrite_page(void *ctx, uint32_t addr, const uint32_t *data)
+{
+	memcpy(flash_at(addr), data, FW_PAGE_SIZE);
+	g_flash_us += ERASE_US + PAGE_US;
+	return true;
+}
+
+static void flash_read(void *ctx, uint32_t addr, void *buf, uint32_t len)
+{
+	memcpy(buf, flash_at(addr), len);
+}
+
+static const fw_flash_t g_flash = { flash_erase, flash_write_page, flash_rewrite_page, flash_read, NULL };
+static fw_update_t g_update;
+
+static void setup_link(can_isotp_link_t *link, uint8_t index, uint8_t *tx, uint16_t tx_size, uint8_t *rx,
+                       uint16_t rx_size)
+{
+	memset(link, 0, sizeof(*link));
+	link->emit = emit;
+	link->ctx = (void *)(uintptr_t)index;
+	link->tx_buf = tx;
+	link->tx_size = tx_size;
+	link->rx_buf = rx;
+	link->rx_size = rx_size;
+	link->block_size = 0; // As the fwu row of conf_can_isotp.h
+	link->st_min = 0;
+	can_isotp_link_init(link);
+}
+
+// Run the bus and the timers until link to has a message waiting; returns the time reached
+static uint64_t run(uint64_t now, uint32_t to)
+{
+	while (!can_isotp_link_rx_ready(&g_link[to])) {
+		if (g_count != 0) {
+			wire_t w = g_queue[g_head];
+			g_head = (g_head + 1u) % QUEUE_LEN;
+			g_count--;
+			now += frame_us(w.len);
+			can_isotp_link_on_tx_done(&g_link[w.from], now);
+			can_isotp_link_on_frame(&g_link[w.from ^ 1u], w.data, w.len, now);
+			continue;
+		}
+		uint64_t next = can_isotp_link_next_event(&g_link[TESTER]);
+		uint64_t t = can_isotp_link_next_event(&g_link[NODE]);
+		if (t < next) next = t;
+		if (next == CAN_ISOTP_NO_EVENT) break;
+		if (next > now) now = next;
+		can_isotp_link_poll(&g_link[TESTER], now);
+		can_isotp_link_poll(&g_link[NODE], now);
+	}
+	return now;
+}
+
+static uint32_t put32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+	return 4;
+}
+
+// One request from the tester and can_fwu_task's reply; returns the status byte, -1 if none came back
+static int request(uint64_t *now, const uint8_t *req, uint32_t len)
+{
+	TEST_CHECK(can_isotp_link_send(&g_link[TESTER], req, len, *now));
+	*now = run(*now, NODE);
+
+	static uint8_t got[FW_UPDATE_MSG_MAX];
+	int32_t n = can_isotp_link_read(&g_link[NODE], got, sizeof(got));
+	if (n < 0) return -1;
+	uint8_t reply[FW_UPDATE_REPLY_MAX];
+	g_flash_us = 0;
+	uint32_t reply_len = fw_update_handle(&g_update, got, (uint32_t)n, reply, sizeof(reply));
+	*now += g_flash_us; // Bus idle: the node's interrupts are masked, the tester waits
+	g_flash_total_us += g_flash_us;
+	TEST_CHECK(can_isotp_link_send(&g_link[NODE], reply, reply_len, *now));
+	*now = run(*now, TESTER);
+
+	uint8_t back[FW_UPDATE_REPLY_MAX];
+	if (can_isotp_link_read(&g_link[TESTER], back, sizeof(back)) < 2 || back[0] != (uint8_t)(req[0] | FW_UPDATE_REPLY)) {
+		return -1;
+	}
+	return back[1];
+}
+
+int main(void)
+{
+	static uint8_t image[IMAGE_SIZE];
+	uint32_t seed = 3u;
+	for (uint32_t i = 0; i < IMAGE_SIZE; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		image[i] = (uint8_t)(seed >> 24);
+	}
+	memset(g_flash_mem, 0x00, sizeof(g_flash_mem)); // Staging not erased yet
+	setup_link(&g_link[TESTER], TESTER, g_tester_tx, sizeof(g_tester_tx), g_tester_rx, sizeof(g_tester_rx));
+	setup_link(&g_link[NODE], NODE, g_node_tx, sizeof(g_node_tx), g_node_rx, sizeof(g_node_rx));
+	fw_update_init(&g_update, &g_flash);
+
+	uint64_t now = 0;
+	uint32_t crc = fw_crc32(0, image, IMAGE_SIZE);
+	uint8_t begin[9] = { FW_UPDATE_CMD_BEGIN };
+	put32(&begin[1], IMAGE_SIZE);
+	put32(&begin[5], crc);
+	TEST_CHECK(request(&now, begin, sizeof(begin)) == FW_UPDATE_OK);
+
+	static uint8_t data[FW_UPDATE_MSG_MAX];
+	uint64_t data_start = now;
+	bool ok = true;
+	for (uint32_t off = 0; off < IMAGE_SIZE && ok; off += FW_UPDATE_BLOCK) {
+		uint32_t n = IMAGE_SIZE - off;
+		if (n > FW_UPDATE_BLOCK) n = FW_UPDATE_BLOCK;
+		data[0] = FW_UPDATE_CMD_DATA;
+		put32(&data[1], off);
+		memcpy(&data[5], &image[off], n);
+		ok = (request(&now, data, 5u + n) == FW_UPDATE_OK);
+	}
+	TEST_CHECK(ok);
+	uint64_t data_us = now - data_start;
+	uint8_t end[1] = { FW_UPDATE_CMD_END };
+	TEST_CHECK(request(&now, end, sizeof(end)) == FW_UPDATE_OK);
+
+	TEST_CHECK(memcmp(flash_at(FW_STAGING_ADDR), image, IMAGE_SIZE) == 0);
+	fw_record_t rec;
+	TEST_CHECK(fw_record_newest(&g_flash, &rec, NULL) && rec.state == FW_RECORD_PENDING && rec.crc == crc);
+	TEST_CHECK(g_link[TESTER].stats.tx_stalled == 0 && g_link[NODE].stats.rx_overflow == 0);
+
+	double limit = 7.0 * 1e6 / (double)frame_us(8); // A CF carries 7 bytes in one 8-byte frame
+	double rate = (double)IMAGE_SIZE * 1e6 / (double)data_us;
+	printf("%u-byte image in %u-byte blocks at %u kbit/s: %.0f bytes/s (%.0f %% of the %.0f bytes/s the CFs "
+	       "carry), %u pages, %u erases, flash busy %.0f %% of the transfer, %.2f s in all\n",
+	       (unsigned)IMAGE_SIZE, (unsigned)FW_UPDATE_BLOCK, (unsigned)(BUS_BPS / 1000u), rate, 100.0 * rate / limit,
+	       limit, (unsigned)g_update.stats.pages, (unsigned)g_update.stats.erases,
+	       100.0 * (double)g_flash_total_us / (double)now, (double)now / 1e6);
+	TEST_CHECK(g_update.stats.erases == IMAGE_SIZE / FW_ERASE_SIZE);
+	TEST_CHECK(rate > 0.7 * limit);
+
+	return test_result("fw_update_link");
+}
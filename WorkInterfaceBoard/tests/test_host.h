@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Shared bits of the host tests: a check that reports and fails the run,
+ * a monotonic clock and a cycle counter for the benchmarks. */
+
+static int test_failures;
+
+#define TEST_CHECK(cond) do { \
+	if (!(cond)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		test_failures++; \
+	} \
+} while (0)
+
+// Print the outcome and return the exit status for main()
+static inline int test_result(const char *name)
+{
+	printf("%s: %s\n", name, test_failures ? "FAILED" : "ok");
+	return test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static inline uint64_t test_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Cost of a code path: the time stamp counter where there is one, else ns
+#if defined(__x86_64__) || defined(__i386__)
+#define TEST_COST_UNIT "TSC cycles"
+static inline uint64_t test_cost_now(void)
+{
+	uint32_t lo, hi;
+	__asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+#else
+#define TEST_COST_UNIT "ns"
+static inline uint64_t test_cost_now(void) { return test_now_ns(); }
+#endif
+
+// Mailbox status registers are read-only in the device headers; mocks set them
+#define TEST_SET_RO(reg, value) (*(volatile uint32_t *)&(reg) = (value))